@@ -290,6 +290,7 @@ EXTEND_ARRAY_CLASS_METHODS(StructuredBufferList)
 // list of array types. These are the concrete types used in rdcarray that will be bound
 // If you get an error with add_your_use_of_rdcarray_to_swig_interface missing, add your type here
 // or in qrenderdoc.i, depending on which one is appropriate
+TEMPLATE_ARRAY_INSTANTIATE(rdcarray, bool)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, int)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, float)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, uint32_t)
@@ -325,6 +326,7 @@ TEMPLATE_ARRAY_INSTANTIATE(rdcarray, DebugVariableReference)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, SourceVariableMapping)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, SigParameter)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, TextureDescription)
+TEMPLATE_ARRAY_INSTANTIATE(rdcarray, TextureSave)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, ShaderEntryPoint)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, Viewport)
 TEMPLATE_ARRAY_INSTANTIATE(rdcarray, Scissor)
@@ -145,6 +145,14 @@ struct ExtRefcount<SDChunk *> : public ActiveRefcounter<SDChunk>
 template <>
 struct TypeConversion<SDChunk *, false> : public RefcountConverter<SDChunk>
 {
+  // python can access data.children directly and hold onto the children, so lazily populated
+  // chunks must be populated and kept that way before they are handed out. Mutable access does that
+  static PyObject *ConvertToPy(SDChunk *const &in)
+  {
+    if(in)
+      in->GetChildren();
+    return RefcountConverter<SDChunk>::ConvertToPy(in);
+  }
 };
 
 template <>
@@ -216,6 +224,13 @@ struct ExtRefcount<SDFile *>
 template <>
 struct TypeConversion<SDObject *, false> : public RefcountConverter<SDObject>
 {
+  // see the SDChunk conversion above
+  static PyObject *ConvertToPy(SDObject *const &in)
+  {
+    if(in)
+      in->PopulateChildren();
+    return RefcountConverter<SDObject>::ConvertToPy(in);
+  }
 };
 
 template <>
@@ -154,6 +154,7 @@ void APIInspector::fillAPIView()
 
         root->setText(1, chunk->name);
 
+        chunk->PopulateChildren();
         addStructuredObjects(root, chunk->data.children, false);
       }
       else
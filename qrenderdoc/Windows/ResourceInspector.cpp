@@ -315,6 +315,7 @@ void ResourceInspector::Inspect(ResourceId id)
 
         root->setText(0, chunkObj->name);
 
+        chunkObj->PopulateChildren();
         addStructuredObjects(root, chunkObj->data.children, false);
       }
       else
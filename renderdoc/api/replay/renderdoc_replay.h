@@ -885,6 +885,39 @@ completed, further calls will return an empty list.
 )");
   virtual rdcarray<ShaderDebugState> ContinueDebug(ShaderDebugger *debugger) = 0;
 
+  DOCUMENT(R"(Continue a shader's debugging in the same way as :meth:`ContinueDebug`, but keep the
+new states in a compact packed form instead of returning them. Any stored state can then be fetched
+with :meth:`GetDebugStates` without unpacking the ones before it, which avoids holding every state
+of a long trace in memory at once.
+
+:param ShaderDebugger debugger: The shader debugger to continue running.
+:return: The number of new states. If this is 0, the debugging process has completed.
+:rtype: int
+)");
+  virtual uint32_t AdvanceDebug(ShaderDebugger *debugger) = 0;
+
+  DOCUMENT(R"(Retrieve how many states have been stored for a shader debugger by
+:meth:`AdvanceDebug`.
+
+:param ShaderDebugger debugger: The shader debugger to query.
+:return: The number of stored states.
+:rtype: int
+)");
+  virtual uint32_t GetNumDebugStates(ShaderDebugger *debugger) = 0;
+
+  DOCUMENT(R"(Retrieve a range of the states stored for a shader debugger by :meth:`AdvanceDebug`.
+
+Only the requested states are unpacked, so this can seek to any step of a trace directly.
+
+:param ShaderDebugger debugger: The shader debugger to retrieve states from.
+:param int first: The index of the first state to return.
+:param int count: The number of states to return. This is clamped to the stored states.
+:return: The requested states.
+:rtype: ``list`` of :class:`ShaderDebugState`
+)");
+  virtual rdcarray<ShaderDebugState> GetDebugStates(ShaderDebugger *debugger, uint32_t first,
+                                                    uint32_t count) = 0;
+
   DOCUMENT(R"(Free a debugging trace from running a shader invocation debug.
 
 :param ShaderDebugTrace trace: The shader debugging trace to free.
@@ -929,6 +962,24 @@ texture to something compatible with the target file format.
 )");
   virtual bool SaveTexture(const TextureSave &saveData, const char *path) = 0;
 
+  DOCUMENT(R"(Save several textures to files on disk, as if by calling :meth:`SaveTexture` for each.
+
+Each texture's data is read back in turn while previously fetched textures are converted and written
+out on worker threads, so this is faster than saving the textures one by one. The amount of
+fetched data waiting to be written is bounded by the ``Replay.TextureSaveMemoryMB`` setting.
+
+:param List[TextureSave] saveData: The configuration settings of each texture to save, and how.
+:param List[str] paths: The path on disk to save each texture to. Must be the same length as
+  :paramref:`saveData`, and each path should be distinct.
+:param ProgressCallback progress: A callback that will be repeatedly called with an updated progress
+  value for the whole batch. Can be ``None`` if no progress is desired.
+:return: Whether each texture was saved successfully, in the same order as :paramref:`saveData`.
+:rtype: ``list`` of ``bool``
+)");
+  virtual rdcarray<bool> SaveTextures(const rdcarray<TextureSave> &saveData,
+                                      const rdcarray<rdcstr> &paths,
+                                      RENDERDOC_ProgressCallback progress) = 0;
+
   DOCUMENT(R"(Retrieve the generated data from one of the geometry processing shader stages.
 
 :param int instance: The index of the instance to retrieve data for, or 0 for non-instanced draws.
@@ -86,6 +86,8 @@ rdcstr DoStringise(const ReplayStatus &el)
                                "Failed to install Android remote server for unknown reasons");
     STRINGISE_ENUM_CLASS_NAMED(AndroidAPKVerifyFailed,
                                "Failed to verify installed Android remote server");
+    STRINGISE_ENUM_CLASS_NAMED(NetworkRemoteCaptureTooLarge,
+                               "Capture is larger than the remote server allows");
   }
   END_ENUM_STRINGISE();
 }
@@ -1066,6 +1068,7 @@ rdcstr DoStringise(const SectionFlags &el)
     STRINGISE_BITFIELD_CLASS_BIT_NAMED(ASCIIStored, "Stored as ASCII");
     STRINGISE_BITFIELD_CLASS_BIT_NAMED(LZ4Compressed, "Compressed with LZ4");
     STRINGISE_BITFIELD_CLASS_BIT_NAMED(ZstdCompressed, "Compressed with Zstd");
+    STRINGISE_BITFIELD_CLASS_BIT_NAMED(BlockIndexed, "Block indexed");
   }
   END_BITFIELD_STRINGISE();
 }
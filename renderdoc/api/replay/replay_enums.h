@@ -3439,6 +3439,10 @@ a remote server.
 .. data:: AndroidAPKVerifyFailed
 
   Failed to install Android remote server.
+
+.. data:: NetworkRemoteCaptureTooLarge
+
+  The uncompressed capture is larger than the remote server allows a replay session to open.
 )");
 enum class ReplayStatus : uint32_t
 {
@@ -3467,6 +3471,7 @@ enum class ReplayStatus : uint32_t
   AndroidAPKFolderNotFound,
   AndroidAPKInstallFailed,
   AndroidAPKVerifyFailed,
+  NetworkRemoteCaptureTooLarge,
 };
 
 DECLARE_REFLECTION_ENUM(ReplayStatus);
@@ -3783,6 +3788,11 @@ DOCUMENT(R"(A set of flags describing the properties of a section in a renderdoc
 .. data:: ZstdCompressed
 
   This section is compressed with Zstd on disk.
+
+.. data:: BlockIndexed
+
+  This section is compressed in independent blocks, with an index of the blocks stored after them
+  on disk. This allows the section to be decompressed in parallel and read from any offset.
 )");
 enum class SectionFlags : uint32_t
 {
@@ -3790,6 +3800,7 @@ enum class SectionFlags : uint32_t
   ASCIIStored = 0x1,
   LZ4Compressed = 0x2,
   ZstdCompressed = 0x4,
+  BlockIndexed = 0x8,
 };
 
 BITMASK_OPERATORS(SectionFlags);
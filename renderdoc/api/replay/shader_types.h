@@ -228,7 +228,7 @@ struct ShaderVariable
     displayAsHex = isStruct = rowMajor = false;
     type = VarType::Unknown;
     for(int i = 0; i < 16; i++)
-      value.uv[i] = 0;
+      value.u64v[i] = 0;
   }
   ShaderVariable(const ShaderVariable &) = default;
   ShaderVariable &operator=(const ShaderVariable &) = default;
@@ -239,7 +239,7 @@ struct ShaderVariable
     columns = 4;
     displayAsHex = isStruct = rowMajor = false;
     for(int i = 0; i < 16; i++)
-      value.uv[i] = 0;
+      value.u64v[i] = 0;
     type = VarType::Float;
     value.f.x = x;
     value.f.y = y;
@@ -253,7 +253,7 @@ struct ShaderVariable
     columns = 4;
     displayAsHex = isStruct = rowMajor = false;
     for(int i = 0; i < 16; i++)
-      value.uv[i] = 0;
+      value.u64v[i] = 0;
     type = VarType::SInt;
     value.i.x = x;
     value.i.y = y;
@@ -267,7 +267,7 @@ struct ShaderVariable
     columns = 4;
     displayAsHex = isStruct = rowMajor = false;
     for(int i = 0; i < 16; i++)
-      value.uv[i] = 0;
+      value.u64v[i] = 0;
     type = VarType::UInt;
     value.u.x = x;
     value.u.y = y;
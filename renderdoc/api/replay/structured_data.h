@@ -162,6 +162,30 @@ DECLARE_REFLECTION_ENUM(SDTypeFlags);
 struct SDObject;
 struct SDChunk;
 
+#if !defined(SWIG)
+// structured objects are allocated through these rather than the array functions, so that they can
+// be bulk-allocated from an arena owned by the library but still be freed individually.
+struct SDObjectArena;
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_FreeStructuredMem(void *mem);
+typedef void(RENDERDOC_CC *pRENDERDOC_FreeStructuredMem)(void *mem);
+
+extern "C" RENDERDOC_API void *RENDERDOC_CC RENDERDOC_AllocStructuredMem(uint64_t sz,
+                                                                        SDObjectArena *arena);
+typedef void *(RENDERDOC_CC *pRENDERDOC_AllocStructuredMem)(uint64_t sz, SDObjectArena *arena);
+
+// chunks in a lazily populated structured file only hold their children while they're being
+// accessed, see SDObject::PopulateChildren. If keep is true the chunk stays populated permanently.
+struct SDObjectLazyData;
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_PopulateLazyStructuredObject(SDObject *obj,
+                                                                                bool keep);
+typedef void(RENDERDOC_CC *pRENDERDOC_PopulateLazyStructuredObject)(SDObject *obj, bool keep);
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_ReleaseLazyStructuredObject(SDObject *obj);
+typedef void(RENDERDOC_CC *pRENDERDOC_ReleaseLazyStructuredObject)(SDObject *obj);
+#endif
+
 DOCUMENT("Details the name and properties of a structured type");
 struct SDType
 {
@@ -375,26 +399,16 @@ struct SDObject
 {
   /////////////////////////////////////////////////////////////////
   // memory management, in a dll safe way
-  void *operator new(size_t sz)
+  void *operator new(size_t sz) { return RENDERDOC_AllocStructuredMem(sz, NULL); }
+  void operator delete(void *p) { RENDERDOC_FreeStructuredMem(p); }
+#if !defined(SWIG)
+  // allocate from an arena, the object can still be deleted individually as normal
+  void *operator new(size_t sz, SDObjectArena *arena)
   {
-    void *ret = NULL;
-#ifdef RENDERDOC_EXPORTS
-    ret = malloc(sz);
-    if(ret == NULL)
-      RENDERDOC_OutOfMemory(sz);
-#else
-    ret = RENDERDOC_AllocArrayMem(sz);
-#endif
-    return ret;
+    return RENDERDOC_AllocStructuredMem(sz, arena);
   }
-  void operator delete(void *p)
-  {
-#ifdef RENDERDOC_EXPORTS
-    free(p);
-#else
-    RENDERDOC_FreeArrayMem(p);
+  void operator delete(void *p, SDObjectArena *arena) { RENDERDOC_FreeStructuredMem(p); }
 #endif
-  }
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
@@ -408,6 +422,8 @@ struct SDObject
   DOCUMENT("Create a deep copy of this object.");
   SDObject *Duplicate() const
   {
+    PopulateChildren();
+
     SDObject *ret = new SDObject();
     ret->name = name;
     ret->type = type;
@@ -433,6 +449,9 @@ struct SDObject
   DOCUMENT("Checks if the given object has the same value as this one.");
   bool HasEqualValue(const SDObject *o) const
   {
+    PopulateChildren();
+    o->PopulateChildren();
+
     bool ret = true;
 
     if(data.str != o->data.str)
@@ -457,10 +476,12 @@ struct SDObject
   }
 
   DOCUMENT("Add a new child object by duplicating it.");
-  inline void AddChild(SDObject *child) { data.children.push_back(child->Duplicate()); }
+  inline void AddChild(SDObject *child) { GetChildren().push_back(child->Duplicate()); }
   DOCUMENT("Find a child object by a given name.");
   inline SDObject *FindChild(const char *childName) const
   {
+    PopulateChildren();
+
     for(size_t i = 0; i < data.children.size(); i++)
       if(data.children[i]->name == childName)
         return data.children[i];
@@ -470,6 +491,8 @@ struct SDObject
   DOCUMENT("Get a child object at a given index.");
   inline SDObject *GetChild(size_t index) const
   {
+    PopulateChildren();
+
     if(index < data.children.size())
       return data.children[index];
     return NULL;
@@ -478,6 +501,12 @@ struct SDObject
   DOCUMENT("Delete all child objects.");
   inline void DeleteChildren()
   {
+#if !defined(SWIG)
+    // drop any lazy data, the children it populated (if any) are deleted below as normal
+    if(m_Lazy)
+      RENDERDOC_ReleaseLazyStructuredObject(this);
+#endif
+
     for(size_t i = 0; i < data.children.size(); i++)
       delete data.children[i];
 
@@ -485,17 +514,57 @@ struct SDObject
   }
 
   DOCUMENT("Get the number of child objects.");
-  inline size_t NumChildren() const { return data.children.size(); }
+  inline size_t NumChildren() const
+  {
+    PopulateChildren();
+    return data.children.size();
+  }
   DOCUMENT("Get a ``list`` of :class:`SDObject` children.");
-  inline StructuredObjectList &GetChildren() { return data.children; }
+  inline StructuredObjectList &GetChildren()
+  {
+    KeepChildren();
+    return data.children;
+  }
 #if !defined(SWIG)
+  inline const StructuredObjectList &GetChildren() const
+  {
+    PopulateChildren();
+    return data.children;
+  }
+
   // these are for C++ iteration so not defined when SWIG is generating interfaces
-  inline SDObject *const *begin() const { return data.children.begin(); }
+  inline SDObject *const *begin() const
+  {
+    PopulateChildren();
+    return data.children.begin();
+  }
   inline SDObject *const *end() const { return data.children.end(); }
-  inline SDObject **begin() { return data.children.begin(); }
+  inline SDObject **begin()
+  {
+    KeepChildren();
+    return data.children.begin();
+  }
   inline SDObject **end() { return data.children.end(); }
 #endif
 
+  DOCUMENT(R"(Ensure that this object's children are available in :data:`data`.
+
+Structured data is normally fully populated and this does nothing. With the
+``Replay.LazyStructuredData`` setting enabled, chunks hold their children in a compact form and only
+populate them when accessed through the functions here. Only a limited number of recently accessed
+chunks stay populated, so child objects from read-only access should not be kept past accessing
+another chunk. Modifying the children, or passing the chunk to python, keeps it populated.
+
+Code that walks :data:`data` directly must call this first.
+)");
+  inline void PopulateChildren() const
+  {
+#if !defined(SWIG)
+    if(m_Lazy)
+      RENDERDOC_PopulateLazyStructuredObject((SDObject *)this, false);
+#endif
+  }
+
 // C++ gets more extensive typecasts. We'll add a couple for python in the interface file
 #if !defined(SWIG)
   // templated enum cast
@@ -634,6 +703,20 @@ protected:
   SDObject() {}
   SDObject(const SDObject &other) = delete;
   SDObject &operator=(const SDObject &other) = delete;
+
+#if !defined(SWIG)
+  friend struct SDObjectLazyData;
+
+  // populate and stop this chunk from being lazy, for any access that can modify the children
+  inline void KeepChildren()
+  {
+    if(m_Lazy)
+      RENDERDOC_PopulateLazyStructuredObject(this, true);
+  }
+
+  // only set for chunks in a lazily populated file
+  SDObjectLazyData *m_Lazy = NULL;
+#endif
 };
 
 DECLARE_REFLECTION_STRUCT(SDObject);
@@ -889,36 +972,31 @@ struct SDChunk : public SDObject
 {
   /////////////////////////////////////////////////////////////////
   // memory management, in a dll safe way
-  void *operator new(size_t sz)
+  void *operator new(size_t sz) { return RENDERDOC_AllocStructuredMem(sz, NULL); }
+  void operator delete(void *p) { RENDERDOC_FreeStructuredMem(p); }
+#if !defined(SWIG)
+  void *operator new(size_t sz, SDObjectArena *arena)
   {
-    void *ret = NULL;
-#ifdef RENDERDOC_EXPORTS
-    ret = malloc(sz);
-    if(ret == NULL)
-      RENDERDOC_OutOfMemory(sz);
-#else
-    ret = RENDERDOC_AllocArrayMem(sz);
-#endif
-    return ret;
+    return RENDERDOC_AllocStructuredMem(sz, arena);
   }
-  void operator delete(void *p)
-  {
-#ifdef RENDERDOC_EXPORTS
-    free(p);
-#else
-    RENDERDOC_FreeArrayMem(p);
+  void operator delete(void *p, SDObjectArena *arena) { RENDERDOC_FreeStructuredMem(p); }
 #endif
-  }
   void *operator new[](size_t count) = delete;
   void operator delete[](void *p) = delete;
 
   SDChunk(const char *name) : SDObject(name, "Chunk"_lit) { type.basetype = SDBasic::Chunk; }
+#if !defined(SWIG)
+  // chunk names are typically literals, so this avoids copying them into every chunk
+  SDChunk(const rdcstr &name) : SDObject(name, "Chunk"_lit) { type.basetype = SDBasic::Chunk; }
+#endif
   DOCUMENT("The :class:`SDChunkMetaData` with the metadata for this chunk.");
   SDChunkMetaData metadata;
 
   DOCUMENT("Create a deep copy of this chunk.");
   SDChunk *Duplicate() const
   {
+    PopulateChildren();
+
     SDChunk *ret = new SDChunk();
     ret->name = name;
     ret->metadata = metadata;
@@ -0,0 +1,433 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "bc_decode.h"
+#include "common/common.h"
+#include "compressonator/CMP_Core.h"
+#include "core/jobsystem.h"
+#include "maths/half_convert.h"
+
+namespace
+{
+// rows of blocks are grouped so each job decodes at least this many blocks
+const uint32_t BlocksPerJob = 4096;
+
+uint32_t BlockSize(ResourceFormatType type)
+{
+  return (type == ResourceFormatType::BC1 || type == ResourceFormatType::BC4) ? 8 : 16;
+}
+
+byte HalfToUNorm8(uint16_t half)
+{
+  float f = RDCCLAMP(ConvertFromHalf(half), 0.0f, 1.0f);
+  return byte(f * 255.0f + 0.5f);
+}
+
+// compressonator only decodes unsigned BC4 channels, so signed ones are handled here
+void DecodeSignedChannel(const byte *block, byte out[16])
+{
+  int32_t e0 = RDCMAX(-127, (int32_t)(int8_t)block[0]);
+  int32_t e1 = RDCMAX(-127, (int32_t)(int8_t)block[1]);
+
+  int32_t palette[8] = {e0, e1};
+  if(e0 > e1)
+  {
+    for(int32_t i = 1; i < 7; i++)
+      palette[i + 1] = ((7 - i) * e0 + i * e1) / 7;
+  }
+  else
+  {
+    for(int32_t i = 1; i < 5; i++)
+      palette[i + 1] = ((5 - i) * e0 + i * e1) / 5;
+    palette[6] = -127;
+    palette[7] = 127;
+  }
+
+  uint64_t indices = 0;
+  for(int i = 0; i < 6; i++)
+    indices |= uint64_t(block[2 + i]) << (8 * i);
+
+  for(int i = 0; i < 16; i++)
+  {
+    // remap [-127, 127] onto [0, 255] so negative values stay distinct
+    int32_t val = palette[(indices >> (3 * i)) & 0x7];
+    out[i] = byte(((val + 127) * 255 + 127) / 254);
+  }
+}
+
+void DecodeChannel(const ResourceFormat &fmt, const byte *block, byte out[16])
+{
+  if(fmt.compType == CompType::SNorm)
+    DecodeSignedChannel(block, out);
+  else
+    DecompressBlockBC4(block, out, NULL);
+}
+
+// decodes one block to a 4x4 RGBA8 tile
+void DecodeBlock(const ResourceFormat &fmt, const byte *block, byte rgba[64])
+{
+  switch(fmt.type)
+  {
+    case ResourceFormatType::BC1: DecompressBlockBC1(block, rgba, NULL); break;
+    case ResourceFormatType::BC2: DecompressBlockBC2(block, rgba, NULL); break;
+    case ResourceFormatType::BC3: DecompressBlockBC3(block, rgba, NULL); break;
+    case ResourceFormatType::BC7: DecompressBlockBC7(block, rgba, NULL); break;
+    case ResourceFormatType::BC4:
+    {
+      byte red[16];
+      DecodeChannel(fmt, block, red);
+      for(int i = 0; i < 16; i++)
+      {
+        rgba[i * 4 + 0] = red[i];
+        rgba[i * 4 + 1] = rgba[i * 4 + 2] = 0;
+        rgba[i * 4 + 3] = 255;
+      }
+      break;
+    }
+    case ResourceFormatType::BC5:
+    {
+      byte red[16], green[16];
+      DecodeChannel(fmt, block, red);
+      DecodeChannel(fmt, block + 8, green);
+      for(int i = 0; i < 16; i++)
+      {
+        rgba[i * 4 + 0] = red[i];
+        rgba[i * 4 + 1] = green[i];
+        rgba[i * 4 + 2] = 0;
+        rgba[i * 4 + 3] = 255;
+      }
+      break;
+    }
+    case ResourceFormatType::BC6:
+    {
+      uint16_t rgb[48];
+      DecompressBlockBC6(block, rgb, NULL);
+      for(int i = 0; i < 16; i++)
+      {
+        rgba[i * 4 + 0] = HalfToUNorm8(rgb[i * 3 + 0]);
+        rgba[i * 4 + 1] = HalfToUNorm8(rgb[i * 3 + 1]);
+        rgba[i * 4 + 2] = HalfToUNorm8(rgb[i * 3 + 2]);
+        rgba[i * 4 + 3] = 255;
+      }
+      break;
+    }
+    default: break;
+  }
+}
+
+void DecodeBlockRow(const ResourceFormat &fmt, const byte *src, uint32_t width, uint32_t height,
+                    uint32_t blockY, byte *dst)
+{
+  const uint32_t blockSize = BlockSize(fmt.type);
+  const uint32_t blocksWide = (width + 3) / 4;
+  const uint32_t rows = RDCMIN(4U, height - blockY * 4);
+
+  byte tile[64];
+
+  for(uint32_t blockX = 0; blockX < blocksWide; blockX++)
+  {
+    DecodeBlock(fmt, src + size_t(blocksWide * blockY + blockX) * blockSize, tile);
+
+    // clip the tile against the image edges for sizes that aren't a multiple of 4
+    const uint32_t cols = RDCMIN(4U, width - blockX * 4);
+    byte *out = dst + (size_t(blockY * 4) * width + blockX * 4) * 4;
+    for(uint32_t y = 0; y < rows; y++)
+      memcpy(out + size_t(y) * width * 4, tile + y * 16, cols * 4);
+  }
+}
+}
+
+bool CanDecodeBC(const ResourceFormat &fmt)
+{
+  switch(fmt.type)
+  {
+    case ResourceFormatType::BC1:
+    case ResourceFormatType::BC2:
+    case ResourceFormatType::BC3:
+    case ResourceFormatType::BC4:
+    case ResourceFormatType::BC5:
+    case ResourceFormatType::BC7: return true;
+    // the bundled BC6 decoder always treats the endpoints as unsigned
+    case ResourceFormatType::BC6: return fmt.compType != CompType::SNorm;
+    default: break;
+  }
+
+  return false;
+}
+
+bool DecodeBCToRGBA8(const ResourceFormat &fmt, const byte *src, size_t srcSize, uint32_t width,
+                     uint32_t height, byte *dst)
+{
+  if(!CanDecodeBC(fmt) || width == 0 || height == 0)
+    return false;
+
+  const uint32_t blocksWide = (width + 3) / 4;
+  const uint32_t blocksHigh = (height + 3) / 4;
+
+  if(srcSize < size_t(blocksWide) * blocksHigh * BlockSize(fmt.type))
+  {
+    RDCERR("Block compressed data is %zu bytes, too small for %ux%u image", srcSize, width, height);
+    return false;
+  }
+
+  const uint32_t rowsPerJob = RDCMAX(1U, BlocksPerJob / blocksWide);
+  const uint32_t numJobs = (blocksHigh + rowsPerJob - 1) / rowsPerJob;
+
+  JobSystem::ParallelFor(numJobs, [&](uint32_t job) {
+    const uint32_t end = RDCMIN(blocksHigh, (job + 1) * rowsPerJob);
+    for(uint32_t blockY = job * rowsPerJob; blockY < end; blockY++)
+      DecodeBlockRow(fmt, src, width, height, blockY, dst);
+  });
+
+  return true;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static ResourceFormat BCFormat(ResourceFormatType type, CompType compType = CompType::UNorm)
+{
+  ResourceFormat ret;
+  ret.type = type;
+  ret.compType = compType;
+  ret.compCount = 4;
+  ret.compByteWidth = 1;
+  return ret;
+}
+
+// encodes an RGBA8 image with the compressonator encoders, padding partial blocks by clamping
+static bytebuf EncodeBC(ResourceFormatType type, const bytebuf &rgba, uint32_t width,
+                        uint32_t height)
+{
+  const uint32_t blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+
+  bytebuf ret;
+  ret.resize(size_t(blocksWide) * blocksHigh * BlockSize(type));
+  byte *out = ret.data();
+
+  for(uint32_t by = 0; by < blocksHigh; by++)
+  {
+    for(uint32_t bx = 0; bx < blocksWide; bx++)
+    {
+      byte tile[64], red[16], green[16];
+      for(uint32_t i = 0; i < 16; i++)
+      {
+        uint32_t x = RDCMIN(width - 1, bx * 4 + (i % 4));
+        uint32_t y = RDCMIN(height - 1, by * 4 + (i / 4));
+        memcpy(tile + i * 4, rgba.data() + (size_t(y) * width + x) * 4, 4);
+        red[i] = tile[i * 4 + 0];
+        green[i] = tile[i * 4 + 1];
+      }
+
+      switch(type)
+      {
+        case ResourceFormatType::BC1: CompressBlockBC1(tile, 16, out, NULL); break;
+        case ResourceFormatType::BC3: CompressBlockBC3(tile, 16, out, NULL); break;
+        case ResourceFormatType::BC4: CompressBlockBC4(red, 4, out, NULL); break;
+        case ResourceFormatType::BC5: CompressBlockBC5(red, 4, green, 4, out, NULL); break;
+        case ResourceFormatType::BC7: CompressBlockBC7(tile, 16, out, NULL); break;
+        default: break;
+      }
+
+      out += BlockSize(type);
+    }
+  }
+
+  return ret;
+}
+
+TEST_CASE("Check BC block decoding", "[bc]")
+{
+  SECTION("Decoded images match the source and a serial decode")
+  {
+    // deliberately not a multiple of the block size, and tall enough to split across jobs
+    const uint32_t width = 37, height = 1203;
+
+    bytebuf rgba;
+    rgba.resize(size_t(width) * height * 4);
+    for(uint32_t y = 0; y < height; y++)
+    {
+      for(uint32_t x = 0; x < width; x++)
+      {
+        byte *px = rgba.data() + (size_t(y) * width + x) * 4;
+        px[0] = byte(x * 255 / (width - 1));
+        px[1] = byte((y % 64) * 4);
+        px[2] = byte(128 + (x % 8) * 8);
+        px[3] = 255;
+      }
+    }
+
+    const ResourceFormatType types[] = {
+        ResourceFormatType::BC1, ResourceFormatType::BC3, ResourceFormatType::BC4,
+        ResourceFormatType::BC5, ResourceFormatType::BC7,
+    };
+
+    for(ResourceFormatType type : types)
+    {
+      const ResourceFormat fmt = BCFormat(type);
+      bytebuf encoded = EncodeBC(type, rgba, width, height);
+
+      bytebuf decoded;
+      decoded.resize(rgba.size());
+      REQUIRE(DecodeBCToRGBA8(fmt, encoded.data(), encoded.size(), width, height, decoded.data()));
+
+      const uint32_t numChannels =
+          type == ResourceFormatType::BC4 ? 1 : (type == ResourceFormatType::BC5 ? 2 : 3);
+
+      int maxError = 0;
+      bool matchesSerial = true;
+      for(uint32_t y = 0; y < height; y++)
+      {
+        for(uint32_t x = 0; x < width; x++)
+        {
+          const size_t idx = (size_t(y) * width + x) * 4;
+          for(uint32_t c = 0; c < numChannels; c++)
+            maxError = RDCMAX(maxError, abs(int(decoded[idx + c]) - int(rgba[idx + c])));
+
+          for(uint32_t c = numChannels; c < 3; c++)
+            matchesSerial &= decoded[idx + c] == 0;
+        }
+      }
+
+      for(uint32_t by = 0; by < (height + 3) / 4; by++)
+      {
+        for(uint32_t bx = 0; bx < (width + 3) / 4; bx++)
+        {
+          byte tile[64];
+          DecodeBlock(fmt, encoded.data() + (by * ((width + 3) / 4) + bx) * BlockSize(type), tile);
+
+          for(uint32_t i = 0; i < 16; i++)
+          {
+            uint32_t x = bx * 4 + (i % 4), y = by * 4 + (i / 4);
+            if(x < width && y < height)
+              matchesSerial &= memcmp(tile + i * 4, decoded.data() + (y * width + x) * 4, 4) == 0;
+          }
+        }
+      }
+
+      INFO("format " << ToStr(type).c_str());
+      CHECK(matchesSerial);
+      CHECK(maxError < 24);
+    }
+  }
+
+  SECTION("Signed BC4 maps the full range")
+  {
+    // endpoints of 127 and -127, with texels using indices 0, 1, 7, 2 then 0 for the rest
+    const byte block[8] = {0x7f, 0x81, 0xc8, 0x05, 0x00, 0x00, 0x00, 0x00};
+
+    byte decoded[16 * 4];
+    REQUIRE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC4, CompType::SNorm), block,
+                            sizeof(block), 4, 4, decoded));
+
+    CHECK(decoded[0 * 4] == 255);
+    CHECK(decoded[1 * 4] == 0);
+    // (127 - 6 * 127) / 7 = -90
+    CHECK(decoded[2 * 4] == 37);
+    // (6 * 127 - 127) / 7 = 90
+    CHECK(decoded[3 * 4] == 218);
+    CHECK(decoded[4 * 4] == 255);
+    CHECK(decoded[1] == 0);
+    CHECK(decoded[3] == 255);
+
+    // zero endpoints decode to the middle of the range, and -128 is treated as -127
+    const byte zeroBlock[8] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    REQUIRE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC4, CompType::SNorm), zeroBlock,
+                            sizeof(zeroBlock), 4, 4, decoded));
+    CHECK(decoded[0] == 128);
+
+    const byte minBlock[8] = {0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+    REQUIRE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC4, CompType::SNorm), minBlock,
+                            sizeof(minBlock), 4, 4, decoded));
+    CHECK(decoded[0] == 0);
+  }
+
+  SECTION("Unsupported formats and truncated data are rejected")
+  {
+    byte data[16] = {};
+    byte decoded[8 * 4 * 4];
+
+    CHECK_FALSE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC6, CompType::SNorm), data,
+                                sizeof(data), 4, 4, decoded));
+    CHECK_FALSE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::Regular), data, sizeof(data), 4, 4,
+                                decoded));
+    CHECK_FALSE(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC7), data, sizeof(data), 8, 4,
+                                decoded));
+    CHECK(DecodeBCToRGBA8(BCFormat(ResourceFormatType::BC6, CompType::Float), data, sizeof(data),
+                          4, 4, decoded));
+  }
+}
+
+TEST_CASE("Benchmark BC block decoding", "[.][benchmark]")
+{
+  const uint32_t width = 2048, height = 2048;
+
+  // encode a handful of varied blocks and tile them across the image
+  bytebuf source;
+  source.resize(32 * 4 * 4 * 4);
+  uint32_t seed = 99;
+  for(size_t i = 0; i < source.size(); i++)
+  {
+    seed = seed * 1664525 + 1013904223;
+    source[i] = byte(seed >> 24);
+  }
+
+  const ResourceFormatType types[] = {
+      ResourceFormatType::BC1, ResourceFormatType::BC3, ResourceFormatType::BC5,
+      ResourceFormatType::BC7,
+  };
+
+  bytebuf decoded;
+  decoded.resize(size_t(width) * height * 4);
+
+  WARN("Decoding " << width << "x" << height << " images on " << JobSystem::GetNumWorkers()
+                   << " workers");
+
+  for(ResourceFormatType type : types)
+  {
+    const ResourceFormat fmt = BCFormat(type);
+    const uint32_t blockSize = BlockSize(type);
+
+    bytebuf blocks = EncodeBC(type, source, 32 * 4, 4);
+    bytebuf encoded;
+    encoded.resize(size_t(width / 4) * (height / 4) * blockSize);
+    for(size_t offs = 0; offs < encoded.size(); offs += blocks.size())
+      memcpy(encoded.data() + offs, blocks.data(), blocks.size());
+
+    const rdcstr name = ToStr(type);
+
+    BENCHMARK((name + " (serial)").c_str())
+    {
+      for(uint32_t blockY = 0; blockY < height / 4; blockY++)
+        DecodeBlockRow(fmt, encoded.data(), width, height, blockY, decoded.data());
+    }
+    BENCHMARK(name.c_str())
+    {
+      DecodeBCToRGBA8(fmt, encoded.data(), encoded.size(), width, height, decoded.data());
+    }
+  }
+}
+
+#endif
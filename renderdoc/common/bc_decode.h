@@ -0,0 +1,39 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/data_types.h"
+
+// Returns true if DecodeBCToRGBA8 can decode this format.
+bool CanDecodeBC(const ResourceFormat &fmt);
+
+// Decodes a width x height image of BC1-BC7 block compressed data on the CPU to tightly packed
+// RGBA8, without needing any replay device. Rows of blocks are decoded in parallel on the job
+// system. Channels the format doesn't store are written as 0 with alpha as 255. Signed BC4/BC5
+// channels are remapped from [-1, 1] to [0, 1], and HDR values are clamped to [0, 1].
+//
+// Returns false if the format isn't supported or srcSize is too small for the image.
+bool DecodeBCToRGBA8(const ResourceFormat &fmt, const byte *src, size_t srcSize, uint32_t width,
+                     uint32_t height, byte *dst);
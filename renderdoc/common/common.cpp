@@ -39,143 +39,350 @@ void rdcassert(const char *msg, const char *file, unsigned int line, const char
                 "Assertion failed: %s", msg);
 }
 
-#if 0
-static __m128 zero = {0};
-#endif
+// FindDiffRange and FindDiffRanges are used on every submit/unmap to compare mapped memory against
+// its shadow copy, so they're implemented with a set of kernels chosen at runtime for the widest
+// vector unit available.
+#if ENABLED(RDOC_SSE2)
 
-// assumes a and b both point to 16-byte aligned 16-byte chunks of memory.
-// Returns if they're equal or different
-bool Vec16NotEqual(void *a, void *b)
-{
-// disabled SSE version as it's acting dodgy
-#if 0
-	__m128 avec = _mm_load_ps(aflt);
-	__m128 bvec = _mm_load_ps(bflt);
-
-	__m128 diff = _mm_xor_ps(avec, bvec);
-
-	__m128 eq = _mm_cmpeq_ps(diff, zero);
-	int mask = _mm_movemask_ps(eq);
-	int signMask = _mm_movemask_ps(diff);
-
-	// first check ensures that diff is floatequal to zero (ie. avec bitwise equal to bvec).
-	// HOWEVER -0 is floatequal to 0, so we ensure no sign bits are set on diff
-	if((mask^0xf) || signMask != 0)
-	{
-		return true;
-	}
-	
-	return false;
-#elif ENABLED(RDOC_X64)
-  uint64_t *a64 = (uint64_t *)a;
-  uint64_t *b64 = (uint64_t *)b;
-
-  return a64[0] != b64[0] || a64[1] != b64[1];
-#else
-  uint32_t *a32 = (uint32_t *)a;
-  uint32_t *b32 = (uint32_t *)b;
+#include <emmintrin.h>
+#include <immintrin.h>
+
+#if ENABLED(RDOC_MSVS)
+#include <intrin.h>
+#endif
 
-  return a32[0] != b32[0] || a32[1] != b32[1] || a32[2] != b32[2] || a32[3] != b32[3];
 #endif
+
+namespace
+{
+// returns the offset of the first byte that differs, or size if the buffers are identical
+typedef size_t (*FirstDiffFunc)(const byte *a, const byte *b, size_t size);
+// returns one past the offset of the last byte that differs, or 0 if the buffers are identical
+typedef size_t (*LastDiffFunc)(const byte *a, const byte *b, size_t size);
+// returns the offset of the first kernel-sized chunk (relative to a/b) that is entirely identical,
+// or size if every chunk contains a difference
+typedef size_t (*FirstEqualChunkFunc)(const byte *a, const byte *b, size_t size);
+
+struct DiffKernels
+{
+  const char *name;
+  FirstDiffFunc FirstDiff;
+  LastDiffFunc LastDiff;
+  FirstEqualChunkFunc FirstEqualChunk;
+};
+
+inline uint64_t Load64(const byte *p)
+{
+  uint64_t ret;
+  memcpy(&ret, p, sizeof(ret));
+  return ret;
 }
 
-bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd)
+size_t FirstDiff_Scalar(const byte *a, const byte *b, size_t size)
 {
-  RDCASSERT(uintptr_t(a) % 16 == 0);
-  RDCASSERT(uintptr_t(b) % 16 == 0);
+  size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+    if(Load64(a + i) != Load64(b + i))
+      break;
 
-  diffStart = bufSize + 1;
-  diffEnd = 0;
+  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE
+  while(i < size && a[i] == b[i])
+    i++;
 
-  size_t alignedSize = bufSize & (~0xf);
-  size_t numVecs = alignedSize / 16;
+  return i;
+}
+
+size_t LastDiff_Scalar(const byte *a, const byte *b, size_t size)
+{
+  size_t i = size;
+  for(; i >= 8; i -= 8)
+    if(Load64(a + i - 8) != Load64(b + i - 8))
+      break;
 
-  size_t offs = 0;
+  while(i > 0 && a[i - 1] == b[i - 1])
+    i--;
 
-  float *aflt = (float *)a;
-  float *bflt = (float *)b;
+  return i;
+}
+
+size_t FirstEqualChunk_Scalar(const byte *a, const byte *b, size_t size)
+{
+  for(size_t i = 0; i + 8 <= size; i += 8)
+    if(Load64(a + i) == Load64(b + i))
+      return i;
+
+  return size;
+}
+
+#if ENABLED(RDOC_SSE2)
+
+inline uint32_t EqualMask16(const byte *a, const byte *b)
+{
+  __m128i va = _mm_loadu_si128((const __m128i *)a);
+  __m128i vb = _mm_loadu_si128((const __m128i *)b);
+  return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb));
+}
 
-  // sweep to find the start of differences
-  for(size_t v = 0; v < numVecs; v++)
+inline bool Equal64_SSE2(const byte *a, const byte *b)
+{
+  __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 0)),
+                             _mm_loadu_si128((const __m128i *)(b + 0)));
+  __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 16)),
+                             _mm_loadu_si128((const __m128i *)(b + 16)));
+  __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 32)),
+                             _mm_loadu_si128((const __m128i *)(b + 32)));
+  __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(a + 48)),
+                             _mm_loadu_si128((const __m128i *)(b + 48)));
+
+  __m128i any = _mm_or_si128(_mm_or_si128(x0, x1), _mm_or_si128(x2, x3));
+
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) == 0xffff;
+}
+
+size_t FirstDiff_SSE2(const byte *a, const byte *b, size_t size)
+{
+  size_t i = 0;
+
+  // check 64 bytes at a time with only one movemask, then narrow down
+  for(; i + 64 <= size; i += 64)
+    if(!Equal64_SSE2(a + i, b + i))
+      break;
+
+  for(; i + 16 <= size; i += 16)
   {
-    if(Vec16NotEqual(aflt, bflt))
-    {
-      diffStart = offs;
+    uint32_t mask = EqualMask16(a + i, b + i);
+    if(mask != 0xffff)
+      return i + Bits::CountTrailingZeroes(~mask);
+  }
+
+  return i + FirstDiff_Scalar(a + i, b + i, size - i);
+}
+
+size_t LastDiff_SSE2(const byte *a, const byte *b, size_t size)
+{
+  size_t i = size;
+
+  for(; i >= 64; i -= 64)
+    if(!Equal64_SSE2(a + i - 64, b + i - 64))
       break;
-    }
 
-    aflt += 4;
-    bflt += 4;
-    offs += 4 * sizeof(float);
+  for(; i >= 16; i -= 16)
+  {
+    uint32_t mask = ~EqualMask16(a + i - 16, b + i - 16) & 0xffff;
+    if(mask != 0)
+      return i - 16 + (32 - Bits::CountLeadingZeroes(mask));
   }
 
-  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE
-  while(diffStart < bufSize && *((byte *)a + diffStart) == *((byte *)b + diffStart))
-    diffStart++;
+  return LastDiff_Scalar(a, b, i);
+}
+
+size_t FirstEqualChunk_SSE2(const byte *a, const byte *b, size_t size)
+{
+  for(size_t i = 0; i + 16 <= size; i += 16)
+    if(EqualMask16(a + i, b + i) == 0xffff)
+      return i;
 
-  // do we have some unaligned bytes at the end of the buffer?
-  if(bufSize > alignedSize)
+  return size;
+}
+
+AVX2_FUNCTION inline uint32_t EqualMask32(const byte *a, const byte *b)
+{
+  __m256i va = _mm256_loadu_si256((const __m256i *)a);
+  __m256i vb = _mm256_loadu_si256((const __m256i *)b);
+  return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb));
+}
+
+AVX2_FUNCTION inline bool Equal128_AVX2(const byte *a, const byte *b)
+{
+  __m256i x0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 0)),
+                                _mm256_loadu_si256((const __m256i *)(b + 0)));
+  __m256i x1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 32)),
+                                _mm256_loadu_si256((const __m256i *)(b + 32)));
+  __m256i x2 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 64)),
+                                _mm256_loadu_si256((const __m256i *)(b + 64)));
+  __m256i x3 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(a + 96)),
+                                _mm256_loadu_si256((const __m256i *)(b + 96)));
+
+  __m256i any = _mm256_or_si256(_mm256_or_si256(x0, x1), _mm256_or_si256(x2, x3));
+
+  return _mm256_testz_si256(any, any) != 0;
+}
+
+AVX2_FUNCTION size_t FirstDiff_AVX2(const byte *a, const byte *b, size_t size)
+{
+  size_t i = 0;
+
+  for(; i + 128 <= size; i += 128)
+    if(!Equal128_AVX2(a + i, b + i))
+      break;
+
+  for(; i + 32 <= size; i += 32)
   {
-    size_t numBytes = bufSize - alignedSize;
+    uint32_t mask = EqualMask32(a + i, b + i);
+    if(mask != 0xffffffff)
+      return i + Bits::CountTrailingZeroes(~mask);
+  }
 
-    // if we haven't even found a start, check in these bytes
-    if(diffStart > bufSize)
-    {
-      offs = alignedSize;
+  return i + FirstDiff_SSE2(a + i, b + i, size - i);
+}
 
-      for(size_t by = 0; by < numBytes; by++)
-      {
-        if(*((byte *)a + alignedSize + by) != *((byte *)b + alignedSize + by))
-        {
-          diffStart = offs;
-          break;
-        }
+AVX2_FUNCTION size_t LastDiff_AVX2(const byte *a, const byte *b, size_t size)
+{
+  size_t i = size;
 
-        offs++;
-      }
-    }
+  for(; i >= 128; i -= 128)
+    if(!Equal128_AVX2(a + i - 128, b + i - 128))
+      break;
 
-    // sweep from the last byte to find the end
-    for(size_t by = 0; by < numBytes; by++)
-    {
-      if(*((byte *)a + bufSize - 1 - by) != *((byte *)b + bufSize - 1 - by))
-      {
-        diffEnd = bufSize - by;
-        break;
-      }
-    }
+  for(; i >= 32; i -= 32)
+  {
+    uint32_t mask = ~EqualMask32(a + i - 32, b + i - 32);
+    if(mask != 0)
+      return i - 32 + (32 - Bits::CountLeadingZeroes(mask));
   }
 
-  // if we haven't found a start, or we've found a start AND and end,
-  // then we're done.
-  if(diffStart > bufSize || diffEnd > 0)
-    return diffStart < bufSize;
+  return LastDiff_SSE2(a, b, i);
+}
+
+AVX2_FUNCTION size_t FirstEqualChunk_AVX2(const byte *a, const byte *b, size_t size)
+{
+  for(size_t i = 0; i + 32 <= size; i += 32)
+    if(EqualMask32(a + i, b + i) == 0xffffffff)
+      return i;
+
+  return size;
+}
+
+#endif    // ENABLED(RDOC_SSE2)
+
+const DiffKernels scalarKernels = {
+    "Scalar", &FirstDiff_Scalar, &LastDiff_Scalar, &FirstEqualChunk_Scalar,
+};
+
+#if ENABLED(RDOC_SSE2)
+const DiffKernels sse2Kernels = {
+    "SSE2", &FirstDiff_SSE2, &LastDiff_SSE2, &FirstEqualChunk_SSE2,
+};
+
+const DiffKernels avx2Kernels = {
+    "AVX2", &FirstDiff_AVX2, &LastDiff_AVX2, &FirstEqualChunk_AVX2,
+};
+#endif
+
+const DiffKernels &GetDiffKernels()
+{
+#if ENABLED(RDOC_SSE2)
+  static const DiffKernels &kernels = CPUHasAVX2() ? avx2Kernels : sse2Kernels;
+  return kernels;
+#else
+  return scalarKernels;
+#endif
+}
+
+bool FindDiffRange(const DiffKernels &kernels, const byte *a, const byte *b, size_t bufSize,
+                   size_t &diffStart, size_t &diffEnd)
+{
+  diffStart = bufSize + 1;
+  diffEnd = 0;
+
+  size_t start = kernels.FirstDiff(a, b, bufSize);
+
+  if(start >= bufSize)
+    return false;
 
-  offs = alignedSize;
+  // if we found a start then we necessarily have an end, and it's no earlier than the start
+  diffStart = start;
+  diffEnd = start + kernels.LastDiff(a + start, b + start, bufSize - start);
 
-  // sweep from the last __m128
-  aflt = (float *)a + offs / sizeof(float) - 4;
-  bflt = (float *)b + offs / sizeof(float) - 4;
+  return true;
+}
+
+bool FindDiffRanges(const DiffKernels &kernels, const byte *a, const byte *b, size_t bufSize,
+                    size_t mergeGap, rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  ranges.clear();
 
-  for(size_t v = 0; v < numVecs; v++)
+  size_t pos = 0;
+  while(pos < bufSize)
   {
-    if(Vec16NotEqual(aflt, bflt))
-    {
-      diffEnd = offs;
+    size_t start = pos + kernels.FirstDiff(a + pos, b + pos, bufSize - pos);
+
+    if(start >= bufSize)
       break;
+
+    size_t end = start + 1;
+    pos = bufSize;
+
+    while(end < bufSize)
+    {
+      // skip over chunks that contain differences until we hit one that's entirely identical, then
+      // find exactly where the last difference before it is.
+      size_t eq = end + kernels.FirstEqualChunk(a + end, b + end, bufSize - end);
+      end += kernels.LastDiff(a + end, b + end, eq - end);
+
+      if(eq >= bufSize)
+        break;
+
+      size_t next = eq + kernels.FirstDiff(a + eq, b + eq, bufSize - eq);
+
+      if(next >= bufSize)
+        break;
+
+      // if the identical run is long enough, this range is done and the next one starts here
+      if(next - end >= mergeGap)
+      {
+        pos = next;
+        break;
+      }
+
+      end = next + 1;
     }
 
-    aflt -= 4;
-    bflt -= 4;
-    offs -= 16;
+    ranges.push_back({start, end});
   }
 
-  // make sure we're byte-accurate, to comply with WRITE_NO_OVERWRITE
-  while(diffEnd > 0 && *((byte *)a + diffEnd - 1) == *((byte *)b + diffEnd - 1))
-    diffEnd--;
+  return !ranges.empty();
+}
+}
 
-  // if we found a start then we necessarily found an end
-  return diffStart < bufSize;
+bool CPUHasAVX2()
+{
+#if ENABLED(RDOC_SSE2)
+#if ENABLED(RDOC_MSVS)
+  int info[4];
+  __cpuid(info, 0);
+  if(info[0] < 7)
+    return false;
+
+  // AVX and OSXSAVE, and the OS must be saving the upper halves of the YMM registers
+  __cpuid(info, 1);
+  if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return false;
+  if((_xgetbv(0) & 0x6) != 0x6)
+    return false;
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+#else
+  return false;
+#endif
+}
+
+bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd)
+{
+  return FindDiffRange(GetDiffKernels(), (const byte *)a, (const byte *)b, bufSize, diffStart,
+                       diffEnd);
+}
+
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  return FindDiffRanges(GetDiffKernels(), (const byte *)a, (const byte *)b, bufSize, mergeGap,
+                        ranges);
 }
 
 uint32_t CalcNumMips(int w, int h, int d)
@@ -501,3 +708,223 @@ void rdclog_direct(time_t utcTime, uint32_t pid, LogType type, const char *proje
 
   SAFE_DELETE_ARRAY(oversizedBuffer);
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static rdcarray<const DiffKernels *> GetTestDiffKernels()
+{
+  rdcarray<const DiffKernels *> ret = {&scalarKernels};
+#if ENABLED(RDOC_SSE2)
+  ret.push_back(&sse2Kernels);
+  if(CPUHasAVX2())
+    ret.push_back(&avx2Kernels);
+#endif
+  return ret;
+}
+
+TEST_CASE("Test finding differences in buffers", "[diffrange]")
+{
+  // deterministic pseudo-random sequence so failures are reproducible
+  uint32_t seed = 0x1234567;
+  auto rnd = [&seed]() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  };
+
+  const size_t maxSize = 4096 + 64;
+
+  bytebuf bufA, bufB;
+  bufA.resize(maxSize);
+  bufB.resize(maxSize);
+
+  for(size_t i = 0; i < maxSize; i++)
+    bufA[i] = byte(rnd() & 0xff);
+
+  SECTION("Identical buffers")
+  {
+    for(const DiffKernels *kernels : GetTestDiffKernels())
+    {
+      INFO("Kernels: " << kernels->name);
+
+      for(size_t size : {0, 1, 15, 16, 17, 64, 127, 128, 129, 4096})
+      {
+        size_t s = 0, e = 0;
+        CHECK_FALSE(FindDiffRange(*kernels, bufA.data(), bufA.data(), size, s, e));
+        CHECK(s == size + 1);
+        CHECK(e == 0);
+
+        rdcarray<rdcpair<size_t, size_t>> ranges;
+        CHECK_FALSE(FindDiffRanges(*kernels, bufA.data(), bufA.data(), size, 0, ranges));
+        CHECK(ranges.empty());
+      }
+    }
+  };
+
+  SECTION("Single byte differences")
+  {
+    for(const DiffKernels *kernels : GetTestDiffKernels())
+    {
+      INFO("Kernels: " << kernels->name);
+
+      // test every position in a buffer that covers all the vector and tail paths, with both
+      // aligned and unaligned starting pointers
+      for(size_t align : {0, 1, 7})
+      {
+        const size_t size = 300;
+        byte *a = bufA.data() + align;
+        byte *b = bufB.data() + align;
+        memcpy(b, a, size);
+
+        for(size_t pos = 0; pos < size; pos++)
+        {
+          b[pos] ^= 0x80;
+
+          size_t s = 0, e = 0;
+          CHECK(FindDiffRange(*kernels, a, b, size, s, e));
+          CHECK(s == pos);
+          CHECK(e == pos + 1);
+
+          rdcarray<rdcpair<size_t, size_t>> ranges;
+          CHECK(FindDiffRanges(*kernels, a, b, size, 0, ranges));
+          REQUIRE(ranges.size() == 1);
+          CHECK(ranges[0].first == pos);
+          CHECK(ranges[0].second == pos + 1);
+
+          b[pos] ^= 0x80;
+        }
+      }
+    }
+  };
+
+  SECTION("Random differences")
+  {
+    for(const DiffKernels *kernels : GetTestDiffKernels())
+    {
+      INFO("Kernels: " << kernels->name);
+
+      for(int iter = 0; iter < 200; iter++)
+      {
+        const size_t align = rnd() % 16;
+        const size_t size = rnd() % (maxSize - align);
+        const size_t mergeGap = rnd() % 512;
+
+        byte *a = bufA.data() + align;
+        byte *b = bufB.data() + align;
+        memcpy(b, a, size);
+
+        // a mix of isolated bytes and runs of modified data
+        const uint32_t numChanges = size > 0 ? rnd() % 16 : 0;
+        for(uint32_t c = 0; c < numChanges; c++)
+        {
+          size_t start = rnd() % size;
+          size_t len = RDCMIN(size - start, size_t((rnd() % 4) == 0 ? rnd() % 200 : 1));
+          for(size_t i = start; i < start + len; i++)
+            b[i] = byte(a[i] + 1 + (rnd() % 255));
+        }
+
+        size_t first = size, last = 0;
+        for(size_t i = 0; i < size; i++)
+        {
+          if(a[i] != b[i])
+          {
+            first = RDCMIN(first, i);
+            last = i + 1;
+          }
+        }
+
+        size_t s = 0, e = 0;
+        bool found = FindDiffRange(*kernels, a, b, size, s, e);
+        CHECK(found == (first < size));
+        if(found)
+        {
+          CHECK(s == first);
+          CHECK(e == last);
+        }
+
+        rdcarray<rdcpair<size_t, size_t>> ranges;
+        CHECK(FindDiffRanges(*kernels, a, b, size, mergeGap, ranges) == found);
+
+        // every range must start and end on a difference, be in order, and be separated by at
+        // least mergeGap identical bytes
+        for(size_t r = 0; r < ranges.size(); r++)
+        {
+          REQUIRE(ranges[r].first < ranges[r].second);
+          CHECK(a[ranges[r].first] != b[ranges[r].first]);
+          CHECK(a[ranges[r].second - 1] != b[ranges[r].second - 1]);
+
+          if(r > 0)
+          {
+            REQUIRE(ranges[r].first > ranges[r - 1].second);
+            CHECK(ranges[r].first - ranges[r - 1].second >= mergeGap);
+            for(size_t i = ranges[r - 1].second; i < ranges[r].first; i++)
+              REQUIRE(a[i] == b[i]);
+          }
+        }
+
+        if(found)
+        {
+          CHECK(ranges[0].first == first);
+          CHECK(ranges.back().second == last);
+        }
+      }
+    }
+  };
+};
+
+TEST_CASE("Benchmark finding differences in mapped buffers", "[.][benchmark]")
+{
+  for(size_t size : {size_t(64 * 1024), size_t(4 * 1024 * 1024), size_t(256 * 1024 * 1024)})
+  {
+    byte *a = AllocAlignedBuffer(size);
+    byte *b = AllocAlignedBuffer(size);
+
+    memset(a, 0x3c, size);
+    memset(b, 0x3c, size);
+
+    size_t s = 0, e = 0;
+    rdcarray<rdcpair<size_t, size_t>> ranges;
+
+    // an unmodified buffer has to be scanned in full, which is the common case for large maps
+    WARN("Unmodified buffer of " << size / 1024 << " KB");
+
+    for(const DiffKernels *kernels : GetTestDiffKernels())
+    {
+      rdcstr single = rdcstr(kernels->name) + " FindDiffRange";
+      rdcstr multi = rdcstr(kernels->name) + " FindDiffRanges";
+
+      BENCHMARK(single.c_str()) { FindDiffRange(*kernels, a, b, size, s, e); }
+      BENCHMARK(multi.c_str()) { FindDiffRanges(*kernels, a, b, size, 4096, ranges); }
+    }
+
+    // one byte changed at each end of the buffer - the worst case for a single min/max range
+    b[100]++;
+    b[size - 100]++;
+
+    WARN("Buffer of " << size / 1024 << " KB modified at each end");
+
+    for(const DiffKernels *kernels : GetTestDiffKernels())
+    {
+      rdcstr single = rdcstr(kernels->name) + " FindDiffRange";
+      rdcstr multi = rdcstr(kernels->name) + " FindDiffRanges";
+
+      BENCHMARK(single.c_str()) { FindDiffRange(*kernels, a, b, size, s, e); }
+      BENCHMARK(multi.c_str()) { FindDiffRanges(*kernels, a, b, size, 4096, ranges); }
+    }
+
+    size_t multiBytes = 0;
+    for(const rdcpair<size_t, size_t> &r : ranges)
+      multiBytes += r.second - r.first;
+
+    WARN("Single range covers " << (e - s) << " bytes, " << ranges.size()
+                                << " disjoint ranges cover " << multiBytes << " bytes");
+
+    FreeAlignedBuffer(a);
+    FreeAlignedBuffer(b);
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -187,9 +187,32 @@ inline T AlignUpPtr(T x, A a)
 #define MAKE_FOURCC(a, b, c, d) \
   (((uint32_t)(d) << 24) | ((uint32_t)(c) << 16) | ((uint32_t)(b) << 8) | (uint32_t)(a))
 
+template <typename T>
+struct rdcarray;
+template <typename A, typename B>
+struct rdcpair;
+
+// finds the first and last bytes that differ between a and b, returning [diffStart, diffEnd).
+// Returns false if the buffers are identical.
 bool FindDiffRange(void *a, void *b, size_t bufSize, size_t &diffStart, size_t &diffEnd);
+// finds each disjoint [start, end) range where a and b differ. Ranges separated by fewer than
+// mergeGap identical bytes are merged together. Returns false if the buffers are identical.
+bool FindDiffRanges(const void *a, const void *b, size_t bufSize, size_t mergeGap,
+                    rdcarray<rdcpair<size_t, size_t>> &ranges);
 uint32_t CalcNumMips(int Width, int Height, int Depth);
 
+// whether the CPU and OS support AVX2, for code that picks its vector kernels at runtime. Always
+// false on non-x86 platforms.
+bool CPUHasAVX2();
+
+// marks a function that uses AVX2 intrinsics, so it can be compiled without enabling AVX2 for the
+// whole file. It must only be called after CPUHasAVX2() returns true
+#if ENABLED(RDOC_MSVS)
+#define AVX2_FUNCTION
+#else
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
 typedef uint8_t byte;
 
 byte *AllocAlignedBuffer(uint64_t size, uint64_t alignment = 64);
@@ -24,7 +24,9 @@
 
 #include "dds_readwrite.h"
 #include <stdint.h>
+#include "common/bc_decode.h"
 #include "common/common.h"
+#include "maths/formatpacking.h"
 #include "os/os_specific.h"
 #include "serialise/streamio.h"
 
@@ -920,10 +922,10 @@ bool is_dds_file(byte *headerBuffer, size_t size)
   return memcmp(headerBuffer, &dds_fourcc, 4) == 0;
 }
 
-dds_data load_dds_from_file(StreamReader *reader)
+static bool parse_dds_layout(StreamReader *reader, dds_layout &layout)
 {
-  dds_data ret = {};
-  dds_data error = {};
+  dds_data &ret = layout.data;
+  ret = dds_data();
 
   uint64_t fileSize = reader->GetSize();
 
@@ -980,7 +982,7 @@ dds_data load_dds_from_file(StreamReader *reader)
     if(ret.format.type == ResourceFormatType::Undefined)
     {
       RDCWARN("Unsupported DXGI_FORMAT: %u", (uint32_t)headerDXT10.dxgiFormat);
-      return error;
+      return false;
     }
   }
   else if(header.ddspf.dwFlags & DDPF_FOURCC)
@@ -1031,8 +1033,8 @@ dds_data load_dds_from_file(StreamReader *reader)
       case 114: ret.format = DXGIFormat2ResourceFormat(DXGI_FORMAT_R32_FLOAT); break;
       case 115: ret.format = DXGIFormat2ResourceFormat(DXGI_FORMAT_R32G32_FLOAT); break;
       case 116: ret.format = DXGIFormat2ResourceFormat(DXGI_FORMAT_R32G32B32A32_FLOAT); break;
-      case 117: RDCERR("Legacy CxV8U8 format is unsupported"); return error;
-      default: RDCWARN("Unsupported FourCC: %08x", header.ddspf.dwFourCC); return error;
+      case 117: RDCERR("Legacy CxV8U8 format is unsupported"); return false;
+      default: RDCWARN("Unsupported FourCC: %08x", header.ddspf.dwFourCC); return false;
     }
   }
   else
@@ -1041,7 +1043,7 @@ dds_data load_dds_from_file(StreamReader *reader)
        header.ddspf.dwRGBBitCount != 16 && header.ddspf.dwRGBBitCount != 8)
     {
       RDCWARN("Unsupported RGB bit count: %u", header.ddspf.dwRGBBitCount);
-      return error;
+      return false;
     }
 
     ret.format.compByteWidth = 1;
@@ -1081,7 +1083,7 @@ dds_data load_dds_from_file(StreamReader *reader)
     case ResourceFormatType::D16S8:
     case ResourceFormatType::R4G4:
       RDCERR("Unsupported file format %u", ret.format.type);
-      return error;
+      return false;
     default: bytesPerPixel = ret.format.compCount * ret.format.compByteWidth;
   }
 
@@ -1102,7 +1104,7 @@ dds_data load_dds_from_file(StreamReader *reader)
       case ResourceFormatType::EAC:
       case ResourceFormatType::ASTC:
         RDCERR("Unsupported file format, %u", ret.format.type);
-        return error;
+        return false;
       default: break;
     }
   }
@@ -1111,11 +1113,16 @@ dds_data load_dds_from_file(StreamReader *reader)
      uint64_t(ret.slices * ret.mips) > fileSize)
   {
     RDCERR("Invalid slice count %u or mip count %u", ret.slices, ret.mips);
-    return ret;
+    return false;
   }
 
-  ret.subsizes = new uint32_t[ret.slices * ret.mips];
-  ret.subdata = new byte *[ret.slices * ret.mips];
+  layout.bgrSwap = bgrSwap;
+  layout.bytesPerPixel = bytesPerPixel;
+  layout.offsets.resize(ret.slices * ret.mips);
+  layout.sizes.resize(ret.slices * ret.mips);
+
+  // subresources are tightly packed after the header, each slice's full mip chain in turn
+  uint64_t offset = reader->GetOffset();
 
   int i = 0;
   for(uint32_t slice = 0; slice < ret.slices; slice++)
@@ -1141,45 +1148,332 @@ dds_data load_dds_from_file(StreamReader *reader)
         pitch = RDCMAX(blockSize, (((rowlen + 3) / 4)) * blockSize);
       }
 
-      ret.subsizes[i] = numdepths * numRows * pitch;
+      layout.offsets[i] = offset;
+      layout.sizes[i] = numdepths * numRows * pitch;
 
-      byte *bytedata = ret.subdata[i] = new byte[ret.subsizes[i]];
+      offset += layout.sizes[i];
 
-      for(uint32_t d = 0; d < numdepths; d++)
-      {
-        for(uint32_t row = 0; row < numRows; row++)
-        {
-          reader->Read(bytedata, pitch);
+      i++;
+    }
+  }
 
-          if(bgrSwap)
-          {
-            byte *rgba = bytedata;
-
-            if(bytesPerPixel >= 3)
-            {
-              for(uint32_t p = 0; p < rowlen; p++)
-              {
-                std::swap(rgba[0], rgba[2]);
-                rgba += bytesPerPixel;
-              }
-            }
-            else
-            {
-              for(uint32_t p = 0; p < rowlen; p++)
-              {
-                std::swap(rgba[0], rgba[1]);
-                rgba += bytesPerPixel;
-              }
-            }
-          }
+  return true;
+}
 
-          bytedata += pitch;
-        }
+// rows are tightly packed so the swap can run over the whole subresource at once
+static void swap_dds_channels(byte *data, uint32_t size, uint32_t bytesPerPixel)
+{
+  const uint32_t swapIdx = bytesPerPixel >= 3 ? 2 : 1;
+
+  for(uint32_t p = 0; p + bytesPerPixel <= size; p += bytesPerPixel)
+    std::swap(data[p], data[p + swapIdx]);
+}
+
+dds_data load_dds_from_file(StreamReader *reader)
+{
+  dds_layout layout;
+  if(!parse_dds_layout(reader, layout))
+    return dds_data();
+
+  dds_data ret = layout.data;
+
+  const uint32_t numSubs = ret.slices * ret.mips;
+
+  ret.subsizes = new uint32_t[numSubs];
+  ret.subdata = new byte *[numSubs];
+
+  for(uint32_t i = 0; i < numSubs; i++)
+  {
+    ret.subsizes[i] = layout.sizes[i];
+    ret.subdata[i] = new byte[ret.subsizes[i]];
+
+    reader->Read(ret.subdata[i], ret.subsizes[i]);
+
+    if(layout.bgrSwap)
+      swap_dds_channels(ret.subdata[i], ret.subsizes[i], layout.bytesPerPixel);
+  }
+
+  return ret;
+}
+
+DDSReader *DDSReader::Open(FILE *f, const rdcstr &filename)
+{
+  if(!f)
+    return NULL;
+
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t fileSize = FileIO::ftell64(f);
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  StreamReader reader(f, fileSize, Ownership::Stream);
+
+  DDSReader *ret = new DDSReader(filename);
+
+  if(!parse_dds_layout(&reader, ret->m_Layout))
+  {
+    delete ret;
+    return NULL;
+  }
+
+  return ret;
+}
+
+uint32_t DDSReader::GetSubresourceSize(uint32_t subresource) const
+{
+  if(subresource >= m_Layout.sizes.size())
+    return 0;
+
+  return m_Layout.sizes[subresource];
+}
+
+bool DDSReader::ReadSubresource(uint32_t subresource, bytebuf &data)
+{
+  if(subresource >= m_Layout.sizes.size())
+  {
+    RDCERR("Invalid DDS subresource %u", subresource);
+    return false;
+  }
+
+  FILE *f = FileIO::fopen(m_Filename.c_str(), "rb");
+
+  if(!f)
+  {
+    RDCERR("Couldn't re-open DDS file %s", m_Filename.c_str());
+    return false;
+  }
+
+  // the file may have been truncated or rewritten since the header was parsed
+  FileIO::fseek64(f, 0, SEEK_END);
+  uint64_t fileSize = FileIO::ftell64(f);
+
+  if(m_Layout.offsets[subresource] + m_Layout.sizes[subresource] > fileSize)
+  {
+    RDCERR("DDS subresource %u is past the end of the file", subresource);
+    FileIO::fclose(f);
+    return false;
+  }
+
+  data.resize(m_Layout.sizes[subresource]);
+
+  FileIO::fseek64(f, m_Layout.offsets[subresource], SEEK_SET);
+  size_t read = FileIO::fread(data.data(), 1, data.size(), f);
+  FileIO::fclose(f);
+
+  if(read != data.size())
+  {
+    RDCERR("Failed to read DDS subresource %u", subresource);
+    data.clear();
+    return false;
+  }
+
+  if(m_Layout.bgrSwap)
+    swap_dds_channels(data.data(), (uint32_t)data.size(), m_Layout.bytesPerPixel);
+
+  return true;
+}
+
+bool decode_dds_to_rgb8(const ResourceFormat &fmt, const byte *data, size_t size, uint32_t width,
+                        uint32_t height, bytebuf &rgb)
+{
+  const size_t numPixels = size_t(width) * height;
+
+  if(numPixels == 0)
+    return false;
+
+  rgb.resize(numPixels * 3);
+  byte *dst = rgb.data();
+
+  if(CanDecodeBC(fmt))
+  {
+    bytebuf rgba;
+    rgba.resize(numPixels * 4);
+
+    if(!DecodeBCToRGBA8(fmt, data, size, width, height, rgba.data()))
+      return false;
+
+    // single channel data is shown as greyscale
+    const bool grey = fmt.type == ResourceFormatType::BC4;
+
+    const byte *src = rgba.data();
+    for(size_t i = 0; i < numPixels; i++, src += 4, dst += 3)
+    {
+      dst[0] = src[0];
+      dst[1] = grey ? src[0] : src[1];
+      dst[2] = grey ? src[0] : src[2];
+    }
+
+    return true;
+  }
+
+  switch(fmt.type)
+  {
+    case ResourceFormatType::Regular:
+    case ResourceFormatType::D32S8:
+    case ResourceFormatType::D24S8:
+    case ResourceFormatType::D16S8:
+    case ResourceFormatType::A8:
+    case ResourceFormatType::R10G10B10A2:
+    case ResourceFormatType::R11G11B10:
+    case ResourceFormatType::R9G9B9E5:
+    case ResourceFormatType::R4G4B4A4:
+    case ResourceFormatType::R5G6B5:
+    case ResourceFormatType::R5G5B5A1: break;
+    default: RDCERR("Unsupported DDS format %s for CPU decode", fmt.Name().c_str()); return false;
+  }
+
+  uint32_t texelSize = fmt.ElementSize();
+
+  // account for padding
+  if(fmt.type == ResourceFormatType::D32S8)
+    texelSize = 8;
+  else if(fmt.type == ResourceFormatType::D16S8)
+    texelSize = 4;
+
+  if(size < numPixels * texelSize)
+  {
+    RDCERR("DDS data is %zu bytes, too small for %ux%u image", size, width, height);
+    return false;
+  }
+
+  rdcarray<FloatVector> row;
+  row.resize(width);
+
+  const byte *src = data;
+
+  for(uint32_t y = 0; y < height; y++)
+  {
+    if(fmt.type == ResourceFormatType::D32S8 || fmt.type == ResourceFormatType::D24S8 ||
+       fmt.type == ResourceFormatType::D16S8)
+    {
+      for(uint32_t x = 0; x < width; x++)
+      {
+        const byte *texel = src + x * texelSize;
+        float depth;
+        if(fmt.type == ResourceFormatType::D32S8)
+          memcpy(&depth, texel, sizeof(float));
+        else if(fmt.type == ResourceFormatType::D24S8)
+          depth = float((*(const uint32_t *)texel) >> 8) / 16777215.0f;
+        else
+          depth = float(*(const uint16_t *)texel) / 65535.0f;
+
+        row[x].x = row[x].y = row[x].z = depth;
       }
+    }
+    else
+    {
+      ConvertComponents(fmt, src, texelSize, width, row.data());
 
-      i++;
+      if(fmt.type == ResourceFormatType::A8)
+      {
+        for(uint32_t x = 0; x < width; x++)
+          row[x].y = row[x].z = row[x].x;
+      }
     }
+
+    for(uint32_t x = 0; x < width; x++, dst += 3)
+    {
+      dst[0] = byte(RDCCLAMP(row[x].x, 0.0f, 1.0f) * 255.0f);
+      dst[1] = byte(RDCCLAMP(row[x].y, 0.0f, 1.0f) * 255.0f);
+      dst[2] = byte(RDCCLAMP(row[x].z, 0.0f, 1.0f) * 255.0f);
+    }
+
+    src += size_t(width) * texelSize;
   }
 
-  return ret;
+  return true;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Check lazy DDS reading matches a full load", "[dds]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_dds_test.dds";
+
+  dds_data data = {};
+  data.width = 13;
+  data.height = 7;
+  data.depth = 1;
+  data.mips = 3;
+  data.slices = 2;
+  data.format.type = ResourceFormatType::Regular;
+  data.format.compType = CompType::UNorm;
+  data.format.compCount = 4;
+  data.format.compByteWidth = 1;
+
+  const uint32_t numSubs = data.slices * data.mips;
+
+  rdcarray<bytebuf> subs;
+  rdcarray<byte *> subdata;
+  rdcarray<uint32_t> subsizes;
+  subs.resize(numSubs);
+  for(uint32_t i = 0; i < numSubs; i++)
+  {
+    uint32_t mip = i % data.mips;
+    subs[i].resize(RDCMAX(1U, data.width >> mip) * RDCMAX(1U, data.height >> mip) * 4);
+    for(size_t b = 0; b < subs[i].size(); b++)
+      subs[i][b] = byte(b * 7 + i * 31);
+
+    subdata.push_back(subs[i].data());
+    subsizes.push_back((uint32_t)subs[i].size());
+  }
+  data.subdata = subdata.data();
+  data.subsizes = subsizes.data();
+
+  FILE *f = FileIO::fopen(filename.c_str(), "wb");
+  REQUIRE(f);
+  REQUIRE(write_dds_to_file(f, data));
+  FileIO::fclose(f);
+
+  f = FileIO::fopen(filename.c_str(), "rb");
+  REQUIRE(f);
+  StreamReader fullReader(f);
+  dds_data full = load_dds_from_file(&fullReader);
+
+  REQUIRE(full.subdata);
+
+  DDSReader *lazy = DDSReader::Open(FileIO::fopen(filename.c_str(), "rb"), filename);
+  REQUIRE(lazy);
+
+  CHECK(lazy->GetData().width == data.width);
+  CHECK(lazy->GetData().height == data.height);
+  CHECK(lazy->GetData().mips == data.mips);
+  CHECK(lazy->GetData().slices == data.slices);
+  CHECK((lazy->GetData().format == data.format));
+  CHECK(lazy->GetData().subdata == NULL);
+
+  // read out of order to check seeking
+  for(uint32_t i = numSubs; i-- > 0;)
+  {
+    bytebuf sub;
+    REQUIRE(lazy->ReadSubresource(i, sub));
+
+    CHECK(lazy->GetSubresourceSize(i) == full.subsizes[i]);
+    REQUIRE(sub.size() == subs[i].size());
+    CHECK(memcmp(sub.data(), subs[i].data(), sub.size()) == 0);
+    CHECK(memcmp(full.subdata[i], subs[i].data(), sub.size()) == 0);
+  }
+
+  bytebuf invalid;
+  CHECK_FALSE(lazy->ReadSubresource(numSubs, invalid));
+
+  // the file isn't held open, so it can be truncated underneath the reader which then fails cleanly
+  f = FileIO::fopen(filename.c_str(), "wb");
+  REQUIRE(f);
+  FileIO::fwrite(subs[0].data(), 1, 16, f);
+  FileIO::fclose(f);
+
+  CHECK_FALSE(lazy->ReadSubresource(0, invalid));
+
+  delete lazy;
+
+  for(uint32_t i = 0; i < numSubs; i++)
+    delete[] full.subdata[i];
+  delete[] full.subdata;
+  delete[] full.subsizes;
+
+  FileIO::Delete(filename.c_str());
+}
+
+#endif
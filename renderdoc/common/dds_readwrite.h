@@ -47,4 +47,44 @@ struct dds_data
 
 extern bool is_dds_file(byte *headerBuffer, size_t size);
 extern dds_data load_dds_from_file(StreamReader *reader);
+
+// where each subresource lives in a DDS file, as parsed from its header
+struct dds_layout
+{
+  // subdata and subsizes are not filled out
+  dds_data data = {};
+
+  bool bgrSwap = false;
+  uint32_t bytesPerPixel = 1;
+
+  rdcarray<uint64_t> offsets;
+  rdcarray<uint32_t> sizes;
+};
+
+// reads subresources from a DDS file on demand, rather than loading every mip and slice up front
+// like load_dds_from_file. The file is only held open while the header or a subresource is being
+// read, so it can be rewritten on disk while the reader is alive.
+class DDSReader
+{
+public:
+  // parses the header from f and closes it, subresources are read later by re-opening filename.
+  // Returns NULL if it isn't a DDS file that can be loaded
+  static DDSReader *Open(FILE *f, const rdcstr &filename);
+
+  // the file's description. subdata and subsizes are NULL, use the functions below instead
+  const dds_data &GetData() const { return m_Layout.data; }
+  // subresources are indexed by slice * mips + mip, like dds_data::subdata
+  uint32_t GetSubresourceSize(uint32_t subresource) const;
+  bool ReadSubresource(uint32_t subresource, bytebuf &data);
+
+private:
+  DDSReader(const rdcstr &filename) : m_Filename(filename) {}
+  rdcstr m_Filename;
+  dds_layout m_Layout;
+};
 extern bool write_dds_to_file(FILE *f, const dds_data &data);
+
+// decodes one subresource of DDS data to tightly packed RGB8 on the CPU, for thumbnails and
+// previews where there's no replay device. Block compressed formats are decoded in parallel.
+extern bool decode_dds_to_rgb8(const ResourceFormat &fmt, const byte *data, size_t size,
+                               uint32_t width, uint32_t height, bytebuf &rgb);
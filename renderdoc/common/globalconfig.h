@@ -57,6 +57,15 @@
 #define RDOC_MSVS OPTION_OFF
 #endif
 
+// SSE2 is always available on x64, and on x86 when the compiler targets it. Code using wider
+// instruction sets checks for them at runtime
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RDOC_SSE2 OPTION_ON
+#else
+#define RDOC_SSE2 OPTION_OFF
+#endif
+
 // translate from build system defines, so they don't have to be defined to anything in
 // particular
 #if defined(RENDERDOC_PLATFORM_WIN32)
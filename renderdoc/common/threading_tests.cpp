@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "common/threading.h"
+#include "core/jobsystem.h"
 #include "os/os_specific.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
@@ -71,4 +72,137 @@ TEST_CASE("Test spin lock", "[threading]")
   CHECK(finalValue == value);
 }
 
+TEST_CASE("Test semaphore", "[threading]")
+{
+  Threading::Semaphore *sem = Threading::Semaphore::Create();
+
+  volatile int32_t woken = 0;
+
+  rdcarray<Threading::ThreadHandle> threads;
+
+  for(int i = 0; i < 4; i++)
+  {
+    threads.push_back(Threading::CreateThread([sem, &woken]() {
+      sem->WaitForWake();
+      Atomic::Inc32(&woken);
+    }));
+  }
+
+  // wake two, then the rest. Each wake should release exactly one waiter
+  sem->Wake(2);
+
+  while(woken < 2)
+    Threading::Sleep(1);
+
+  Threading::Sleep(10);
+  CHECK(woken == 2);
+
+  sem->Wake(2);
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+
+  CHECK(woken == 4);
+
+  sem->Destroy();
+}
+
+TEST_CASE("Test job system", "[threading]")
+{
+  SECTION("Jobs all run and can be synced in any order")
+  {
+    rdcarray<int32_t> results;
+    results.resize(100);
+
+    rdcarray<JobSystem::Job *> jobs;
+    for(int32_t i = 0; i < 100; i++)
+      jobs.push_back(JobSystem::AddJob([&results, i]() { results[i] = i * 3; }));
+
+    // sync in reverse, so some jobs are likely run by the waiting thread
+    for(int32_t i = 99; i >= 0; i--)
+      JobSystem::SyncJob(jobs[i]);
+
+    for(int32_t i = 0; i < 100; i++)
+      CHECK(results[i] == i * 3);
+  };
+
+  SECTION("Jobs can wait on other jobs")
+  {
+    volatile int32_t value = 0;
+
+    JobSystem::Job *inner = JobSystem::AddJob([&value]() { Atomic::Inc32(&value); });
+    JobSystem::Job *outer = JobSystem::AddJob([&value, inner]() {
+      JobSystem::SyncJob(inner);
+      Atomic::Inc32(&value);
+    });
+
+    JobSystem::SyncJob(outer);
+
+    CHECK(value == 2);
+  };
+
+  SECTION("Waiting on a job a worker is running blocks until it finishes")
+  {
+    volatile int32_t started = 0;
+    volatile int32_t value = 0;
+
+    JobSystem::Job *job = JobSystem::AddJob([&started, &value]() {
+      Atomic::Inc32(&started);
+      Threading::Sleep(50);
+      Atomic::Inc32(&value);
+    });
+
+    while(started == 0)
+      Threading::Sleep(1);
+
+    CHECK_FALSE(JobSystem::IsJobComplete(job));
+
+    JobSystem::SyncJob(job);
+
+    CHECK(value == 1);
+  };
+
+  SECTION("ParallelFor visits every index exactly once")
+  {
+    rdcarray<int32_t> visits;
+    visits.resize(10000);
+
+    JobSystem::ParallelFor(10000, [&visits](uint32_t i) { Atomic::Inc32(&visits[i]); });
+
+    int32_t wrong = 0;
+    for(int32_t v : visits)
+      if(v != 1)
+        wrong++;
+
+    CHECK(wrong == 0);
+  };
+
+  SECTION("Shutdown finishes pending jobs and the pool can be recreated")
+  {
+    volatile int32_t value = 0;
+
+    rdcarray<JobSystem::Job *> jobs;
+    for(int32_t i = 0; i < 20; i++)
+      jobs.push_back(JobSystem::AddJob([&value]() { Atomic::Inc32(&value); }));
+
+    JobSystem::Shutdown();
+
+    CHECK(value == 20);
+
+    for(JobSystem::Job *job : jobs)
+    {
+      CHECK(JobSystem::IsJobComplete(job));
+      JobSystem::SyncJob(job);
+    }
+
+    JobSystem::Job *job = JobSystem::AddJob([&value]() { Atomic::Inc32(&value); });
+    JobSystem::SyncJob(job);
+
+    CHECK(value == 21);
+  };
+}
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -29,6 +29,7 @@
 #include "api/replay/version.h"
 #include "common/common.h"
 #include "common/threading.h"
+#include "core/settings.h"
 #include "hooks/hooks.h"
 #include "maths/formatpacking.h"
 #include "replay/replay_driver.h"
@@ -44,6 +45,23 @@
 
 #include "replay/renderdoc_serialise.inl"
 
+RDOC_CONFIG(bool, Capture_BackgroundWriting, true,
+            "Compress and write captures to disk on a background thread, so that the application "
+            "can continue rendering as soon as the frame contents have been gathered. Currently "
+            "only Vulkan captures are written in the background.");
+
+RDOC_CONFIG(uint32_t, Capture_BackgroundWritingMemoryMB, 1024,
+            "The maximum memory in MB that captures queued for background writing can hold. When "
+            "this would be exceeded, capturing waits for earlier captures to finish writing. A "
+            "single capture larger than this is written immediately.");
+
+RDOC_CONFIG(bool, Capture_MapPageTracking, false,
+            "Track CPU writes to persistent coherent maps by write-protecting their pages, so that "
+            "only pages written since the last submit are compared and serialised. This reduces "
+            "overhead for applications with large persistently mapped buffers, but can break "
+            "applications that pass mapped pointers to system calls such as read(), or that "
+            "install their own SIGSEGV handler. For that reason it is off by default.");
+
 void LogReplayOptions(const ReplayOptions &opts)
 {
   RDCLOG("%s API validation during replay", (opts.apiValidation ? "Enabling" : "Not enabling"));
@@ -465,6 +483,13 @@ RenderDoc::~RenderDoc()
     UnloadCrashHandler();
   }
 
+  // finish any captures being written before shutting down the systems they might use
+  FlushCaptureWriting();
+
+  if(m_CaptureWriteDone)
+    m_CaptureWriteDone->Destroy();
+  m_CaptureWriteDone = NULL;
+
   for(auto it = m_ShutdownFunctions.begin(); it != m_ShutdownFunctions.end(); ++it)
     (*it)();
   m_ShutdownFunctions.clear();
@@ -514,6 +539,8 @@ void RenderDoc::RemoveHooks()
     UnloadCrashHandler();
   }
 
+  FlushCaptureWriting();
+
   if(m_RemoteThread)
   {
     // explicitly wait for thread to shutdown, this call is not from module unloading and
@@ -1597,73 +1624,271 @@ void RenderDoc::SetCaptureFileTemplate(const char *pathtemplate)
   FileIO::CreateParentDirectory(m_CaptureFileTemplate);
 }
 
+bytebuf RenderDoc::GetCaptureResolveDatabase()
+{
+  bytebuf ret;
+
+  // add the resolve database if we were capturing callstacks.
+  if(m_Options.captureCallstacks)
+  {
+    size_t sz = 0;
+    Callstack::GetLoadedModules(NULL, sz);
+
+    ret.resize(sz);
+    Callstack::GetLoadedModules(ret.data(), sz);
+  }
+
+  return ret;
+}
+
+void RenderDoc::WriteCaptureTrailer(RDCFile *rdc, const bytebuf &resolveDatabase)
+{
+  if(!resolveDatabase.empty())
+  {
+    SectionProperties props = {};
+    props.type = SectionType::ResolveDatabase;
+    props.version = 1;
+    StreamWriter *w = rdc->WriteSection(props);
+
+    w->Write(resolveDatabase.data(), resolveDatabase.size());
+
+    w->Finish();
+
+    delete w;
+  }
+
+  const RDCThumb &thumb = rdc->GetThumbnail();
+  if(thumb.format != FileType::JPG && thumb.width > 0 && thumb.height > 0)
+  {
+    SectionProperties props = {};
+    props.type = SectionType::ExtendedThumbnail;
+    props.version = 1;
+    StreamWriter *w = rdc->WriteSection(props);
+
+    // if this file format ever changes, be sure to update the XML export which has a special
+    // handling for this case.
+
+    ExtThumbnailHeader header;
+    header.width = thumb.width;
+    header.height = thumb.height;
+    header.len = thumb.len;
+    header.format = thumb.format;
+    w->Write(header);
+    w->Write(thumb.pixels, thumb.len);
+
+    w->Finish();
+
+    delete w;
+  }
+}
+
+void RenderDoc::AddCapture(const rdcstr &path, RDCDriver driver, uint32_t frameNumber)
+{
+  CaptureData cap(path, Timing::GetUnixTimestamp(), driver, frameNumber);
+  {
+    SCOPED_LOCK(m_CaptureLock);
+    m_Captures.push_back(cap);
+  }
+}
+
 void RenderDoc::FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber)
 {
   RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
 
   if(rdc)
   {
-    // add the resolve database if we were capturing callstacks.
-    if(m_Options.captureCallstacks)
-    {
-      SectionProperties props = {};
-      props.type = SectionType::ResolveDatabase;
-      props.version = 1;
-      StreamWriter *w = rdc->WriteSection(props);
+    WriteCaptureTrailer(rdc, GetCaptureResolveDatabase());
 
-      size_t sz = 0;
-      Callstack::GetLoadedModules(NULL, sz);
+    RDCLOG("Written to disk: %s", rdc->GetFilename().c_str());
 
-      byte *buf = new byte[sz];
-      Callstack::GetLoadedModules(buf, sz);
+    AddCapture(rdc->GetFilename(), rdc->GetDriver(), frameNumber);
 
-      w->Write(buf, sz);
+    delete rdc;
+  }
+  else
+  {
+    RDCLOG("Discarded capture, Frame %u", frameNumber);
+  }
 
-      w->Finish();
+  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+}
 
-      delete w;
-    }
+bool RenderDoc::IsBackgroundCaptureWritingEnabled()
+{
+  return Capture_BackgroundWriting;
+}
 
-    const RDCThumb &thumb = rdc->GetThumbnail();
-    if(thumb.format != FileType::JPG && thumb.width > 0 && thumb.height > 0)
-    {
-      SectionProperties props = {};
-      props.type = SectionType::ExtendedThumbnail;
-      props.version = 1;
-      StreamWriter *w = rdc->WriteSection(props);
+bool RenderDoc::IsMapPageTrackingEnabled()
+{
+  return Capture_MapPageTracking && PageTracking::IsSupported();
+}
 
-      // if this file format ever changes, be sure to update the XML export which has a special
-      // handling for this case.
+void RenderDoc::QueueCaptureWriting(RDCFile *rdc, uint32_t frameNumber,
+                                    const SectionProperties &props, StreamWriter *frameContents)
+{
+  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 0.0f);
 
-      ExtThumbnailHeader header;
-      header.width = thumb.width;
-      header.height = thumb.height;
-      header.len = thumb.len;
-      header.format = thumb.format;
-      w->Write(header);
-      w->Write(thumb.pixels, thumb.len);
+  // anything that depends on the capture options or the process state is gathered now, so the
+  // writer thread only has to deal with the file itself.
+  QueuedCaptureWrite write = {
+      rdc,  frameNumber, props, frameContents, frameContents->GetOffset(),
+      GetCaptureResolveDatabase(),
+  };
 
-      w->Finish();
+  // the RDC is owned by the writer once queued, so grab what we need to register it now
+  const rdcstr path = rdc->GetFilename();
+  const RDCDriver driver = rdc->GetDriver();
 
-      delete w;
-    }
+  const uint64_t budget = uint64_t(Capture_BackgroundWritingMemoryMB) * 1024 * 1024;
 
-    RDCLOG("Written to disk: %s", m_CurrentLogFile.c_str());
+  // if this capture could never fit in the budget, write it now. Flush first so that captures are
+  // still completed in the order they were made.
+  if(write.size > budget)
+  {
+    RDCLOG("Capture of %llu MB exceeds background writing budget, writing immediately",
+           write.size / (1024 * 1024));
+    FlushCaptureWriting();
+    WriteQueuedCapture(write);
+    AddCapture(path, driver, frameNumber);
+  }
+  else
+  {
+    SCOPED_LOCK(m_CaptureWriteLock);
+
+    // wait for earlier captures to be written and free up memory
+    while(m_CaptureWriteQueueBytes + write.size > budget)
+      WaitForCaptureWrite();
 
-    CaptureData cap(m_CurrentLogFile, Timing::GetUnixTimestamp(), rdc->GetDriver(), frameNumber);
+    m_CaptureWriteQueue.push_back(write);
+    m_CaptureWriteQueueBytes += write.size;
+
+    if(!m_CaptureWriteThreadRunning)
     {
-      SCOPED_LOCK(m_CaptureLock);
-      m_Captures.push_back(cap);
+      // a previous writer thread may have exited but not been tidied up yet
+      if(m_CaptureWriteThread)
+      {
+        Threading::JoinThread(m_CaptureWriteThread);
+        Threading::CloseThread(m_CaptureWriteThread);
+      }
+
+      m_CaptureWriteThreadRunning = true;
+      m_CaptureWriteThread = Threading::CreateThread([this]() { CaptureWriteThread(); });
     }
+  }
 
-    delete rdc;
+  // the capture is registered before returning so that it's visible to the API and target control
+  // in the order it was made. Anything that reads the file itself must check IsCaptureWritten()
+  // or call FlushCaptureWriting() first.
+  if(write.size <= budget)
+    AddCapture(path, driver, frameNumber);
+
+  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+}
+
+void RenderDoc::FlushCaptureWriting()
+{
+  SCOPED_LOCK(m_CaptureWriteLock);
+
+  while(m_CaptureWriteThreadRunning)
+    WaitForCaptureWrite();
+
+  if(m_CaptureWriteThread)
+  {
+    Threading::JoinThread(m_CaptureWriteThread);
+    Threading::CloseThread(m_CaptureWriteThread);
+    m_CaptureWriteThread = 0;
   }
-  else
+}
+
+bool RenderDoc::IsCaptureWritten(const rdcstr &path)
+{
+  SCOPED_LOCK(m_CaptureWriteLock);
+
+  // captures stay in the queue until they have been completely written
+  for(const QueuedCaptureWrite &write : m_CaptureWriteQueue)
+    if(write.rdc->GetFilename() == path)
+      return false;
+
+  return true;
+}
+
+void RenderDoc::WaitForCaptureWrite()
+{
+  // must be called with m_CaptureWriteLock held. The semaphore counts wakes, so one that arrives
+  // between unlocking and waiting isn't lost.
+  if(!m_CaptureWriteDone)
+    m_CaptureWriteDone = Threading::Semaphore::Create();
+
+  m_CaptureWriteWaiters++;
+
+  m_CaptureWriteLock.Unlock();
+  m_CaptureWriteDone->WaitForWake();
+  m_CaptureWriteLock.Lock();
+}
+
+void RenderDoc::WakeCaptureWriteWaiters()
+{
+  // must be called with m_CaptureWriteLock held
+  if(m_CaptureWriteWaiters > 0)
   {
-    RDCLOG("Discarded capture, Frame %u", frameNumber);
+    m_CaptureWriteDone->Wake(m_CaptureWriteWaiters);
+    m_CaptureWriteWaiters = 0;
   }
+}
 
-  RenderDoc::Inst().SetProgress(CaptureProgress::FileWriting, 1.0f);
+void RenderDoc::CaptureWriteThread()
+{
+  Threading::SetCurrentThreadName("CaptureWriter");
+
+  while(true)
+  {
+    QueuedCaptureWrite write;
+
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+
+      if(m_CaptureWriteQueue.empty())
+      {
+        // must be cleared under the lock, so that anyone queueing after this point knows to
+        // start a new thread
+        m_CaptureWriteThreadRunning = false;
+        WakeCaptureWriteWaiters();
+        return;
+      }
+
+      write = m_CaptureWriteQueue[0];
+    }
+
+    WriteQueuedCapture(write);
+
+    {
+      SCOPED_LOCK(m_CaptureWriteLock);
+      m_CaptureWriteQueue.erase(0);
+      m_CaptureWriteQueueBytes -= write.size;
+      WakeCaptureWriteWaiters();
+    }
+  }
+}
+
+void RenderDoc::WriteQueuedCapture(const QueuedCaptureWrite &write)
+{
+  PerformanceTimer timer;
+
+  StreamWriter *w = write.rdc->WriteSection(write.props);
+  w->Write(write.frameContents->GetData(), write.size);
+  w->Finish();
+
+  delete w;
+  delete write.frameContents;
+
+  RDCLOG("Wrote %f MB frame capture section in %f seconds", double(write.size) / (1024.0 * 1024.0),
+         timer.GetMilliseconds() / 1000.0);
+
+  WriteCaptureTrailer(write.rdc, write.resolveDatabase);
+
+  RDCLOG("Written to disk: %s", write.rdc->GetFilename().c_str());
+
+  delete write.rdc;
 }
 
 void RenderDoc::AddChildProcess(uint32_t pid, uint32_t ident)
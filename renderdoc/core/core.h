@@ -51,6 +51,7 @@ class IRemoteDriver;
 class IReplayDriver;
 
 class StreamReader;
+class StreamWriter;
 class RDCFile;
 struct SDFile;
 enum class VulkanLayerFlags : uint32_t;
@@ -445,6 +446,24 @@ public:
   RDCFile *CreateRDC(RDCDriver driver, uint32_t frameNum, const FramePixels &fp);
   void FinishCaptureWriting(RDCFile *rdc, uint32_t frameNumber);
 
+  // returns true if drivers should serialise the frame capture section to memory and pass it to
+  // QueueCaptureWriting, instead of writing it directly to the RDC. Only Vulkan does this so far,
+  // other drivers still write their captures on the capturing thread.
+  bool IsBackgroundCaptureWritingEnabled();
+  // takes ownership of rdc and the in-memory frameContents, and replaces FinishCaptureWriting. The
+  // capture is registered immediately, but its file is compressed and written on a background
+  // thread, so anything reading the file must call FlushCaptureWriting first.
+  void QueueCaptureWriting(RDCFile *rdc, uint32_t frameNumber, const SectionProperties &props,
+                           StreamWriter *frameContents);
+  // blocks until every queued capture has been written to disk
+  void FlushCaptureWriting();
+  // returns false if the capture at this path is still queued or being written
+  bool IsCaptureWritten(const rdcstr &path);
+
+  // returns true if drivers should track writes to persistently mapped memory with
+  // PageTracking, so that only written pages need to be compared and serialised.
+  bool IsMapPageTrackingEnabled();
+
   void AddChildProcess(uint32_t pid, uint32_t ident);
   rdcarray<rdcpair<uint32_t, uint32_t> > GetChildProcesses();
 
@@ -623,6 +642,33 @@ private:
   Threading::CriticalSection m_CaptureLock;
   rdcarray<CaptureData> m_Captures;
 
+  struct QueuedCaptureWrite
+  {
+    RDCFile *rdc;
+    uint32_t frameNumber;
+    SectionProperties props;
+    StreamWriter *frameContents;
+    uint64_t size;
+    bytebuf resolveDatabase;
+  };
+
+  Threading::CriticalSection m_CaptureWriteLock;
+  rdcarray<QueuedCaptureWrite> m_CaptureWriteQueue;
+  uint64_t m_CaptureWriteQueueBytes = 0;
+  bool m_CaptureWriteThreadRunning = false;
+  Threading::ThreadHandle m_CaptureWriteThread = 0;
+  // signalled whenever a queued capture finishes writing, for threads waiting on the queue
+  Threading::Semaphore *m_CaptureWriteDone = NULL;
+  uint32_t m_CaptureWriteWaiters = 0;
+
+  bytebuf GetCaptureResolveDatabase();
+  void WriteCaptureTrailer(RDCFile *rdc, const bytebuf &resolveDatabase);
+  void AddCapture(const rdcstr &path, RDCDriver driver, uint32_t frameNumber);
+  void CaptureWriteThread();
+  void WriteQueuedCapture(const QueuedCaptureWrite &write);
+  void WaitForCaptureWrite();
+  void WakeCaptureWriteWaiters();
+
   Threading::CriticalSection m_ChildLock;
   rdcarray<rdcpair<uint32_t, uint32_t> > m_Children;
 
@@ -65,6 +65,7 @@ public:
 
   virtual ~ImageViewer()
   {
+    delete m_DDS;
     m_Proxy->Shutdown();
     m_Proxy = NULL;
   }
@@ -121,16 +122,19 @@ public:
       y = (mipHeight - 1) - y;
     }
 
+    UploadSubresource(sub);
     m_Proxy->PickPixel(texture, x, y, sub, typeCast, pixel);
   }
   bool GetMinMax(ResourceId texid, const Subresource &sub, CompType typeCast, float *minval,
                  float *maxval)
   {
+    UploadSubresource(sub);
     return m_Proxy->GetMinMax(m_TextureID, sub, typeCast, minval, maxval);
   }
   bool GetHistogram(ResourceId texid, const Subresource &sub, CompType typeCast, float minval,
                     float maxval, bool channels[4], rdcarray<uint32_t> &histogram)
   {
+    UploadSubresource(sub);
     return m_Proxy->GetHistogram(m_TextureID, sub, typeCast, minval, maxval, channels, histogram);
   }
   bool RenderTexture(TextureDisplay cfg)
@@ -138,6 +142,9 @@ public:
     if(cfg.resourceId != m_TextureID && cfg.resourceId != m_CustomTexID)
       cfg.resourceId = m_TextureID;
 
+    if(cfg.resourceId == m_TextureID)
+      UploadSubresource(cfg.subresource);
+
     if(m_Props.localRenderer == GraphicsAPI::OpenGL)
       cfg.flipY = !cfg.flipY;
 
@@ -166,6 +173,7 @@ public:
   ResourceId ApplyCustomShader(ResourceId shader, ResourceId texid, const Subresource &sub,
                                CompType typeCast)
   {
+    UploadSubresource(sub);
     m_CustomTexID = m_Proxy->ApplyCustomShader(shader, m_TextureID, sub, typeCast);
     return m_CustomTexID;
   }
@@ -175,6 +183,7 @@ public:
   void GetTextureData(ResourceId tex, const Subresource &sub, const GetTextureDataParams &params,
                       bytebuf &data)
   {
+    UploadSubresource(sub);
     m_Proxy->GetTextureData(m_TextureID, sub, params, data);
   }
 
@@ -308,6 +317,7 @@ public:
   void FileChanged() { RefreshFile(); }
 private:
   void RefreshFile();
+  void UploadSubresource(const Subresource &sub);
 
   APIProperties m_Props;
   FrameRecord m_FrameRecord;
@@ -318,6 +328,10 @@ private:
   rdcarray<ResourceDescription> m_Resources;
   SDFile m_File;
   TextureDescription m_TexDetails;
+
+  // DDS files are read lazily, with each subresource uploaded the first time it's used
+  DDSReader *m_DDS = NULL;
+  rdcarray<bool> m_DDSUploaded;
 };
 
 ReplayStatus IMG_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
@@ -396,22 +410,17 @@ ReplayStatus IMG_CreateReplayDevice(RDCFile *rdc, IReplayDriver **driver)
   }
   else if(is_dds_file(headerBuffer, headerSize))
   {
-    FileIO::fseek64(f, 0, SEEK_SET);
-    StreamReader reader(f);
-    dds_data read_data = load_dds_from_file(&reader);
+    // only the header is parsed here, the pixel data is read when it's displayed
+    DDSReader *dds = DDSReader::Open(f, filename);
     f = NULL;
 
-    if(read_data.subdata == NULL)
+    if(dds == NULL)
     {
       RDCERR("DDS file recognised, but couldn't load");
       return ReplayStatus::ImageUnsupported;
     }
 
-    for(uint32_t i = 0; i < read_data.slices * read_data.mips; i++)
-      delete[] read_data.subdata[i];
-
-    delete[] read_data.subdata;
-    delete[] read_data.subsizes;
+    delete dds;
   }
   else
   {
@@ -674,20 +683,21 @@ void ImageViewer::RefreshFile()
   m_FrameRecord.frameInfo.persistentSize = 0;
   m_FrameRecord.frameInfo.uncompressedFileSize = datasize;
 
-  dds_data read_data = {0};
+  DDSReader *ddsReader = NULL;
 
   if(dds)
   {
     FileIO::fseek64(f, 0, SEEK_SET);
-    StreamReader reader(f);
-    read_data = load_dds_from_file(&reader);
+    ddsReader = DDSReader::Open(f, m_Filename);
     f = NULL;
 
-    if(read_data.subdata == NULL)
+    if(ddsReader == NULL)
     {
       return;
     }
 
+    const dds_data &read_data = ddsReader->GetData();
+
     texDetails.cubemap = read_data.cubemap;
     texDetails.arraysize = read_data.slices;
     texDetails.width = read_data.width;
@@ -721,7 +731,7 @@ void ImageViewer::RefreshFile()
 
     m_FrameRecord.frameInfo.uncompressedFileSize = 0;
     for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-      m_FrameRecord.frameInfo.uncompressedFileSize += read_data.subsizes[i];
+      m_FrameRecord.frameInfo.uncompressedFileSize += ddsReader->GetSubresourceSize(i);
   }
 
   m_FrameRecord.frameInfo.compressedFileSize = m_FrameRecord.frameInfo.uncompressedFileSize;
@@ -761,20 +771,37 @@ void ImageViewer::RefreshFile()
     m_Proxy->SetProxyTextureData(m_TextureID, Subresource(), data, datasize);
     free(data);
   }
-  else
-  {
-    for(uint32_t i = 0; i < texDetails.arraysize * texDetails.mips; i++)
-    {
-      m_Proxy->SetProxyTextureData(m_TextureID, {i % texDetails.mips, i / texDetails.mips},
-                                   read_data.subdata[i], (size_t)read_data.subsizes[i]);
 
-      delete[] read_data.subdata[i];
-    }
+  // any previous contents are stale now, whether or not the texture was recreated
+  delete m_DDS;
+  m_DDS = ddsReader;
+  m_DDSUploaded.clear();
 
-    delete[] read_data.subdata;
-    delete[] read_data.subsizes;
-  }
+  if(m_DDS)
+    m_DDSUploaded.resize(texDetails.arraysize * texDetails.mips);
 
   if(f != NULL)
     FileIO::fclose(f);
 }
+
+void ImageViewer::UploadSubresource(const Subresource &sub)
+{
+  if(m_DDS == NULL || m_TextureID == ResourceId())
+    return;
+
+  // 3D textures store every depth slice in each mip's subresource
+  const uint32_t slice = m_TexDetails.depth > 1 ? 0 : sub.slice;
+  const uint32_t idx = slice * m_TexDetails.mips + sub.mip;
+
+  if(sub.mip >= m_TexDetails.mips || idx >= m_DDSUploaded.size() || m_DDSUploaded[idx])
+    return;
+
+  // don't retry subresources that fail to read
+  m_DDSUploaded[idx] = true;
+
+  bytebuf data;
+  if(!m_DDS->ReadSubresource(idx, data))
+    return;
+
+  m_Proxy->SetProxyTextureData(m_TextureID, {sub.mip, slice}, data.data(), data.size());
+}
@@ -0,0 +1,267 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "jobsystem.h"
+#include <thread>
+#include "common/threading.h"
+#include "core/core.h"
+#include "core/settings.h"
+
+RDOC_CONFIG(uint32_t, Threading_JobWorkerCount, 0,
+            "The number of worker threads used for parallel processing such as compression. If 0 "
+            "this is chosen automatically based on the number of CPU cores.");
+
+namespace JobSystem
+{
+enum JobState
+{
+  Pending = 0,
+  Running,
+  Complete,
+};
+
+struct Job
+{
+  std::function<void()> callback;
+  volatile int32_t state = Pending;
+  // woken once the job completes, so SyncJob can block instead of spinning
+  Threading::Semaphore *done = Threading::Semaphore::Create();
+  // one reference is held by the queue, and one by the handle returned from AddJob
+  volatile int32_t refcount = 2;
+};
+
+struct Pool
+{
+  Threading::CriticalSection lock;
+  Threading::Semaphore *sem = NULL;
+
+  // queue[head] onwards are the jobs still to be picked up by a worker
+  rdcarray<Job *> queue;
+  size_t head = 0;
+
+  rdcarray<Threading::ThreadHandle> workers;
+  volatile int32_t shutdown = 0;
+};
+
+static Threading::CriticalSection poolLock;
+static Pool *pool = NULL;
+
+static void ReleaseJob(Job *job)
+{
+  if(Atomic::Dec32(&job->refcount) == 0)
+  {
+    job->done->Destroy();
+    delete job;
+  }
+}
+
+static void RunJob(Job *job)
+{
+  // only one thread gets to run the job, whether that's a worker or someone waiting on it
+  if(Atomic::CmpExch32(&job->state, Pending, Running) != Pending)
+    return;
+
+  job->callback();
+  job->callback = std::function<void()>();
+
+  Atomic::CmpExch32(&job->state, Running, Complete);
+  job->done->Wake(1);
+}
+
+static Job *PopJob(Pool *p)
+{
+  SCOPED_LOCK(p->lock);
+
+  if(p->head >= p->queue.size())
+    return NULL;
+
+  Job *ret = p->queue[p->head++];
+
+  // periodically compact the queue rather than erasing from the front each time
+  if(p->head >= 64 && p->head * 2 >= p->queue.size())
+  {
+    p->queue.erase(0, p->head);
+    p->head = 0;
+  }
+
+  return ret;
+}
+
+static void WorkerThread(Pool *p)
+{
+  Threading::SetCurrentThreadName("JobSystem worker");
+
+  while(true)
+  {
+    p->sem->WaitForWake();
+
+    if(p->shutdown)
+      return;
+
+    Job *job = PopJob(p);
+    if(job)
+    {
+      RunJob(job);
+      ReleaseJob(job);
+    }
+  }
+}
+
+static Pool *GetPool()
+{
+  SCOPED_LOCK(poolLock);
+
+  if(pool)
+    return pool;
+
+  uint32_t numWorkers = Threading_JobWorkerCount;
+
+  if(numWorkers == 0)
+  {
+    // leave one core for the thread that's adding the jobs
+    uint32_t numCores = std::thread::hardware_concurrency();
+    numWorkers = numCores > 1 ? numCores - 1 : 1;
+  }
+
+  pool = new Pool;
+  pool->sem = Threading::Semaphore::Create();
+
+  for(uint32_t i = 0; i < numWorkers; i++)
+  {
+    Pool *p = pool;
+    pool->workers.push_back(Threading::CreateThread([p]() { WorkerThread(p); }));
+  }
+
+  RDCDEBUG("Created job system with %u workers", numWorkers);
+
+  RenderDoc::Inst().RegisterShutdownFunction(&Shutdown);
+
+  return pool;
+}
+
+uint32_t GetNumWorkers()
+{
+  return (uint32_t)GetPool()->workers.size();
+}
+
+Job *AddJob(std::function<void()> callback)
+{
+  Pool *p = GetPool();
+
+  Job *job = new Job;
+  job->callback = callback;
+
+  {
+    SCOPED_LOCK(p->lock);
+    p->queue.push_back(job);
+  }
+
+  p->sem->Wake(1);
+
+  return job;
+}
+
+void SyncJob(Job *job)
+{
+  if(!job)
+    return;
+
+  // if no worker has started it yet, run it ourselves
+  RunJob(job);
+
+  // otherwise sleep until whoever is running it finishes. If we ran it, it's already been woken
+  job->done->WaitForWake();
+
+  ReleaseJob(job);
+}
+
+bool IsJobComplete(Job *job)
+{
+  return job == NULL || job->state == Complete;
+}
+
+void ParallelFor(uint32_t count, std::function<void(uint32_t)> callback)
+{
+  if(count == 0)
+    return;
+
+  if(count == 1)
+  {
+    callback(0);
+    return;
+  }
+
+  // each job pulls indices until they're exhausted, so uneven work balances out
+  volatile int32_t next = 0;
+
+  auto process = [&next, count, &callback]() {
+    while(true)
+    {
+      int32_t idx = Atomic::Inc32(&next) - 1;
+      if(idx >= (int32_t)count)
+        break;
+      callback((uint32_t)idx);
+    }
+  };
+
+  rdcarray<Job *> jobs;
+  uint32_t numJobs = RDCMIN(count - 1, GetNumWorkers());
+  for(uint32_t i = 0; i < numJobs; i++)
+    jobs.push_back(AddJob(process));
+
+  // the calling thread helps out too
+  process();
+
+  for(Job *job : jobs)
+    SyncJob(job);
+}
+
+void Shutdown()
+{
+  SCOPED_LOCK(poolLock);
+
+  if(!pool)
+    return;
+
+  // finish anything still queued
+  while(Job *job = PopJob(pool))
+  {
+    RunJob(job);
+    ReleaseJob(job);
+  }
+
+  pool->shutdown = 1;
+  pool->sem->Wake((uint32_t)pool->workers.size());
+
+  for(Threading::ThreadHandle t : pool->workers)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+
+  pool->sem->Destroy();
+
+  SAFE_DELETE(pool);
+}
+};
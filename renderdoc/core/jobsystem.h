@@ -0,0 +1,59 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include "common/common.h"
+
+// A simple pool of worker threads for running independent pieces of work concurrently. Jobs are
+// run in the order they are added, and a thread waiting on a job that hasn't started yet will run
+// it itself rather than blocking, so it's safe to wait on jobs from within other jobs.
+//
+// The pool is created on first use and shut down along with the library.
+namespace JobSystem
+{
+struct Job;
+
+// returns the number of worker threads in the pool
+uint32_t GetNumWorkers();
+
+// adds a job to the queue. The returned handle must be passed to SyncJob exactly once.
+Job *AddJob(std::function<void()> callback);
+
+// waits until the job has finished - running it on this thread if no worker has picked it up yet -
+// then releases the handle.
+void SyncJob(Job *job);
+
+// returns true if the job has finished, and SyncJob will return immediately.
+bool IsJobComplete(Job *job);
+
+// runs callback(i) for every i in [0, count), spread across the workers and the calling thread.
+// Returns once every index has been processed.
+void ParallelFor(uint32_t count, std::function<void(uint32_t)> callback);
+
+// waits for all outstanding jobs and destroys the worker threads. The pool will be recreated if
+// jobs are added afterwards.
+void Shutdown();
+};
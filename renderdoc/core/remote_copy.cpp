@@ -0,0 +1,1079 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "remote_copy.h"
+#include <algorithm>
+#include "api/replay/data_types.h"
+#include "common/threading.h"
+#include "common/timing.h"
+#include "zstd/xxhash.h"
+#include "zstd/zstd.h"
+
+// how many rounds of re-requesting chunks that failed their checksum before giving up
+static const uint32_t MaxCopyAttempts = 3;
+
+// extra streams that nobody claims within this many seconds are closed
+static const uint64_t StaleStreamSeconds = 30;
+
+static const uint32_t ProgressMagic = MAKE_FOURCC('R', 'D', 'C', 'P');
+static const uint32_t ProgressVersion = 1;
+
+// the progress file is this header, followed by the uint32_t index of each chunk that has been
+// written to the partial file
+struct ProgressHeader
+{
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t fileSize;
+  uint64_t chunkSize;
+};
+
+template <>
+rdcstr DoStringise(const RemoteCopyPacket &el)
+{
+  BEGIN_ENUM_STRINGISE(RemoteCopyPacket);
+  {
+    STRINGISE_ENUM_NAMED(eRemoteCopy_Stream, "Stream");
+    STRINGISE_ENUM_NAMED(eRemoteCopy_Header, "Header");
+    STRINGISE_ENUM_NAMED(eRemoteCopy_Needed, "Needed");
+    STRINGISE_ENUM_NAMED(eRemoteCopy_Chunk, "Chunk");
+    STRINGISE_ENUM_NAMED(eRemoteCopy_Status, "Status");
+  }
+  END_ENUM_STRINGISE();
+}
+
+struct PendingStream
+{
+  uint64_t token;
+  uint32_t index;
+  uint64_t timestamp;
+  Network::Socket *sock;
+
+  bool operator<(const PendingStream &o) const { return index < o.index; }
+};
+
+static Threading::CriticalSection pendingLock;
+static rdcarray<PendingStream> pendingStreams;
+
+static void PurgeStaleStreams()
+{
+  uint64_t now = Timing::GetUnixTimestamp();
+
+  for(size_t i = 0; i < pendingStreams.size();)
+  {
+    if(now > pendingStreams[i].timestamp + StaleStreamSeconds)
+    {
+      RDCWARN("Closing unclaimed copy stream %u", pendingStreams[i].index);
+      delete pendingStreams[i].sock;
+      pendingStreams.erase(i);
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+static uint64_t ChunkCount(uint64_t fileSize, uint64_t chunkSize)
+{
+  return (fileSize + chunkSize - 1) / chunkSize;
+}
+
+namespace RemoteCopy
+{
+uint64_t MakeFileKey(const rdcstr &path)
+{
+  uint64_t sizeAndTime[2] = {FileIO::GetFileSize(path), FileIO::GetModifiedTimestamp(path)};
+
+  uint64_t key = XXH64(path.c_str(), path.size(), 0);
+  return XXH64(sizeAndTime, sizeof(sizeAndTime), key);
+}
+
+rdcarray<Network::Socket *> OpenStreams(const rdcstr &host, uint16_t port, uint32_t count,
+                                        uint32_t timeoutMS, uint64_t &token)
+{
+  // only needs to be unique amongst the streams the server is holding at any one time
+  uint64_t seed[2] = {Timing::GetTick(), (uint64_t)Process::GetCurrentPID()};
+  token = XXH64(seed, sizeof(seed), 0);
+
+  rdcarray<Network::Socket *> ret;
+
+  for(uint32_t i = 0; i < count; i++)
+  {
+    Network::Socket *sock = Network::CreateClientSocket(host.c_str(), port, 750);
+
+    if(sock == NULL)
+      break;
+
+    sock->SetTimeout(timeoutMS);
+
+    uint32_t index = (uint32_t)ret.size();
+
+    {
+      WriteSerialiser ser(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
+
+      ser.SetStreamingMode(true);
+
+      SCOPED_SERIALISE_CHUNK(eRemoteCopy_Stream);
+      SERIALISE_ELEMENT(token);
+      SERIALISE_ELEMENT(index);
+    }
+
+    if(!sock->Connected())
+    {
+      delete sock;
+      break;
+    }
+
+    ret.push_back(sock);
+  }
+
+  return ret;
+}
+
+bool AcceptStream(Network::Socket *sock, ReadSerialiser &ser)
+{
+  uint64_t token = 0;
+  uint32_t index = 0;
+
+  SERIALISE_ELEMENT(token);
+  SERIALISE_ELEMENT(index);
+
+  ser.EndChunk();
+
+  if(ser.IsErrored())
+    return false;
+
+  SCOPED_LOCK(pendingLock);
+
+  PurgeStaleStreams();
+
+  pendingStreams.push_back({token, index, Timing::GetUnixTimestamp(), sock});
+
+  return true;
+}
+
+rdcarray<Network::Socket *> TakeStreams(uint64_t token, uint32_t count, uint32_t timeoutMS,
+                                        rdcarray<uint32_t> &indices)
+{
+  rdcarray<Network::Socket *> ret;
+  indices.clear();
+
+  if(count == 0)
+    return ret;
+
+  PerformanceTimer timer;
+
+  rdcarray<PendingStream> taken;
+
+  while(true)
+  {
+    {
+      SCOPED_LOCK(pendingLock);
+
+      uint32_t arrived = 0;
+      for(const PendingStream &s : pendingStreams)
+        if(s.token == token)
+          arrived++;
+
+      if(arrived >= count || timer.GetMilliseconds() >= timeoutMS)
+      {
+        for(size_t i = 0; i < pendingStreams.size();)
+        {
+          if(pendingStreams[i].token == token && taken.size() < count)
+          {
+            taken.push_back(pendingStreams[i]);
+            pendingStreams.erase(i);
+          }
+          else
+          {
+            i++;
+          }
+        }
+
+        break;
+      }
+    }
+
+    Threading::Sleep(5);
+  }
+
+  std::sort(taken.begin(), taken.end());
+
+  for(const PendingStream &s : taken)
+  {
+    ret.push_back(s.sock);
+    indices.push_back(s.index);
+  }
+
+  if(ret.size() < count)
+    RDCWARN("Only %zu of %u copy streams connected", ret.size(), count);
+
+  return ret;
+}
+};    // namespace RemoteCopy
+
+struct SendState
+{
+  rdcstr path;
+  rdcarray<uint32_t> needed;
+  uint64_t fileSize;
+  uint64_t chunkSize;
+  bool compress;
+
+  int32_t next;
+  int32_t sent;
+};
+
+// sends chunks until there are none left to claim, then an end marker. Only returns false on a
+// network error - a chunk that can't be read is skipped and the receiver will ask for it again.
+static bool SendChunkStream(WriteSerialiser &ser, SendState &state,
+                            RENDERDOC_ProgressCallback progress)
+{
+  FILE *f = FileIO::fopen(state.path.c_str(), "rb");
+
+  if(f == NULL)
+    RDCERR("Can't open '%s' to send: %s", state.path.c_str(), FileIO::ErrorString().c_str());
+
+  uint64_t numChunks = ChunkCount(state.fileSize, state.chunkSize);
+
+  bytebuf data, packed;
+
+  while(!ser.IsErrored())
+  {
+    int32_t n = Atomic::Inc32(&state.next) - 1;
+
+    if(n >= state.needed.count())
+      break;
+
+    uint32_t index = state.needed[n];
+
+    if(f == NULL || index >= numChunks)
+      continue;
+
+    uint64_t offset = index * state.chunkSize;
+    uint64_t length = RDCMIN(state.chunkSize, state.fileSize - offset);
+
+    data.resize((size_t)length);
+    FileIO::fseek64(f, offset, SEEK_SET);
+    if(FileIO::fread(data.data(), 1, (size_t)length, f) != length)
+    {
+      RDCERR("Failed to read chunk %u of '%s'", index, state.path.c_str());
+      continue;
+    }
+
+    uint64_t hash = XXH64(data.data(), data.size(), 0);
+
+    // only keep the compressed version if it saves anything
+    bool compressed = false;
+    if(state.compress)
+    {
+      packed.resize(ZSTD_compressBound(data.size()));
+      size_t packedSize = ZSTD_compress(packed.data(), packed.size(), data.data(), data.size(), 1);
+
+      if(!ZSTD_isError(packedSize) && packedSize < data.size())
+      {
+        packed.resize(packedSize);
+        compressed = true;
+      }
+    }
+
+    {
+      SCOPED_SERIALISE_CHUNK(eRemoteCopy_Chunk);
+      SERIALISE_ELEMENT(index);
+      SERIALISE_ELEMENT(hash);
+      SERIALISE_ELEMENT(compressed);
+      bytebuf &payload = compressed ? packed : data;
+      SERIALISE_ELEMENT(payload);
+    }
+
+    int32_t sent = Atomic::Inc32(&state.sent);
+
+    if(progress)
+      progress(float(sent) / float(state.needed.count()));
+  }
+
+  if(f)
+    FileIO::fclose(f);
+
+  {
+    uint32_t index = ~0U;
+    uint64_t hash = 0;
+    bool compressed = false;
+    bytebuf payload;
+
+    SCOPED_SERIALISE_CHUNK(eRemoteCopy_Chunk);
+    SERIALISE_ELEMENT(index);
+    SERIALISE_ELEMENT(hash);
+    SERIALISE_ELEMENT(compressed);
+    SERIALISE_ELEMENT(payload);
+  }
+
+  return !ser.IsErrored();
+}
+
+struct ReceiveState
+{
+  uint64_t fileSize;
+  uint64_t chunkSize;
+
+  Threading::CriticalSection lock;
+  FILE *partial;
+  FILE *progressFile;
+  rdcarray<bool> have;
+  int32_t haveCount;
+
+  int32_t errored;
+};
+
+// receives chunks until the end marker. Chunks that fail their checksum are dropped, so they're
+// still missing at the end of this round.
+static void ReceiveChunkStream(ReadSerialiser &ser, ReceiveState &state,
+                               RENDERDOC_ProgressCallback progress)
+{
+  uint64_t numChunks = state.have.size();
+
+  bytebuf payload, unpacked;
+
+  while(true)
+  {
+    RemoteCopyPacket type = ser.ReadChunk<RemoteCopyPacket>();
+
+    if(ser.IsErrored() || type != eRemoteCopy_Chunk)
+    {
+      if(!ser.IsErrored())
+        RDCERR("Unexpected packet %s during file copy", ToStr(type).c_str());
+      Atomic::Inc32(&state.errored);
+      return;
+    }
+
+    uint32_t index = 0;
+    uint64_t hash = 0;
+    bool compressed = false;
+
+    SERIALISE_ELEMENT(index);
+    SERIALISE_ELEMENT(hash);
+    SERIALISE_ELEMENT(compressed);
+    SERIALISE_ELEMENT(payload);
+
+    ser.EndChunk();
+
+    if(ser.IsErrored())
+    {
+      Atomic::Inc32(&state.errored);
+      return;
+    }
+
+    if(index == ~0U)
+      return;
+
+    if(index >= numChunks)
+    {
+      RDCWARN("Ignoring out of range chunk %u", index);
+      continue;
+    }
+
+    uint64_t offset = index * state.chunkSize;
+    uint64_t length = RDCMIN(state.chunkSize, state.fileSize - offset);
+
+    const bytebuf *contents = &payload;
+
+    if(compressed)
+    {
+      unpacked.resize((size_t)length);
+      size_t unpackedSize =
+          ZSTD_decompress(unpacked.data(), unpacked.size(), payload.data(), payload.size());
+
+      if(ZSTD_isError(unpackedSize) || unpackedSize != length)
+      {
+        RDCWARN("Chunk %u failed to decompress, it will be requested again", index);
+        continue;
+      }
+
+      contents = &unpacked;
+    }
+
+    if(contents->size() != length || XXH64(contents->data(), contents->size(), 0) != hash)
+    {
+      RDCWARN("Chunk %u failed its checksum, it will be requested again", index);
+      continue;
+    }
+
+    {
+      SCOPED_LOCK(state.lock);
+
+      if(state.have[index])
+        continue;
+
+      // the data must be on disk before the progress file claims it is
+      FileIO::fseek64(state.partial, offset, SEEK_SET);
+      if(FileIO::fwrite(contents->data(), 1, contents->size(), state.partial) != length ||
+         !FileIO::fflush(state.partial))
+      {
+        RDCERR("Failed to write chunk %u: %s", index, FileIO::ErrorString().c_str());
+        continue;
+      }
+
+      FileIO::fwrite(&index, sizeof(index), 1, state.progressFile);
+      FileIO::fflush(state.progressFile);
+
+      state.have[index] = true;
+    }
+
+    int32_t haveCount = Atomic::Inc32(&state.haveCount);
+
+    if(progress)
+      progress(float(haveCount) / float(numChunks));
+  }
+}
+
+// opens the partial file and its progress file, picking up where a previous copy left off if they
+// match the file being sent. Returns how many chunks were already there.
+static uint32_t OpenPartialFile(const rdcstr &partialPath, const rdcstr &progressPath,
+                                const ProgressHeader &header, ReceiveState &state)
+{
+  uint32_t resumed = 0;
+
+  bytebuf progress;
+  if(FileIO::exists(partialPath.c_str()) &&
+     FileIO::GetFileSize(partialPath) == header.fileSize && FileIO::ReadAll(progressPath, progress) &&
+     progress.size() >= sizeof(ProgressHeader))
+  {
+    ProgressHeader prev;
+    memcpy(&prev, progress.data(), sizeof(prev));
+
+    if(prev.magic == header.magic && prev.version == header.version && prev.key == header.key &&
+       prev.fileSize == header.fileSize && prev.chunkSize == header.chunkSize)
+      state.partial = FileIO::fopen(partialPath.c_str(), "r+b");
+
+    // a trailing partial index from an interrupted write is ignored
+    size_t count = (progress.size() - sizeof(ProgressHeader)) / sizeof(uint32_t);
+    const uint32_t *indices = (const uint32_t *)(progress.data() + sizeof(ProgressHeader));
+
+    for(size_t i = 0; state.partial && i < count; i++)
+    {
+      if(indices[i] < state.have.size() && !state.have[indices[i]])
+      {
+        state.have[indices[i]] = true;
+        resumed++;
+      }
+    }
+  }
+
+  if(state.partial == NULL)
+  {
+    FileIO::CreateParentDirectory(partialPath);
+    state.partial = FileIO::fopen(partialPath.c_str(), "w+b");
+
+    // size the file up-front so that a resume can check it's still intact
+    if(state.partial && header.fileSize > 0)
+    {
+      byte zero = 0;
+      FileIO::fseek64(state.partial, header.fileSize - 1, SEEK_SET);
+      FileIO::fwrite(&zero, 1, 1, state.partial);
+      FileIO::fflush(state.partial);
+    }
+  }
+
+  // rewrite the progress file from scratch, which also drops any torn write at the end of it
+  state.progressFile = FileIO::fopen(progressPath.c_str(), "wb");
+
+  if(state.progressFile)
+  {
+    FileIO::fwrite(&header, sizeof(header), 1, state.progressFile);
+    for(uint32_t i = 0; i < state.have.size(); i++)
+      if(state.have[i])
+        FileIO::fwrite(&i, sizeof(i), 1, state.progressFile);
+    FileIO::fflush(state.progressFile);
+  }
+
+  return resumed;
+}
+
+namespace RemoteCopy
+{
+bool SendFile(ReadSerialiser &reader, WriteSerialiser &writer,
+              const rdcarray<Network::Socket *> &streams, const rdcstr &path, uint64_t key,
+              uint64_t chunkSize, bool compress, RENDERDOC_ProgressCallback progress)
+{
+  bool exists = FileIO::exists(path.c_str());
+  uint64_t fileSize = exists ? FileIO::GetFileSize(path) : 0;
+
+  if(chunkSize == 0)
+    chunkSize = DefaultChunkSize;
+
+  {
+    WriteSerialiser &ser = writer;
+    SCOPED_SERIALISE_CHUNK(eRemoteCopy_Header);
+    SERIALISE_ELEMENT(exists);
+    SERIALISE_ELEMENT(key);
+    SERIALISE_ELEMENT(fileSize);
+    SERIALISE_ELEMENT(chunkSize);
+  }
+
+  if(!exists)
+  {
+    RDCERR("Can't send '%s', it doesn't exist", path.c_str());
+    return false;
+  }
+
+  // these must live for the whole copy, since a reader on the other end may have buffered ahead
+  rdcarray<WriteSerialiser *> streamWriters;
+  for(Network::Socket *sock : streams)
+  {
+    streamWriters.push_back(
+        new WriteSerialiser(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream));
+    streamWriters.back()->SetStreamingMode(true);
+  }
+
+  bool success = false;
+
+  while(!writer.IsErrored())
+  {
+    ReadSerialiser &ser = reader;
+
+    RemoteCopyPacket type = reader.ReadChunk<RemoteCopyPacket>();
+
+    if(reader.IsErrored())
+      break;
+
+    if(type == eRemoteCopy_Status)
+    {
+      SERIALISE_ELEMENT(success);
+      reader.EndChunk();
+      success &= !reader.IsErrored();
+      break;
+    }
+
+    if(type != eRemoteCopy_Needed)
+    {
+      RDCERR("Unexpected packet %s during file copy", ToStr(type).c_str());
+      break;
+    }
+
+    SendState state;
+    state.path = path;
+    state.fileSize = fileSize;
+    state.chunkSize = chunkSize;
+    state.compress = compress;
+    state.next = 0;
+    state.sent = 0;
+
+    SERIALISE_ELEMENT(state.needed).Named("needed"_lit);
+    reader.EndChunk();
+
+    if(reader.IsErrored())
+      break;
+
+    rdcarray<Threading::ThreadHandle> threads;
+    int32_t streamsErrored = 0;
+
+    for(WriteSerialiser *w : streamWriters)
+    {
+      threads.push_back(Threading::CreateThread([w, &state, &streamsErrored]() {
+        if(!SendChunkStream(*w, state, NULL))
+          Atomic::Inc32(&streamsErrored);
+      }));
+    }
+
+    bool mainOK = SendChunkStream(writer, state, progress);
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    if(!mainOK || streamsErrored > 0)
+      break;
+  }
+
+  for(WriteSerialiser *w : streamWriters)
+    delete w;
+
+  if(!success)
+    RDCERR("Failed to send '%s'", path.c_str());
+
+  return success;
+}
+
+bool ReceiveFile(ReadSerialiser &reader, WriteSerialiser &writer,
+                 const rdcarray<Network::Socket *> &streams,
+                 const std::function<rdcstr(uint64_t)> &getPath,
+                 RENDERDOC_ProgressCallback progress, rdcstr &destPath)
+{
+  destPath.clear();
+
+  ProgressHeader header = {};
+  header.magic = ProgressMagic;
+  header.version = ProgressVersion;
+
+  bool exists = false;
+
+  {
+    ReadSerialiser &ser = reader;
+
+    RemoteCopyPacket type = reader.ReadChunk<RemoteCopyPacket>();
+
+    if(reader.IsErrored() || type != eRemoteCopy_Header)
+    {
+      RDCERR("Didn't get file copy header");
+      return false;
+    }
+
+    SERIALISE_ELEMENT(exists);
+    SERIALISE_ELEMENT(header.key).Named("key"_lit);
+    SERIALISE_ELEMENT(header.fileSize).Named("fileSize"_lit);
+    SERIALISE_ELEMENT(header.chunkSize).Named("chunkSize"_lit);
+
+    reader.EndChunk();
+  }
+
+  if(reader.IsErrored())
+    return false;
+
+  if(!exists)
+  {
+    RDCERR("File to be copied doesn't exist");
+    return false;
+  }
+
+  rdcstr dest = getPath(header.key);
+  rdcstr partialPath = dest + ".partial";
+  rdcstr progressPath = dest + ".progress";
+
+  ReceiveState state;
+  state.fileSize = header.fileSize;
+  state.chunkSize = header.chunkSize;
+  state.partial = NULL;
+  state.progressFile = NULL;
+  state.haveCount = 0;
+  state.errored = 0;
+
+  // anything over 4GB chunks can't be serialised, so is not a valid copy
+  bool valid = header.chunkSize > 0 && header.chunkSize <= 0xffffffffU;
+
+  if(valid)
+  {
+    state.have.resize((size_t)ChunkCount(header.fileSize, header.chunkSize));
+
+    state.haveCount = (int32_t)OpenPartialFile(partialPath, progressPath, header, state);
+
+    if(state.partial == NULL || state.progressFile == NULL)
+    {
+      RDCERR("Can't write to '%s': %s", partialPath.c_str(), FileIO::ErrorString().c_str());
+      valid = false;
+    }
+    else if(state.haveCount > 0)
+    {
+      RDCLOG("Resuming copy to '%s' with %d of %zu chunks already received", dest.c_str(),
+             state.haveCount, state.have.size());
+    }
+  }
+
+  rdcarray<ReadSerialiser *> streamReaders;
+  for(Network::Socket *sock : streams)
+  {
+    streamReaders.push_back(
+        new ReadSerialiser(new StreamReader(sock, Ownership::Nothing), Ownership::Stream));
+    streamReaders.back()->SetStreamingMode(true);
+  }
+
+  bool success = false;
+
+  for(uint32_t attempt = 0; valid; attempt++)
+  {
+    rdcarray<uint32_t> needed;
+    for(uint32_t i = 0; i < state.have.size(); i++)
+      if(!state.have[i])
+        needed.push_back(i);
+
+    if(needed.empty())
+    {
+      success = true;
+      break;
+    }
+
+    if(attempt == MaxCopyAttempts)
+    {
+      RDCERR("%zu chunks of '%s' still failed after %u attempts", needed.size(), dest.c_str(),
+             attempt);
+      break;
+    }
+
+    {
+      WriteSerialiser &ser = writer;
+      SCOPED_SERIALISE_CHUNK(eRemoteCopy_Needed);
+      SERIALISE_ELEMENT(needed);
+    }
+
+    rdcarray<Threading::ThreadHandle> threads;
+
+    for(ReadSerialiser *r : streamReaders)
+      threads.push_back(
+          Threading::CreateThread([r, &state]() { ReceiveChunkStream(*r, state, NULL); }));
+
+    ReceiveChunkStream(reader, state, progress);
+
+    for(Threading::ThreadHandle t : threads)
+    {
+      Threading::JoinThread(t);
+      Threading::CloseThread(t);
+    }
+
+    if(state.errored > 0 || writer.IsErrored())
+      break;
+  }
+
+  for(ReadSerialiser *r : streamReaders)
+    delete r;
+
+  if(state.partial)
+    FileIO::fclose(state.partial);
+  if(state.progressFile)
+    FileIO::fclose(state.progressFile);
+
+  // on a network error the partial file is kept so that the copy can resume
+  if(state.errored > 0 || writer.IsErrored())
+  {
+    RDCERR("Network error receiving file, %d of %zu chunks received", state.haveCount,
+           state.have.size());
+    return false;
+  }
+
+  {
+    WriteSerialiser &ser = writer;
+    SCOPED_SERIALISE_CHUNK(eRemoteCopy_Status);
+    SERIALISE_ELEMENT(success);
+  }
+
+  if(!success)
+    return false;
+
+  FileIO::Delete(dest.c_str());
+  if(!FileIO::Move(partialPath.c_str(), dest.c_str(), true))
+  {
+    RDCERR("Couldn't move received file to '%s'", dest.c_str());
+    return false;
+  }
+
+  FileIO::Delete(progressPath.c_str());
+
+  destPath = dest;
+
+  return true;
+}
+};    // namespace RemoteCopy
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static bytebuf RandomBytes(size_t size, uint32_t seed)
+{
+  bytebuf ret;
+  ret.resize(size);
+  uint32_t state = seed;
+  for(size_t i = 0; i < size; i++)
+  {
+    state = state * 1664525U + 1013904223U;
+    ret[i] = byte(state >> 24);
+  }
+  return ret;
+}
+
+static Network::Socket *ListenOnFreePort(uint16_t &port)
+{
+  for(port = 39020; port < 39120; port++)
+  {
+    Network::Socket *sock = Network::CreateServerSocket("127.0.0.1", port, 4);
+    if(sock)
+      return sock;
+  }
+
+  return NULL;
+}
+
+// one end of a loopback connection, with serialisers the way the remote server sets them up
+struct CopyEndpoint
+{
+  CopyEndpoint(Network::Socket *s) : sock(s)
+  {
+    sock->SetTimeout(5000);
+    writer = new WriteSerialiser(new StreamWriter(sock, Ownership::Nothing), Ownership::Stream);
+    reader = new ReadSerialiser(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
+    writer->SetStreamingMode(true);
+    reader->SetStreamingMode(true);
+  }
+
+  ~CopyEndpoint()
+  {
+    delete writer;
+    delete reader;
+    delete sock;
+    for(Network::Socket *s : streams)
+      delete s;
+  }
+
+  Network::Socket *sock;
+  WriteSerialiser *writer;
+  ReadSerialiser *reader;
+  rdcarray<Network::Socket *> streams;
+};
+
+struct CopyConnection
+{
+  CopyConnection(uint32_t numStreams)
+  {
+    uint16_t port = 0;
+    listen = ListenOnFreePort(port);
+    REQUIRE(listen);
+
+    Network::Socket *s = Network::CreateClientSocket("127.0.0.1", port, 1000);
+    REQUIRE(s);
+    sender = new CopyEndpoint(s);
+
+    s = listen->AcceptClient(1000);
+    REQUIRE(s);
+    receiver = new CopyEndpoint(s);
+
+    if(numStreams > 0)
+    {
+      uint64_t token = 0;
+      sender->streams = RemoteCopy::OpenStreams("127.0.0.1", port, numStreams, 5000, token);
+      REQUIRE(sender->streams.size() == numStreams);
+
+      // do what the remote server's accept loop does with new connections
+      for(uint32_t i = 0; i < numStreams; i++)
+      {
+        Network::Socket *client = listen->AcceptClient(1000);
+        REQUIRE(client);
+
+        ReadSerialiser ser(new StreamReader(client, Ownership::Nothing), Ownership::Stream);
+        REQUIRE(ser.ReadChunk<RemoteCopyPacket>() == eRemoteCopy_Stream);
+        REQUIRE(RemoteCopy::AcceptStream(client, ser));
+      }
+
+      rdcarray<uint32_t> indices;
+      receiver->streams = RemoteCopy::TakeStreams(token, numStreams, 1000, indices);
+
+      REQUIRE(indices.size() == numStreams);
+      for(uint32_t i = 0; i < numStreams; i++)
+        CHECK(indices[i] == i);
+
+      for(Network::Socket *r : receiver->streams)
+        r->SetTimeout(5000);
+    }
+  }
+
+  ~CopyConnection()
+  {
+    delete sender;
+    delete receiver;
+    delete listen;
+  }
+
+  // runs the sender on a thread and the receiver on this one
+  bool Copy(const rdcstr &src, const rdcstr &dst, uint64_t chunkSize, bool compress,
+            RENDERDOC_ProgressCallback senderProgress, bool &sendResult)
+  {
+    Threading::ThreadHandle thread = Threading::CreateThread([&]() {
+      sendResult = RemoteCopy::SendFile(*sender->reader, *sender->writer, sender->streams, src,
+                                        RemoteCopy::MakeFileKey(src), chunkSize, compress,
+                                        senderProgress);
+    });
+
+    rdcstr destPath;
+    bool ret = RemoteCopy::ReceiveFile(*receiver->reader, *receiver->writer, receiver->streams,
+                                       [dst](uint64_t) { return dst; }, NULL, destPath);
+
+    // if the receiver fails first, make sure the sender isn't left waiting on it
+    if(!ret)
+      receiver->sock->Shutdown();
+
+    Threading::JoinThread(thread);
+    Threading::CloseThread(thread);
+
+    if(ret)
+      CHECK(destPath == dst);
+
+    return ret;
+  }
+
+  Network::Socket *listen;
+  CopyEndpoint *sender;
+  CopyEndpoint *receiver;
+};
+
+TEST_CASE("Test chunked remote file copy", "[remotecopy]")
+{
+  rdcstr dir = FileIO::GetTempFolderFilename() + "renderdoc_remote_copy_tests";
+  rdcstr src = dir + "/source.rdc";
+  rdcstr dst = dir + "/dest.rdc";
+
+  FileIO::CreateParentDirectory(src);
+  FileIO::Delete(dst.c_str());
+  FileIO::Delete((dst + ".partial").c_str());
+  FileIO::Delete((dst + ".progress").c_str());
+
+  const uint64_t chunkSize = 16 * 1024;
+
+  // not a multiple of the chunk size, so the last chunk is short
+  bytebuf data = RandomBytes(64 * chunkSize - 1234, 7);
+
+  // make part of it compressible
+  memset(data.data() + chunkSize * 4, 0x42, chunkSize * 8);
+
+  REQUIRE(FileIO::WriteAll(src, data));
+
+  bytebuf result;
+
+  SECTION("Single stream copy")
+  {
+    CopyConnection conn(0);
+    bool sent = false;
+    REQUIRE(conn.Copy(src, dst, chunkSize, false, NULL, sent));
+    CHECK(sent);
+  }
+
+  SECTION("Compressed copy")
+  {
+    CopyConnection conn(0);
+    bool sent = false;
+    REQUIRE(conn.Copy(src, dst, chunkSize, true, NULL, sent));
+    CHECK(sent);
+  }
+
+  SECTION("Multiple stream copy")
+  {
+    CopyConnection conn(3);
+    bool sent = false;
+    REQUIRE(conn.Copy(src, dst, chunkSize, true, NULL, sent));
+    CHECK(sent);
+  }
+
+  SECTION("Empty file")
+  {
+    data.clear();
+    REQUIRE(FileIO::WriteAll(src, data));
+
+    CopyConnection conn(1);
+    bool sent = false;
+    REQUIRE(conn.Copy(src, dst, chunkSize, false, NULL, sent));
+    CHECK(sent);
+  }
+
+  SECTION("Missing file")
+  {
+    CopyConnection conn(0);
+    bool sent = true;
+    CHECK_FALSE(conn.Copy(dir + "/missing.rdc", dst, chunkSize, false, NULL, sent));
+    CHECK_FALSE(sent);
+
+    // nothing to compare
+    data.clear();
+    REQUIRE(FileIO::WriteAll(dst, data));
+  }
+
+  SECTION("Resume after a dropped connection")
+  {
+    int32_t sentChunks = 0;
+
+    {
+      CopyConnection conn(0);
+
+      // drop the connection from the sending side part-way through
+      Network::Socket *sock = conn.sender->sock;
+      RENDERDOC_ProgressCallback dropConnection = [&sentChunks, sock](float) {
+        if(++sentChunks == 20)
+          sock->Shutdown();
+      };
+
+      bool sent = true;
+      CHECK_FALSE(conn.Copy(src, dst, chunkSize, false, dropConnection, sent));
+      CHECK_FALSE(sent);
+    }
+
+    CHECK(FileIO::exists((dst + ".partial").c_str()));
+    CHECK(FileIO::exists((dst + ".progress").c_str()));
+
+    sentChunks = 0;
+
+    {
+      CopyConnection conn(0);
+
+      RENDERDOC_ProgressCallback countChunks = [&sentChunks](float) { sentChunks++; };
+
+      bool sent = false;
+      REQUIRE(conn.Copy(src, dst, chunkSize, false, countChunks, sent));
+      CHECK(sent);
+    }
+
+    // only the chunks that didn't make it the first time were sent again
+    CHECK(sentChunks > 0);
+    CHECK(sentChunks <= 64 - 20);
+  }
+
+  SECTION("Changed source restarts the copy")
+  {
+    {
+      CopyConnection conn(0);
+
+      Network::Socket *sock = conn.sender->sock;
+      int32_t sentChunks = 0;
+      RENDERDOC_ProgressCallback dropConnection = [&sentChunks, sock](float) {
+        if(++sentChunks == 20)
+          sock->Shutdown();
+      };
+
+      bool sent = true;
+      CHECK_FALSE(conn.Copy(src, dst, chunkSize, false, dropConnection, sent));
+    }
+
+    // a different size gives a different key, so none of the partial file can be reused
+    data = RandomBytes(64 * chunkSize + 99, 8);
+    REQUIRE(FileIO::WriteAll(src, data));
+
+    int32_t sentChunks = 0;
+    RENDERDOC_ProgressCallback countChunks = [&sentChunks](float) { sentChunks++; };
+
+    CopyConnection conn(0);
+    bool sent = false;
+    REQUIRE(conn.Copy(src, dst, chunkSize, false, countChunks, sent));
+    CHECK(sentChunks == 65);
+  }
+
+  REQUIRE(FileIO::ReadAll(dst, result));
+  CHECK(result.size() == data.size());
+  CHECK((result == data));
+
+  CHECK_FALSE(FileIO::exists((dst + ".partial").c_str()));
+  CHECK_FALSE(FileIO::exists((dst + ".progress").c_str()));
+
+  FileIO::Delete(src.c_str());
+  FileIO::Delete(dst.c_str());
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,89 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include "api/replay/renderdoc_replay.h"
+#include "common/common.h"
+#include "os/os_specific.h"
+#include "serialise/serialiser.h"
+
+// Copies files between the host and a remote server in fixed size chunks, each with a checksum and
+// optionally zstd compressed. The chunks can be spread over several extra sockets as well as the
+// main connection.
+//
+// The receiving side records which chunks it has in a progress file next to the partially copied
+// file. If a copy fails part-way, e.g. when the connection drops, retrying the same copy only
+// sends the chunks that are still missing.
+
+enum RemoteCopyPacket
+{
+  // offset so that these can share a connection with remote server and replay proxy packets
+  eRemoteCopy_First = 0x2000,
+
+  eRemoteCopy_Stream = eRemoteCopy_First,
+  eRemoteCopy_Header,
+  eRemoteCopy_Needed,
+  eRemoteCopy_Chunk,
+  eRemoteCopy_Status,
+};
+
+DECLARE_REFLECTION_ENUM(RemoteCopyPacket);
+
+namespace RemoteCopy
+{
+static const uint64_t DefaultChunkSize = 4 * 1024 * 1024;
+
+// identifies a file by its path, size and modification time, so that a retried copy of an
+// unchanged file can resume
+uint64_t MakeFileKey(const rdcstr &path);
+
+// connects up to count extra sockets for a copy, all identified by a new token. Each socket's
+// index is its position in the returned array.
+rdcarray<Network::Socket *> OpenStreams(const rdcstr &host, uint16_t port, uint32_t count,
+                                        uint32_t timeoutMS, uint64_t &token);
+
+// on the remote server, takes a newly accepted connection whose first packet was eRemoteCopy_Stream
+// and holds onto it until TakeStreams claims it.
+bool AcceptStream(Network::Socket *sock, ReadSerialiser &ser);
+
+// waits for up to count extra streams with the given token to arrive, and takes ownership of them.
+// The streams are returned in index order, with their indices in the same order.
+rdcarray<Network::Socket *> TakeStreams(uint64_t token, uint32_t count, uint32_t timeoutMS,
+                                        rdcarray<uint32_t> &indices);
+
+// sends a file. Control packets go over the main reader and writer, and chunks are sent over the
+// main writer and all of the extra streams in parallel.
+bool SendFile(ReadSerialiser &reader, WriteSerialiser &writer,
+              const rdcarray<Network::Socket *> &streams, const rdcstr &path, uint64_t key,
+              uint64_t chunkSize, bool compress, RENDERDOC_ProgressCallback progress);
+
+// receives a file sent with SendFile over the same set of streams. getPath returns the destination
+// for the file given its key. On success the complete file is at destPath.
+bool ReceiveFile(ReadSerialiser &reader, WriteSerialiser &writer,
+                 const rdcarray<Network::Socket *> &streams,
+                 const std::function<rdcstr(uint64_t)> &getPath,
+                 RENDERDOC_ProgressCallback progress, rdcstr &destPath);
+};
@@ -28,6 +28,7 @@
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "api/replay/version.h"
+#include "common/threading.h"
 #include "core/core.h"
 #include "core/settings.h"
 #include "os/os_specific.h"
@@ -35,11 +36,35 @@
 #include "serialise/rdcfile.h"
 #include "serialise/serialiser.h"
 #include "strings/string_utils.h"
+#include "remote_copy.h"
 #include "replay_proxy.h"
 
 RDOC_CONFIG(uint32_t, RemoteServer_TimeoutMS, 5000,
             "Timeout in milliseconds for remote server operations.");
 
+RDOC_CONFIG(uint64_t, RemoteServer_MaxSessions, 1,
+            "How many clients the remote server will serve at once, each with their own replay "
+            "session.");
+
+RDOC_CONFIG(uint64_t, RemoteServer_MaxQueued, 4,
+            "How many clients can wait for a remote server session when all sessions are in use. "
+            "Any more are told the server is busy.");
+
+RDOC_CONFIG(uint64_t, RemoteServer_QueueWaitMS, 0,
+            "How long in milliseconds to wait in a remote server's queue for a session before "
+            "giving up. If 0, a server with no free sessions is treated as busy.");
+
+RDOC_CONFIG(uint64_t, RemoteServer_MaxCaptureSizeMB, 0,
+            "The largest uncompressed frame capture in MB that a remote server session will open. "
+            "If 0 there is no limit.");
+
+RDOC_CONFIG(uint64_t, RemoteServer_CopyStreams, 0,
+            "How many extra sockets to open to the remote server when copying captures, to spread "
+            "the copy over several connections.");
+
+RDOC_CONFIG(bool, RemoteServer_CopyCompression, false,
+            "Compress captures with zstd while copying them to or from the remote server.");
+
 RDOC_DEBUG_CONFIG(bool, RemoteServer_DebugLogging, false,
                   "Where possible (i.e. it is completely unambiguous) replace register names with "
                   "high-level variable names.");
@@ -47,6 +72,8 @@ RDOC_DEBUG_CONFIG(bool, RemoteServer_DebugLogging, false,
 static const uint32_t RemoteServerProtocolVersion =
     uint32_t(RENDERDOC_VERSION_MAJOR * 1000) | RENDERDOC_VERSION_MINOR;
 
+static const uint32_t MaxCopyStreams = 16;
+
 enum RemoteServerPacket
 {
   eRemoteServer_Noop = 1,
@@ -79,6 +106,7 @@ enum RemoteServerPacket
   eRemoteServer_GetSectionContents,
   eRemoteServer_WriteSection,
   eRemoteServer_GetAvailableGPUs,
+  eRemoteServer_Queued,
   eRemoteServer_RemoteServerCount,
 };
 
@@ -122,6 +150,7 @@ rdcstr DoStringise(const RemoteServerPacket &el)
     STRINGISE_ENUM_NAMED(eRemoteServer_GetSectionContents, "GetSectionContents");
     STRINGISE_ENUM_NAMED(eRemoteServer_WriteSection, "WriteSection");
     STRINGISE_ENUM_NAMED(eRemoteServer_GetAvailableGPUs, "GetAvailableGPUs");
+    STRINGISE_ENUM_NAMED(eRemoteServer_Queued, "Queued");
     STRINGISE_ENUM_NAMED(eRemoteServer_RemoteServerCount, "RemoteServerCount");
   }
   END_ENUM_STRINGISE();
@@ -132,20 +161,31 @@ rdcstr GetRemoteServerChunkName(uint32_t idx)
   if(idx < eRemoteServer_RemoteServerCount)
     return ToStr((RemoteServerPacket)idx);
 
+  if(idx >= eRemoteCopy_First)
+    return ToStr((RemoteCopyPacket)idx);
+
   return ToStr((ReplayProxyPacket)idx);
 }
 
 #define WRITE_DATA_SCOPE() WriteSerialiser &ser = writer;
 #define READ_DATA_SCOPE() ReadSerialiser &ser = reader;
 
+struct SessionQueue;
+
 struct ClientThread
 {
   ClientThread()
-      : socket(NULL), allowExecution(false), killThread(false), killServer(false), thread(0)
+      : socket(NULL),
+        queue(NULL),
+        allowExecution(false),
+        killThread(false),
+        killServer(false),
+        thread(0)
   {
   }
 
   Network::Socket *socket;
+  SessionQueue *queue;
 
   bool allowExecution;
   bool killThread;
@@ -154,66 +194,168 @@ struct ClientThread
   Threading::ThreadHandle thread;
 };
 
-static void InactiveRemoteClientThread(ClientThread *threadData)
+enum class SessionAdmission
 {
-  Threading::SetCurrentThreadName("InactiveRemoteClientThread");
-
-  uint32_t ip = threadData->socket->GetRemoteIP();
+  Admitted,
+  Queued,
+  Busy,
+};
 
+// hands out the server's replay sessions to clients in the order they connected
+struct SessionQueue
+{
+  SessionAdmission TryAdmit(ClientThread *client, uint32_t &position)
   {
-    uint32_t version = 0;
+    SCOPED_LOCK(lock);
 
-    {
-      ReadSerialiser ser(new StreamReader(threadData->socket, Ownership::Nothing), Ownership::Stream);
+    uint64_t maxSessions = RemoteServer_MaxSessions;
+    maxSessions = RDCMAX(maxSessions, (uint64_t)1);
 
-      // this thread just handles receiving the handshake and sending a busy signal without blocking
-      // the server thread
-      RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+    int32_t idx = waiting.indexOf(client);
 
-      if(ser.IsErrored() || type != eRemoteServer_Handshake)
+    if(idx < 0)
+    {
+      if(waiting.empty() && active < maxSessions)
       {
-        RDCWARN("Didn't receive proper handshake");
-        SAFE_DELETE(threadData->socket);
-        return;
+        active++;
+        return SessionAdmission::Admitted;
       }
 
-      SERIALISE_ELEMENT(version);
+      if(waiting.size() >= RemoteServer_MaxQueued)
+        return SessionAdmission::Busy;
 
-      ser.EndChunk();
+      waiting.push_back(client);
+      idx = waiting.count() - 1;
     }
-
+    else if(idx == 0 && active < maxSessions)
     {
-      WriteSerialiser ser(new StreamWriter(threadData->socket, Ownership::Nothing),
-                          Ownership::Stream);
+      waiting.erase(0);
+      active++;
+      return SessionAdmission::Admitted;
+    }
 
-      ser.SetStreamingMode(true);
+    position = uint32_t(idx + 1);
+    return SessionAdmission::Queued;
+  }
 
-      if(version != RemoteServerProtocolVersion)
-      {
-        RDCLOG("Connection using protocol %u, but we are running %u", version,
-               RemoteServerProtocolVersion);
+  void Leave(ClientThread *client)
+  {
+    SCOPED_LOCK(lock);
+    waiting.removeOne(client);
+  }
 
-        {
-          SCOPED_SERIALISE_CHUNK(eRemoteServer_VersionMismatch);
-        }
-      }
-      else
-      {
-        SCOPED_SERIALISE_CHUNK(eRemoteServer_Busy);
-      }
+  void Release(ClientThread *client)
+  {
+    SCOPED_LOCK(lock);
+    active--;
+    if(previewOwner == client)
+      previewOwner = NULL;
+  }
+
+  // there's only one preview window, so only one session at a time can show its replay
+  bool ClaimPreview(ClientThread *client)
+  {
+    SCOPED_LOCK(lock);
+    if(previewOwner == NULL)
+      previewOwner = client;
+    return previewOwner == client;
+  }
+
+  void ReleasePreview(ClientThread *client)
+  {
+    SCOPED_LOCK(lock);
+    if(previewOwner == client)
+      previewOwner = NULL;
+  }
+
+private:
+  Threading::CriticalSection lock;
+  uint32_t active = 0;
+  rdcarray<ClientThread *> waiting;
+  ClientThread *previewOwner = NULL;
+};
+
+// capture loading reports progress through global state, so sessions take turns to load
+static Threading::CriticalSection captureLoadLock;
+
+static bool FitsCaptureSizeLimit(RDCFile *rdc)
+{
+  uint64_t limitMB = RemoteServer_MaxCaptureSizeMB;
+
+  if(limitMB == 0)
+    return true;
+
+  // only the size of the capture is checked, as a cheap guard against opening something far too
+  // big. The replay's own allocations aren't tracked
+  int idx = rdc->SectionIndex(SectionType::FrameCapture);
+  uint64_t needed = idx >= 0 ? rdc->GetSectionProperties(idx).uncompressedSize : 0;
+
+  if(needed > limitMB * 1024 * 1024)
+  {
+    RDCERR("Capture is %llu MB uncompressed, more than the %llu MB limit",
+           needed / (1024 * 1024), limitMB);
+    return false;
+  }
+
+  return true;
+}
+
+// waits in the queue until there's a session for this client. Returns false if the client was
+// turned away or went away while waiting.
+static bool WaitForSession(ClientThread *threadData)
+{
+  WriteSerialiser ser(new StreamWriter(threadData->socket, Ownership::Nothing), Ownership::Stream);
+
+  ser.SetStreamingMode(true);
+
+  while(!threadData->killThread)
+  {
+    uint32_t position = 0;
+    SessionAdmission admission = threadData->queue->TryAdmit(threadData, position);
+
+    if(admission == SessionAdmission::Admitted)
+      return true;
+
+    if(admission == SessionAdmission::Busy)
+    {
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_Busy);
+      return false;
     }
 
-    SAFE_DELETE(threadData->socket);
+    // keep the client updated on where it is, which also tells us if it has given up waiting
+    {
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_Queued);
+      SERIALISE_ELEMENT(position);
+    }
 
-    RDCLOG("Closed inactive connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
-           Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
+    if(ser.IsErrored())
+      break;
+
+    Threading::Sleep(100);
   }
+
+  threadData->queue->Leave(threadData);
+
+  return false;
 }
 
-static void ActiveRemoteClientThread(ClientThread *threadData,
-                                     RENDERDOC_PreviewWindowCallback previewWindow)
+static rdcarray<Network::Socket *> TakeCopyStreams(uint64_t token, uint32_t count,
+                                                   rdcarray<uint32_t> &accepted)
 {
-  Threading::SetCurrentThreadName("ActiveRemoteClientThread");
+  // the client connects these before sending the copy request, so they should already be here
+  rdcarray<Network::Socket *> streams =
+      RemoteCopy::TakeStreams(token, RDCMIN(count, MaxCopyStreams), 1000, accepted);
+
+  for(Network::Socket *s : streams)
+    s->SetTimeout(RemoteServer_TimeoutMS);
+
+  return streams;
+}
+
+static void RemoteClientThread(ClientThread *threadData,
+                               RENDERDOC_PreviewWindowCallback previewWindow)
+{
+  Threading::SetCurrentThreadName("RemoteClientThread");
 
   Network::Socket *&client = threadData->socket;
 
@@ -226,10 +368,18 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
   {
     ReadSerialiser ser(new StreamReader(client, Ownership::Nothing), Ownership::Stream);
 
-    // this thread just handles receiving the handshake and sending a busy signal without blocking
-    // the server thread
     RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
+    // extra sockets for a capture copy in another session get handed over to it
+    if(!ser.IsErrored() && (uint32_t)type == eRemoteCopy_Stream)
+    {
+      if(RemoteCopy::AcceptStream(client, ser))
+        client = NULL;
+      else
+        SAFE_DELETE(client);
+      return;
+    }
+
     if(ser.IsErrored() || type != eRemoteServer_Handshake)
     {
       RDCWARN("Didn't receive proper handshake");
@@ -242,29 +392,44 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     ser.EndChunk();
   }
 
+  if(version != RemoteServerProtocolVersion)
   {
-    WriteSerialiser ser(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
-
-    ser.SetStreamingMode(true);
+    RDCLOG("Connection using protocol %u, but we are running %u", version,
+           RemoteServerProtocolVersion);
 
-    if(version != RemoteServerProtocolVersion)
     {
-      RDCLOG("Connection using protocol %u, but we are running %u", version,
-             RemoteServerProtocolVersion);
+      WriteSerialiser ser(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
 
-      {
-        SCOPED_SERIALISE_CHUNK(eRemoteServer_VersionMismatch);
-      }
-      SAFE_DELETE(client);
-      return;
-    }
-    else
-    {
-      // handshake and continue
-      SCOPED_SERIALISE_CHUNK(eRemoteServer_Handshake);
+      ser.SetStreamingMode(true);
+
+      SCOPED_SERIALISE_CHUNK(eRemoteServer_VersionMismatch);
     }
+
+    SAFE_DELETE(client);
+    return;
+  }
+
+  if(!WaitForSession(threadData))
+  {
+    SAFE_DELETE(client);
+
+    RDCLOG("Closed waiting connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
+           Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
+    return;
+  }
+
+  {
+    WriteSerialiser ser(new StreamWriter(client, Ownership::Nothing), Ownership::Stream);
+
+    ser.SetStreamingMode(true);
+
+    // handshake and continue
+    SCOPED_SERIALISE_CHUNK(eRemoteServer_Handshake);
   }
 
+  RDCLOG("Starting session for %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
+         Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
+
   rdcarray<rdcstr> tempFiles;
   IRemoteDriver *remoteDriver = NULL;
   IReplayDriver *replayDriver = NULL;
@@ -363,53 +528,83 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     else if(type == eRemoteServer_CopyCaptureFromRemote)
     {
       rdcstr path;
+      uint64_t token = 0;
+      uint32_t streamCount = 0;
+      bool compress = false;
 
       {
         READ_DATA_SCOPE();
         SERIALISE_ELEMENT(path);
+        SERIALISE_ELEMENT(token);
+        SERIALISE_ELEMENT(streamCount);
+        SERIALISE_ELEMENT(compress);
       }
 
       reader.EndChunk();
 
+      rdcarray<uint32_t> accepted;
+      rdcarray<Network::Socket *> streams = TakeCopyStreams(token, streamCount, accepted);
+
       {
         WRITE_DATA_SCOPE();
         SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
-
-        StreamReader fileStream(FileIO::fopen(path.c_str(), "rb"));
-        ser.SerialiseStream(path, fileStream);
+        SERIALISE_ELEMENT(accepted);
       }
+
+      RemoteCopy::SendFile(reader, writer, streams, path, RemoteCopy::MakeFileKey(path),
+                           RemoteCopy::DefaultChunkSize, compress, NULL);
+
+      for(Network::Socket *s : streams)
+        delete s;
     }
     else if(type == eRemoteServer_CopyCaptureToRemote)
     {
-      rdcstr path;
-      rdcstr dummy, dummy2;
-      FileIO::GetDefaultFiles("remotecopy", path, dummy, dummy2);
-
-      RDCLOG("Copying file to local path '%s'.", path.c_str());
-
-      FileIO::CreateParentDirectory(path);
+      uint64_t token = 0;
+      uint32_t streamCount = 0;
 
       {
         READ_DATA_SCOPE();
-
-        StreamWriter streamWriter(FileIO::fopen(path.c_str(), "wb"), Ownership::Stream);
-
-        ser.SerialiseStream(path.c_str(), streamWriter, NULL);
+        SERIALISE_ELEMENT(token);
+        SERIALISE_ELEMENT(streamCount);
       }
 
       reader.EndChunk();
 
-      if(reader.IsErrored())
+      rdcarray<uint32_t> accepted;
+      rdcarray<Network::Socket *> streams = TakeCopyStreams(token, streamCount, accepted);
+
       {
-        FileIO::Delete(path.c_str());
+        WRITE_DATA_SCOPE();
+        SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
+        SERIALISE_ELEMENT(accepted);
+      }
 
+      // name the file after the capture being sent, so that if this copy fails part-way a retry
+      // finds the partial copy and resumes it
+      rdcstr path;
+      bool success = RemoteCopy::ReceiveFile(
+          reader, writer, streams,
+          [](uint64_t key) {
+            return StringFormat::Fmt("%s/RenderDoc/remotecopy_%016llx.rdc",
+                                     FileIO::GetTempFolderFilename().c_str(), key);
+          },
+          NULL, path);
+
+      for(Network::Socket *s : streams)
+        delete s;
+
+      if(reader.IsErrored() || writer.IsErrored())
+      {
         RDCERR("Network error receiving file");
         break;
       }
 
-      RDCLOG("File received.");
+      if(success)
+      {
+        RDCLOG("File received at '%s'.", path.c_str());
 
-      tempFiles.push_back(path);
+        tempFiles.push_back(path);
+      }
 
       {
         WRITE_DATA_SCOPE();
@@ -492,6 +687,10 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
           default: break;
         }
       }
+      else if(!FitsCaptureSizeLimit(rdc))
+      {
+        status = ReplayStatus::NetworkRemoteCaptureTooLarge;
+      }
       else
       {
         if(RenderDoc::Inst().HasRemoteDriver(rdc->GetDriver()))
@@ -499,8 +698,6 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
           bool kill = false;
           float progress = 0.0f;
 
-          RenderDoc::Inst().SetProgressCallback<LoadProgress>([&progress](float p) { progress = p; });
-
           Threading::ThreadHandle ticker = Threading::CreateThread([&writer, &kill, &progress]() {
             while(!kill)
             {
@@ -513,6 +710,11 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
             }
           });
 
+          // the ticker keeps the client informed while we wait for any other session to load
+          SCOPED_LOCK(captureLoadLock);
+
+          RenderDoc::Inst().SetProgressCallback<LoadProgress>([&progress](float p) { progress = p; });
+
           // if we have a replay driver, try to create it so we can display a local preview e.g.
           if(RenderDoc::Inst().HasReplayDriver(rdc->GetDriver()))
           {
@@ -550,7 +752,10 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
           if(status == ReplayStatus::Succeeded && remoteDriver)
           {
-            proxy = new ReplayProxy(reader, writer, remoteDriver, replayDriver, previewWindow);
+            proxy = new ReplayProxy(
+                reader, writer, remoteDriver, replayDriver,
+                threadData->queue->ClaimPreview(threadData) ? previewWindow
+                                                            : RENDERDOC_PreviewWindowCallback());
           }
         }
         else
@@ -801,6 +1006,7 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
         if(sectionWriter)
         {
           sectionWriter->Write(contents.data(), contents.size());
+          sectionWriter->Finish();
           delete sectionWriter;
 
           success = true;
@@ -826,6 +1032,8 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
 
       SAFE_DELETE(rdc);
       SAFE_DELETE(resolver);
+
+      threadData->queue->ReleasePreview(threadData);
     }
     else if(type == eRemoteServer_ExecuteAndInject)
     {
@@ -890,10 +1098,10 @@ static void ActiveRemoteClientThread(ClientThread *threadData,
     FileIO::Delete(tempFiles[i].c_str());
   }
 
-  RDCLOG("Closing active connection from %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
-         Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
+  threadData->queue->Release(threadData);
 
-  RDCLOG("Ready for new active connection...");
+  RDCLOG("Closing session for %u.%u.%u.%u.", Network::GetIPOctet(ip, 0),
+         Network::GetIPOctet(ip, 1), Network::GetIPOctet(ip, 2), Network::GetIPOctet(ip, 3));
 
   SAFE_DELETE(client);
 }
@@ -1000,38 +1208,38 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
 
   RDCLOG("Replay host ready for requests...");
 
-  ClientThread *activeClientData = NULL;
+  SessionQueue queue;
 
-  rdcarray<ClientThread *> inactives;
+  rdcarray<ClientThread *> clients;
 
   while(!killReplay())
   {
-    Network::Socket *client = sock->AcceptClient(0);
+    Network::Socket *client = sock->AcceptClient(5);
 
-    if(activeClientData && activeClientData->killServer)
-      break;
+    bool killServer = false;
 
-    // reap any dead inactive threads
-    for(size_t i = 0; i < inactives.size(); i++)
+    // reap any finished client threads
+    for(size_t i = 0; i < clients.size();)
     {
-      if(inactives[i]->socket == NULL)
+      killServer |= clients[i]->killServer;
+
+      if(clients[i]->socket == NULL)
       {
-        Threading::JoinThread(inactives[i]->thread);
-        Threading::CloseThread(inactives[i]->thread);
-        delete inactives[i];
-        inactives.erase(i);
-        break;
+        Threading::JoinThread(clients[i]->thread);
+        Threading::CloseThread(clients[i]->thread);
+        delete clients[i];
+        clients.erase(i);
+      }
+      else
+      {
+        i++;
       }
     }
 
-    // reap our active connection possibly
-    if(activeClientData && activeClientData->socket == NULL)
+    if(killServer)
     {
-      Threading::JoinThread(activeClientData->thread);
-      Threading::CloseThread(activeClientData->thread);
-
-      delete activeClientData;
-      activeClientData = NULL;
+      SAFE_DELETE(client);
+      break;
     }
 
     if(client == NULL)
@@ -1039,13 +1247,9 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       if(!sock->Connected())
       {
         RDCERR("Error in accept - shutting down server");
-
-        SAFE_DELETE(sock);
-        return;
+        break;
       }
 
-      Threading::Sleep(5);
-
       continue;
     }
 
@@ -1075,81 +1279,35 @@ void RenderDoc::BecomeRemoteServer(const char *listenhost, uint16_t port,
       continue;
     }
 
-    if(activeClientData == NULL)
-    {
-      activeClientData = new ClientThread();
-      activeClientData->socket = client;
-      activeClientData->allowExecution = allowExecution;
-
-      activeClientData->thread = Threading::CreateThread([activeClientData, previewWindow]() {
-        ActiveRemoteClientThread(activeClientData, previewWindow);
-      });
-
-      RDCLOG("Making active connection");
-    }
-    else
-    {
-      ClientThread *inactive = new ClientThread();
-      inactive->socket = client;
-      inactive->allowExecution = false;
+    // each client waits for a session on its own thread, so that the server stays responsive
+    ClientThread *clientData = new ClientThread();
+    clientData->socket = client;
+    clientData->queue = &queue;
+    clientData->allowExecution = allowExecution;
 
-      inactive->thread =
-          Threading::CreateThread([inactive]() { InactiveRemoteClientThread(inactive); });
+    clientData->thread = Threading::CreateThread(
+        [clientData, previewWindow]() { RemoteClientThread(clientData, previewWindow); });
 
-      inactives.push_back(inactive);
-
-      RDCLOG("Refusing inactive connection");
-    }
-  }
-
-  if(activeClientData && activeClientData->socket != NULL)
-  {
-    activeClientData->killThread = true;
-
-    Threading::JoinThread(activeClientData->thread);
-    Threading::CloseThread(activeClientData->thread);
-
-    delete activeClientData;
+    clients.push_back(clientData);
   }
 
   // shut down client threads
-  for(size_t i = 0; i < inactives.size(); i++)
+  for(ClientThread *c : clients)
+    c->killThread = true;
+
+  for(ClientThread *c : clients)
   {
-    Threading::JoinThread(inactives[i]->thread);
-    Threading::CloseThread(inactives[i]->thread);
-    delete inactives[i];
+    Threading::JoinThread(c->thread);
+    Threading::CloseThread(c->thread);
+    delete c;
   }
 
   SAFE_DELETE(sock);
 }
 
-extern "C" RENDERDOC_API ReplayStatus RENDERDOC_CC
-RENDERDOC_CreateRemoteServerConnection(const char *URL, IRemoteServer **rend)
+static ReplayStatus ConnectToRemoteServer(const rdcstr &host, uint16_t port, Network::Socket *&sock)
 {
-  if(rend == NULL)
-    return ReplayStatus::InternalError;
-
-  rdcstr host = "localhost";
-  if(URL != NULL && URL[0] != '\0')
-    host = URL;
-
-  rdcstr deviceID = host;
-
-  IDeviceProtocolHandler *protocol = RenderDoc::Inst().GetDeviceProtocol(deviceID);
-
-  uint16_t port = RenderDoc_RemoteServerPort;
-
-  if(protocol)
-  {
-    deviceID = protocol->GetDeviceID(deviceID);
-    host = protocol->RemapHostname(deviceID);
-    if(host.empty())
-      return ReplayStatus::NetworkIOFailed;
-
-    port = protocol->RemapPort(deviceID, port);
-  }
-
-  Network::Socket *sock = Network::CreateClientSocket(host.c_str(), port, 750);
+  sock = Network::CreateClientSocket(host.c_str(), port, 750);
 
   if(sock == NULL)
     return ReplayStatus::NetworkIOFailed;
@@ -1168,13 +1326,42 @@ RENDERDOC_CreateRemoteServerConnection(const char *URL, IRemoteServer **rend)
   }
 
   if(!sock->Connected())
+  {
+    SAFE_DELETE(sock);
     return ReplayStatus::NetworkIOFailed;
+  }
 
   {
     ReadSerialiser ser(new StreamReader(sock, Ownership::Nothing), Ownership::Stream);
 
+    ser.SetStreamingMode(true);
+
+    PerformanceTimer queueTimer;
+    uint32_t lastPosition = 0;
+
     RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
 
+    // the server sends updates while we wait for a session to be free
+    while(type == eRemoteServer_Queued && !ser.IsErrored())
+    {
+      uint32_t position = 0;
+      SERIALISE_ELEMENT(position);
+
+      ser.EndChunk();
+
+      if(queueTimer.GetMilliseconds() >= RemoteServer_QueueWaitMS)
+      {
+        SAFE_DELETE(sock);
+        return ReplayStatus::NetworkRemoteBusy;
+      }
+
+      if(position != lastPosition)
+        RDCLOG("Waiting for a remote server session, position %u in the queue", position);
+      lastPosition = position;
+
+      type = ser.ReadChunk<RemoteServerPacket>();
+    }
+
     ser.EndChunk();
 
     if(type == eRemoteServer_Busy)
@@ -1197,10 +1384,53 @@ RENDERDOC_CreateRemoteServerConnection(const char *URL, IRemoteServer **rend)
     }
   }
 
+  return ReplayStatus::Succeeded;
+}
+
+extern "C" RENDERDOC_API ReplayStatus RENDERDOC_CC
+RENDERDOC_CreateRemoteServerConnection(const char *URL, IRemoteServer **rend)
+{
+  if(rend == NULL)
+    return ReplayStatus::InternalError;
+
+  rdcstr host = "localhost";
+  if(URL != NULL && URL[0] != '\0')
+    host = URL;
+
+  rdcstr deviceID = host;
+
+  IDeviceProtocolHandler *protocol = RenderDoc::Inst().GetDeviceProtocol(deviceID);
+
+  uint16_t port = RenderDoc_RemoteServerPort;
+
+  if(protocol)
+  {
+    deviceID = protocol->GetDeviceID(deviceID);
+    host = protocol->RemapHostname(deviceID);
+    if(host.empty())
+      return ReplayStatus::NetworkIOFailed;
+
+    port = protocol->RemapPort(deviceID, port);
+  }
+
+  Network::Socket *sock = NULL;
+  ReplayStatus status = ConnectToRemoteServer(host, port, sock);
+
+  if(status != ReplayStatus::Succeeded)
+    return status;
+
   if(protocol)
+  {
     *rend = protocol->CreateRemoteServer(sock, deviceID);
+  }
   else
-    *rend = new RemoteServer(sock, deviceID);
+  {
+    // extra sockets for copies can only connect directly, device protocols may only forward the
+    // one connection
+    RemoteServer *server = new RemoteServer(sock, deviceID);
+    server->SetCopyStreamAddress(host, port);
+    *rend = server;
+  }
 
   return ReplayStatus::Succeeded;
 }
@@ -1460,61 +1690,111 @@ ExecuteResult RemoteServer::ExecuteAndInject(const char *a, const char *w, const
   return ret;
 }
 
+rdcarray<Network::Socket *> RemoteServer::OpenCopyStreams(uint64_t &token)
+{
+  token = 0;
+
+  uint32_t count = (uint32_t)RDCMIN(RemoteServer_CopyStreams, (uint64_t)MaxCopyStreams);
+
+  if(m_CopyHost.empty() || count == 0)
+    return {};
+
+  return RemoteCopy::OpenStreams(m_CopyHost, m_CopyPort, count, RemoteServer_TimeoutMS, token);
+}
+
+// reads the server's reply to a copy request, and closes any extra streams it didn't get
+static bool ReadAcceptedStreams(ReadSerialiser &ser, RemoteServerPacket expected,
+                                rdcarray<Network::Socket *> &streams)
+{
+  rdcarray<uint32_t> accepted;
+
+  RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
+
+  if(type == expected)
+  {
+    SERIALISE_ELEMENT(accepted);
+  }
+  else
+  {
+    RDCERR("Unexpected response to capture copy request");
+  }
+
+  ser.EndChunk();
+
+  rdcarray<Network::Socket *> keep;
+  for(uint32_t i = 0; i < streams.size(); i++)
+  {
+    if(accepted.contains(i))
+      keep.push_back(streams[i]);
+    else
+      delete streams[i];
+  }
+  streams.swap(keep);
+
+  return type == expected && !ser.IsErrored();
+}
+
 void RemoteServer::CopyCaptureFromRemote(const char *remotepath, const char *localpath,
                                          RENDERDOC_ProgressCallback progress)
 {
   rdcstr path = remotepath;
+  uint64_t token = 0;
+  rdcarray<Network::Socket *> streams = OpenCopyStreams(token);
+  uint32_t streamCount = (uint32_t)streams.size();
+  bool compress = RemoteServer_CopyCompression;
 
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureFromRemote);
     SERIALISE_ELEMENT(path);
+    SERIALISE_ELEMENT(token);
+    SERIALISE_ELEMENT(streamCount);
+    SERIALISE_ELEMENT(compress);
   }
 
+  if(ReadAcceptedStreams(*reader, eRemoteServer_CopyCaptureFromRemote, streams))
   {
-    READ_DATA_SCOPE();
-    RemoteServerPacket type = ser.ReadChunk<RemoteServerPacket>();
-
-    if(type == eRemoteServer_CopyCaptureFromRemote)
-    {
-      StreamWriter streamWriter(FileIO::fopen(localpath, "wb"), Ownership::Stream);
-
-      ser.SerialiseStream(localpath, streamWriter, progress);
-
-      if(ser.IsErrored())
-      {
-        RDCERR("Network error receiving file");
-        return;
-      }
-    }
-    else
-    {
-      RDCERR("Unexpected response to capture copy request");
-    }
-
-    ser.EndChunk();
+    rdcstr dest = localpath;
+    rdcstr received;
+    RemoteCopy::ReceiveFile(*reader, *writer, streams, [dest](uint64_t) { return dest; },
+                            progress, received);
   }
+
+  for(Network::Socket *s : streams)
+    delete s;
 }
 
 rdcstr RemoteServer::CopyCaptureToRemote(const char *filename, RENDERDOC_ProgressCallback progress)
 {
-  FILE *fileHandle = FileIO::fopen(filename, "rb");
-
-  if(!fileHandle)
+  if(!FileIO::exists(filename))
   {
     RDCERR("Can't open file '%s'", filename);
     return "";
   }
 
+  uint64_t token = 0;
+  rdcarray<Network::Socket *> streams = OpenCopyStreams(token);
+  uint32_t streamCount = (uint32_t)streams.size();
+
   {
     WRITE_DATA_SCOPE();
     SCOPED_SERIALISE_CHUNK(eRemoteServer_CopyCaptureToRemote);
-
-    // this will take ownership of and close the file
-    StreamReader fileStream(fileHandle);
-    ser.SerialiseStream(filename, fileStream, progress);
+    SERIALISE_ELEMENT(token);
+    SERIALISE_ELEMENT(streamCount);
   }
 
+  bool accepted = ReadAcceptedStreams(*reader, eRemoteServer_CopyCaptureToRemote, streams);
+
+  if(accepted)
+    RemoteCopy::SendFile(*reader, *writer, streams, filename, RemoteCopy::MakeFileKey(filename),
+                         RemoteCopy::DefaultChunkSize, RemoteServer_CopyCompression, progress);
+
+  for(Network::Socket *s : streams)
+    delete s;
+
+  if(!accepted)
+    return "";
+
   rdcstr path;
 
   {
@@ -2029,3 +2309,208 @@ rdcarray<rdcstr> RemoteServer::GetResolve(const rdcarray<uint64_t> &callstack)
 
   return StackFrames;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+// runs a remote server on a free localhost port for the duration of a test
+struct LocalRemoteServer
+{
+  LocalRemoteServer()
+  {
+    for(port = 39120; port < 39220; port++)
+    {
+      Network::Socket *probe = Network::CreateServerSocket("127.0.0.1", port, 1);
+      if(probe)
+      {
+        delete probe;
+        break;
+      }
+    }
+
+    thread = Threading::CreateThread([this]() {
+      RenderDoc::Inst().BecomeRemoteServer("127.0.0.1", port, [this]() { return kill != 0; },
+                                           RENDERDOC_PreviewWindowCallback());
+    });
+
+    // wait for the server to start listening
+    for(int i = 0; i < 200; i++)
+    {
+      Network::Socket *sock = Network::CreateClientSocket("127.0.0.1", port, 100);
+      if(sock)
+      {
+        delete sock;
+        break;
+      }
+      Threading::Sleep(10);
+    }
+  }
+
+  ~LocalRemoteServer()
+  {
+    Atomic::Inc32(&kill);
+    Threading::JoinThread(thread);
+    Threading::CloseThread(thread);
+  }
+
+  ReplayStatus Connect(RemoteServer *&server)
+  {
+    server = NULL;
+    Network::Socket *sock = NULL;
+    ReplayStatus status = ConnectToRemoteServer("127.0.0.1", port, sock);
+    if(status == ReplayStatus::Succeeded)
+      server = new RemoteServer(sock, "127.0.0.1");
+    return status;
+  }
+
+  uint16_t port = 0;
+  int32_t kill = 0;
+  Threading::ThreadHandle thread;
+};
+
+struct ScopedConfig
+{
+  ScopedConfig(const char *name, uint64_t value) : name(name)
+  {
+    SDObject *o = RenderDoc::Inst().SetConfigSetting(name);
+    prev = o->data.basic.u;
+    o->data.basic.u = value;
+  }
+  ~ScopedConfig() { RenderDoc::Inst().SetConfigSetting(name)->data.basic.u = prev; }
+  rdcstr name;
+  uint64_t prev;
+};
+
+TEST_CASE("Test remote server sessions", "[remoteserver]")
+{
+  ScopedConfig queueWait("RemoteServer_QueueWaitMS", 0);
+
+  LocalRemoteServer local;
+
+  SECTION("Concurrent sessions")
+  {
+    ScopedConfig sessions("RemoteServer_MaxSessions", 2);
+
+    RemoteServer *a = NULL, *b = NULL, *c = NULL;
+    CHECK(local.Connect(a) == ReplayStatus::Succeeded);
+    CHECK(local.Connect(b) == ReplayStatus::Succeeded);
+
+    // the third client doesn't want to wait, so the server is busy for it
+    CHECK(local.Connect(c) == ReplayStatus::NetworkRemoteBusy);
+
+    REQUIRE(a);
+    REQUIRE(b);
+
+    CHECK(a->Ping());
+    CHECK(b->Ping());
+    CHECK(a->GetHomeFolder() == b->GetHomeFolder());
+
+    a->ShutdownConnection();
+
+    CHECK(b->Ping());
+
+    b->ShutdownConnection();
+  }
+
+  SECTION("Queued clients get sessions in order")
+  {
+    ScopedConfig sessions("RemoteServer_MaxSessions", 1);
+    ScopedConfig wait("RemoteServer_QueueWaitMS", 10000);
+
+    RemoteServer *a = NULL;
+    REQUIRE(local.Connect(a) == ReplayStatus::Succeeded);
+
+    RemoteServer *queued[2] = {};
+    ReplayStatus status[2] = {ReplayStatus::UnknownError, ReplayStatus::UnknownError};
+    int32_t done[2] = {};
+    Threading::ThreadHandle threads[2];
+
+    for(int i = 0; i < 2; i++)
+    {
+      threads[i] = Threading::CreateThread([&, i]() {
+        status[i] = local.Connect(queued[i]);
+        Atomic::Inc32(&done[i]);
+      });
+
+      // make sure they queue up in a known order
+      Threading::Sleep(300);
+    }
+
+    CHECK(done[0] == 0);
+    CHECK(done[1] == 0);
+
+    a->ShutdownConnection();
+
+    Threading::JoinThread(threads[0]);
+    Threading::CloseThread(threads[0]);
+
+    CHECK(status[0] == ReplayStatus::Succeeded);
+    CHECK(done[1] == 0);
+
+    REQUIRE(queued[0]);
+    CHECK(queued[0]->Ping());
+    queued[0]->ShutdownConnection();
+
+    Threading::JoinThread(threads[1]);
+    Threading::CloseThread(threads[1]);
+
+    CHECK(status[1] == ReplayStatus::Succeeded);
+
+    REQUIRE(queued[1]);
+    CHECK(queued[1]->Ping());
+    queued[1]->ShutdownConnection();
+  }
+
+  SECTION("Full queue is busy")
+  {
+    ScopedConfig sessions("RemoteServer_MaxSessions", 1);
+    ScopedConfig maxQueued("RemoteServer_MaxQueued", 0);
+    ScopedConfig wait("RemoteServer_QueueWaitMS", 10000);
+
+    RemoteServer *a = NULL, *b = NULL;
+    REQUIRE(local.Connect(a) == ReplayStatus::Succeeded);
+    CHECK(local.Connect(b) == ReplayStatus::NetworkRemoteBusy);
+
+    a->ShutdownConnection();
+  }
+
+  SECTION("Capture size limit")
+  {
+    ScopedConfig limit("RemoteServer_MaxCaptureSizeMB", 1);
+
+    rdcstr path = FileIO::GetTempFolderFilename() + "/renderdoc_remote_server_test.rdc";
+
+    {
+      RDCFile rdc;
+      rdc.SetData(RDCDriver::Vulkan, "Vulkan", 0, NULL);
+      rdc.Create(path.c_str());
+
+      SectionProperties props;
+      props.type = SectionType::FrameCapture;
+
+      bytebuf data;
+      data.resize(2 * 1024 * 1024);
+
+      StreamWriter *writer = rdc.WriteSection(props);
+      writer->Write(data.data(), data.size());
+      delete writer;
+    }
+
+    RemoteServer *a = NULL;
+    REQUIRE(local.Connect(a) == ReplayStatus::Succeeded);
+
+    rdcpair<ReplayStatus, IReplayController *> opened =
+        a->OpenCapture(~0U, path.c_str(), ReplayOptions(), RENDERDOC_ProgressCallback());
+
+    CHECK(opened.first == ReplayStatus::NetworkRemoteCaptureTooLarge);
+    CHECK(opened.second == NULL);
+
+    CHECK(a->Ping());
+    a->ShutdownConnection();
+
+    FileIO::Delete(path.c_str());
+  }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -99,12 +99,24 @@ public:
 
   virtual rdcarray<rdcstr> GetResolve(const rdcarray<uint64_t> &callstack);
 
+  // the address the server can be reached on directly, for opening extra sockets for copies
+  void SetCopyStreamAddress(const rdcstr &host, uint16_t port)
+  {
+    m_CopyHost = host;
+    m_CopyPort = port;
+  }
+
 protected:
+  rdcarray<Network::Socket *> OpenCopyStreams(uint64_t &token);
+
   Network::Socket *m_Socket;
   WriteSerialiser *writer;
   ReadSerialiser *reader;
   FileIO::LogFileHandle *debugLog;
   rdcstr m_deviceID;
 
+  rdcstr m_CopyHost;
+  uint16_t m_CopyPort = 0;
+
   rdcarray<rdcpair<RDCDriver, rdcstr>> m_Proxies;
 };
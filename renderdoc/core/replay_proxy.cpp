@@ -25,9 +25,24 @@
 
 #include "replay_proxy.h"
 #include <list>
+#include "core/settings.h"
+#include "core/shader_debug_trace.h"
 #include "lz4/lz4.h"
 #include "serialise/lz4io.h"
 
+RDOC_CONFIG(bool, Replay_TransferCache, true,
+            "When replaying on a remote server, keep texture and buffer contents received from the "
+            "server in a cache on disk, split into content-defined chunks, so that identical data "
+            "is only transferred once even across different resources and connections.");
+
+RDOC_CONFIG(uint32_t, Replay_TransferCacheSizeMB, 512,
+            "The size in MB that the remote replay transfer cache is trimmed to when a connection "
+            "is opened.");
+
+RDOC_CONFIG(rdcstr, Replay_TransferCacheDirPath, "",
+            "The directory to store the remote replay transfer cache in. If empty, a folder in the "
+            "RenderDoc application data folder is used.");
+
 template <>
 rdcstr DoStringise(const ReplayProxyPacket &el)
 {
@@ -95,6 +110,9 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
     STRINGISE_ENUM_NAMED(eReplayProxy_GetDriverInfo, "GetDriverInfo");
 
     STRINGISE_ENUM_NAMED(eReplayProxy_ContinueDebug, "ContinueDebug");
+
+    STRINGISE_ENUM_NAMED(eReplayProxy_SyncTransferCache, "SyncTransferCache");
+    STRINGISE_ENUM_NAMED(eReplayProxy_EvictTransferChunks, "EvictTransferChunks");
   }
   END_ENUM_STRINGISE();
 }
@@ -111,9 +129,9 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
 // begins the set of parameters. Note that we only begin a chunk when writing (sending a request to
 // the remote server), since on reading the chunk has already been begun to read the type to
 // dispatch to the correct function.
-#define BEGIN_PARAMS()             \
-  ParamSerialiser &ser = paramser; \
-  if(ser.IsWriting())              \
+#define BEGIN_PARAMS()                                \
+  ParamSerialiser &ser = GetParamSerialiser(paramser); \
+  if(ser.IsWriting())                                 \
     ser.BeginChunk(packet, 0);
 
 // end the set of parameters, and that chunk.
@@ -124,6 +142,16 @@ rdcstr DoStringise(const ReplayProxyPacket &el)
     CheckError(packet, expectedPacket);             \
   }
 
+// on the host, when sending the requests in a pipelined batch, return once the parameters have been
+// sent. The function is called again to read the response after the whole batch has been sent.
+#define PIPELINE_SEND_RETURN(...)              \
+  if(m_PipelinePhase == PipelinePhase::Send) \
+  {                                          \
+    m_PipelineOutstanding++;                 \
+    m_PipelineCallRequests++;                \
+    return __VA_ARGS__;                      \
+  }
+
 // begin serialising a return value. We begin a chunk here in either the writing or reading case
 // since this chunk is used purely to send/receive the return value and is fully handled within the
 // function.
@@ -200,6 +228,16 @@ ReplayProxy::~ReplayProxy()
 
   for(auto it = m_ShaderReflectionCache.begin(); it != m_ShaderReflectionCache.end(); ++it)
     delete it->second;
+
+  if(m_TransferCache)
+  {
+    const TransferCacheStats &stats = m_TransferCache->GetStats();
+
+    RDCLOG("Transfer cache received %llu bytes in %llu chunks, reused %llu bytes in %llu chunks",
+           stats.bytesReceived, stats.chunksReceived, stats.bytesReused, stats.chunksReused);
+
+    delete m_TransferCache;
+  }
 }
 
 #pragma region Proxied Functions
@@ -277,6 +315,8 @@ APIProperties ReplayProxy::Proxied_GetAPIProperties(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -311,6 +351,8 @@ DriverInformation ReplayProxy::Proxied_GetDriverInfo(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -369,6 +411,8 @@ rdcarray<DebugMessage> ReplayProxy::Proxied_GetDebugMessages(ParamSerialiser &pa
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -398,6 +442,8 @@ rdcarray<TextureDescription> ReplayProxy::Proxied_GetTextures(ParamSerialiser &p
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -434,6 +480,8 @@ TextureDescription ReplayProxy::Proxied_GetTexture(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -466,6 +514,8 @@ rdcarray<BufferDescription> ReplayProxy::Proxied_GetBuffers(ParamSerialiser &par
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -495,6 +545,8 @@ rdcarray<ResourceDescription> ReplayProxy::Proxied_GetResources(ParamSerialiser
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -525,6 +577,8 @@ BufferDescription ReplayProxy::Proxied_GetBuffer(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -555,6 +609,8 @@ rdcarray<uint32_t> ReplayProxy::Proxied_GetPassEvents(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -585,6 +641,8 @@ rdcarray<EventUsage> ReplayProxy::Proxied_GetUsage(ParamSerialiser &paramser,
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -613,6 +671,8 @@ FrameRecord ReplayProxy::Proxied_GetFrameRecord(ParamSerialiser &paramser, Retur
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN(ret);
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -822,6 +882,8 @@ void ReplayProxy::Proxied_GetBufferData(ParamSerialiser &paramser, ReturnSeriali
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN();
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -900,6 +962,8 @@ void ReplayProxy::Proxied_GetTextureData(ParamSerialiser &paramser, ReturnSerial
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN();
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1591,7 +1655,26 @@ rdcarray<ShaderDebugState> ReplayProxy::Proxied_ContinueDebug(ParamSerialiser &p
       ret = m_Remote->ContinueDebug(debugger);
   }
 
-  SERIALISE_RETURN(ret);
+  // each state carries whole copies of every variable it changes, almost all of which is
+  // repeated between steps, so send the states packed and unpack them on this side.
+  bytebuf packedStates;
+  if(retser.IsWriting())
+  {
+    PackedShaderDebugTrace trace;
+    trace.Append(ret);
+    trace.Write(packedStates);
+  }
+
+  SERIALISE_RETURN(packedStates);
+
+  if(retser.IsReading())
+  {
+    PackedShaderDebugTrace trace;
+    if(trace.Read(packedStates))
+      ret = trace.GetStates(0, trace.GetNumStates());
+    else
+      ret.clear();
+  }
 
   return ret;
 }
@@ -1614,6 +1697,8 @@ void ReplayProxy::Proxied_SavePipelineState(ParamSerialiser &paramser, ReturnSer
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN();
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1747,6 +1832,8 @@ void ReplayProxy::Proxied_ReplayLog(ParamSerialiser &paramser, ReturnSerialiser
     END_PARAMS();
   }
 
+  PIPELINE_SEND_RETURN();
+
   {
     REMOTE_EXECUTION();
     if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
@@ -1856,9 +1943,175 @@ void DoSerialise(SerialiserType &ser, DeltaSection &el)
   SERIALISE_MEMBER(contents);
 }
 
+struct ChunkSection
+{
+  uint64_t hash = 0;
+  uint64_t length = 0;
+  // empty if the client's transfer cache already has this chunk
+  bytebuf contents;
+};
+
+DECLARE_REFLECTION_STRUCT(ChunkSection);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, ChunkSection &el)
+{
+  SERIALISE_MEMBER(hash);
+  SERIALISE_MEMBER(length);
+  SERIALISE_MEMBER(contents);
+}
+
+template <typename SerialiserType>
+bool ReplayProxy::ChunkedTransferBytes(SerialiserType &xferser, bytebuf &data)
+{
+  rdcarray<ChunkSection> chunks;
+
+  // lz4 compress
+  if(xferser.IsReading())
+  {
+    uint64_t uncompSize = 0;
+    xferser.Serialise("uncompSize"_lit, uncompSize);
+
+    {
+      ReadSerialiser ser(new StreamReader(new LZ4Decompressor(xferser.GetReader(), Ownership::Nothing),
+                                          uncompSize, Ownership::Stream),
+                         Ownership::Stream);
+
+      SERIALISE_ELEMENT(chunks);
+
+      // add any necessary padding.
+      uint64_t offs = ser.GetReader()->GetOffset();
+      RDCASSERT(offs <= uncompSize, offs, uncompSize);
+
+      if(offs < uncompSize)
+      {
+        if(uncompSize - offs > 128)
+          RDCERR("Unexpected amount of padding: %llu", uncompSize - offs);
+        ser.GetReader()->Read(NULL, uncompSize - offs);
+      }
+    }
+
+    uint64_t totalSize = 0;
+    for(const ChunkSection &chunk : chunks)
+      totalSize += chunk.length;
+
+    data.resize((size_t)totalSize);
+
+    byte *dst = data.data();
+
+    // new chunks are added to the cache as they arrive, so a chunk repeated within the same data is
+    // only sent the first time
+    for(const ChunkSection &chunk : chunks)
+    {
+      if(!chunk.contents.empty())
+      {
+        memcpy(dst, chunk.contents.data(), chunk.contents.size());
+
+        if(m_TransferCache)
+          m_TransferCache->AddChunk(chunk.hash, chunk.contents.data(), chunk.contents.size());
+      }
+      else if(!m_TransferCache || !m_TransferCache->ReadChunk(chunk.hash, dst, (size_t)chunk.length))
+      {
+        RDCWARN("Transfer cache is missing chunk %016llx, it will be requested again",
+                chunk.hash);
+        m_MissingTransferChunks.push_back(chunk.hash);
+      }
+
+      dst += chunk.length;
+    }
+
+    // don't hand out contents with holes in them
+    if(!m_MissingTransferChunks.empty())
+    {
+      data.clear();
+      return false;
+    }
+  }
+  else
+  {
+    rdcarray<TransferChunk> split;
+    SplitTransferChunks(data.data(), data.size(), split);
+
+    chunks.resize(split.size());
+
+    uint64_t sentBytes = 0;
+
+    for(size_t i = 0; i < split.size(); i++)
+    {
+      chunks[i].hash = split[i].hash;
+      chunks[i].length = split[i].length;
+
+      if(m_ClientChunks.insert(split[i].hash).second)
+      {
+        chunks[i].contents.assign(data.data() + split[i].offset, split[i].length);
+        sentBytes += split[i].length;
+      }
+    }
+
+    RDCDEBUG("Sending %llu of %llu bytes in %zu chunks", sentBytes, (uint64_t)data.size(),
+             chunks.size());
+
+    uint64_t uncompSize = 0;
+
+    {
+      // serialise to an invalid writer, to get the size of the data that will be written.
+      WriteSerialiser ser(new StreamWriter(StreamWriter::InvalidStream), Ownership::Stream);
+
+      SERIALISE_ELEMENT(chunks);
+
+      uncompSize = ser.GetWriter()->GetOffset() + ser.GetChunkAlignment();
+    }
+
+    xferser.Serialise("uncompSize"_lit, uncompSize);
+
+    WriteSerialiser ser(new StreamWriter(new LZ4Compressor(xferser.GetWriter(), Ownership::Nothing),
+                                         Ownership::Stream),
+                        Ownership::Stream);
+
+    SERIALISE_ELEMENT(chunks);
+
+    char empty[128] = {};
+
+    // add any necessary padding.
+    uint64_t offs = ser.GetWriter()->GetOffset();
+    RDCASSERT(offs <= uncompSize, offs, uncompSize);
+    RDCASSERT(uncompSize - offs < sizeof(empty), offs, uncompSize);
+
+    if(offs < uncompSize)
+      ser.GetWriter()->Write(empty, uncompSize - offs);
+  }
+
+  return true;
+}
+
 template <typename SerialiserType>
 void ReplayProxy::DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData)
 {
+  // when there's no reference data to diff against, the whole contents are sent. If the client has
+  // a transfer cache, do that in chunks so that any data it's seen before isn't sent again.
+  bool chunked = false;
+
+  if(xferser.IsWriting())
+    chunked = m_ClientTransferCache &&
+              (referenceData.empty() || referenceData.size() != newData.size());
+
+  xferser.Serialise("chunked"_lit, chunked);
+
+  if(chunked)
+  {
+    if(xferser.IsReading())
+    {
+      ChunkedTransferBytes(xferser, referenceData);
+    }
+    else
+    {
+      ChunkedTransferBytes(xferser, newData);
+      referenceData.swap(newData);
+    }
+
+    return;
+  }
+
   // lz4 compress
   if(xferser.IsReading())
   {
@@ -2190,6 +2443,104 @@ void ReplayProxy::CacheTextureData(ResourceId tex, const Subresource &sub,
   PROXY_FUNCTION(CacheTextureData, tex, sub, params);
 }
 
+template <typename ParamSerialiser, typename ReturnSerialiser>
+void ReplayProxy::Proxied_SyncTransferCache(ParamSerialiser &paramser, ReturnSerialiser &retser,
+                                            bool enabled, const rdcarray<uint64_t> &chunks)
+{
+  const ReplayProxyPacket expectedPacket = eReplayProxy_SyncTransferCache;
+  ReplayProxyPacket packet = eReplayProxy_SyncTransferCache;
+
+  {
+    BEGIN_PARAMS();
+    SERIALISE_ELEMENT(enabled);
+    SERIALISE_ELEMENT(chunks);
+    END_PARAMS();
+  }
+
+  {
+    REMOTE_EXECUTION();
+    if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
+    {
+      m_ClientTransferCache = enabled;
+      m_ClientChunks.clear();
+      m_ClientChunks.insert(chunks.begin(), chunks.end());
+    }
+  }
+
+  SERIALISE_RETURN_VOID();
+}
+
+void ReplayProxy::SyncTransferCache(bool enabled, const rdcarray<uint64_t> &chunks)
+{
+  PROXY_FUNCTION(SyncTransferCache, enabled, chunks);
+}
+
+template <typename ParamSerialiser, typename ReturnSerialiser>
+void ReplayProxy::Proxied_EvictTransferChunks(ParamSerialiser &paramser, ReturnSerialiser &retser,
+                                              const rdcarray<uint64_t> &chunks)
+{
+  const ReplayProxyPacket expectedPacket = eReplayProxy_EvictTransferChunks;
+  ReplayProxyPacket packet = eReplayProxy_EvictTransferChunks;
+
+  {
+    BEGIN_PARAMS();
+    SERIALISE_ELEMENT(chunks);
+    END_PARAMS();
+  }
+
+  {
+    REMOTE_EXECUTION();
+    if(paramser.IsReading() && !paramser.IsErrored() && !m_IsErrored)
+    {
+      for(uint64_t hash : chunks)
+        m_ClientChunks.erase(hash);
+
+      // with no reference data every resource is sent whole next time, which also replaces
+      // whatever the client has for it.
+      m_ProxyTextureData.clear();
+      m_ProxyBufferData.clear();
+    }
+  }
+
+  SERIALISE_RETURN_VOID();
+}
+
+void ReplayProxy::EvictTransferChunks(const rdcarray<uint64_t> &chunks)
+{
+  PROXY_FUNCTION(EvictTransferChunks, chunks);
+}
+
+bool ReplayProxy::EvictMissingTransferChunks()
+{
+  if(m_MissingTransferChunks.empty())
+    return false;
+
+  rdcarray<uint64_t> missing;
+  missing.swap(m_MissingTransferChunks);
+
+  if(m_Reader.IsErrored() || m_Writer.IsErrored())
+    return false;
+
+  EvictTransferChunks(missing);
+
+  return true;
+}
+
+void ReplayProxy::InitTransferCache()
+{
+  if(!Replay_TransferCache)
+    return;
+
+  rdcstr dir = Replay_TransferCacheDirPath;
+  if(dir.empty())
+    dir = FileIO::GetAppFolderFilename("transfer_cache");
+
+  m_TransferCache =
+      new TransferChunkStore(dir, uint64_t(Replay_TransferCacheSizeMB) * 1024 * 1024);
+
+  SyncTransferCache(true, m_TransferCache->GetChunkHashes());
+}
+
 #pragma endregion Proxied Functions
 
 // If a remap is required, modify the params that are used when getting the proxy texture data
@@ -2353,6 +2704,10 @@ void ReplayProxy::EnsureTexCached(ResourceId &texid, CompType typeCast, const Su
 
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
       CacheTextureData(texid, s, params);
+
+      // each retry sends the evicted chunks in full, so this ends once every chunk has been read
+      while(EvictMissingTransferChunks())
+        CacheTextureData(texid, s, params);
 #else
       GetTextureData(texid, s, params, m_ProxyTextureData[entry]);
 #endif
@@ -2386,6 +2741,10 @@ void ReplayProxy::EnsureBufCached(ResourceId bufid)
 
 #if ENABLED(TRANSFER_RESOURCE_CONTENTS_DELTAS)
     CacheBufferData(bufid);
+
+    // each retry sends the evicted chunks in full, so this ends once every chunk has been read
+    while(EvictMissingTransferChunks())
+      CacheBufferData(bufid);
 #else
     GetBufferData(bufid, 0, 0, m_ProxyBufferData[bufid]);
 #endif
@@ -2592,6 +2951,27 @@ void ReplayProxy::EndRemoteExecution()
   }
   else
   {
+    if(m_PipelinePhase == PipelinePhase::Send)
+    {
+      RDCERR("Proxied call that can't be pipelined was made while sending a batch");
+      m_IsErrored = true;
+      return;
+    }
+    else if(m_PipelinePhase == PipelinePhase::Receive)
+    {
+      // this call's response is the next one in the stream. Any calls made while handling it are
+      // normal round-trips.
+      m_PipelinePhase = PipelinePhase::None;
+      m_PipelineOutstanding--;
+      m_PipelineScratch.GetWriter()->Rewind();
+    }
+    else if(m_PipelineOutstanding > 0)
+    {
+      RDCERR("Proxied call made with %u pipelined responses still pending", m_PipelineOutstanding);
+      m_IsErrored = true;
+      return;
+    }
+
     while(!m_Writer.IsErrored() && !m_Reader.IsErrored() && !m_IsErrored)
     {
       ReplayProxyPacket packet = m_Reader.ReadChunk<ReplayProxyPacket>();
@@ -2674,6 +3054,61 @@ void ReplayProxy::RemoteExecutionThreadEntry()
   }
 }
 
+void ReplayProxy::ExecuteBatch(const rdcarray<std::function<void()>> &calls)
+{
+  // the remote server handles one packet at a time, and batches don't nest
+  if(m_RemoteServer || m_PipelinePhase != PipelinePhase::None || m_PipelineOutstanding > 0)
+  {
+    IReplayDriver::ExecuteBatch(calls);
+    return;
+  }
+
+  // the remote server can't read new requests while it's blocked sending a large response, so
+  // limit how many requests are in flight to keep them well within the socket buffers.
+  const size_t maxInFlight = 32;
+
+  for(size_t base = 0; base < calls.size() && !m_IsErrored; base += maxInFlight)
+  {
+    const size_t count = RDCMIN(maxInFlight, calls.size() - base);
+
+    // send every request up front. Each call must make exactly one pipelined request, since they
+    // are matched to responses purely by order. The requests are small so cork the socket while
+    // sending them, to send full packets instead of one per request.
+    m_Writer.GetWriter()->SetCork(true);
+
+    for(size_t i = 0; i < count && !m_IsErrored; i++)
+    {
+      m_PipelinePhase = PipelinePhase::Send;
+      m_PipelineCallRequests = 0;
+
+      calls[base + i]();
+
+      if(m_PipelineCallRequests > 1)
+      {
+        RDCERR("Batched call made %u proxied requests, only one is allowed", m_PipelineCallRequests);
+        m_IsErrored = true;
+      }
+    }
+
+    m_Writer.GetWriter()->SetCork(false);
+
+    // then repeat the calls to read back each response in order. A call which makes further
+    // proxied calls while handling its response (such as SavePipelineState fetching shader
+    // reflection) must be the last one in the batch.
+    for(size_t i = 0; i < count && !m_IsErrored; i++)
+    {
+      m_PipelinePhase = PipelinePhase::Receive;
+
+      calls[base + i]();
+    }
+
+    m_PipelinePhase = PipelinePhase::None;
+  }
+
+  m_PipelinePhase = PipelinePhase::None;
+  m_PipelineOutstanding = 0;
+}
+
 bool ReplayProxy::CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket)
 {
   if(m_Writer.IsErrored() || m_Reader.IsErrored() || m_IsErrored)
@@ -2787,6 +3222,8 @@ bool ReplayProxy::Tick(int type)
       break;
     }
     case eReplayProxy_ContinueDebug: ContinueDebug(NULL); break;
+    case eReplayProxy_SyncTransferCache: SyncTransferCache(false, rdcarray<uint64_t>()); break;
+    case eReplayProxy_EvictTransferChunks: EvictTransferChunks(rdcarray<uint64_t>()); break;
     case eReplayProxy_RenderOverlay:
       RenderOverlay(ResourceId(), Subresource(), CompType::Typeless, FloatVector(),
                     DebugOverlay::NoOverlay, 0, rdcarray<uint32_t>());
@@ -25,9 +25,11 @@
 
 #pragma once
 
+#include <unordered_set>
 #include "os/os_specific.h"
 #include "replay/replay_driver.h"
 #include "serialise/serialiser.h"
+#include "transfer_cache.h"
 
 // turns on/off the feature to transfer resource contents (cached textures and buffers) as a series
 // of deltas to a shared view of the previous resource contents.
@@ -102,6 +104,9 @@ enum ReplayProxyPacket
   eReplayProxy_GetAvailableGPUs,
 
   eReplayProxy_ContinueDebug,
+
+  eReplayProxy_SyncTransferCache,
+  eReplayProxy_EvictTransferChunks,
 };
 
 DECLARE_REFLECTION_ENUM(ReplayProxyPacket);
@@ -131,6 +136,7 @@ public:
   {
     GetAPIProperties();
     FetchStructuredFile();
+    InitTransferCache();
   }
 
   ReplayProxy(ReadSerialiser &reader, WriteSerialiser &writer, IRemoteDriver *remoteDriver,
@@ -165,6 +171,12 @@ public:
 
   bool IsRemoteProxy() { return !m_RemoteServer; }
   void Shutdown() { delete this; }
+  void ExecuteBatch(const rdcarray<std::function<void()>> &calls);
+
+  TransferCacheStats GetTransferCacheStats() const
+  {
+    return m_TransferCache ? m_TransferCache->GetStats() : TransferCacheStats();
+  }
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
   {
     return ReplayStatus::Succeeded;
@@ -550,6 +562,24 @@ public:
   template <typename SerialiserType>
   void DeltaTransferBytes(SerialiserType &xferser, bytebuf &referenceData, bytebuf &newData);
 
+  // tells the remote server whether we have a transfer cache, and which chunks are already in it
+  IMPLEMENT_FUNCTION_PROXIED(void, SyncTransferCache, bool enabled, const rdcarray<uint64_t> &chunks);
+  void InitTransferCache();
+
+  // tells the remote server that the client no longer has these chunks, so they're sent in full
+  // again. All of the server's reference data is dropped too, since the client may have lost its
+  // copy of whatever was being transferred.
+  IMPLEMENT_FUNCTION_PROXIED(void, EvictTransferChunks, const rdcarray<uint64_t> &chunks);
+  // if the last transfer was missing chunks, evicts them on the server and returns true so the
+  // transfer can be requested again.
+  bool EvictMissingTransferChunks();
+
+  // serialise the whole contents of a byte array as content-defined chunks, only sending the
+  // contents of chunks that the client's transfer cache doesn't already have. When reading, returns
+  // false and leaves data empty if any chunk couldn't be read from the transfer cache.
+  template <typename SerialiserType>
+  bool ChunkedTransferBytes(SerialiserType &xferser, bytebuf &data);
+
   void FileChanged() {}
   // will never be used
   ResourceId CreateProxyTexture(const TextureDescription &templateTex)
@@ -586,6 +616,32 @@ private:
 
   bool CheckError(ReplayProxyPacket receivedPacket, ReplayProxyPacket expectedPacket);
 
+  // on the host, a batch of calls is pipelined by first running every call in the Send phase,
+  // where each one writes its parameters and returns immediately, then running them all again in
+  // the Receive phase, where the parameters are discarded and the responses are read. The remote
+  // server handles packets strictly in order, so the responses arrive in the order they were sent.
+  enum class PipelinePhase
+  {
+    None,
+    Send,
+    Receive,
+  };
+
+  PipelinePhase m_PipelinePhase = PipelinePhase::None;
+  // how many requests have been sent in the current batch without their response being read
+  uint32_t m_PipelineOutstanding = 0;
+  // how many requests the current call in the batch has sent
+  uint32_t m_PipelineCallRequests = 0;
+  // parameters written in the Receive phase go here, since they were already sent
+  WriteSerialiser m_PipelineScratch{new StreamWriter(StreamWriter::DefaultScratchSize),
+                                    Ownership::Stream};
+
+  WriteSerialiser &GetParamSerialiser(WriteSerialiser &ser)
+  {
+    return m_PipelinePhase == PipelinePhase::Receive ? m_PipelineScratch : ser;
+  }
+  ReadSerialiser &GetParamSerialiser(ReadSerialiser &ser) { return ser; }
+
   struct TextureCacheEntry
   {
     ResourceId replayid;
@@ -626,6 +682,16 @@ private:
   std::map<TextureCacheEntry, bytebuf> m_ProxyTextureData;
   std::map<ResourceId, bytebuf> m_ProxyBufferData;
 
+  // on the client side, the persistent store of chunks received with ChunkedTransferBytes. NULL if
+  // the transfer cache is disabled, and always NULL on the remote server.
+  TransferChunkStore *m_TransferCache = NULL;
+  // on the remote server, whether the client has a transfer cache and the chunks it holds, so that
+  // only new chunks are sent.
+  bool m_ClientTransferCache = false;
+  std::unordered_set<uint64_t> m_ClientChunks;
+  // on the client side, chunks the last transfer needed that the transfer cache couldn't provide
+  rdcarray<uint64_t> m_MissingTransferChunks;
+
   // this lists any textures which are only created locally (e.g. custom visualisation shaders) and
   // should not be treated as proxied.
   std::set<ResourceId> m_LocalTextures;
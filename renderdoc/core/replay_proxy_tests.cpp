@@ -0,0 +1,670 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/globalconfig.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "common/threading.h"
+#include "common/timing.h"
+#include "core/core.h"
+#include "core/resource_manager.h"
+#include "replay_proxy.h"
+
+#include "catch/catch.hpp"
+
+// a stand-in driver that answers queries with generated data, so the proxy protocol can be tested
+// without a real replay. On the remote side it records the order calls arrive in.
+class FakeReplayDriver : public IReplayDriver
+{
+public:
+  rdcarray<rdcstr> GetCalls()
+  {
+    SCOPED_LOCK(m_Lock);
+    return m_Calls;
+  }
+
+  const bytebuf &GetProxyTextureData() { return m_ProxyTextureData; }
+
+  void Shutdown() {}
+  APIProperties GetAPIProperties()
+  {
+    APIProperties ret = {};
+    ret.pipelineType = ret.localRenderer = GraphicsAPI::Vulkan;
+    return ret;
+  }
+  rdcarray<ResourceDescription> GetResources() { return {}; }
+  rdcarray<BufferDescription> GetBuffers()
+  {
+    Log("GetBuffers");
+    rdcarray<BufferDescription> ret;
+    ret.resize(20);
+    for(size_t i = 0; i < ret.size(); i++)
+      ret[i].length = i * 100;
+    return ret;
+  }
+  BufferDescription GetBuffer(ResourceId id) { return {}; }
+  rdcarray<TextureDescription> GetTextures()
+  {
+    Log("GetTextures");
+    rdcarray<TextureDescription> ret;
+    ret.resize(10);
+    for(size_t i = 0; i < ret.size(); i++)
+      ret[i].width = uint32_t(i + 1);
+    return ret;
+  }
+  TextureDescription GetTexture(ResourceId id) { return {}; }
+  rdcarray<DebugMessage> GetDebugMessages() { return {}; }
+  rdcarray<ShaderEntryPoint> GetShaderEntryPoints(ResourceId shader) { return {}; }
+  ShaderReflection *GetShader(ResourceId pipeline, ResourceId shader, ShaderEntryPoint entry)
+  {
+    return NULL;
+  }
+  rdcarray<rdcstr> GetDisassemblyTargets() { return {}; }
+  rdcstr DisassembleShader(ResourceId pipeline, const ShaderReflection *refl, const rdcstr &target)
+  {
+    return rdcstr();
+  }
+  rdcarray<EventUsage> GetUsage(ResourceId id)
+  {
+    Log("GetUsage");
+    return {EventUsage(10, ResourceUsage::VertexBuffer), EventUsage(20, ResourceUsage::CopyDst)};
+  }
+  void SavePipelineState(uint32_t eventId)
+  {
+    Log("SavePipelineState");
+    m_VKState.compute.pipelineResourceId = ResourceId();
+  }
+  const D3D11Pipe::State *GetD3D11PipelineState() { return NULL; }
+  const D3D12Pipe::State *GetD3D12PipelineState() { return NULL; }
+  const GLPipe::State *GetGLPipelineState() { return NULL; }
+  const VKPipe::State *GetVulkanPipelineState() { return &m_VKState; }
+  FrameRecord GetFrameRecord() { return FrameRecord(); }
+  ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
+  {
+    return ReplayStatus::Succeeded;
+  }
+  void ReplayLog(uint32_t endEventID, ReplayLogType replayType) { Log("ReplayLog"); }
+  const SDFile &GetStructuredFile() { return m_File; }
+  rdcarray<uint32_t> GetPassEvents(uint32_t eventId) { return {}; }
+  void InitPostVSBuffers(uint32_t eventId) {}
+  void InitPostVSBuffers(const rdcarray<uint32_t> &passEvents) {}
+  ResourceId GetLiveID(ResourceId id) { return id; }
+  MeshFormat GetPostVSBuffers(uint32_t eventId, uint32_t instID, uint32_t viewID,
+                              MeshDataStage stage)
+  {
+    return MeshFormat();
+  }
+  void GetBufferData(ResourceId buff, uint64_t offset, uint64_t len, bytebuf &retData)
+  {
+    Log("GetBufferData");
+    retData.resize((size_t)len);
+    for(size_t i = 0; i < retData.size(); i++)
+      retData[i] = byte((offset + i) & 0xff);
+  }
+  void GetTextureData(ResourceId tex, const Subresource &sub, const GetTextureDataParams &params,
+                      bytebuf &data)
+  {
+    Log("GetTextureData");
+    data.resize(64 * 1024 >> sub.mip);
+    uint32_t state = sub.mip;
+    for(size_t i = 0; i < data.size(); i++)
+    {
+      state = state * 1664525U + 1013904223U;
+      data[i] = byte(state >> 24);
+    }
+  }
+  void BuildTargetShader(ShaderEncoding sourceEncoding, const bytebuf &source, const rdcstr &entry,
+                         const ShaderCompileFlags &compileFlags, ShaderStage type, ResourceId &id,
+                         rdcstr &errors)
+  {
+  }
+  rdcarray<ShaderEncoding> GetTargetShaderEncodings() { return {}; }
+  void ReplaceResource(ResourceId from, ResourceId to) {}
+  void RemoveReplacement(ResourceId id) {}
+  void FreeTargetResource(ResourceId id) {}
+  rdcarray<GPUCounter> EnumerateCounters() { return {}; }
+  CounterDescription DescribeCounter(GPUCounter counterID) { return CounterDescription(); }
+  rdcarray<CounterResult> FetchCounters(const rdcarray<GPUCounter> &counterID) { return {}; }
+  void FillCBufferVariables(ResourceId pipeline, ResourceId shader, rdcstr entryPoint,
+                            uint32_t cbufSlot, rdcarray<ShaderVariable> &outvars,
+                            const bytebuf &data)
+  {
+  }
+  rdcarray<PixelModification> PixelHistory(rdcarray<EventUsage> events, ResourceId target,
+                                           uint32_t x, uint32_t y, const Subresource &sub,
+                                           CompType typeCast)
+  {
+    return {};
+  }
+  ShaderDebugTrace *DebugVertex(uint32_t eventId, uint32_t vertid, uint32_t instid, uint32_t idx)
+  {
+    return NULL;
+  }
+  ShaderDebugTrace *DebugPixel(uint32_t eventId, uint32_t x, uint32_t y, uint32_t sample,
+                               uint32_t primitive)
+  {
+    return NULL;
+  }
+  ShaderDebugTrace *DebugThread(uint32_t eventId, const uint32_t groupid[3],
+                                const uint32_t threadid[3])
+  {
+    return NULL;
+  }
+  rdcarray<ShaderDebugState> ContinueDebug(ShaderDebugger *debugger) { return {}; }
+  ResourceId RenderOverlay(ResourceId texid, const Subresource &sub, CompType typeCast,
+                           FloatVector clearCol, DebugOverlay overlay, uint32_t eventId,
+                           const rdcarray<uint32_t> &passEvents)
+  {
+    return ResourceId();
+  }
+  bool IsRenderOutput(ResourceId id) { return false; }
+  void FileChanged() {}
+  bool NeedRemapForFetch(const ResourceFormat &format) { return false; }
+  DriverInformation GetDriverInfo() { return DriverInformation(); }
+  rdcarray<GPUDevice> GetAvailableGPUs() { return {}; }
+
+  bool IsRemoteProxy() { return false; }
+  rdcarray<WindowingSystem> GetSupportedWindowSystems() { return {}; }
+  AMDRGPControl *GetRGPControl() { return NULL; }
+  uint64_t MakeOutputWindow(WindowingData window, bool depth) { return 0; }
+  void DestroyOutputWindow(uint64_t id) {}
+  bool CheckResizeOutputWindow(uint64_t id) { return false; }
+  void SetOutputWindowDimensions(uint64_t id, int32_t w, int32_t h) {}
+  void GetOutputWindowDimensions(uint64_t id, int32_t &w, int32_t &h) {}
+  void GetOutputWindowData(uint64_t id, bytebuf &retData) {}
+  void ClearOutputWindowColor(uint64_t id, FloatVector col) {}
+  void ClearOutputWindowDepth(uint64_t id, float depth, uint8_t stencil) {}
+  void BindOutputWindow(uint64_t id, bool depth) {}
+  bool IsOutputWindowVisible(uint64_t id) { return false; }
+  void FlipOutputWindow(uint64_t id) {}
+  bool GetMinMax(ResourceId texid, const Subresource &sub, CompType typeCast, float *minval,
+                 float *maxval)
+  {
+    return false;
+  }
+  bool GetHistogram(ResourceId texid, const Subresource &sub, CompType typeCast, float minval,
+                    float maxval, bool channels[4], rdcarray<uint32_t> &histogram)
+  {
+    return false;
+  }
+  void PickPixel(ResourceId texture, uint32_t x, uint32_t y, const Subresource &sub,
+                 CompType typeCast, float pixel[4])
+  {
+  }
+  ResourceId CreateProxyTexture(const TextureDescription &templateTex) { return ResourceId(); }
+  void SetProxyTextureData(ResourceId texid, const Subresource &sub, byte *data, size_t dataSize)
+  {
+    m_ProxyTextureData = bytebuf(data, dataSize);
+  }
+  bool IsTextureSupported(const TextureDescription &tex) { return true; }
+  ResourceId CreateProxyBuffer(const BufferDescription &templateBuf) { return ResourceId(); }
+  void SetProxyBufferData(ResourceId bufid, byte *data, size_t dataSize) {}
+  void RenderMesh(uint32_t eventId, const rdcarray<MeshFormat> &secondaryDraws,
+                  const MeshDisplay &cfg)
+  {
+  }
+  bool RenderTexture(TextureDisplay cfg) { return false; }
+  void BuildCustomShader(ShaderEncoding sourceEncoding, const bytebuf &source, const rdcstr &entry,
+                         const ShaderCompileFlags &compileFlags, ShaderStage type, ResourceId &id,
+                         rdcstr &errors)
+  {
+  }
+  rdcarray<ShaderEncoding> GetCustomShaderEncodings() { return {}; }
+  ResourceId ApplyCustomShader(ResourceId shader, ResourceId texid, const Subresource &sub,
+                               CompType typeCast)
+  {
+    return ResourceId();
+  }
+  void FreeCustomShader(ResourceId id) {}
+  void RenderCheckerboard() {}
+  void RenderHighlightBox(float w, float h, float scale) {}
+  uint32_t PickVertex(uint32_t eventId, int32_t width, int32_t height, const MeshDisplay &cfg,
+                      uint32_t x, uint32_t y)
+  {
+    return ~0U;
+  }
+
+private:
+  void Log(const char *call)
+  {
+    SCOPED_LOCK(m_Lock);
+    m_Calls.push_back(call);
+  }
+
+  Threading::CriticalSection m_Lock;
+  rdcarray<rdcstr> m_Calls;
+  SDFile m_File;
+  VKPipe::State m_VKState;
+  bytebuf m_ProxyTextureData;
+};
+
+static Network::Socket *ListenOnFreePort(uint16_t &port)
+{
+  for(port = 38920; port < 39020; port++)
+  {
+    Network::Socket *sock = Network::CreateServerSocket("127.0.0.1", port, 1);
+    if(sock)
+      return sock;
+  }
+
+  return NULL;
+}
+
+// connects a host-side ReplayProxy to a remote-side ReplayProxy over localhost. If a latency is
+// given the connection goes through a relay that holds all data in each direction for that long,
+// standing in for a real network round-trip.
+struct ProxyConnection
+{
+  ProxyConnection(uint32_t oneWayLatencyMS) : latencyMS(oneWayLatencyMS)
+  {
+    // keep the host's transfer cache out of the user's real one
+    SDObject *cacheDir = RenderDoc::Inst().SetConfigSetting("Replay_TransferCacheDirPath");
+    REQUIRE(cacheDir);
+    prevCacheDir = cacheDir->data.str;
+    cacheDir->data.str = GetTestCacheDir();
+
+    uint16_t serverPort = 0;
+    serverListen = ListenOnFreePort(serverPort);
+    REQUIRE(serverListen);
+
+    if(latencyMS > 0)
+    {
+      uint16_t relayPort = 0;
+      relayListen = ListenOnFreePort(relayPort);
+      REQUIRE(relayListen);
+
+      hostSock = Network::CreateClientSocket("127.0.0.1", relayPort, 1000);
+      relayHostSide = relayListen->AcceptClient(1000);
+      relayServerSide = Network::CreateClientSocket("127.0.0.1", serverPort, 1000);
+      serverSock = serverListen->AcceptClient(1000);
+
+      REQUIRE(relayHostSide);
+      REQUIRE(relayServerSide);
+
+      relayThread = Threading::CreateThread([this]() { RelayEntry(); });
+    }
+    else
+    {
+      hostSock = Network::CreateClientSocket("127.0.0.1", serverPort, 1000);
+      serverSock = serverListen->AcceptClient(1000);
+    }
+
+    REQUIRE(hostSock);
+    REQUIRE(serverSock);
+
+    serverThread = Threading::CreateThread([this]() { ServerEntry(); });
+
+    hostWriter = new WriteSerialiser(new StreamWriter(hostSock, Ownership::Nothing), Ownership::Stream);
+    hostReader = new ReadSerialiser(new StreamReader(hostSock, Ownership::Nothing), Ownership::Stream);
+    hostWriter->SetStreamingMode(true);
+    hostReader->SetStreamingMode(true);
+
+    host = new ReplayProxy(*hostReader, *hostWriter, &hostDriver);
+  }
+
+  ~ProxyConnection()
+  {
+    host->Shutdown();
+    delete hostWriter;
+    delete hostReader;
+    delete hostSock;
+
+    if(relayThread)
+    {
+      Atomic::Inc32(&relayKill);
+      Threading::JoinThread(relayThread);
+      Threading::CloseThread(relayThread);
+      delete relayHostSide;
+      delete relayServerSide;
+      delete relayListen;
+    }
+
+    // the server exits once its connection is closed
+    Threading::JoinThread(serverThread);
+    Threading::CloseThread(serverThread);
+    delete serverSock;
+    delete serverListen;
+
+    RenderDoc::Inst().SetConfigSetting("Replay_TransferCacheDirPath")->data.str = prevCacheDir;
+  }
+
+  static rdcstr GetTestCacheDir()
+  {
+    return FileIO::GetTempFolderFilename() + "renderdoc_replay_proxy_tests";
+  }
+
+  static void ClearTestCacheDir()
+  {
+    rdcarray<PathEntry> files;
+    FileIO::GetFilesInDirectory(GetTestCacheDir().c_str(), files);
+    for(const PathEntry &f : files)
+      if(f.filename.endsWith(".pack"))
+        FileIO::Delete((GetTestCacheDir() + "/" + f.filename).c_str());
+  }
+
+  void ServerEntry()
+  {
+    WriteSerialiser writer(new StreamWriter(serverSock, Ownership::Nothing), Ownership::Stream);
+    ReadSerialiser reader(new StreamReader(serverSock, Ownership::Nothing), Ownership::Stream);
+    writer.SetStreamingMode(true);
+    reader.SetStreamingMode(true);
+
+    ReplayProxy *proxy = new ReplayProxy(reader, writer, &remoteDriver, NULL, NULL);
+
+    while(true)
+    {
+      ReplayProxyPacket type = reader.ReadChunk<ReplayProxyPacket>();
+
+      if(reader.IsErrored() || writer.IsErrored())
+        break;
+
+      if(!proxy->Tick(type))
+        break;
+    }
+
+    proxy->Shutdown();
+  }
+
+  void RelayEntry()
+  {
+    struct Pending
+    {
+      double deliverTime;
+      bytebuf data;
+    };
+
+    rdcarray<Pending> toServer, toHost;
+    bytebuf buf;
+    buf.resize(64 * 1024);
+
+    PerformanceTimer timer;
+
+    while(Atomic::CmpExch32(&relayKill, 0, 0) == 0)
+    {
+      bool busy = false;
+
+      uint32_t size = (uint32_t)buf.size();
+      relayHostSide->RecvDataNonBlocking(buf.data(), size);
+      if(size > 0)
+        toServer.push_back({timer.GetMilliseconds() + latencyMS, bytebuf(buf.data(), size)});
+
+      size = (uint32_t)buf.size();
+      relayServerSide->RecvDataNonBlocking(buf.data(), size);
+      if(size > 0)
+        toHost.push_back({timer.GetMilliseconds() + latencyMS, bytebuf(buf.data(), size)});
+
+      while(!toServer.empty() && toServer[0].deliverTime <= timer.GetMilliseconds())
+      {
+        relayServerSide->SendDataBlocking(toServer[0].data.data(), (uint32_t)toServer[0].data.size());
+        toServer.erase(0);
+        busy = true;
+      }
+
+      while(!toHost.empty() && toHost[0].deliverTime <= timer.GetMilliseconds())
+      {
+        relayHostSide->SendDataBlocking(toHost[0].data.data(), (uint32_t)toHost[0].data.size());
+        toHost.erase(0);
+        busy = true;
+      }
+
+      if(!busy)
+        Threading::Sleep(0);
+    }
+  }
+
+  uint32_t latencyMS;
+  rdcstr prevCacheDir;
+
+  FakeReplayDriver hostDriver, remoteDriver;
+  ReplayProxy *host = NULL;
+
+  Network::Socket *serverListen = NULL, *serverSock = NULL, *hostSock = NULL;
+  Network::Socket *relayListen = NULL, *relayHostSide = NULL, *relayServerSide = NULL;
+  WriteSerialiser *hostWriter = NULL;
+  ReadSerialiser *hostReader = NULL;
+
+  Threading::ThreadHandle serverThread = 0, relayThread = 0;
+  volatile int32_t relayKill = 0;
+};
+
+TEST_CASE("Test pipelined replay proxy batches", "[replayproxy]")
+{
+  ProxyConnection conn(0);
+  ReplayProxy *proxy = conn.host;
+
+  SECTION("Batched results match serial calls")
+  {
+    rdcarray<TextureDescription> texs = proxy->GetTextures();
+    rdcarray<BufferDescription> bufs = proxy->GetBuffers();
+    rdcarray<EventUsage> usage = proxy->GetUsage(ResourceId());
+    bytebuf texData;
+    proxy->GetTextureData(ResourceId(), {1, 0, 0}, GetTextureDataParams(), texData);
+
+    rdcarray<TextureDescription> batchTexs;
+    rdcarray<BufferDescription> batchBufs;
+    rdcarray<EventUsage> batchUsage;
+    bytebuf batchTexData;
+
+    proxy->ExecuteBatch({
+        [&]() { batchTexs = proxy->GetTextures(); },
+        [&]() { batchBufs = proxy->GetBuffers(); },
+        [&]() { batchUsage = proxy->GetUsage(ResourceId()); },
+        [&]() {
+          proxy->GetTextureData(ResourceId(), {1, 0, 0}, GetTextureDataParams(), batchTexData);
+        },
+    });
+
+    REQUIRE(batchTexs.size() == texs.size());
+    for(size_t i = 0; i < texs.size(); i++)
+      CHECK(batchTexs[i].width == texs[i].width);
+
+    REQUIRE(batchBufs.size() == bufs.size());
+    for(size_t i = 0; i < bufs.size(); i++)
+      CHECK(batchBufs[i].length == bufs[i].length);
+
+    REQUIRE(batchUsage.size() == usage.size());
+    for(size_t i = 0; i < usage.size(); i++)
+    {
+      CHECK(batchUsage[i].eventId == usage[i].eventId);
+      CHECK(batchUsage[i].usage == usage[i].usage);
+    }
+    CHECK(batchTexData.size() == 32 * 1024);
+    CHECK(batchTexData == texData);
+
+    // calls are executed on the remote side in the order they were batched
+    rdcarray<rdcstr> calls = conn.remoteDriver.GetCalls();
+    REQUIRE(calls.size() == 8);
+    CHECK(calls[4] == "GetTextures");
+    CHECK(calls[5] == "GetBuffers");
+    CHECK(calls[6] == "GetUsage");
+    CHECK(calls[7] == "GetTextureData");
+  };
+
+  SECTION("Batches larger than the in-flight limit")
+  {
+    rdcarray<bytebuf> results;
+    results.resize(100);
+
+    rdcarray<std::function<void()>> calls;
+    for(size_t i = 0; i < results.size(); i++)
+      calls.push_back([&results, proxy, i]() {
+        proxy->GetBufferData(ResourceId(), i, 16 + i, results[i]);
+      });
+
+    proxy->ExecuteBatch(calls);
+
+    for(size_t i = 0; i < results.size(); i++)
+    {
+      REQUIRE(results[i].size() == 16 + i);
+      CHECK(results[i][0] == byte(i & 0xff));
+      CHECK(results[i].back() == byte((i + 15 + i) & 0xff));
+    }
+  };
+
+  SECTION("Calls made while handling the last response")
+  {
+    bytebuf data;
+
+    // handling the pipeline state response makes further proxied calls to look up shaders, which
+    // is allowed as the last call in the batch
+    proxy->ExecuteBatch({
+        [&]() { proxy->ReplayLog(100, eReplay_OnlyDraw); },
+        [&]() { proxy->SavePipelineState(100); },
+    });
+
+    CHECK(proxy->GetVulkanPipelineState() != NULL);
+
+    // normal calls afterwards are unaffected
+    proxy->GetBufferData(ResourceId(), 0, 8, data);
+
+    CHECK(data.size() == 8);
+
+    rdcarray<rdcstr> calls = conn.remoteDriver.GetCalls();
+    REQUIRE(calls.size() == 3);
+    CHECK(calls[0] == "ReplayLog");
+    CHECK(calls[1] == "SavePipelineState");
+    CHECK(calls[2] == "GetBufferData");
+  };
+}
+
+TEST_CASE("Test replay proxy transfer cache", "[replayproxy]")
+{
+  ProxyConnection::ClearTestCacheDir();
+
+  bytebuf expected;
+  {
+    FakeReplayDriver driver;
+    driver.GetTextureData(ResourceId(), {0, 0, 0}, GetTextureDataParams(), expected);
+  }
+
+  TextureDisplay cfg;
+  cfg.resourceId = ResourceIDGen::GetNewUniqueID();
+
+  {
+    ProxyConnection conn(0);
+
+    // the first time the contents are all sent
+    conn.host->RenderTexture(cfg);
+
+    CHECK(conn.hostDriver.GetProxyTextureData() == expected);
+
+    TransferCacheStats stats = conn.host->GetTransferCacheStats();
+    CHECK(stats.bytesReceived == expected.size());
+    CHECK(stats.bytesReused == 0);
+
+    // a different texture with the same contents is entirely reused
+    cfg.resourceId = ResourceIDGen::GetNewUniqueID();
+    conn.host->RenderTexture(cfg);
+
+    CHECK(conn.hostDriver.GetProxyTextureData() == expected);
+
+    stats = conn.host->GetTransferCacheStats();
+    CHECK(stats.bytesReceived == expected.size());
+    CHECK(stats.bytesReused == expected.size());
+  }
+
+  // after reconnecting, the contents are still reused from the cache on disk
+  {
+    ProxyConnection conn(0);
+
+    conn.host->RenderTexture(cfg);
+
+    CHECK(conn.hostDriver.GetProxyTextureData() == expected);
+
+    TransferCacheStats stats = conn.host->GetTransferCacheStats();
+    CHECK(stats.bytesReceived == 0);
+    CHECK(stats.bytesReused == expected.size());
+  }
+
+  // corrupt the end of the cached data, the broken chunk is then sent again
+  {
+    rdcarray<PathEntry> files;
+    FileIO::GetFilesInDirectory(ProxyConnection::GetTestCacheDir().c_str(), files);
+    for(const PathEntry &f : files)
+    {
+      if(!f.filename.endsWith(".pack"))
+        continue;
+
+      FILE *pack =
+          FileIO::fopen((ProxyConnection::GetTestCacheDir() + "/" + f.filename).c_str(), "r+b");
+      REQUIRE(pack);
+
+      byte garbage[16];
+      memset(garbage, 0xcc, sizeof(garbage));
+      FileIO::fseek64(pack, 0, SEEK_END);
+      FileIO::fseek64(pack, FileIO::ftell64(pack) - sizeof(garbage), SEEK_SET);
+      FileIO::fwrite(garbage, 1, sizeof(garbage), pack);
+      FileIO::fclose(pack);
+    }
+
+    ProxyConnection conn(0);
+
+    conn.host->RenderTexture(cfg);
+
+    CHECK(conn.hostDriver.GetProxyTextureData() == expected);
+
+    TransferCacheStats stats = conn.host->GetTransferCacheStats();
+    CHECK(stats.bytesReceived > 0);
+    CHECK(stats.bytesReceived < expected.size());
+  }
+
+  ProxyConnection::ClearTestCacheDir();
+}
+
+TEST_CASE("Benchmark pipelined replay proxy over a high latency link", "[.][benchmark]")
+{
+  // 25ms each way, a 50ms round-trip
+  ProxyConnection conn(25);
+  ReplayProxy *proxy = conn.host;
+
+  rdcarray<TextureDescription> texs;
+  rdcarray<BufferDescription> bufs;
+  rdcarray<EventUsage> usage;
+  bytebuf texData[4];
+
+  // the queries made when refreshing the UI after selecting an event
+  rdcarray<std::function<void()>> refresh = {
+      [&]() { texs = proxy->GetTextures(); },
+      [&]() { bufs = proxy->GetBuffers(); },
+      [&]() { usage = proxy->GetUsage(ResourceId()); },
+      [&]() { proxy->GetTextureData(ResourceId(), {0, 0, 0}, GetTextureDataParams(), texData[0]); },
+      [&]() { proxy->GetTextureData(ResourceId(), {1, 0, 0}, GetTextureDataParams(), texData[1]); },
+      [&]() { proxy->GetTextureData(ResourceId(), {2, 0, 0}, GetTextureDataParams(), texData[2]); },
+      [&]() { proxy->GetTextureData(ResourceId(), {3, 0, 0}, GetTextureDataParams(), texData[3]); },
+      [&]() { proxy->SavePipelineState(100); },
+  };
+
+  WARN(refresh.size() << " queries with a " << conn.latencyMS * 2 << "ms round-trip");
+
+  BENCHMARK("Serial")
+  {
+    for(const std::function<void()> &call : refresh)
+      call();
+  }
+
+  BENCHMARK("Pipelined") { proxy->ExecuteBatch(refresh); }
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
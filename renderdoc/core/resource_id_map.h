@@ -0,0 +1,323 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <string.h>
+#include "api/replay/rdcarray.h"
+#include "api/replay/rdcpair.h"
+#include "api/replay/resourceid.h"
+#include "common/threading.h"
+
+// An open-addressed hash map keyed by ResourceId, for the tables that are looked up on every
+// wrapped API call. IDs are allocated from a single counter so they hash very well, and a flat
+// table with linear probing avoids a node allocation per entry and a pointer chase per level that a
+// std::map would need.
+//
+// The interface is a subset of std::map, with one important difference - iteration order is not
+// sorted. Erasing leaves a tombstone rather than moving elements, so erasing during iteration (or
+// erasing any element while holding an iterator to another) is safe. Only inserting a new key can
+// invalidate iterators and references.
+template <typename V>
+class ResourceIdMap
+{
+public:
+  typedef rdcpair<ResourceId, V> value_type;
+
+  template <typename MapType, typename ValueType>
+  class iter
+  {
+  public:
+    iter(MapType *m, size_t i) : map(m), idx(i) { skip(); }
+    ValueType &operator*() const { return map->m_Slots[idx]; }
+    ValueType *operator->() const { return &map->m_Slots[idx]; }
+    iter &operator++()
+    {
+      idx++;
+      skip();
+      return *this;
+    }
+    iter operator++(int)
+    {
+      iter ret = *this;
+      ++(*this);
+      return ret;
+    }
+    bool operator==(const iter &o) const { return idx == o.idx; }
+    bool operator!=(const iter &o) const { return idx != o.idx; }
+  private:
+    friend class ResourceIdMap;
+
+    void skip()
+    {
+      while(idx < map->m_State.size() && map->m_State[idx] != Full)
+        idx++;
+    }
+
+    MapType *map;
+    size_t idx;
+  };
+
+  typedef iter<ResourceIdMap, value_type> iterator;
+  typedef iter<const ResourceIdMap, const value_type> const_iterator;
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, m_State.size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, m_State.size()); }
+  size_t size() const { return m_Count; }
+  bool empty() const { return m_Count == 0; }
+  void clear()
+  {
+    m_Slots.clear();
+    m_State.clear();
+    m_Count = m_Used = 0;
+  }
+
+  void swap(ResourceIdMap<V> &other)
+  {
+    m_Slots.swap(other.m_Slots);
+    m_State.swap(other.m_State);
+    std::swap(m_Count, other.m_Count);
+    std::swap(m_Used, other.m_Used);
+  }
+
+  void reserve(size_t count)
+  {
+    size_t cap = MinCapacity;
+    while(count * 4 >= cap * 3)
+      cap *= 2;
+
+    if(cap > m_State.size())
+      Rehash(cap);
+  }
+
+  iterator find(ResourceId id)
+  {
+    size_t idx = Lookup(id);
+    return iterator(this, idx == NotFound ? m_State.size() : idx);
+  }
+
+  const_iterator find(ResourceId id) const
+  {
+    size_t idx = Lookup(id);
+    return const_iterator(this, idx == NotFound ? m_State.size() : idx);
+  }
+
+  size_t count(ResourceId id) const { return Lookup(id) == NotFound ? 0 : 1; }
+  V &operator[](ResourceId id) { return m_Slots[Insert(id)].second; }
+  size_t erase(ResourceId id)
+  {
+    size_t idx = Lookup(id);
+    if(idx == NotFound)
+      return 0;
+
+    EraseSlot(idx);
+    return 1;
+  }
+
+  iterator erase(iterator it)
+  {
+    EraseSlot(it.idx);
+    return iterator(this, it.idx + 1);
+  }
+
+private:
+  enum : uint8_t
+  {
+    Empty,
+    Full,
+    Deleted,
+  };
+
+  static const size_t MinCapacity = 16;
+  static const size_t NotFound = ~(size_t)0;
+
+  rdcarray<value_type> m_Slots;
+  rdcarray<uint8_t> m_State;
+
+  // number of live elements, and number of slots that are full or tombstoned
+  size_t m_Count = 0;
+  size_t m_Used = 0;
+
+  static size_t Hash(ResourceId id, size_t mask)
+  {
+    uint64_t key;
+    memcpy(&key, &id, sizeof(key));
+    // fibonacci hashing spreads sequential IDs out across the table
+    return size_t((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+  }
+
+  size_t Lookup(ResourceId id) const
+  {
+    if(m_Count == 0)
+      return NotFound;
+
+    const size_t mask = m_State.size() - 1;
+    for(size_t idx = Hash(id, mask);; idx = (idx + 1) & mask)
+    {
+      if(m_State[idx] == Empty)
+        return NotFound;
+      if(m_State[idx] == Full && m_Slots[idx].first == id)
+        return idx;
+    }
+  }
+
+  size_t Insert(ResourceId id)
+  {
+    size_t idx = Lookup(id);
+    if(idx != NotFound)
+      return idx;
+
+    // keep the table at most 3/4 used including tombstones, so probe sequences stay short. If most
+    // of the used slots are tombstones, rehashing at the same size is enough to clean them up
+    if((m_Used + 1) * 4 > m_State.size() * 3)
+    {
+      size_t cap = m_State.size();
+      if(cap == 0)
+        cap = MinCapacity;
+      else if(m_Count * 4 >= cap)
+        cap *= 2;
+      Rehash(cap);
+    }
+
+    const size_t mask = m_State.size() - 1;
+    for(idx = Hash(id, mask);; idx = (idx + 1) & mask)
+    {
+      if(m_State[idx] != Full)
+        break;
+    }
+
+    if(m_State[idx] == Empty)
+      m_Used++;
+    m_Count++;
+
+    m_State[idx] = Full;
+    m_Slots[idx].first = id;
+    return idx;
+  }
+
+  void EraseSlot(size_t idx)
+  {
+    m_State[idx] = Deleted;
+    m_Slots[idx].first = ResourceId();
+    m_Slots[idx].second = V();
+    m_Count--;
+  }
+
+  void Rehash(size_t capacity)
+  {
+    rdcarray<value_type> slots;
+    rdcarray<uint8_t> state;
+    slots.swap(m_Slots);
+    state.swap(m_State);
+
+    m_Slots.resize(capacity);
+    m_State.fill(capacity, Empty);
+    m_Used = m_Count;
+
+    const size_t mask = capacity - 1;
+    for(size_t i = 0; i < state.size(); i++)
+    {
+      if(state[i] != Full)
+        continue;
+
+      size_t idx = Hash(slots[i].first, mask);
+      while(m_State[idx] != Empty)
+        idx = (idx + 1) & mask;
+
+      m_State[idx] = Full;
+      m_Slots[idx] = std::move(slots[i]);
+    }
+  }
+};
+
+// A ResourceIdMap split into independently locked shards, for tables that are written from many
+// threads at once while recording. Sequential IDs are spread evenly across the shards by their low
+// bits. Callers lock the shard for an ID and then operate on its map directly, so that a
+// read-modify-write happens under a single lock.
+//
+// Shards must always be locked one at a time, or in index order via ForEach.
+template <typename V>
+class StripedResourceIdMap
+{
+public:
+  static const size_t NumShards = 16;
+
+  struct Shard
+  {
+    Threading::CriticalSection lock;
+    ResourceIdMap<V> map;
+  };
+
+  Shard &GetShard(ResourceId id)
+  {
+    uint64_t key;
+    memcpy(&key, &id, sizeof(key));
+    return m_Shards[key & (NumShards - 1)];
+  }
+
+  bool contains(ResourceId id)
+  {
+    Shard &shard = GetShard(id);
+    SCOPED_LOCK(shard.lock);
+    return shard.map.count(id) != 0;
+  }
+
+  // invokes callback(const ResourceId &, V &) for every element, holding each shard's lock in turn.
+  template <typename Callback>
+  void ForEach(Callback callback)
+  {
+    for(Shard &shard : m_Shards)
+    {
+      SCOPED_LOCK(shard.lock);
+      for(auto it = shard.map.begin(); it != shard.map.end(); ++it)
+        callback(it->first, it->second);
+    }
+  }
+
+  size_t size()
+  {
+    size_t ret = 0;
+    for(Shard &shard : m_Shards)
+    {
+      SCOPED_LOCK(shard.lock);
+      ret += shard.map.size();
+    }
+    return ret;
+  }
+
+  bool empty() { return size() == 0; }
+  void clear()
+  {
+    for(Shard &shard : m_Shards)
+    {
+      SCOPED_LOCK(shard.lock);
+      shard.map.clear();
+    }
+  }
+
+private:
+  Shard m_Shards[NumShards];
+};
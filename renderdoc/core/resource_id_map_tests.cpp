@@ -0,0 +1,288 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "common/globalconfig.h"
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include <map>
+#include "core/resource_manager.h"
+#include "resource_id_map.h"
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Test ResourceIdMap matches std::map", "[resourceidmap]")
+{
+  rdcarray<ResourceId> ids;
+  for(int i = 0; i < 5000; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  ResourceIdMap<uint32_t> map;
+  std::map<ResourceId, uint32_t> reference;
+
+  CHECK(map.empty());
+  CHECK(map.count(ids[0]) == 0);
+  CHECK(map.erase(ids[0]) == 0);
+
+  SECTION("Insert, update and erase")
+  {
+    // repeatedly insert and erase in a random pattern so that there are plenty of tombstones
+    for(uint32_t i = 0; i < 100000; i++)
+    {
+      ResourceId id = ids[rand() % ids.size()];
+
+      if(rand() % 3 == 0)
+      {
+        CHECK(map.erase(id) == reference.erase(id));
+      }
+      else
+      {
+        map[id] += i;
+        reference[id] += i;
+      }
+    }
+
+    REQUIRE(map.size() == reference.size());
+
+    size_t iterated = 0;
+    for(auto it = map.begin(); it != map.end(); ++it)
+    {
+      iterated++;
+      REQUIRE(reference.count(it->first) == 1);
+      CHECK(reference[it->first] == it->second);
+    }
+
+    CHECK(iterated == reference.size());
+
+    for(ResourceId id : ids)
+      CHECK(map.count(id) == reference.count(id));
+  };
+
+  SECTION("Erase during iteration")
+  {
+    for(uint32_t i = 0; i < ids.size(); i++)
+      map[ids[i]] = i;
+
+    // erase every other element, by iterator and by key from ahead of the iterator
+    for(auto it = map.begin(); it != map.end();)
+    {
+      if(it->second % 2)
+      {
+        it = map.erase(it);
+      }
+      else
+      {
+        map.erase(ids[it->second + 1]);
+        ++it;
+      }
+    }
+
+    CHECK(map.size() == ids.size() / 2);
+
+    for(uint32_t i = 0; i < ids.size(); i++)
+      CHECK(map.count(ids[i]) == ((i % 2) ? 0U : 1U));
+  };
+
+  SECTION("Swap and clear")
+  {
+    for(uint32_t i = 0; i < 100; i++)
+      map[ids[i]] = i;
+
+    ResourceIdMap<uint32_t> other;
+    other.swap(map);
+
+    CHECK(map.empty());
+    CHECK(other.size() == 100);
+    CHECK(other[ids[50]] == 50);
+
+    other.clear();
+    CHECK(other.empty());
+    CHECK(other.count(ids[50]) == 0);
+
+    other[ids[0]] = 5;
+    CHECK(other.size() == 1);
+  };
+};
+
+TEST_CASE("Test StripedResourceIdMap", "[resourceidmap]")
+{
+  StripedResourceIdMap<uint32_t> map;
+
+  const int numThreads = 8;
+  const uint32_t numIDs = 10000;
+
+  rdcarray<ResourceId> ids;
+  for(uint32_t i = 0; i < numIDs; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  rdcarray<Threading::ThreadHandle> threads;
+
+  // each thread increments every ID, so each element ends up at exactly numThreads
+  for(int t = 0; t < numThreads; t++)
+  {
+    threads.push_back(Threading::CreateThread([&map, &ids, t]() {
+      for(uint32_t i = 0; i < numIDs; i++)
+      {
+        ResourceId id = ids[(i + t * 1000) % numIDs];
+
+        auto &shard = map.GetShard(id);
+        SCOPED_LOCK(shard.lock);
+        shard.map[id]++;
+      }
+    }));
+  }
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+
+  CHECK(map.size() == numIDs);
+  CHECK(map.contains(ids[123]));
+
+  uint32_t total = 0;
+  map.ForEach([&total, numThreads](ResourceId, uint32_t count) {
+    CHECK(count == numThreads);
+    total += count;
+  });
+
+  CHECK(total == numIDs * numThreads);
+
+  map.clear();
+  CHECK(map.empty());
+};
+
+// the tables as they were, with ordered maps behind a single lock
+struct GlobalLockTracker
+{
+  typedef std::map<ResourceId, FrameRefType> CmdRefs;
+
+  Threading::CriticalSection lock;
+  std::map<ResourceId, uint32_t> records;
+  std::map<ResourceId, FrameRefType> frameRefs;
+
+  void AddRecord(ResourceId id, uint32_t value) { records[id] = value; }
+  bool HasRecord(ResourceId id)
+  {
+    SCOPED_LOCK(lock);
+    return records.find(id) != records.end();
+  }
+  void MarkFrameReferenced(ResourceId id)
+  {
+    SCOPED_LOCK(lock);
+    MarkReferenced(frameRefs, id, eFrameRef_Read);
+  }
+  void ClearFrameReferences() { frameRefs.clear(); }
+};
+
+struct StripedTracker
+{
+  typedef ResourceIdMap<FrameRefType> CmdRefs;
+
+  StripedResourceIdMap<uint32_t> records;
+  StripedResourceIdMap<FrameRefType> frameRefs;
+
+  void AddRecord(ResourceId id, uint32_t value) { records.GetShard(id).map[id] = value; }
+  bool HasRecord(ResourceId id) { return records.contains(id); }
+  void MarkFrameReferenced(ResourceId id)
+  {
+    auto &shard = frameRefs.GetShard(id);
+    SCOPED_LOCK(shard.lock);
+    MarkReferenced(shard.map, id, eFrameRef_Read);
+  }
+  void ClearFrameReferences() { frameRefs.clear(); }
+};
+
+// each thread records commands into its own command buffer, which references a few resources per
+// command. Every reference looks up the resource's record, adds it to the command buffer's
+// references and marks it as referenced in the frame.
+template <typename Tracker>
+void SimulateRecording(Tracker &tracker, const rdcarray<ResourceId> &ids, int numThreads,
+                       int numCommands)
+{
+  tracker.ClearFrameReferences();
+
+  rdcarray<Threading::ThreadHandle> threads;
+  for(int t = 0; t < numThreads; t++)
+  {
+    threads.push_back(Threading::CreateThread([&tracker, &ids, numCommands, t]() {
+      typename Tracker::CmdRefs cmdRefs;
+      uint32_t seed = t * 7919;
+      for(int c = 0; c < numCommands; c++)
+      {
+        for(int r = 0; r < 4; r++)
+        {
+          seed = seed * 1103515245 + 12345;
+          ResourceId id = ids[(seed >> 8) % ids.size()];
+          if(tracker.HasRecord(id))
+          {
+            MarkReferenced(cmdRefs, id, eFrameRef_Read);
+            tracker.MarkFrameReferenced(id);
+          }
+        }
+      }
+    }));
+  }
+
+  for(Threading::ThreadHandle t : threads)
+  {
+    Threading::JoinThread(t);
+    Threading::CloseThread(t);
+  }
+}
+
+TEST_CASE("Benchmark resource tracking while recording", "[.][benchmark]")
+{
+  const uint32_t numResources = 128 * 1024;
+  const int numThreads = 8;
+  const int numCommands = 100000;
+
+  rdcarray<ResourceId> ids;
+  for(uint32_t i = 0; i < numResources; i++)
+    ids.push_back(ResourceIDGen::GetNewUniqueID());
+
+  GlobalLockTracker *global = new GlobalLockTracker;
+  StripedTracker *striped = new StripedTracker;
+
+  for(uint32_t i = 0; i < numResources; i++)
+  {
+    global->AddRecord(ids[i], i);
+    striped->AddRecord(ids[i], i);
+  }
+
+  WARN(numThreads << " threads recording " << numCommands << " commands each, with "
+                  << numResources << " live resources");
+
+  BENCHMARK("std::map with global lock")
+  {
+    SimulateRecording(*global, ids, numThreads, numCommands);
+  }
+
+  BENCHMARK("Striped ResourceIdMap") { SimulateRecording(*striped, ids, numThreads, numCommands); }
+  delete global;
+  delete striped;
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
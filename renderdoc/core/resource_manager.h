@@ -25,11 +25,13 @@
 
 #pragma once
 
+#include <algorithm>
 #include <map>
 #include <set>
 #include "api/replay/resourceid.h"
 #include "common/threading.h"
 #include "core/core.h"
+#include "core/resource_id_map.h"
 #include "os/os_specific.h"
 #include "serialise/serialiser.h"
 
@@ -252,9 +254,8 @@ inline InitReqType InitReq(FrameRefType refType, InitPolicy policy, bool initial
 }
 
 // handle marking a resource referenced for read or write and storing RAW access etc.
-template <typename Compose>
-bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, FrameRefType refType,
-                    Compose comp)
+template <typename Map, typename Compose>
+bool MarkReferenced(Map &refs, ResourceId id, FrameRefType refType, Compose comp)
 {
   auto refit = refs.find(id);
   if(refit == refs.end())
@@ -269,8 +270,8 @@ bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id, Fra
   return false;
 }
 
-inline bool MarkReferenced(std::map<ResourceId, FrameRefType> &refs, ResourceId id,
-                           FrameRefType refType)
+template <typename Map>
+inline bool MarkReferenced(Map &refs, ResourceId id, FrameRefType refType)
 {
   return MarkReferenced(refs, id, refType, ComposeFrameRefs);
 }
@@ -511,7 +512,7 @@ protected:
   rdcarray<rdcpair<int64_t, Chunk *>> m_Chunks;
   Threading::CriticalSection *m_ChunkLock;
 
-  std::map<ResourceId, FrameRefType> m_FrameRefs;
+  ResourceIdMap<FrameRefType> m_FrameRefs;
 };
 
 template <typename Compose>
@@ -676,25 +677,18 @@ protected:
   virtual void Apply_InitialState(WrappedResourceType live, const InitialContentData &initial) = 0;
   virtual rdcarray<ResourceId> InitialContentResources();
 
-  // very coarse lock, protects EVERYTHING. This could certainly be improved and it may be a
-  // bottleneck
-  // for performance. Given that the main use cases are write-rarely read-often the lock should be
-  // optimised
-  // for that as we only want to make sure we're not modifying the objects together, by far the most
-  // common
-  // operation is looking up data.
+  // coarse lock, protects everything except the resource records and frame references. Those are
+  // looked up on every wrapped API call from any thread, so they are striped maps with their own
+  // per-shard locks. If both are needed, m_Lock must be taken first, and a frame reference shard
+  // must be locked before a resource record shard.
   Threading::CriticalSection m_Lock;
 
-  // easy optimisation win - don't use maps everywhere. It's convenient but not optimal, and
-  // profiling will
-  // likely prove that some or all of these could be a problem
-
   // used during capture - map from real resource to its wrapper (other way can be done just with an
   // Unwrap)
   std::map<RealResourceType, WrappedResourceType> m_WrapperMap;
 
   // used during capture - holds resources referenced in current frame (and how they're referenced)
-  std::map<ResourceId, FrameRefType> m_FrameReferencedResources;
+  StripedResourceIdMap<FrameRefType> m_FrameReferencedResources;
 
   // used during capture - holds resources marked as dirty, needing initial contents
   std::set<ResourceId> m_DirtyResources;
@@ -717,26 +711,30 @@ protected:
   };
 
   // used during capture or replay - holds initial contents
-  std::map<ResourceId, InitialContentDataOrChunk> m_InitialContents;
+  ResourceIdMap<InitialContentDataOrChunk> m_InitialContents;
+
+  // the IDs in m_InitialContents in ascending order. The map iterates in hash order, so anything
+  // that writes to a capture or must be deterministic iterates over this instead.
+  rdcarray<ResourceId> GetSortedInitialContentIDs();
 
   // used during capture or replay - map of resources currently alive with their real IDs, used in
   // capture and replay.
-  std::map<ResourceId, WrappedResourceType> m_CurrentResourceMap;
+  ResourceIdMap<WrappedResourceType> m_CurrentResourceMap;
 
   // used during replay - maps back and forth from original id to live id and vice-versa
-  std::map<ResourceId, ResourceId> m_OriginalIDs, m_LiveIDs;
+  ResourceIdMap<ResourceId> m_OriginalIDs, m_LiveIDs;
 
   // used during replay - holds resources allocated and the original id that they represent
-  std::map<ResourceId, WrappedResourceType> m_LiveResourceMap;
+  ResourceIdMap<WrappedResourceType> m_LiveResourceMap;
 
   // used during capture - holds resource records by id.
-  std::map<ResourceId, RecordType *> m_ResourceRecords;
+  StripedResourceIdMap<RecordType *> m_ResourceRecords;
 
   // used during replay - holds current resource replacements
   // replaced -> replacement
-  std::map<ResourceId, ResourceId> m_Replacements;
+  ResourceIdMap<ResourceId> m_Replacements;
   // replacement -> replaced (for looking up original IDs)
-  std::map<ResourceId, ResourceId> m_Replaced;
+  ResourceIdMap<ResourceId> m_Replaced;
 
   // During initial resources preparation, persistent resources are
   // postponed until serializing to RDC file.
@@ -745,7 +743,7 @@ protected:
   // On marking resource write-referenced in frame, its last write
   // time is reset. The time is used to determine persistent resources,
   // and is checked against the `PERSISTENT_RESOURCE_AGE`.
-  std::map<ResourceId, double> m_LastWriteTime;
+  ResourceIdMap<double> m_LastWriteTime;
 
   // Timestamp at the beginning of the frame capture. Used to determine which
   // resources to refresh for their last write time (see `m_LastWriteTime`).
@@ -771,13 +769,16 @@ void ResourceManager<Configuration>::Shutdown()
 
   while(!m_LiveResourceMap.empty())
   {
-    auto it = m_LiveResourceMap.begin();
-    ResourceId id = it->first;
-    ResourceTypeRelease(it->second);
+    // releasing a resource may erase others from the map, which leaves iteration intact
+    for(auto it = m_LiveResourceMap.begin(); it != m_LiveResourceMap.end(); ++it)
+    {
+      ResourceId id = it->first;
+      ResourceTypeRelease(it->second);
 
-    auto removeit = m_LiveResourceMap.find(id);
-    if(removeit != m_LiveResourceMap.end())
-      m_LiveResourceMap.erase(removeit);
+      auto removeit = m_LiveResourceMap.find(id);
+      if(removeit != m_LiveResourceMap.end())
+        m_LiveResourceMap.erase(removeit);
+    }
   }
 
   RDCASSERT(m_ResourceRecords.empty());
@@ -799,8 +800,6 @@ template <typename Compose>
 void ResourceManager<Configuration>::MarkResourceFrameReferenced(ResourceId id,
                                                                  FrameRefType refType, Compose comp)
 {
-  SCOPED_LOCK(m_Lock);
-
   if(id == ResourceId())
     return;
 
@@ -813,7 +812,11 @@ void ResourceManager<Configuration>::MarkResourceFrameReferenced(ResourceId id,
   if(IsBackgroundCapturing(m_State))
     return;
 
-  bool newRef = MarkReferenced(m_FrameReferencedResources, id, refType, comp);
+  auto &shard = m_FrameReferencedResources.GetShard(id);
+  SCOPED_LOCK(shard.lock);
+
+  // the record is referenced under the shard lock, so that clearing references can't race with it
+  bool newRef = MarkReferenced(shard.map, id, refType, comp);
 
   if(newRef)
   {
@@ -931,23 +934,24 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
 
   // all resources that were recorded as being modified should be included in the list of those
   // needing initial contents
-  for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
-  {
-    RecordType *record = GetResourceRecord(it->first);
-    if(IsDirtyFrameRef(it->second))
+  m_FrameReferencedResources.ForEach([this, &WrittenRecords](ResourceId id, FrameRefType ref) {
+    RecordType *record = GetResourceRecord(id);
+    if(IsDirtyFrameRef(ref))
     {
-      WrittenRecord wr = {it->first, record ? record->DataInSerialiser : true};
+      WrittenRecord wr = {id, record ? record->DataInSerialiser : true};
 
       WrittenRecords.push_back(wr);
     }
-  }
+  });
 
   // any resources that had initial contents generated should also be included
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : GetSortedInitialContentIDs())
   {
-    ResourceId id = it->first;
-    auto ref = m_FrameReferencedResources.find(id);
-    if(ref == m_FrameReferencedResources.end() || !IsDirtyFrameRef(ref->second))
+    auto &shard = m_FrameReferencedResources.GetShard(id);
+    SCOPED_LOCK(shard.lock);
+
+    auto ref = shard.map.find(id);
+    if(ref == shard.map.end() || !IsDirtyFrameRef(ref->second))
     {
       WrittenRecord wr = {id, true};
 
@@ -955,22 +959,33 @@ void ResourceManager<Configuration>::Serialise_InitialContentsNeeded(WriteSerial
     }
   }
 
+  // write in ID order, as the frame references also iterate in hash order
+  std::sort(WrittenRecords.begin(), WrittenRecords.end(),
+            [](const WrittenRecord &a, const WrittenRecord &b) { return a.id < b.id; });
+
   uint64_t chunkSize = uint64_t(WrittenRecords.size() * sizeof(WrittenRecord) + 16);
 
   SCOPED_SERIALISE_CHUNK(SystemChunk::InitialContentsList, chunkSize);
   SERIALISE_ELEMENT(WrittenRecords);
 }
 
+template <typename Configuration>
+rdcarray<ResourceId> ResourceManager<Configuration>::GetSortedInitialContentIDs()
+{
+  rdcarray<ResourceId> ret;
+  ret.reserve(m_InitialContents.size());
+  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+    ret.push_back(it->first);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
 template <typename Configuration>
 void ResourceManager<Configuration>::FreeInitialContents()
 {
-  while(!m_InitialContents.empty())
-  {
-    auto it = m_InitialContents.begin();
+  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
     it->second.Free(this);
-    if(!m_InitialContents.empty())
-      m_InitialContents.erase(m_InitialContents.begin());
-  }
+  m_InitialContents.clear();
   m_PostponedResourceIDs.clear();
 }
 
@@ -1120,10 +1135,8 @@ template <typename Configuration>
 rdcarray<ResourceId> ResourceManager<Configuration>::InitialContentResources()
 {
   rdcarray<ResourceId> resources;
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : GetSortedInitialContentIDs())
   {
-    ResourceId id = it->first;
-
     if(HasLiveResource(id))
     {
       resources.push_back(id);
@@ -1137,10 +1150,7 @@ void ResourceManager<Configuration>::MarkUnwrittenResources()
 {
   SCOPED_LOCK(m_Lock);
 
-  for(auto it = m_ResourceRecords.begin(); it != m_ResourceRecords.end(); ++it)
-  {
-    it->second->MarkDataUnwritten();
-  }
+  m_ResourceRecords.ForEach([](ResourceId, RecordType *record) { record->MarkDataUnwritten(); });
 }
 
 template <typename Configuration>
@@ -1154,16 +1164,22 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
 
   if(RenderDoc::Inst().GetCaptureOptions().refAllResources)
   {
-    float num = float(m_ResourceRecords.size());
+    // take a copy of the records first, since frame references can't be looked up while holding a
+    // record shard's lock
+    rdcarray<rdcpair<ResourceId, RecordType *>> records;
+    records.reserve(m_ResourceRecords.size());
+    m_ResourceRecords.ForEach(
+        [&records](ResourceId id, RecordType *record) { records.push_back({id, record}); });
+
+    float num = float(records.size());
     float idx = 0.0f;
 
-    for(auto it = m_ResourceRecords.begin(); it != m_ResourceRecords.end(); ++it)
+    for(auto it = records.begin(); it != records.end(); ++it)
     {
       RenderDoc::Inst().SetProgress(CaptureProgress::AddReferencedResources, idx / num);
       idx += 1.0f;
 
-      if(m_FrameReferencedResources.find(it->first) == m_FrameReferencedResources.end() &&
-         it->second->InternalResource)
+      if(!m_FrameReferencedResources.contains(it->first) && it->second->InternalResource)
         continue;
 
       it->second->Insert(sortedChunks);
@@ -1174,15 +1190,14 @@ void ResourceManager<Configuration>::InsertReferencedChunks(WriteSerialiser &ser
     float num = float(m_FrameReferencedResources.size());
     float idx = 0.0f;
 
-    for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
-    {
+    m_FrameReferencedResources.ForEach([&](ResourceId id, FrameRefType) {
       RenderDoc::Inst().SetProgress(CaptureProgress::AddReferencedResources, idx / num);
       idx += 1.0f;
 
-      RecordType *record = GetResourceRecord(it->first);
+      RecordType *record = GetResourceRecord(id);
       if(record)
         record->Insert(sortedChunks);
-    }
+    });
   }
 
   RDCDEBUG("%u frame resource chunks", (uint32_t)sortedChunks.size());
@@ -1257,14 +1272,12 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
   float num = float(m_InitialContents.size());
   float idx = 0.0f;
 
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : GetSortedInitialContentIDs())
   {
-    ResourceId id = it->first;
-
     RenderDoc::Inst().SetProgress(CaptureProgress::SerialiseInitialStates, idx / num);
     idx += 1.0f;
 
-    if(m_FrameReferencedResources.find(id) == m_FrameReferencedResources.end() &&
+    if(!m_FrameReferencedResources.contains(id) &&
        !RenderDoc::Inst().GetCaptureOptions().refAllResources)
     {
 #if ENABLED(VERBOSE_DIRTY_RESOURCES)
@@ -1301,24 +1314,26 @@ void ResourceManager<Configuration>::InsertInitialContentsChunks(WriteSerialiser
 
     dirty++;
 
-    if(!Need_InitialStateChunk(id, it->second.data))
+    InitialContentDataOrChunk &contents = m_InitialContents[id];
+
+    if(!Need_InitialStateChunk(id, contents.data))
     {
       // this was handled in ApplyInitialContentsNonChunks(), do nothing as there's no point copying
       // the data again (it's already been serialised).
       continue;
     }
 
-    if(it->second.chunk)
+    if(contents.chunk)
     {
-      it->second.chunk->Write(ser);
+      contents.chunk->Write(ser);
     }
     else
     {
-      uint64_t size = GetSize_InitialState(id, it->second.data);
+      uint64_t size = GetSize_InitialState(id, contents.data);
 
       SCOPED_SERIALISE_CHUNK(SystemChunk::InitialContents, size);
 
-      Serialise_InitialState(ser, id, record, &it->second.data);
+      Serialise_InitialState(ser, id, record, &contents.data);
     }
 
     // Reset back to empty contents, unloading the actual resource.
@@ -1333,11 +1348,9 @@ void ResourceManager<Configuration>::ApplyInitialContentsNonChunks(WriteSerialis
 {
   SCOPED_LOCK(m_Lock);
 
-  for(auto it = m_InitialContents.begin(); it != m_InitialContents.end(); ++it)
+  for(ResourceId id : GetSortedInitialContentIDs())
   {
-    ResourceId id = it->first;
-
-    if(m_FrameReferencedResources.find(id) == m_FrameReferencedResources.end() &&
+    if(!m_FrameReferencedResources.contains(id) &&
        !RenderDoc::Inst().GetCaptureOptions().refAllResources)
     {
       continue;
@@ -1348,8 +1361,10 @@ void ResourceManager<Configuration>::ApplyInitialContentsNonChunks(WriteSerialis
     if(!record || record->InternalResource)
       continue;
 
-    if(!Need_InitialStateChunk(id, it->second.data))
-      Serialise_InitialState(ser, id, record, &it->second.data);
+    InitialContentDataOrChunk &contents = m_InitialContents[id];
+
+    if(!Need_InitialStateChunk(id, contents.data))
+      Serialise_InitialState(ser, id, record, &contents.data);
   }
 }
 
@@ -1358,17 +1373,16 @@ void ResourceManager<Configuration>::ClearReferencedResources()
 {
   SCOPED_LOCK(m_Lock);
 
-  for(auto it = m_FrameReferencedResources.begin(); it != m_FrameReferencedResources.end(); ++it)
-  {
-    RecordType *record = GetResourceRecord(it->first);
+  m_FrameReferencedResources.ForEach([this](ResourceId id, FrameRefType ref) {
+    RecordType *record = GetResourceRecord(id);
 
     if(record)
     {
-      if(IncludesWrite(it->second))
-        MarkDirtyResource(it->first);
+      if(IncludesWrite(ref))
+        MarkDirtyResource(id);
       record->Delete(this);
     }
-  }
+  });
 
   m_FrameReferencedResources.clear();
 }
@@ -1410,11 +1424,12 @@ void ResourceManager<Configuration>::RemoveReplacement(ResourceId id)
 template <typename Configuration>
 typename Configuration::RecordType *ResourceManager<Configuration>::GetResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
+  auto &shard = m_ResourceRecords.GetShard(id);
+  SCOPED_LOCK(shard.lock);
 
-  auto it = m_ResourceRecords.find(id);
+  auto it = shard.map.find(id);
 
-  if(it == m_ResourceRecords.end())
+  if(it == shard.map.end())
     return NULL;
 
   return it->second;
@@ -1423,34 +1438,29 @@ typename Configuration::RecordType *ResourceManager<Configuration>::GetResourceR
 template <typename Configuration>
 bool ResourceManager<Configuration>::HasResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
-
-  auto it = m_ResourceRecords.find(id);
-
-  if(it == m_ResourceRecords.end())
-    return false;
-
-  return true;
+  return m_ResourceRecords.contains(id);
 }
 
 template <typename Configuration>
 typename Configuration::RecordType *ResourceManager<Configuration>::AddResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
+  auto &shard = m_ResourceRecords.GetShard(id);
+  SCOPED_LOCK(shard.lock);
 
-  RDCASSERT(m_ResourceRecords.find(id) == m_ResourceRecords.end(), id);
+  RDCASSERT(shard.map.find(id) == shard.map.end(), id);
 
-  return (m_ResourceRecords[id] = new RecordType(id));
+  return (shard.map[id] = new RecordType(id));
 }
 
 template <typename Configuration>
 void ResourceManager<Configuration>::RemoveResourceRecord(ResourceId id)
 {
-  SCOPED_LOCK(m_Lock);
+  auto &shard = m_ResourceRecords.GetShard(id);
+  SCOPED_LOCK(shard.lock);
 
-  RDCASSERT(m_ResourceRecords.find(id) != m_ResourceRecords.end(), id);
+  RDCASSERT(shard.map.find(id) != shard.map.end(), id);
 
-  m_ResourceRecords.erase(id);
+  shard.map.erase(id);
 }
 
 template <typename Configuration>
@@ -0,0 +1,751 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "shader_debug_trace.h"
+#include "common/common.h"
+#include "zstd/xxhash.h"
+
+static const uint32_t TraceMagic = MAKE_FOURCC('R', 'D', 'S', 'T');
+static const uint32_t TraceVersion = 1;
+
+enum PackedVarFlags
+{
+  PackedVar_DisplayAsHex = 0x1,
+  PackedVar_IsStruct = 0x2,
+  PackedVar_RowMajor = 0x4,
+};
+
+// ShaderValue is a union of 32 32-bit words, which is the granularity values are packed at
+static const uint32_t ValueWords = sizeof(ShaderValue) / sizeof(uint32_t);
+RDCCOMPILE_ASSERT(ValueWords == 32, "Value mask must fit all words of a ShaderValue");
+
+static void WriteVarint(bytebuf &out, uint64_t val)
+{
+  while(val >= 0x80)
+  {
+    out.push_back(byte(val & 0x7f) | 0x80);
+    val >>= 7;
+  }
+  out.push_back(byte(val));
+}
+
+static bool ReadVarint(const byte *&cur, const byte *end, uint64_t &val)
+{
+  val = 0;
+  for(uint32_t shift = 0; shift < 64; shift += 7)
+  {
+    if(cur >= end)
+      return false;
+
+    byte b = *(cur++);
+    val |= uint64_t(b & 0x7f) << shift;
+    if((b & 0x80) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+template <typename T>
+static bool ReadVarint(const byte *&cur, const byte *end, T &val)
+{
+  uint64_t v = 0;
+  if(!ReadVarint(cur, end, v))
+    return false;
+  val = (T)v;
+  return true;
+}
+
+// signed values are zigzag encoded so that small negative numbers stay small
+static void WriteSignedVarint(bytebuf &out, int32_t val)
+{
+  WriteVarint(out, (uint32_t(val) << 1) ^ uint32_t(val >> 31));
+}
+
+static bool ReadSignedVarint(const byte *&cur, const byte *end, int32_t &val)
+{
+  uint32_t v = 0;
+  if(!ReadVarint(cur, end, v))
+    return false;
+  val = int32_t(v >> 1) ^ -int32_t(v & 1);
+  return true;
+}
+
+uint32_t PackedBlobTable::Intern(const bytebuf &blob)
+{
+  uint64_t hash = XXH64(blob.data(), blob.size(), 0);
+
+  auto range = m_Lookup.equal_range(hash);
+  for(auto it = range.first; it != range.second; ++it)
+  {
+    size_t size = 0;
+    const byte *existing = Get(it->second, size);
+    if(size == blob.size() && !memcmp(existing, blob.data(), size))
+      return it->second;
+  }
+
+  uint32_t idx = (uint32_t)m_Offsets.size();
+  m_Offsets.push_back(m_Data.size());
+  m_Data.append(blob);
+  m_Lookup.insert(std::make_pair(hash, idx));
+  return idx;
+}
+
+const byte *PackedBlobTable::Get(uint32_t idx, size_t &size) const
+{
+  if(idx >= m_Offsets.size())
+  {
+    size = 0;
+    return NULL;
+  }
+
+  uint64_t end = idx + 1 < m_Offsets.size() ? m_Offsets[idx + 1] : m_Data.size();
+  size = size_t(end - m_Offsets[idx]);
+  return m_Data.data() + m_Offsets[idx];
+}
+
+uint64_t PackedBlobTable::GetByteSize() const
+{
+  // count the lookup as a hash and index per entry, ignoring the container's own overhead
+  return m_Data.size() + m_Offsets.size() * (sizeof(uint64_t) * 2 + sizeof(uint32_t));
+}
+
+void PackedBlobTable::Write(bytebuf &out) const
+{
+  WriteVarint(out, m_Offsets.size());
+  for(uint32_t i = 0; i < m_Offsets.size(); i++)
+  {
+    size_t size = 0;
+    const byte *blob = Get(i, size);
+    WriteVarint(out, size);
+    out.append(blob, size);
+  }
+}
+
+bool PackedBlobTable::Read(const byte *&cur, const byte *end)
+{
+  m_Data.clear();
+  m_Offsets.clear();
+  m_Lookup.clear();
+
+  uint64_t count = 0;
+  if(!ReadVarint(cur, end, count) || count > uint64_t(end - cur))
+    return false;
+
+  m_Offsets.reserve((size_t)count);
+
+  for(uint64_t i = 0; i < count; i++)
+  {
+    uint64_t size = 0;
+    if(!ReadVarint(cur, end, size) || size > uint64_t(end - cur))
+      return false;
+
+    m_Lookup.insert(std::make_pair(XXH64(cur, (size_t)size, 0), (uint32_t)m_Offsets.size()));
+    m_Offsets.push_back(m_Data.size());
+    m_Data.append(cur, (size_t)size);
+    cur += size;
+  }
+
+  return true;
+}
+
+uint32_t PackedShaderDebugTrace::InternString(const rdcstr &str)
+{
+  bytebuf blob;
+  blob.append((const byte *)str.c_str(), str.size());
+  return m_Strings.Intern(blob);
+}
+
+rdcstr PackedShaderDebugTrace::GetString(uint32_t idx) const
+{
+  size_t size = 0;
+  const byte *str = m_Strings.Get(idx, size);
+  return rdcstr((const char *)str, size);
+}
+
+uint32_t PackedShaderDebugTrace::InternLayout(const ShaderVariable &var)
+{
+  bytebuf blob;
+  WriteVarint(blob, InternString(var.name));
+  WriteVarint(blob, (uint32_t)var.type);
+  blob.push_back(var.rows);
+  blob.push_back(var.columns);
+  blob.push_back(byte((var.displayAsHex ? PackedVar_DisplayAsHex : 0) |
+                      (var.isStruct ? PackedVar_IsStruct : 0) |
+                      (var.rowMajor ? PackedVar_RowMajor : 0)));
+  WriteVarint(blob, var.members.size());
+  for(const ShaderVariable &member : var.members)
+    WriteVarint(blob, InternLayout(member));
+  return m_Layouts.Intern(blob);
+}
+
+void PackedShaderDebugTrace::DecodeLayout(uint32_t idx, ShaderVariable &var) const
+{
+  var = ShaderVariable();
+
+  size_t size = 0;
+  const byte *cur = m_Layouts.Get(idx, size);
+  const byte *end = cur + size;
+
+  uint32_t name = 0, members = 0;
+  if(!ReadVarint(cur, end, name) || !ReadVarint(cur, end, var.type) || end - cur < 3)
+    return;
+
+  var.name = GetString(name);
+  var.rows = cur[0];
+  var.columns = cur[1];
+  var.displayAsHex = (cur[2] & PackedVar_DisplayAsHex) != 0;
+  var.isStruct = (cur[2] & PackedVar_IsStruct) != 0;
+  var.rowMajor = (cur[2] & PackedVar_RowMajor) != 0;
+  cur += 3;
+
+  if(!ReadVarint(cur, end, members) || members > size_t(end - cur))
+    return;
+
+  var.members.resize(members);
+  for(uint32_t m = 0; m < members; m++)
+  {
+    uint32_t memberLayout = 0;
+    if(!ReadVarint(cur, end, memberLayout))
+      return;
+    DecodeLayout(memberLayout, var.members[m]);
+  }
+}
+
+void PackedShaderDebugTrace::EncodeValue(bytebuf &out, const ShaderVariable &var,
+                                         const ShaderVariable *base)
+{
+  uint32_t words[ValueWords];
+  uint32_t baseWords[ValueWords] = {};
+  memcpy(words, &var.value, sizeof(words));
+  if(base)
+    memcpy(baseWords, &base->value, sizeof(baseWords));
+
+  // XOR against the base leaves only the touched words non-zero, and for small changes to a value
+  // only the low bits of those words
+  uint32_t mask = 0;
+  for(uint32_t w = 0; w < ValueWords; w++)
+  {
+    words[w] ^= baseWords[w];
+    if(words[w])
+      mask |= 1U << w;
+  }
+
+  WriteVarint(out, mask);
+  for(uint32_t w = 0; w < ValueWords; w++)
+    if(mask & (1U << w))
+      WriteVarint(out, words[w]);
+
+  for(size_t m = 0; m < var.members.size(); m++)
+    EncodeValue(out, var.members[m], base ? &base->members[m] : NULL);
+}
+
+bool PackedShaderDebugTrace::DecodeValue(const byte *&cur, const byte *end, ShaderVariable &var,
+                                         const ShaderVariable *base) const
+{
+  uint32_t words[ValueWords] = {};
+  if(base)
+    memcpy(words, &base->value, sizeof(words));
+
+  uint32_t mask = 0;
+  if(!ReadVarint(cur, end, mask))
+    return false;
+
+  for(uint32_t w = 0; w < ValueWords; w++)
+  {
+    if(mask & (1U << w))
+    {
+      uint32_t word = 0;
+      if(!ReadVarint(cur, end, word))
+        return false;
+      words[w] ^= word;
+    }
+  }
+
+  memcpy(&var.value, words, sizeof(words));
+
+  for(size_t m = 0; m < var.members.size(); m++)
+    if(!DecodeValue(cur, end, var.members[m], base ? &base->members[m] : NULL))
+      return false;
+
+  return true;
+}
+
+uint32_t PackedShaderDebugTrace::InternSourceVars(const rdcarray<SourceVariableMapping> &sourceVars)
+{
+  if(m_LastSourceVarsIdx != ~0U && sourceVars == m_LastSourceVars)
+    return m_LastSourceVarsIdx;
+
+  bytebuf blob;
+  WriteVarint(blob, sourceVars.size());
+  for(const SourceVariableMapping &mapping : sourceVars)
+  {
+    WriteVarint(blob, InternString(mapping.name));
+    WriteVarint(blob, (uint32_t)mapping.type);
+    WriteVarint(blob, mapping.rows);
+    WriteVarint(blob, mapping.columns);
+    WriteVarint(blob, mapping.offset);
+    WriteSignedVarint(blob, mapping.signatureIndex);
+    WriteVarint(blob, mapping.variables.size());
+    for(const DebugVariableReference &ref : mapping.variables)
+    {
+      WriteVarint(blob, InternString(ref.name));
+      WriteVarint(blob, (uint32_t)ref.type);
+      WriteVarint(blob, ref.component);
+    }
+  }
+
+  m_LastSourceVars = sourceVars;
+  m_LastSourceVarsIdx = m_SourceVars.Intern(blob);
+  return m_LastSourceVarsIdx;
+}
+
+void PackedShaderDebugTrace::DecodeSourceVars(uint32_t idx,
+                                              rdcarray<SourceVariableMapping> &sourceVars) const
+{
+  sourceVars.clear();
+
+  size_t size = 0;
+  const byte *cur = m_SourceVars.Get(idx, size);
+  const byte *end = cur + size;
+
+  uint32_t count = 0;
+  if(!ReadVarint(cur, end, count) || count > size)
+    return;
+
+  sourceVars.resize(count);
+  for(SourceVariableMapping &mapping : sourceVars)
+  {
+    uint32_t name = 0, vars = 0;
+    if(!ReadVarint(cur, end, name) || !ReadVarint(cur, end, mapping.type) ||
+       !ReadVarint(cur, end, mapping.rows) || !ReadVarint(cur, end, mapping.columns) ||
+       !ReadVarint(cur, end, mapping.offset) ||
+       !ReadSignedVarint(cur, end, mapping.signatureIndex) || !ReadVarint(cur, end, vars) ||
+       vars > size)
+      return;
+
+    mapping.name = GetString(name);
+    mapping.variables.resize(vars);
+    for(DebugVariableReference &ref : mapping.variables)
+    {
+      if(!ReadVarint(cur, end, name) || !ReadVarint(cur, end, ref.type) ||
+         !ReadVarint(cur, end, ref.component))
+        return;
+
+      ref.name = GetString(name);
+    }
+  }
+}
+
+uint32_t PackedShaderDebugTrace::InternCallstack(const rdcarray<rdcstr> &callstack)
+{
+  if(m_LastCallstackIdx != ~0U && callstack == m_LastCallstack)
+    return m_LastCallstackIdx;
+
+  bytebuf blob;
+  WriteVarint(blob, callstack.size());
+  for(const rdcstr &func : callstack)
+    WriteVarint(blob, InternString(func));
+
+  m_LastCallstack = callstack;
+  m_LastCallstackIdx = m_Callstacks.Intern(blob);
+  return m_LastCallstackIdx;
+}
+
+void PackedShaderDebugTrace::DecodeCallstack(uint32_t idx, rdcarray<rdcstr> &callstack) const
+{
+  callstack.clear();
+
+  size_t size = 0;
+  const byte *cur = m_Callstacks.Get(idx, size);
+  const byte *end = cur + size;
+
+  uint32_t count = 0;
+  if(!ReadVarint(cur, end, count) || count > size)
+    return;
+
+  callstack.reserve(count);
+  for(uint32_t i = 0; i < count; i++)
+  {
+    uint32_t name = 0;
+    if(!ReadVarint(cur, end, name))
+      return;
+    callstack.push_back(GetString(name));
+  }
+}
+
+void PackedShaderDebugTrace::Append(const ShaderDebugState &state)
+{
+  m_StateOffsets.push_back(m_Data.size());
+
+  WriteVarint(m_Data, state.nextInstruction);
+  WriteVarint(m_Data, state.stepIndex);
+  WriteVarint(m_Data, (uint32_t)state.flags);
+  WriteVarint(m_Data, InternSourceVars(state.sourceVars));
+  WriteVarint(m_Data, InternCallstack(state.callstack));
+
+  WriteVarint(m_Data, state.changes.size());
+  for(const ShaderVariableChange &change : state.changes)
+  {
+    uint32_t before = InternLayout(change.before);
+    uint32_t after = InternLayout(change.after);
+
+    WriteVarint(m_Data, before);
+    WriteVarint(m_Data, after);
+
+    EncodeValue(m_Data, change.before, NULL);
+    // layouts are interned, so matching indices mean the variables have the same shape
+    EncodeValue(m_Data, change.after, before == after ? &change.before : NULL);
+  }
+}
+
+void PackedShaderDebugTrace::Append(const rdcarray<ShaderDebugState> &states)
+{
+  m_StateOffsets.reserve(m_StateOffsets.size() + states.size());
+  for(const ShaderDebugState &state : states)
+    Append(state);
+}
+
+bool PackedShaderDebugTrace::DecodeState(size_t idx, ShaderDebugState &state) const
+{
+  const byte *cur = m_Data.data() + m_StateOffsets[idx];
+  const byte *end =
+      m_Data.data() + (idx + 1 < m_StateOffsets.size() ? m_StateOffsets[idx + 1] : m_Data.size());
+
+  uint32_t sourceVars = 0, callstack = 0, numChanges = 0;
+  if(!ReadVarint(cur, end, state.nextInstruction) || !ReadVarint(cur, end, state.stepIndex) ||
+     !ReadVarint(cur, end, state.flags) || !ReadVarint(cur, end, sourceVars) ||
+     !ReadVarint(cur, end, callstack) || !ReadVarint(cur, end, numChanges) ||
+     numChanges > size_t(end - cur))
+    return false;
+
+  if(sourceVars >= m_SourceVars.Count() || callstack >= m_Callstacks.Count())
+    return false;
+
+  DecodeSourceVars(sourceVars, state.sourceVars);
+  DecodeCallstack(callstack, state.callstack);
+
+  state.changes.resize(numChanges);
+  for(ShaderVariableChange &change : state.changes)
+  {
+    uint32_t before = 0, after = 0;
+    if(!ReadVarint(cur, end, before) || !ReadVarint(cur, end, after) ||
+       before >= m_Layouts.Count() || after >= m_Layouts.Count())
+      return false;
+
+    DecodeLayout(before, change.before);
+    DecodeLayout(after, change.after);
+
+    if(!DecodeValue(cur, end, change.before, NULL) ||
+       !DecodeValue(cur, end, change.after, before == after ? &change.before : NULL))
+      return false;
+  }
+
+  return cur == end;
+}
+
+ShaderDebugState PackedShaderDebugTrace::GetState(size_t idx) const
+{
+  ShaderDebugState ret;
+
+  if(idx >= m_StateOffsets.size())
+  {
+    RDCERR("Invalid state %zu requested from trace with %zu states", idx, m_StateOffsets.size());
+    return ret;
+  }
+
+  if(!DecodeState(idx, ret))
+  {
+    RDCERR("Corrupt packed shader debug state %zu", idx);
+    ret = ShaderDebugState();
+  }
+
+  return ret;
+}
+
+rdcarray<ShaderDebugState> PackedShaderDebugTrace::GetStates(size_t first, size_t count) const
+{
+  rdcarray<ShaderDebugState> ret;
+
+  if(first >= m_StateOffsets.size())
+    return ret;
+
+  count = RDCMIN(count, m_StateOffsets.size() - first);
+
+  ret.resize(count);
+  for(size_t i = 0; i < count; i++)
+  {
+    if(!DecodeState(first + i, ret[i]))
+    {
+      RDCERR("Corrupt packed shader debug state %zu", first + i);
+      ret[i] = ShaderDebugState();
+    }
+  }
+
+  return ret;
+}
+
+uint64_t PackedShaderDebugTrace::GetByteSize() const
+{
+  return m_Strings.GetByteSize() + m_Layouts.GetByteSize() + m_SourceVars.GetByteSize() +
+         m_Callstacks.GetByteSize() + m_Data.size() + m_StateOffsets.size() * sizeof(uint64_t);
+}
+
+void PackedShaderDebugTrace::Write(bytebuf &out) const
+{
+  out.clear();
+  out.append((const byte *)&TraceMagic, sizeof(TraceMagic));
+  out.append((const byte *)&TraceVersion, sizeof(TraceVersion));
+
+  m_Strings.Write(out);
+  m_Layouts.Write(out);
+  m_SourceVars.Write(out);
+  m_Callstacks.Write(out);
+
+  // the index is stored as the length of each state, and the offsets are rebuilt on read
+  WriteVarint(out, m_StateOffsets.size());
+  for(size_t i = 0; i < m_StateOffsets.size(); i++)
+  {
+    uint64_t end = i + 1 < m_StateOffsets.size() ? m_StateOffsets[i + 1] : m_Data.size();
+    WriteVarint(out, end - m_StateOffsets[i]);
+  }
+
+  out.append(m_Data);
+}
+
+bool PackedShaderDebugTrace::Read(const bytebuf &in)
+{
+  *this = PackedShaderDebugTrace();
+
+  const byte *cur = in.data();
+  const byte *end = in.data() + in.size();
+
+  uint32_t header[2] = {};
+  if(in.size() < sizeof(header))
+    return false;
+
+  memcpy(header, cur, sizeof(header));
+  cur += sizeof(header);
+
+  if(header[0] != TraceMagic || header[1] != TraceVersion)
+  {
+    RDCERR("Unrecognised packed shader debug trace, magic %08x version %u", header[0], header[1]);
+    return false;
+  }
+
+  uint64_t count = 0;
+  if(!m_Strings.Read(cur, end) || !m_Layouts.Read(cur, end) || !m_SourceVars.Read(cur, end) ||
+     !m_Callstacks.Read(cur, end) || !ReadVarint(cur, end, count) || count > uint64_t(end - cur))
+  {
+    RDCERR("Truncated packed shader debug trace");
+    *this = PackedShaderDebugTrace();
+    return false;
+  }
+
+  m_StateOffsets.resize((size_t)count);
+
+  uint64_t offset = 0;
+  for(uint64_t i = 0; i < count; i++)
+  {
+    uint64_t size = 0;
+    if(!ReadVarint(cur, end, size))
+    {
+      RDCERR("Truncated packed shader debug trace");
+      *this = PackedShaderDebugTrace();
+      return false;
+    }
+
+    m_StateOffsets[(size_t)i] = offset;
+    offset += size;
+  }
+
+  if(offset != uint64_t(end - cur))
+  {
+    RDCERR("Packed shader debug trace has %llu bytes of states, expected %llu",
+           uint64_t(end - cur), offset);
+    *this = PackedShaderDebugTrace();
+    return false;
+  }
+
+  m_Data.assign(cur, (size_t)offset);
+
+  return true;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static rdcarray<ShaderDebugState> MakeTestStates()
+{
+  rdcarray<ShaderDebugState> states;
+
+  ShaderVariable counter("_12", 0U, 0U, 0U, 0U);
+  counter.columns = 1;
+
+  ShaderVariable colour("_15", 0.25f, 0.5f, -1.0f, 1.0f);
+
+  ShaderVariable block;
+  block.name = "_20";
+  block.isStruct = true;
+  block.members = {ShaderVariable("a", 1, -2, 3, -4), ShaderVariable("b", 1.5f, 0.0f, 0.0f, 0.0f)};
+  block.members[1].rowMajor = true;
+  block.members[1].displayAsHex = true;
+
+  SourceVariableMapping mapping;
+  mapping.name = "counter";
+  mapping.type = VarType::UInt;
+  mapping.rows = 1;
+  mapping.columns = 1;
+  mapping.offset = 0;
+  mapping.signatureIndex = -1;
+  mapping.variables = {DebugVariableReference(DebugVariableType::Variable, "_12", 0)};
+
+  // the first state creates the variables, changing from nothing
+  {
+    ShaderDebugState state;
+    state.flags = ShaderEvents::SampleLoadGather;
+    state.nextInstruction = 4;
+    state.changes.push_back({ShaderVariable(), counter});
+    state.changes.push_back({ShaderVariable(), colour});
+    state.changes.push_back({ShaderVariable(), block});
+    state.callstack = {"main"};
+    states.push_back(state);
+  }
+
+  for(uint32_t i = 1; i < 50; i++)
+  {
+    ShaderDebugState state;
+    state.stepIndex = i;
+    state.nextInstruction = 5 + (i % 7);
+    state.sourceVars = {mapping};
+    state.callstack = {"main"};
+    if(i % 10 >= 5)
+      state.callstack.push_back("helper(f1;");
+
+    ShaderVariableChange change;
+    change.before = counter;
+    counter.value.u.x += i;
+    change.after = counter;
+    state.changes.push_back(change);
+
+    if(i % 3 == 0)
+    {
+      change.before = block;
+      block.members[0].value.i.y -= 1000 * i;
+      block.members[1].value.f.x *= -1.5f;
+      change.after = block;
+      state.changes.push_back(change);
+    }
+
+    states.push_back(state);
+  }
+
+  // the last state kills a variable, changing to nothing
+  {
+    ShaderDebugState state;
+    state.stepIndex = 50;
+    state.flags = ShaderEvents::GeneratedNanOrInf;
+    state.changes.push_back({colour, ShaderVariable()});
+    states.push_back(state);
+  }
+
+  return states;
+}
+
+TEST_CASE("Test packed shader debug traces", "[shaderdebug]")
+{
+  rdcarray<ShaderDebugState> states = MakeTestStates();
+
+  PackedShaderDebugTrace trace;
+  trace.Append(states);
+
+  REQUIRE(trace.GetNumStates() == states.size());
+
+  SECTION("States unpack identically")
+  {
+    rdcarray<ShaderDebugState> unpacked = trace.GetStates(0, trace.GetNumStates());
+
+    REQUIRE(unpacked.size() == states.size());
+    for(size_t i = 0; i < states.size(); i++)
+    {
+      CHECK((unpacked[i] == states[i]));
+      CHECK(unpacked[i].callstack == states[i].callstack);
+    }
+  };
+
+  SECTION("States can be read in any order")
+  {
+    for(size_t i : {size_t(33), size_t(0), states.size() - 1, size_t(12)})
+      CHECK((trace.GetState(i) == states[i]));
+
+    CHECK(trace.GetStates(45, 100).size() == states.size() - 45);
+    CHECK(trace.GetStates(states.size(), 10).empty());
+  };
+
+  SECTION("Appending states keeps the existing ones")
+  {
+    trace.Append(states);
+
+    REQUIRE(trace.GetNumStates() == states.size() * 2);
+    CHECK((trace.GetState(states.size() + 3) == states[3]));
+    CHECK((trace.GetState(3) == states[3]));
+  };
+
+  SECTION("Written traces read back")
+  {
+    bytebuf packed;
+    trace.Write(packed);
+
+    PackedShaderDebugTrace readback;
+    REQUIRE(readback.Read(packed));
+    REQUIRE(readback.GetNumStates() == states.size());
+    CHECK((readback.GetStates(0, states.size()) == states));
+
+    // the tables are rebuilt on read, so appending still interns against them
+    readback.Append(states[7]);
+    CHECK((readback.GetState(states.size()) == states[7]));
+  };
+
+  SECTION("Damaged traces are rejected")
+  {
+    bytebuf packed;
+    trace.Write(packed);
+
+    PackedShaderDebugTrace readback;
+
+    bytebuf truncated;
+    truncated.assign(packed.data(), packed.size() - 3);
+    CHECK_FALSE(readback.Read(truncated));
+    CHECK(readback.GetNumStates() == 0);
+
+    bytebuf badMagic = packed;
+    badMagic[0] ^= 0xff;
+    CHECK_FALSE(readback.Read(badMagic));
+
+    CHECK_FALSE(readback.Read(bytebuf()));
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -0,0 +1,113 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <unordered_map>
+#include "api/replay/shader_types.h"
+
+// a list of byte strings where identical entries are stored once. Entries are looked up by hash
+// and then compared, so an entry's index is stable once it's been added.
+class PackedBlobTable
+{
+public:
+  uint32_t Intern(const bytebuf &blob);
+
+  size_t Count() const { return m_Offsets.size(); }
+  const byte *Get(uint32_t idx, size_t &size) const;
+
+  uint64_t GetByteSize() const;
+
+  void Write(bytebuf &out) const;
+  bool Read(const byte *&cur, const byte *end);
+
+private:
+  bytebuf m_Data;
+  rdcarray<uint64_t> m_Offsets;
+  std::unordered_multimap<uint64_t, uint32_t> m_Lookup;
+};
+
+// a compact store for a sequence of shader debugging states.
+//
+// Each variable is split into its layout - the name, type, dimensions and members - which is
+// interned in a table, and its value. Values only store the 32-bit words that are non-zero as
+// varints, and the after value in a change is stored as an XOR against the before value when
+// their layouts match, so only the components the step actually touched take any space. Source
+// variable mappings and callstacks are interned whole since they rarely change between steps.
+//
+// Every state is encoded independently of the ones before it and its offset is kept, so any state
+// can be decoded directly without decoding the rest of the trace.
+//
+// ContinueDebug sends its states over the replay proxy in this form, and ReplayController keeps
+// the states from AdvanceDebug packed so that GetDebugStates can seek to any step.
+class PackedShaderDebugTrace
+{
+public:
+  void Append(const ShaderDebugState &state);
+  void Append(const rdcarray<ShaderDebugState> &states);
+
+  size_t GetNumStates() const { return m_StateOffsets.size(); }
+  ShaderDebugState GetState(size_t idx) const;
+  rdcarray<ShaderDebugState> GetStates(size_t first, size_t count) const;
+
+  // the memory used by the packed trace, including all tables and the index
+  uint64_t GetByteSize() const;
+
+  void Write(bytebuf &out) const;
+  bool Read(const bytebuf &in);
+
+private:
+  uint32_t InternString(const rdcstr &str);
+  rdcstr GetString(uint32_t idx) const;
+
+  uint32_t InternLayout(const ShaderVariable &var);
+  void DecodeLayout(uint32_t idx, ShaderVariable &var) const;
+
+  void EncodeValue(bytebuf &out, const ShaderVariable &var, const ShaderVariable *base);
+  bool DecodeValue(const byte *&cur, const byte *end, ShaderVariable &var,
+                   const ShaderVariable *base) const;
+
+  uint32_t InternSourceVars(const rdcarray<SourceVariableMapping> &sourceVars);
+  void DecodeSourceVars(uint32_t idx, rdcarray<SourceVariableMapping> &sourceVars) const;
+
+  uint32_t InternCallstack(const rdcarray<rdcstr> &callstack);
+  void DecodeCallstack(uint32_t idx, rdcarray<rdcstr> &callstack) const;
+
+  bool DecodeState(size_t idx, ShaderDebugState &state) const;
+
+  PackedBlobTable m_Strings;
+  PackedBlobTable m_Layouts;
+  PackedBlobTable m_SourceVars;
+  PackedBlobTable m_Callstacks;
+
+  // consecutive states almost always share their source mappings and callstack, so remember the
+  // last ones interned to skip hashing them again
+  rdcarray<SourceVariableMapping> m_LastSourceVars;
+  uint32_t m_LastSourceVarsIdx = ~0U;
+  rdcarray<rdcstr> m_LastCallstack;
+  uint32_t m_LastCallstackIdx = ~0U;
+
+  bytebuf m_Data;
+  rdcarray<uint64_t> m_StateOffsets;
+};
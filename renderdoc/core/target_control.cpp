@@ -26,6 +26,7 @@
 #include "android/android.h"
 #include "api/replay/renderdoc_replay.h"
 #include "common/threading.h"
+#include "common/timing.h"
 #include "core/core.h"
 #include "jpeg-compressor/jpgd.h"
 #include "os/os_specific.h"
@@ -145,7 +146,8 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
   const int pingtime = 1000;       // ping every 1000ms
   const int ticktime = 10;         // tick every 10ms
   const int progresstime = 100;    // update capture progress every 100ms
-  int curtime = 0;
+  double curtime = 0.0;
+  PerformanceTimer tickTimer;
 
   rdcarray<CaptureData> captures;
   rdcarray<rdcpair<uint32_t, uint32_t> > children;
@@ -161,8 +163,12 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
       break;
     }
 
-    Threading::Sleep(ticktime);
-    curtime += ticktime;
+    // wake up early if the client sends us something, rather than sleeping through the tick
+    client->WaitForRecv(ticktime);
+
+    // count the time that actually passed, since we may have woken early
+    curtime += tickTimer.GetMilliseconds();
+    tickTimer.Restart();
 
     std::map<RDCDriver, bool> curdrivers = RenderDoc::Inst().GetActiveDrivers();
 
@@ -204,7 +210,8 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
         SERIALISE_ELEMENT(supported);
       }
     }
-    else if(caps.size() != captures.size())
+    else if(caps.size() != captures.size() &&
+            RenderDoc::Inst().IsCaptureWritten(caps[captures.size()].path))
     {
       uint32_t idx = (uint32_t)captures.size();
 
@@ -265,7 +272,7 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
       // we don't need to ping while we're sending capture progress, so we re-use curtime
       if(captureProgress == -1.0f || curtime > progresstime)
       {
-        curtime = 0;
+        curtime = 0.0;
 
         prevCaptureProgress = captureProgress;
 
@@ -293,7 +300,7 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
       {
         SCOPED_SERIALISE_CHUNK(ePacket_Noop);
       }
-      curtime = 0;
+      curtime = 0.0;
     }
 
     if(writer.IsErrored())
@@ -356,6 +363,9 @@ void RenderDoc::TargetControlClientThread(uint32_t version, Network::Socket *cli
 
           rdcstr filename = caps[id].path;
 
+          // the capture may still be being written in the background
+          RenderDoc::Inst().FlushCaptureWriting();
+
           StreamReader fileStream(FileIO::fopen(filename.c_str(), "rb"));
           ser.SerialiseStream(filename, fileStream);
 
@@ -402,7 +412,7 @@ void RenderDoc::TargetControlServerThread(Network::Socket *sock)
 
   while(!RenderDoc::Inst().m_TargetControlThreadShutdown)
   {
-    Network::Socket *client = sock->AcceptClient(0);
+    Network::Socket *client = sock->AcceptClient(5);
 
     if(client == NULL)
     {
@@ -415,8 +425,6 @@ void RenderDoc::TargetControlServerThread(Network::Socket *sock)
         return;
       }
 
-      Threading::Sleep(5);
-
       continue;
     }
 
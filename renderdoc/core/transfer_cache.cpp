@@ -0,0 +1,509 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "transfer_cache.h"
+#include <algorithm>
+#include "api/replay/data_types.h"
+#include "common/formatting.h"
+#include "zstd/xxhash.h"
+
+// a chunk is cut wherever the top 13 bits of the rolling hash are all zero, giving an 8kB average
+// chunk length on top of the minimum
+static const uint64_t TransferChunkCutMask = 0xFFF8000000000000ULL;
+
+static const uint32_t PackMagic = MAKE_FOURCC('R', 'D', 'T', 'C');
+static const uint32_t PackVersion = 1;
+
+// each indexed pack keeps a file open, so that it stays readable if another process evicts it
+// while we're using it. Limit how many there can be.
+static const size_t MaxPacks = 64;
+
+struct PackHeader
+{
+  uint32_t magic;
+  uint32_t version;
+};
+
+// precedes each chunk's data in a pack file
+struct PackRecord
+{
+  uint64_t hash;
+  uint32_t size;
+  uint32_t padding;
+};
+
+static const uint64_t *GetGearTable()
+{
+  static uint64_t gear[256] = {};
+
+  static bool init = []() {
+    // fixed seed, since both sides of a connection and every session must cut chunks identically
+    uint64_t state = 0x52656e646572446fULL;
+    for(size_t i = 0; i < 256; i++)
+    {
+      // splitmix64
+      uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      gear[i] = z ^ (z >> 31);
+    }
+    return true;
+  }();
+  (void)init;
+
+  return gear;
+}
+
+uint64_t HashTransferChunk(const byte *data, size_t size)
+{
+  return XXH64(data, size, 0);
+}
+
+void SplitTransferChunks(const byte *data, size_t size, rdcarray<TransferChunk> &chunks)
+{
+  chunks.clear();
+
+  const uint64_t *gear = GetGearTable();
+
+  size_t offset = 0;
+  while(offset < size)
+  {
+    const byte *chunk = data + offset;
+    const size_t remain = size - offset;
+    size_t length = remain;
+
+    if(remain > TransferChunkMinSize)
+    {
+      // gear hash - each byte shifts the previous state up by one, so the top bits depend only on
+      // the last 64 bytes and the cut points move with the data.
+      const size_t end = RDCMIN(remain, TransferChunkMaxSize);
+      length = end;
+
+      uint64_t h = 0;
+      for(size_t i = TransferChunkMinSize; i < end; i++)
+      {
+        h = (h << 1) + gear[chunk[i]];
+        if((h & TransferChunkCutMask) == 0)
+        {
+          length = i + 1;
+          break;
+        }
+      }
+    }
+
+    chunks.push_back({HashTransferChunk(chunk, length), offset, length});
+    offset += length;
+  }
+}
+
+TransferChunkStore::TransferChunkStore(const rdcstr &dir, uint64_t maxSize) : m_Dir(dir)
+{
+  rdcarray<PathEntry> files;
+  FileIO::GetFilesInDirectory(m_Dir.c_str(), files);
+
+  rdcarray<PathEntry> packs;
+  uint64_t totalSize = 0;
+
+  for(const PathEntry &f : files)
+  {
+    if(f.flags & (PathProperty::Directory | PathProperty::ErrorUnknown |
+                  PathProperty::ErrorAccessDenied | PathProperty::ErrorInvalidPath))
+      continue;
+
+    if(f.filename.endsWith(".pack"))
+    {
+      packs.push_back(f);
+      totalSize += f.size;
+    }
+  }
+
+  // packs from the same second are ordered by the counter in their name
+  std::sort(packs.begin(), packs.end(), [](const PathEntry &a, const PathEntry &b) {
+    if(a.lastmod != b.lastmod)
+      return a.lastmod < b.lastmod;
+    return a.filename < b.filename;
+  });
+
+  // evict the oldest packs until we're within the limits
+  size_t firstPack = 0;
+  while(firstPack < packs.size() && (totalSize > maxSize || packs.size() - firstPack > MaxPacks))
+  {
+    FileIO::Delete((m_Dir + "/" + packs[firstPack].filename).c_str());
+    totalSize -= packs[firstPack].size;
+    firstPack++;
+  }
+
+  for(size_t i = firstPack; i < packs.size(); i++)
+  {
+    m_PackPaths.push_back(m_Dir + "/" + packs[i].filename);
+    m_PackReaders.push_back(NULL);
+    IndexPack(uint32_t(m_PackPaths.size() - 1));
+  }
+
+  RDCLOG("Opened transfer cache in %s with %zu chunks in %zu packs", m_Dir.c_str(), m_Chunks.size(),
+         m_PackPaths.size());
+}
+
+TransferChunkStore::~TransferChunkStore()
+{
+  if(m_WritePack)
+    FileIO::fclose(m_WritePack);
+
+  for(FILE *f : m_PackReaders)
+    if(f)
+      FileIO::fclose(f);
+}
+
+void TransferChunkStore::IndexPack(uint32_t pack)
+{
+  FILE *f = GetPackReader(pack);
+
+  if(!f)
+    return;
+
+  const uint64_t fileSize = FileIO::GetFileSize(m_PackPaths[pack]);
+
+  PackHeader header = {};
+  FileIO::fread(&header, sizeof(header), 1, f);
+
+  if(header.magic != PackMagic || header.version != PackVersion)
+  {
+    RDCWARN("Ignoring unrecognised transfer cache pack %s", m_PackPaths[pack].c_str());
+    return;
+  }
+
+  uint64_t offset = sizeof(header);
+
+  while(offset + sizeof(PackRecord) <= fileSize)
+  {
+    PackRecord record = {};
+    FileIO::fseek64(f, offset, SEEK_SET);
+    if(FileIO::fread(&record, sizeof(record), 1, f) != 1)
+      break;
+
+    offset += sizeof(record);
+
+    // the last record may be truncated if a previous session was interrupted
+    if(offset + record.size > fileSize)
+      break;
+
+    m_Chunks.insert(std::make_pair(record.hash, ChunkLocation({pack, record.size, offset})));
+
+    offset += record.size;
+  }
+}
+
+FILE *TransferChunkStore::GetPackReader(uint32_t pack)
+{
+  if(m_PackReaders[pack] == NULL)
+    m_PackReaders[pack] = FileIO::fopen(m_PackPaths[pack].c_str(), "rb");
+
+  return m_PackReaders[pack];
+}
+
+rdcarray<uint64_t> TransferChunkStore::GetChunkHashes() const
+{
+  rdcarray<uint64_t> ret;
+  ret.reserve(m_Chunks.size() + m_MemoryChunks.size());
+  for(auto it = m_Chunks.begin(); it != m_Chunks.end(); ++it)
+    ret.push_back(it->first);
+  for(auto it = m_MemoryChunks.begin(); it != m_MemoryChunks.end(); ++it)
+    ret.push_back(it->first);
+  return ret;
+}
+
+void TransferChunkStore::AddChunk(uint64_t hash, const byte *data, size_t size)
+{
+  m_Stats.chunksReceived++;
+  m_Stats.bytesReceived += size;
+
+  if(HasChunk(hash))
+    return;
+
+  if(m_WritePack == NULL && !m_WritePackFailed)
+  {
+    // packs are named by creation time, with a counter to keep them unique
+    rdcstr path;
+    for(uint32_t i = 0; path.empty() || FileIO::exists(path.c_str()); i++)
+      path = StringFormat::Fmt("%s/%llu_%u_%u.pack", m_Dir.c_str(), Timing::GetUnixTimestamp(),
+                               Process::GetCurrentPID(), i);
+
+    FileIO::CreateParentDirectory(path);
+
+    m_WritePack = FileIO::fopen(path.c_str(), "wb");
+
+    if(m_WritePack)
+    {
+      PackHeader header = {PackMagic, PackVersion};
+      FileIO::fwrite(&header, sizeof(header), 1, m_WritePack);
+
+      m_WritePackIndex = (uint32_t)m_PackPaths.size();
+      m_PackPaths.push_back(path);
+      m_PackReaders.push_back(NULL);
+    }
+    else
+    {
+      RDCWARN("Couldn't create transfer cache pack %s, chunks will only be kept in memory",
+              path.c_str());
+      m_WritePackFailed = true;
+    }
+  }
+
+  if(m_WritePack)
+  {
+    PackRecord record = {hash, (uint32_t)size, 0};
+
+    uint64_t offset = FileIO::ftell64(m_WritePack) + sizeof(record);
+
+    if(FileIO::fwrite(&record, sizeof(record), 1, m_WritePack) == 1 &&
+       FileIO::fwrite(data, 1, size, m_WritePack) == size)
+    {
+      m_Chunks[hash] = {m_WritePackIndex, (uint32_t)size, offset};
+      m_WritePackDirty = true;
+      return;
+    }
+  }
+
+  // the remote server now assumes we have this chunk, so if it can't go to disk it must be kept in
+  // memory for the rest of the session
+  m_MemoryChunks[hash] = bytebuf(data, size);
+}
+
+bool TransferChunkStore::ReadChunk(uint64_t hash, byte *data, size_t size)
+{
+  auto memit = m_MemoryChunks.find(hash);
+  if(memit != m_MemoryChunks.end())
+  {
+    if(memit->second.size() != size)
+      return false;
+
+    memcpy(data, memit->second.data(), size);
+    m_Stats.chunksReused++;
+    m_Stats.bytesReused += size;
+    return true;
+  }
+
+  auto it = m_Chunks.find(hash);
+  if(it == m_Chunks.end() || it->second.size != size)
+    return false;
+
+  const ChunkLocation loc = it->second;
+
+  if(loc.pack == m_WritePackIndex && m_WritePackDirty)
+  {
+    FileIO::fflush(m_WritePack);
+    m_WritePackDirty = false;
+  }
+
+  FILE *f = GetPackReader(loc.pack);
+  if(!f)
+    return false;
+
+  FileIO::fseek64(f, loc.offset, SEEK_SET);
+  if(FileIO::fread(data, 1, size, f) != size || HashTransferChunk(data, size) != hash)
+  {
+    RDCWARN("Transfer cache chunk %016llx is missing or corrupted in %s", hash,
+            m_PackPaths[loc.pack].c_str());
+    m_Chunks.erase(it);
+    return false;
+  }
+
+  m_Stats.chunksReused++;
+  m_Stats.bytesReused += size;
+  return true;
+}
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+static bytebuf RandomBytes(size_t size, uint32_t seed)
+{
+  bytebuf ret;
+  ret.resize(size);
+  uint32_t state = seed;
+  for(size_t i = 0; i < size; i++)
+  {
+    state = state * 1664525U + 1013904223U;
+    ret[i] = byte(state >> 24);
+  }
+  return ret;
+}
+
+static void ClearStoreDir(const rdcstr &dir)
+{
+  rdcarray<PathEntry> files;
+  FileIO::GetFilesInDirectory(dir.c_str(), files);
+  for(const PathEntry &f : files)
+    if(f.filename.endsWith(".pack"))
+      FileIO::Delete((dir + "/" + f.filename).c_str());
+}
+
+TEST_CASE("Test content-defined transfer chunking", "[transfercache]")
+{
+  bytebuf data = RandomBytes(1024 * 1024, 1234);
+
+  rdcarray<TransferChunk> chunks;
+  SplitTransferChunks(data.data(), data.size(), chunks);
+
+  SECTION("Chunks cover the data within the size limits")
+  {
+    REQUIRE(!chunks.empty());
+
+    size_t offset = 0;
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+      CHECK(chunks[i].offset == offset);
+      CHECK(chunks[i].length <= TransferChunkMaxSize);
+      if(i + 1 < chunks.size())
+        CHECK(chunks[i].length >= TransferChunkMinSize);
+      CHECK(chunks[i].hash == HashTransferChunk(data.data() + chunks[i].offset, chunks[i].length));
+      offset += chunks[i].length;
+    }
+
+    CHECK(offset == data.size());
+
+    // the average size is around 8kB, well away from both limits
+    CHECK(chunks.size() > 64);
+    CHECK(chunks.size() < 256);
+  };
+
+  SECTION("Chunks are found again after the data moves")
+  {
+    // insert some bytes at the start, which shifts everything after it
+    bytebuf shifted = RandomBytes(1000, 5678);
+    shifted.append(data);
+
+    rdcarray<TransferChunk> shiftedChunks;
+    SplitTransferChunks(shifted.data(), shifted.size(), shiftedChunks);
+
+    std::unordered_map<uint64_t, size_t> hashes;
+    for(const TransferChunk &c : chunks)
+      hashes[c.hash] = c.length;
+
+    size_t matchedBytes = 0;
+    for(const TransferChunk &c : shiftedChunks)
+      if(hashes.find(c.hash) != hashes.end())
+        matchedBytes += c.length;
+
+    // only the first chunk or two should differ
+    CHECK(matchedBytes > data.size() - TransferChunkMaxSize * 2);
+  };
+
+  SECTION("Small and empty data")
+  {
+    SplitTransferChunks(data.data(), 100, chunks);
+    REQUIRE(chunks.size() == 1);
+    CHECK(chunks[0].length == 100);
+
+    SplitTransferChunks(data.data(), 0, chunks);
+    CHECK(chunks.empty());
+  };
+}
+
+TEST_CASE("Test transfer chunk store", "[transfercache]")
+{
+  rdcstr dir = FileIO::GetTempFolderFilename() + "renderdoc_transfer_cache_tests";
+  ClearStoreDir(dir);
+
+  bytebuf data = RandomBytes(256 * 1024, 42);
+
+  rdcarray<TransferChunk> chunks;
+  SplitTransferChunks(data.data(), data.size(), chunks);
+
+  {
+    TransferChunkStore store(dir, 1024 * 1024);
+
+    CHECK(store.GetChunkHashes().empty());
+
+    for(const TransferChunk &c : chunks)
+      store.AddChunk(c.hash, data.data() + c.offset, c.length);
+
+    CHECK(store.GetStats().chunksReceived == chunks.size());
+    CHECK(store.GetStats().bytesReceived == data.size());
+
+    // chunks can be read back in the same session they're added
+    bytebuf readback;
+    readback.resize(data.size());
+    for(const TransferChunk &c : chunks)
+      CHECK(store.ReadChunk(c.hash, readback.data() + c.offset, c.length));
+
+    CHECK(readback == data);
+    CHECK(store.GetStats().bytesReused == data.size());
+
+    // unknown chunks, or the wrong size, fail
+    CHECK_FALSE(store.ReadChunk(chunks[0].hash ^ 1, readback.data(), chunks[0].length));
+    CHECK_FALSE(store.ReadChunk(chunks[0].hash, readback.data(), chunks[0].length + 1));
+  }
+
+  SECTION("Chunks persist to the next session")
+  {
+    TransferChunkStore store(dir, 1024 * 1024);
+
+    CHECK(store.GetChunkHashes().size() == chunks.size());
+
+    bytebuf readback;
+    readback.resize(data.size());
+    for(const TransferChunk &c : chunks)
+    {
+      CHECK(store.HasChunk(c.hash));
+      CHECK(store.ReadChunk(c.hash, readback.data() + c.offset, c.length));
+    }
+
+    CHECK(readback == data);
+    CHECK(store.GetStats().chunksReceived == 0);
+  };
+
+  SECTION("Old packs are evicted once over the size limit")
+  {
+    {
+      // a second session adds a second pack
+      bytebuf data2 = RandomBytes(256 * 1024, 43);
+
+      TransferChunkStore store(dir, 1024 * 1024);
+      store.AddChunk(HashTransferChunk(data2.data(), 4096), data2.data(), 4096);
+    }
+
+    // with room for only one pack, the older first pack is deleted
+    TransferChunkStore store(dir, 64 * 1024);
+
+    CHECK(store.GetChunkHashes().size() == 1);
+    CHECK_FALSE(store.HasChunk(chunks[0].hash));
+  };
+
+  ClearStoreDir(dir);
+}
+
+TEST_CASE("Benchmark content-defined transfer chunking", "[.][benchmark]")
+{
+  bytebuf data = RandomBytes(64 * 1024 * 1024, 99);
+
+  rdcarray<TransferChunk> chunks;
+
+  BENCHMARK("Split 64MB") { SplitTransferChunks(data.data(), data.size(), chunks); }
+
+  WARN(chunks.size() << " chunks");
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
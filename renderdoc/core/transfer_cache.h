@@ -0,0 +1,110 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include <unordered_map>
+#include "api/replay/rdcstr.h"
+#include "common/common.h"
+#include "os/os_specific.h"
+
+// a piece of a resource's contents. Chunks are cut at points picked by the data itself rather than
+// at fixed offsets, so an identical run of data is cut into identical chunks wherever it sits in a
+// resource, and can be recognised by its hash.
+struct TransferChunk
+{
+  uint64_t hash;
+  size_t offset;
+  size_t length;
+};
+
+static const size_t TransferChunkMinSize = 2 * 1024;
+static const size_t TransferChunkMaxSize = 64 * 1024;
+
+uint64_t HashTransferChunk(const byte *data, size_t size);
+
+// splits data into content-defined chunks, between TransferChunkMinSize and TransferChunkMaxSize
+// bytes long and around 8kB on average. The final chunk may be smaller than the minimum.
+void SplitTransferChunks(const byte *data, size_t size, rdcarray<TransferChunk> &chunks);
+
+struct TransferCacheStats
+{
+  uint64_t chunksReceived = 0;
+  uint64_t bytesReceived = 0;
+  uint64_t chunksReused = 0;
+  uint64_t bytesReused = 0;
+};
+
+// the client side store of chunks received from a remote server. It's kept on disk so that chunks
+// can be reused across connections as well as within one. Chunks from each session are appended to
+// a new pack file, and when the store is opened the oldest packs are deleted until it fits within
+// its size limit.
+class TransferChunkStore
+{
+public:
+  TransferChunkStore(const rdcstr &dir, uint64_t maxSize);
+  ~TransferChunkStore();
+
+  rdcarray<uint64_t> GetChunkHashes() const;
+  bool HasChunk(uint64_t hash) const
+  {
+    return m_Chunks.find(hash) != m_Chunks.end() ||
+           m_MemoryChunks.find(hash) != m_MemoryChunks.end();
+  }
+  // adds a chunk that was received from the remote server
+  void AddChunk(uint64_t hash, const byte *data, size_t size);
+  // reads back a stored chunk. Fails if the chunk is missing, or if its contents on disk no longer
+  // match the hash
+  bool ReadChunk(uint64_t hash, byte *data, size_t size);
+
+  const TransferCacheStats &GetStats() const { return m_Stats; }
+private:
+  struct ChunkLocation
+  {
+    uint32_t pack;
+    uint32_t size;
+    uint64_t offset;
+  };
+
+  void IndexPack(uint32_t pack);
+  FILE *GetPackReader(uint32_t pack);
+
+  rdcstr m_Dir;
+
+  rdcarray<rdcstr> m_PackPaths;
+  rdcarray<FILE *> m_PackReaders;
+
+  // the pack that this session's chunks are appended to, created on first use
+  FILE *m_WritePack = NULL;
+  uint32_t m_WritePackIndex = ~0U;
+  bool m_WritePackDirty = false;
+  // set if the write pack couldn't be created, so we don't keep trying
+  bool m_WritePackFailed = false;
+
+  std::unordered_map<uint64_t, ChunkLocation> m_Chunks;
+  // chunks that couldn't be written to disk
+  std::unordered_map<uint64_t, bytebuf> m_MemoryChunks;
+
+  TransferCacheStats m_Stats;
+};
@@ -61,15 +61,12 @@ void D3D11ResourceManager::SetInternalResource(ID3D11DeviceChild *res)
 
 void D3D11ResourceManager::FreeCaptureData()
 {
-  for(auto it = m_ResourceRecords.begin(); it != m_ResourceRecords.end(); ++it)
-  {
-    D3D11ResourceRecord *record = it->second;
-
+  m_ResourceRecords.ForEach([this](ResourceId, D3D11ResourceRecord *record) {
     if(record == NULL || m_Device->GetImmediateContext()->ShadowStorageInUse(record))
-      continue;
+      return;
 
     record->FreeShadowStorage();
-  }
+  });
 }
 
 ResourceId D3D11ResourceManager::GetID(ID3D11DeviceChild *res)
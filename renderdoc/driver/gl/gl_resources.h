@@ -243,6 +243,8 @@ struct GLResourceRecord : public ResourceRecord
     bool orphaned;
     bool persistent;
     byte *ptr;
+    // if page tracking is enabled for persistent maps, tracks writes to ptr
+    PageTracking::Region *writeTracking;
   } Map;
 
   void VerifyDataType(GLenum target)
@@ -2172,6 +2172,11 @@ void *WrappedOpenGL::glMapNamedBufferRangeEXT(GLuint buffer, GLintptr offset, GL
       record->Map.ptr = (byte *)GL.glMapNamedBufferRangeEXT(buffer, offset, length, access);
       record->Map.status = GLResourceRecord::Mapped_Direct;
 
+      // only coherent maps are diffed at barriers. Explicitly flushed maps tell us what they wrote
+      if(record->Map.ptr && (access & persistentWriteFlags) == persistentWriteFlags &&
+         (access & GL_MAP_COHERENT_BIT) && RenderDoc::Inst().IsMapPageTrackingEnabled())
+        record->Map.writeTracking = PageTracking::Track(record->Map.ptr, (size_t)length);
+
       return record->Map.ptr;
     }
 
@@ -2440,6 +2445,11 @@ GLboolean WrappedOpenGL::glUnmapNamedBufferEXT(GLuint buffer)
     GetResourceManager()->MarkResourceFrameReferenced(record->GetResourceID(),
                                                       eFrameRef_ReadBeforeWrite);
 
+    // stop tracking before the real unmap, so the pages are writable while GL unmaps them and we
+    // never touch the protection of an address range that has been released.
+    PageTracking::Untrack(record->Map.writeTracking);
+    record->Map.writeTracking = NULL;
+
     GLboolean ret = GL_TRUE;
 
     switch(status)
@@ -2777,28 +2787,61 @@ void WrappedOpenGL::PersistentMapMemoryBarrier(const std::set<GLResourceRecord *
 
     if(record->Map.ptr)
     {
-      size_t diffStart = 0, diffEnd = record->Map.length;
-      bool found = true;
+      // if writes are being tracked, only the pages written since the last check can differ
+      rdcarray<rdcpair<size_t, size_t>> writtenRanges;
+      if(record->Map.writeTracking)
+        PageTracking::GetDirtyRanges(record->Map.writeTracking, writtenRanges);
+      else
+        writtenRanges.push_back({0, (size_t)record->Map.length});
+
+      if(record->GetShadowPtr(0) == NULL)
+      {
+        writtenRanges.clear();
+        writtenRanges.push_back({0, (size_t)record->Map.length});
+      }
 
-      if(record->GetShadowPtr(0))
-        found = FindDiffRange(record->GetShadowPtr(0), record->Map.ptr, (size_t)record->Map.length,
-                              diffStart, diffEnd);
+      // separate changes closer than this are flushed together, since each flush serialises its
+      // own chunk
+      const size_t mergeGap = 4096;
 
-      if(found && diffEnd > diffStart)
+      rdcarray<rdcpair<size_t, size_t>> diffRanges;
+      rdcarray<rdcpair<size_t, size_t>> changed;
+
+      for(const rdcpair<size_t, size_t> &written : writtenRanges)
       {
-        // update the modified region in the 'comparison' shadow buffer for next check
         if(record->GetShadowPtr(0) == NULL)
-          record->AllocShadowStorage(record->Map.length);
-        else
-          memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
-                 diffEnd - diffStart);
+        {
+          diffRanges.push_back(written);
+          continue;
+        }
 
-        // we use our own flush function so it will serialise chunks when necessary, and it
-        // also handles copying into the persistent mapped pointer and flushing the real GL
-        // buffer
-        gl_CurChunk = GLChunk::CoherentMapWrite;
-        glFlushMappedNamedBufferRangeEXT(record->Resource.name, GLintptr(diffStart),
-                                         GLsizeiptr(diffEnd - diffStart));
+        FindDiffRanges(record->GetShadowPtr(0) + written.first, record->Map.ptr + written.first,
+                       written.second - written.first, mergeGap, changed);
+
+        for(const rdcpair<size_t, size_t> &diff : changed)
+          diffRanges.push_back({written.first + diff.first, written.first + diff.second});
+      }
+
+      for(const rdcpair<size_t, size_t> &diff : diffRanges)
+      {
+        size_t diffStart = diff.first, diffEnd = diff.second;
+
+        if(diffEnd > diffStart)
+        {
+          // update the modified region in the 'comparison' shadow buffer for next check
+          if(record->GetShadowPtr(0) == NULL)
+            record->AllocShadowStorage(record->Map.length);
+          else
+            memcpy(record->GetShadowPtr(0) + diffStart, record->Map.ptr + diffStart,
+                   diffEnd - diffStart);
+
+          // we use our own flush function so it will serialise chunks when necessary, and it
+          // also handles copying into the persistent mapped pointer and flushing the real GL
+          // buffer
+          gl_CurChunk = GLChunk::CoherentMapWrite;
+          glFlushMappedNamedBufferRangeEXT(record->Resource.name, GLintptr(diffStart),
+                                           GLsizeiptr(diffEnd - diffStart));
+        }
       }
     }
   }
@@ -4856,6 +4899,9 @@ void WrappedOpenGL::glDeleteBuffers(GLsizei n, const GLuint *buffers)
           m_PersistentMaps.erase(record);
           if(record->Map.access & GL_MAP_COHERENT_BIT)
             m_CoherentMaps.erase(record);
+
+          PageTracking::Untrack(record->Map.writeTracking);
+          record->Map.writeTracking = NULL;
         }
 
         // free any shadow storage
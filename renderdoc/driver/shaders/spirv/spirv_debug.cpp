@@ -187,13 +187,21 @@ const ShaderVariable &ThreadState::GetSrc(Id id)
   return ids[id];
 }
 
+ShaderVariable ThreadState::GetOutputVariable(Id id) const
+{
+  // names are only needed for values that are reported, so they're applied here rather than being
+  // copied around with every value in the register file
+  ShaderVariable ret = debugger.EvaluatePointerVariable(ids[id]);
+  ret.name = debugger.GetRawName(id);
+  return ret;
+}
+
 void ThreadState::SetDst(ShaderDebugState *state, Id id, const ShaderVariable &val)
 {
   if(state && ContainsNaNInf(val))
     state->flags |= ShaderEvents::GeneratedNanOrInf;
 
   ids[id] = val;
-  ids[id].name = debugger.GetRawName(id);
 
   auto it = std::lower_bound(live.begin(), live.end(), id);
   live.insert(it - live.begin(), id);
@@ -201,7 +209,7 @@ void ThreadState::SetDst(ShaderDebugState *state, Id id, const ShaderVariable &v
   if(state)
   {
     ShaderVariableChange change;
-    change.after = debugger.EvaluatePointerVariable(ids[id]);
+    change.after = GetOutputVariable(id);
     state->changes.push_back(change);
 
     debugger.AddSourceVars(sourceVars, id);
@@ -221,7 +229,7 @@ void ThreadState::ProcessScopeChange(ShaderDebugState &state, const rdcarray<Id>
     if(liveGlobals.contains(id))
       continue;
 
-    state.changes.push_back({debugger.EvaluatePointerVariable(ids[id])});
+    state.changes.push_back({GetOutputVariable(id)});
   }
 
   for(const Id id : newLive)
@@ -229,7 +237,7 @@ void ThreadState::ProcessScopeChange(ShaderDebugState &state, const rdcarray<Id>
     if(liveGlobals.contains(id))
       continue;
 
-    state.changes.push_back({ShaderVariable(), debugger.EvaluatePointerVariable(ids[id])});
+    state.changes.push_back({ShaderVariable(), GetOutputVariable(id)});
   }
 }
 
@@ -241,13 +249,12 @@ void ThreadState::JumpToLabel(Id target)
   nextInstruction = debugger.GetInstructionForLabel(target) + 1;
 
   // if jumping to an empty unconditional loop header, continue to the loop block
-  Iter it = debugger.GetIterForInstruction(nextInstruction);
-  if(it.opcode() == Op::LoopMerge)
+  if(debugger.GetDecodedInstruction(nextInstruction).op == Op::LoopMerge)
   {
-    it++;
-    if(it.opcode() == Op::Branch)
+    const DecodedInstruction &branch = debugger.GetDecodedInstruction(nextInstruction + 1);
+    if(branch.op == Op::Branch)
     {
-      JumpToLabel(OpBranch(it).targetLabel);
+      JumpToLabel(branch.branchTarget);
     }
   }
 }
@@ -255,28 +262,16 @@ void ThreadState::JumpToLabel(Id target)
 void ThreadState::StepNext(ShaderDebugState *state,
                            const rdcarray<DenseIdMap<ShaderVariable>> &prevWorkgroup)
 {
+  // skip OpLine/OpNoLine, and for now we don't care about structured control flow so skip past
+  // merge statements so we process the branch. This was all resolved when the module was parsed
+  nextInstruction = debugger.GetDecodedInstruction(nextInstruction).execInstruction;
+
+  // the common ops with fixed ID operands are executed from the decoded form, only the others
+  // decode the instruction words again
+  const DecodedInstruction &opdata = debugger.GetDecodedInstruction(nextInstruction);
   Iter it = debugger.GetIterForInstruction(nextInstruction);
   nextInstruction++;
 
-  OpDecoder opdata(it);
-
-  // skip OpLine/OpNoLine
-  while(opdata.op == Op::Line || opdata.op == Op::NoLine)
-  {
-    it++;
-    nextInstruction++;
-    opdata = OpDecoder(it);
-  }
-
-  // for now we don't care about structured control flow so skip past merge statements so we process
-  // the branch. OpLine can't be in between so we can safely advance
-  if(opdata.op == Op::SelectionMerge || opdata.op == Op::LoopMerge)
-  {
-    it++;
-    nextInstruction++;
-    opdata = OpDecoder(it);
-  }
-
   switch(opdata.op)
   {
     //////////////////////////////////////////////////////////////////////////////
@@ -286,39 +281,35 @@ void ThreadState::StepNext(ShaderDebugState *state,
     //////////////////////////////////////////////////////////////////////////////
     case Op::Load:
     {
-      // we currently handle pointers as fixed storage, so a load becomes a copy
-      OpLoad load(it);
-
-      // ignore
-      (void)load.memoryAccess;
+      // we currently handle pointers as fixed storage, so a load becomes a copy. Memory access
+      // flags are ignored
+      const Id pointer = opdata.operands[0];
 
       // get the pointer value, evaluate it (i.e. dereference) and store the result
-      SetDst(state, load.result, debugger.EvaluatePointerVariable(GetSrc(load.pointer)));
+      SetDst(state, opdata.result, debugger.EvaluatePointerVariable(GetSrc(pointer)));
 
       break;
     }
     case Op::Store:
     {
-      OpStore store(it);
-
-      // ignore
-      (void)store.memoryAccess;
+      // memory access flags are ignored
+      const Id pointer = opdata.operands[0], object = opdata.operands[1];
 
-      RDCASSERT(ids[store.pointer].type == VarType::GPUPointer);
+      RDCASSERT(ids[pointer].type == VarType::GPUPointer);
 
       // this is the only place we don't use SetDst because it's the only place that "violates" SSA
       // i.e. changes an existing value. That way SetDst can always unconditionally assign values,
       // and only here do we write through pointers
 
-      ShaderVariable val = GetSrc(store.object);
+      ShaderVariable val = GetSrc(object);
 
       if(!state)
       {
-        debugger.WriteThroughPointer(ids[store.pointer], val);
+        debugger.WriteThroughPointer(ids[pointer], val);
       }
       else
       {
-        ShaderVariable &var = ids[store.pointer];
+        ShaderVariable &var = ids[pointer];
 
         if(ContainsNaNInf(val))
           state->flags |= ShaderEvents::GeneratedNanOrInf;
@@ -329,7 +320,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
 
         rdcarray<ShaderVariableChange> changes;
         ShaderVariableChange basechange;
-        basechange.before = debugger.EvaluatePointerVariable(ids[ptrid]);
+        basechange.before = GetOutputVariable(ptrid);
 
         rdcarray<Id> &pointers = pointersForId[ptrid];
 
@@ -337,17 +328,17 @@ void ThreadState::StepNext(ShaderDebugState *state,
 
         // for every other pointer, evaluate its value now before
         for(size_t i = 0; i < pointers.size(); i++)
-          changes[i].before = debugger.EvaluatePointerVariable(ids[pointers[i]]);
+          changes[i].before = GetOutputVariable(pointers[i]);
 
         debugger.WriteThroughPointer(var, val);
 
         // now evaluate the value after
         for(size_t i = 0; i < pointers.size(); i++)
-          changes[i].after = debugger.EvaluatePointerVariable(ids[pointers[i]]);
+          changes[i].after = GetOutputVariable(pointers[i]);
 
         // if the pointer we're writing is one of the aliased pointers, be sure we add it even if
         // it's a no-op change
-        int ptrIdx = pointers.indexOf(store.pointer);
+        int ptrIdx = pointers.indexOf(pointer);
 
         if(ptrIdx >= 0)
         {
@@ -364,7 +355,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
 
         // always add a change for the base storage variable written itself, even if that's a no-op.
         // This one is not included in any of the pointers lists above
-        basechange.after = debugger.EvaluatePointerVariable(ids[ptrid]);
+        basechange.after = GetOutputVariable(ptrid);
         state->changes.push_back(basechange);
       }
 
@@ -713,14 +704,12 @@ void ThreadState::StepNext(ShaderDebugState *state,
     }
     case Op::Select:
     {
-      OpSelect select(it);
-
       // we treat this as a composite instruction for the case where the condition is a vector
 
-      ShaderVariable cond = GetSrc(select.condition);
+      const ShaderVariable &cond = GetSrc(opdata.operands[0]);
 
-      ShaderVariable var = GetSrc(select.object1);
-      ShaderVariable b = GetSrc(select.object2);
+      ShaderVariable var = GetSrc(opdata.operands[1]);
+      const ShaderVariable &b = GetSrc(opdata.operands[2]);
       if(cond.columns == 1)
       {
         if(cond.value.u.x == 0)
@@ -740,7 +729,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
         }
       }
 
-      SetDst(state, select.result, var);
+      SetDst(state, opdata.result, var);
 
       break;
     }
@@ -922,10 +911,8 @@ void ThreadState::StepNext(ShaderDebugState *state,
     case Op::FUnordLessThan:
     case Op::FUnordLessThanEqual:
     {
-      OpFMul comp(it);
-
-      ShaderVariable var = GetSrc(comp.operand1);
-      ShaderVariable b = GetSrc(comp.operand2);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
+      const ShaderVariable &b = GetSrc(opdata.operands[1]);
 
       if(opdata.op == Op::IEqual)
       {
@@ -1056,7 +1043,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
       // TODO we should add a bool type
       var.type = VarType::UInt;
 
-      SetDst(state, comp.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
 
@@ -1073,10 +1060,8 @@ void ThreadState::StepNext(ShaderDebugState *state,
     case Op::ShiftRightArithmetic:
     case Op::ShiftRightLogical:
     {
-      OpBitwiseOr bitwise(it);
-
-      ShaderVariable var = GetSrc(bitwise.operand1);
-      ShaderVariable b = GetSrc(bitwise.operand2);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
+      const ShaderVariable &b = GetSrc(opdata.operands[1]);
 
       if(opdata.op == Op::BitwiseOr)
       {
@@ -1109,19 +1094,17 @@ void ThreadState::StepNext(ShaderDebugState *state,
           var.value.uv[c] = var.value.uv[c] >> b.value.uv[c];
       }
 
-      SetDst(state, bitwise.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
     case Op::Not:
     {
-      OpNot bitwise(it);
-
-      ShaderVariable var = GetSrc(bitwise.operand);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
 
       for(uint8_t c = 0; c < var.columns; c++)
         var.value.uv[c] = ~var.value.uv[c];
 
-      SetDst(state, bitwise.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
 
@@ -1146,10 +1129,8 @@ void ThreadState::StepNext(ShaderDebugState *state,
     case Op::IAdd:
     case Op::ISub:
     {
-      OpFMul math(it);
-
-      ShaderVariable var = GetSrc(math.operand1);
-      ShaderVariable b = GetSrc(math.operand2);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
+      const ShaderVariable &b = GetSrc(opdata.operands[1]);
 
       if(opdata.op == Op::FMul)
       {
@@ -1275,15 +1256,13 @@ void ThreadState::StepNext(ShaderDebugState *state,
           var.value.uv[c] -= b.value.uv[c];
       }
 
-      SetDst(state, math.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
     case Op::FNegate:
     case Op::SNegate:
     {
-      OpFNegate math(it);
-
-      ShaderVariable var = GetSrc(math.operand);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
 
       if(opdata.op == Op::FNegate)
       {
@@ -1296,15 +1275,13 @@ void ThreadState::StepNext(ShaderDebugState *state,
           var.value.iv[c] = -var.value.iv[c];
       }
 
-      SetDst(state, math.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
     case Op::Dot:
     {
-      OpDot dot(it);
-
-      ShaderVariable var = GetSrc(dot.vector1);
-      ShaderVariable b = GetSrc(dot.vector2);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
+      const ShaderVariable &b = GetSrc(opdata.operands[1]);
 
       RDCASSERTEQUAL(var.columns, b.columns);
 
@@ -1315,20 +1292,18 @@ void ThreadState::StepNext(ShaderDebugState *state,
       var.columns = 1;
       var.value.f.x = ret;
 
-      SetDst(state, dot.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
     case Op::VectorTimesScalar:
     {
-      OpVectorTimesScalar mul(it);
-
-      ShaderVariable var = GetSrc(mul.vector);
-      ShaderVariable scalar = GetSrc(mul.scalar);
+      ShaderVariable var = GetSrc(opdata.operands[0]);
+      const float scalar = GetSrc(opdata.operands[1]).value.f.x;
 
       for(uint8_t c = 0; c < var.columns; c++)
-        var.value.fv[c] *= scalar.value.f.x;
+        var.value.fv[c] *= scalar;
 
-      SetDst(state, mul.result, var);
+      SetDst(state, opdata.result, var);
       break;
     }
     case Op::MatrixTimesScalar:
@@ -1636,17 +1611,15 @@ void ThreadState::StepNext(ShaderDebugState *state,
     }
     case Op::Branch:
     {
-      OpBranch branch(it);
-      JumpToLabel(branch.targetLabel);
+      JumpToLabel(opdata.branchTarget);
       break;
     }
     case Op::BranchConditional:
     {
-      OpBranchConditional branch(it);
-
-      Id target = branch.falseLabel;
-      if(GetSrc(branch.condition).value.u.x)
-        target = branch.trueLabel;
+      // operands are the condition, then the true and false labels
+      Id target = opdata.operands[2];
+      if(GetSrc(opdata.operands[0]).value.u.x)
+        target = opdata.operands[1];
 
       JumpToLabel(target);
 
@@ -1657,18 +1630,20 @@ void ThreadState::StepNext(ShaderDebugState *state,
       OpPhi phi(it);
 
       ShaderVariable var;
+      bool found = false;
 
       for(const PairIdRefIdRef &parent : phi.parents)
       {
         if(parent.second == lastBlock)
         {
           var = GetSrc(parent.first);
+          found = true;
           break;
         }
       }
 
       // we should have had a matching for the OpPhi of the block we came from
-      RDCASSERT(!var.name.empty());
+      RDCASSERT(found);
 
       SetDst(state, phi.result, var);
       break;
@@ -1686,7 +1661,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
 
       // we hit this twice. The first time we don't have a return value so we jump into the
       // function. The second time we do have a return value so we process it and continue
-      if(returnValue.name.empty())
+      if(!hasReturnValue)
       {
         uint32_t returnInstruction = nextInstruction - 1;
         nextInstruction = debugger.GetInstructionForFunction(call.function);
@@ -1699,7 +1674,8 @@ void ThreadState::StepNext(ShaderDebugState *state,
       else
       {
         SetDst(state, call.result, returnValue);
-        returnValue.name.clear();
+        returnValue = ShaderVariable();
+        hasReturnValue = false;
       }
       break;
     }
@@ -1725,7 +1701,7 @@ void ThreadState::StepNext(ShaderDebugState *state,
       }
       else
       {
-        returnValue.name = "<return value>";
+        hasReturnValue = true;
         if(opdata.op == Op::ReturnValue)
         {
           OpReturnValue ret(it);
@@ -1912,26 +1888,14 @@ void ThreadState::StepNext(ShaderDebugState *state,
   }
 
   // skip over any degenerate branches
-  while(true)
+  while(nextInstruction < debugger.GetNumInstructions())
   {
-    it = debugger.GetIterForInstruction(nextInstruction);
-    if(it.opcode() == Op::Branch)
-    {
-      Id target = OpBranch(it).targetLabel;
+    const DecodedInstruction &branch = debugger.GetDecodedInstruction(nextInstruction);
 
-      it++;
-
-      while(it.opcode() == Op::Line || it.opcode() == Op::NoLine)
-        it++;
-
-      if(target == OpLabel(it).result)
-      {
-        JumpToLabel(target);
-        continue;
-      }
-    }
+    if(!branch.degenerateBranch)
+      break;
 
-    break;
+    JumpToLabel(branch.branchTarget);
   }
 
   // set the state's next instruction (if we have one) to ours, bounded by how many
@@ -1940,3 +1904,237 @@ void ThreadState::StepNext(ShaderDebugState *state,
     state->nextInstruction = RDCMIN(nextInstruction, debugger.GetNumInstructions() - 1);
 }
 };    // namespace rdcspv
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "common/timing.h"
+#include "core/core.h"
+#include "core/shader_debug_trace.h"
+#include "spirv_compile.h"
+#include "spirv_reflect.h"
+
+namespace
+{
+// compute shaders used here have no inputs or resources, so nothing needs to be fetched
+class NullAPIWrapper : public rdcspv::DebugAPIWrapper
+{
+public:
+  void AddDebugMessage(MessageCategory c, MessageSeverity sv, MessageSource src, rdcstr d) {}
+  void ReadConstantBufferValue(uint32_t set, uint32_t bind, uint32_t offset, uint32_t byteSize,
+                               void *dst)
+  {
+    memset(dst, 0, byteSize);
+  }
+  void FillInputValue(ShaderVariable &var, ShaderBuiltin builtin, uint32_t location,
+                      uint32_t component)
+  {
+  }
+  bool CalculateSampleGather(rdcspv::ThreadState &lane, rdcspv::Op opcode, TextureType texType,
+                             BindpointIndex imageBind, BindpointIndex samplerBind,
+                             const ShaderVariable &uv, const ShaderVariable &ddxCalc,
+                             const ShaderVariable &ddyCalc, const ShaderVariable &compare,
+                             rdcspv::GatherChannel gatherChannel,
+                             const rdcspv::ImageOperandsAndParamDatas &operands,
+                             ShaderVariable &output)
+  {
+    return false;
+  }
+  DerivativeDeltas GetDerivative(ShaderBuiltin builtin, uint32_t location, uint32_t component)
+  {
+    return DerivativeDeltas();
+  }
+};
+
+rdcstr LoopShaderSource(uint32_t iterations)
+{
+  return StringFormat::Fmt(R"(
+#version 450 core
+
+layout(local_size_x = 1, local_size_y = 1, local_size_z = 1) in;
+
+float accumulate(float val, int idx)
+{
+  return val * 0.5 + float(idx & 7);
+}
+
+void main()
+{
+  float acc = 1.0;
+  int bits = 0;
+  for(int i = 0; i < %u; i++)
+  {
+    acc = accumulate(acc, i);
+    if((i %% 3) == 0)
+      bits ^= i;
+    else
+      bits += 1;
+  }
+}
+)",
+                           iterations);
+}
+
+rdcarray<uint32_t> CompileCompute(const rdcstr &source)
+{
+  rdcspv::Init();
+  RenderDoc::Inst().RegisterShutdownFunction(&rdcspv::Shutdown);
+
+  rdcarray<uint32_t> spirv;
+  rdcspv::CompilationSettings settings(rdcspv::InputLanguage::VulkanGLSL,
+                                       rdcspv::ShaderStage::Compute);
+  settings.debugInfo = true;
+  rdcstr errors = rdcspv::Compile(settings, {source}, spirv);
+
+  INFO("SPIR-V compile output: " << errors);
+
+  REQUIRE(!spirv.empty());
+
+  return spirv;
+}
+
+size_t DebugToCompletion(const rdcarray<uint32_t> &spirv, rdcarray<ShaderDebugState> *states)
+{
+  SPIRVPatchData patchData;
+
+  rdcspv::Debugger *debugger = new rdcspv::Debugger;
+  debugger->Parse(spirv);
+  ShaderDebugTrace *trace = debugger->BeginDebug(new NullAPIWrapper, ShaderStage::Compute, "main",
+                                                 {}, {}, patchData, 0);
+
+  size_t numSteps = 0;
+  while(true)
+  {
+    rdcarray<ShaderDebugState> chunk = debugger->ContinueDebug();
+    if(chunk.empty())
+      break;
+    numSteps += chunk.size();
+    if(states)
+      states->append(chunk);
+  }
+
+  delete trace;
+  delete debugger;
+
+  return numSteps;
+}
+
+// find the last value stored to the variable with the given OpName
+ShaderVariable LastStoredValue(const rdcarray<uint32_t> &spirv,
+                               const rdcarray<ShaderDebugState> &states, const rdcstr &varName)
+{
+  rdcstr rawName;
+
+  for(rdcspv::ConstIter it(spirv, rdcspv::FirstRealWord); it; it++)
+  {
+    if(it.opcode() == rdcspv::Op::Name)
+    {
+      rdcspv::OpName name(it);
+      if(name.name == varName)
+        rawName = StringFormat::Fmt("_%u", name.target.value());
+    }
+  }
+
+  ShaderVariable ret;
+
+  for(const ShaderDebugState &state : states)
+    for(const ShaderVariableChange &change : state.changes)
+      if(change.after.name == rawName)
+        ret = change.after;
+
+  return ret;
+}
+
+// count the memory held by the states, ignoring allocator overhead and any slack capacity
+uint64_t UnpackedSize(const rdcarray<ShaderDebugState> &states)
+{
+  uint64_t ret = states.size() * sizeof(ShaderDebugState);
+  for(const ShaderDebugState &state : states)
+  {
+    ret += state.changes.size() * sizeof(ShaderVariableChange);
+    ret += state.sourceVars.size() * sizeof(SourceVariableMapping);
+    for(const SourceVariableMapping &mapping : state.sourceVars)
+      ret += mapping.variables.size() * sizeof(DebugVariableReference);
+    ret += state.callstack.size() * sizeof(rdcstr);
+  }
+  return ret;
+}
+};
+
+TEST_CASE("Check SPIR-V debugger execution", "[spirv][debug]")
+{
+  const uint32_t iterations = 20;
+
+  rdcarray<uint32_t> spirv = CompileCompute(LoopShaderSource(iterations));
+  rdcarray<ShaderDebugState> states;
+  DebugToCompletion(spirv, &states);
+
+  REQUIRE(!states.empty());
+
+  for(size_t i = 0; i < states.size(); i++)
+    CHECK(states[i].stepIndex == i);
+
+  float acc = 1.0f;
+  int32_t bits = 0;
+  for(int32_t i = 0; i < (int32_t)iterations; i++)
+  {
+    acc = acc * 0.5f + float(i & 7);
+    if((i % 3) == 0)
+      bits ^= i;
+    else
+      bits += 1;
+  }
+
+  CHECK(LastStoredValue(spirv, states, "acc").value.f.x == acc);
+  CHECK(LastStoredValue(spirv, states, "bits").value.i.x == bits);
+};
+
+TEST_CASE("Check packed SPIR-V debugger traces", "[spirv][debug]")
+{
+  rdcarray<uint32_t> spirv = CompileCompute(LoopShaderSource(100));
+  rdcarray<ShaderDebugState> states;
+  DebugToCompletion(spirv, &states);
+
+  REQUIRE(!states.empty());
+
+  PackedShaderDebugTrace trace;
+  trace.Append(states);
+
+  REQUIRE(trace.GetNumStates() == states.size());
+
+  CHECK(trace.GetByteSize() * 10 < UnpackedSize(states));
+
+  for(size_t i = 0; i < states.size(); i += 97)
+    CHECK((trace.GetState(i) == states[i]));
+
+  CHECK((trace.GetStates(0, states.size()) == states));
+};
+
+TEST_CASE("Benchmark SPIR-V debugger execution", "[.][benchmark][spirv][debug]")
+{
+  rdcarray<uint32_t> spirv = CompileCompute(LoopShaderSource(2000));
+
+  size_t numSteps = 0;
+  double seconds = 0.0;
+
+  BENCHMARK("Loop-heavy compute shader")
+  {
+    PerformanceTimer timer;
+    numSteps = DebugToCompletion(spirv, NULL);
+    seconds = timer.GetMilliseconds() / 1000.0;
+  };
+
+  WARN(numSteps << " steps, " << uint64_t(double(numSteps) / RDCMAX(seconds, 1e-6))
+                << " steps/second");
+
+  rdcarray<ShaderDebugState> states;
+  DebugToCompletion(spirv, &states);
+
+  PackedShaderDebugTrace trace;
+  trace.Append(states);
+
+  WARN(states.size() << " steps take " << UnpackedSize(states) / 1024 << " kB unpacked and "
+                     << trace.GetByteSize() / 1024 << " kB packed");
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
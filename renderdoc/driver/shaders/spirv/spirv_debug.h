@@ -138,6 +138,28 @@ private:
 
 class Debugger;
 
+// an instruction decoded once after parsing, so that stepping doesn't have to walk and decode the
+// SPIR-V words to find what to execute next or what it operates on
+struct DecodedInstruction
+{
+  Op op = Op::Max;
+  // for an OpBranch, true if it jumps directly to the label that follows it
+  bool degenerateBranch = false;
+  // true if executing this instruction reads other workgroup lanes' values (i.e. derivatives)
+  bool crossLane = false;
+  // the instruction that is actually executed when stepping from here, after skipping any
+  // OpLine/OpNoLine and structured control flow merges
+  uint32_t execInstruction = 0;
+  // for an OpBranch, the label it jumps to
+  Id branchTarget;
+  // the result and its type, if the instruction has them
+  Id result, resultType;
+  // the source operands in declaration order, resolved for the ops with a fixed number of ID
+  // operands that stepping executes directly: arithmetic, comparisons, bitwise ops, loads and
+  // stores, selects and conditional branches
+  Id operands[3];
+};
+
 struct ThreadState
 {
   ThreadState(uint32_t workgroupIdx, Debugger &debug, const GlobalState &globalState);
@@ -158,7 +180,8 @@ struct ThreadState
   // thread-local inputs/outputs. This array does not change over the course of debugging
   rdcarray<ShaderVariable> inputs, outputs;
 
-  // every ID's variable, if a pointer it may be pointing at a ShaderVariable stored elsewhere
+  // every ID's variable, if a pointer it may be pointing at a ShaderVariable stored elsewhere.
+  // These are unnamed, use GetOutputVariable to get a named value to report in a change
   DenseIdMap<ShaderVariable> ids;
 
   // for any allocated variables, a list of 'extra' pointers pointing to it. By default the actual
@@ -172,6 +195,8 @@ struct ThreadState
   // the last block we were in and the current block, for OpPhis
   Id lastBlock, curBlock;
   ShaderVariable returnValue;
+  // set when a function returns, so the OpFunctionCall it returns to completes instead of calling
+  bool hasReturnValue = false;
   rdcarray<StackFrame *> callstack;
 
   // the list of IDs that are currently valid and live
@@ -184,6 +209,7 @@ struct ThreadState
   bool done;
 
   const ShaderVariable &GetSrc(Id id);
+  ShaderVariable GetOutputVariable(Id id) const;
 
 private:
   void SetDst(ShaderDebugState *state, Id id, const ShaderVariable &val);
@@ -209,6 +235,10 @@ public:
   uint32_t GetInstructionForIter(Iter it);
   uint32_t GetInstructionForFunction(Id id);
   uint32_t GetInstructionForLabel(Id id);
+  const DecodedInstruction &GetDecodedInstruction(uint32_t inst) const
+  {
+    return decodedInstructions[inst];
+  }
   const DataType &GetType(Id typeId);
   rdcstr GetRawName(Id id) const;
   rdcstr GetHumanName(Id id);
@@ -271,9 +301,12 @@ private:
   rdcarray<MemberName> memberNames;
   std::map<rdcstr, Id> entryLookup;
 
-  SparseIdMap<size_t> idDeathOffset;
+  DenseIdMap<size_t> idDeathOffset;
+
+  DenseIdMap<uint32_t> labelInstruction;
 
-  SparseIdMap<uint32_t> labelInstruction;
+  // cached "_123" style raw names, so results don't need to format a new name every step
+  DenseIdMap<rdcstr> rawNames;
 
   // the live mutable global variables, to initialise a stack frame's live list
   rdcarray<Id> liveGlobals;
@@ -282,6 +315,7 @@ private:
   struct Function
   {
     size_t begin = 0;
+    uint32_t instruction = 0;
     rdcarray<Id> parameters;
     rdcarray<Id> variables;
   };
@@ -290,6 +324,7 @@ private:
   Function *curFunction = NULL;
 
   rdcarray<size_t> instructionOffsets;
+  rdcarray<DecodedInstruction> decodedInstructions;
 
   std::set<rdcstr> usedNames;
   std::map<Id, rdcstr> dynamicNames;
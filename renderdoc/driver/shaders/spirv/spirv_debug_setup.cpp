@@ -66,12 +66,16 @@ Iter Debugger::GetIterForInstruction(uint32_t inst)
 
 uint32_t Debugger::GetInstructionForIter(Iter it)
 {
-  return instructionOffsets.indexOf(it.offs());
+  // instructions are registered in order, so the offsets are sorted
+  auto found = std::lower_bound(instructionOffsets.begin(), instructionOffsets.end(), it.offs());
+  if(found == instructionOffsets.end() || *found != it.offs())
+    return ~0U;
+  return uint32_t(found - instructionOffsets.begin());
 }
 
 uint32_t Debugger::GetInstructionForFunction(Id id)
 {
-  return instructionOffsets.indexOf(functions[id].begin);
+  return functions[id].instruction;
 }
 
 uint32_t Debugger::GetInstructionForLabel(Id id)
@@ -258,7 +262,7 @@ ShaderDebugTrace *Debugger::BeginDebug(DebugAPIWrapper *apiWrapper, const Shader
 
   ThreadState &active = GetActiveLane();
 
-  active.nextInstruction = instructionOffsets.indexOf(functions[entryId].begin);
+  active.nextInstruction = GetInstructionForFunction(entryId);
 
   active.ids.resize(idOffsets.size());
 
@@ -573,7 +577,7 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
     initial.nextInstruction = active.nextInstruction;
 
     for(const Id &v : active.live)
-      initial.changes.push_back({ShaderVariable(), EvaluatePointerVariable(active.ids[v])});
+      initial.changes.push_back({ShaderVariable(), active.GetOutputVariable(v)});
 
     initial.sourceVars = active.sourceVars;
 
@@ -590,6 +594,9 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
   if(active.Finished())
     return ret;
 
+  // reserve up front so that states are constructed in place and never copied when growing
+  ret.reserve(ret.size() + 100);
+
   rdcarray<DenseIdMap<ShaderVariable>> oldworkgroup;
 
   oldworkgroup.resize(workgroup.size());
@@ -602,14 +609,26 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
     if(active.Finished())
       break;
 
+    // calculate the current mask of which threads are active
+    CalcActiveMask(activeMask);
+
     // set up the old workgroup so that cross-workgroup/cross-quad operations (e.g. DDX/DDY) get
     // consistent results even when we step the quad out of order. Otherwise if an operation reads
     // and writes from the same register we'd trash data needed for other workgroup elements.
-    for(size_t i = 0; i < oldworkgroup.size(); i++)
-      oldworkgroup[i] = workgroup[i].ids;
+    // Snapshotting every register is expensive, so only do it when some lane is about to need it.
+    bool crossLane = false;
+    for(size_t lane = 0; lane < workgroup.size(); lane++)
+    {
+      uint32_t inst = workgroup[lane].nextInstruction;
+      if(activeMask[lane] && inst < decodedInstructions.size())
+        crossLane |= decodedInstructions[decodedInstructions[inst].execInstruction].crossLane;
+    }
 
-    // calculate the current mask of which threads are active
-    CalcActiveMask(activeMask);
+    if(crossLane)
+    {
+      for(size_t i = 0; i < oldworkgroup.size(); i++)
+        oldworkgroup[i] = workgroup[i].ids;
+    }
 
     // step all active members of the workgroup
     for(size_t lane = 0; lane < workgroup.size(); lane++)
@@ -628,7 +647,8 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
 
         if(lane == activeLaneIndex)
         {
-          ShaderDebugState state;
+          ret.push_back(ShaderDebugState());
+          ShaderDebugState &state = ret.back();
 
           // see if we're retiring any IDs at this state
           for(size_t l = 0; l < thread.live.size();)
@@ -638,7 +658,7 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
             {
               thread.live.erase(l);
               ShaderVariableChange change;
-              change.before = EvaluatePointerVariable(thread.ids[id]);
+              change.before = thread.GetOutputVariable(id);
               state.changes.push_back(change);
 
               rdcstr name = GetRawName(id);
@@ -657,7 +677,6 @@ rdcarray<ShaderDebugState> Debugger::ContinueDebug()
           state.stepIndex = steps;
           state.sourceVars = thread.sourceVars;
           thread.FillCallstack(state);
-          ret.push_back(state);
         }
         else
         {
@@ -678,7 +697,6 @@ ShaderVariable Debugger::MakePointerVariable(Id id, const ShaderVariable *v, uin
   ShaderVariable var;
   var.rows = var.columns = 1;
   var.type = VarType::GPUPointer;
-  var.name = GetRawName(id);
   // encode the pointer into the first u64v
   var.value.u64v[0] = (uint64_t)(uintptr_t)v;
 
@@ -857,7 +875,7 @@ void Debugger::WriteThroughPointer(const ShaderVariable &ptr, const ShaderVariab
 
 rdcstr Debugger::GetRawName(Id id) const
 {
-  return StringFormat::Fmt("_%u", id.value());
+  return rawNames[id];
 }
 
 rdcstr Debugger::GetHumanName(Id id)
@@ -1448,6 +1466,12 @@ void Debugger::PreParse(uint32_t maxId)
   Processor::PreParse(maxId);
 
   strings.resize(idTypes.size());
+  idDeathOffset.resize(idTypes.size());
+  labelInstruction.resize(idTypes.size());
+
+  rawNames.resize(idTypes.size());
+  for(uint32_t i = 0; i < maxId; i++)
+    rawNames[i] = StringFormat::Fmt("_%u", i);
 }
 
 void Debugger::PostParse()
@@ -1462,6 +1486,138 @@ void Debugger::PostParse()
     idDeathOffset[v.id] = ~0U;
 
   memberNames.clear();
+
+  decodedInstructions.resize(instructionOffsets.size());
+
+  for(size_t i = 0; i < instructionOffsets.size(); i++)
+  {
+    ConstIter it(m_SPIRV, instructionOffsets[i]);
+    DecodedInstruction &dec = decodedInstructions[i];
+
+    OpDecoder opdata(it);
+
+    dec.op = opdata.op;
+    dec.result = opdata.result;
+    dec.resultType = opdata.resultType;
+
+    switch(dec.op)
+    {
+      case Op::IEqual:
+      case Op::INotEqual:
+      case Op::UGreaterThan:
+      case Op::UGreaterThanEqual:
+      case Op::ULessThan:
+      case Op::ULessThanEqual:
+      case Op::SGreaterThan:
+      case Op::SGreaterThanEqual:
+      case Op::SLessThan:
+      case Op::SLessThanEqual:
+      case Op::FOrdEqual:
+      case Op::FOrdNotEqual:
+      case Op::FOrdGreaterThan:
+      case Op::FOrdGreaterThanEqual:
+      case Op::FOrdLessThan:
+      case Op::FOrdLessThanEqual:
+      case Op::FUnordEqual:
+      case Op::FUnordNotEqual:
+      case Op::FUnordGreaterThan:
+      case Op::FUnordGreaterThanEqual:
+      case Op::FUnordLessThan:
+      case Op::FUnordLessThanEqual:
+      case Op::BitwiseOr:
+      case Op::BitwiseAnd:
+      case Op::BitwiseXor:
+      case Op::ShiftLeftLogical:
+      case Op::ShiftRightArithmetic:
+      case Op::ShiftRightLogical:
+      case Op::FMul:
+      case Op::FDiv:
+      case Op::FMod:
+      case Op::FRem:
+      case Op::FAdd:
+      case Op::FSub:
+      case Op::IMul:
+      case Op::SDiv:
+      case Op::UDiv:
+      case Op::UMod:
+      case Op::SMod:
+      case Op::SRem:
+      case Op::IAdd:
+      case Op::ISub:
+      case Op::Dot:
+      case Op::VectorTimesScalar:
+      {
+        // all binary ops share the same layout
+        OpFMul math(it);
+        dec.operands[0] = math.operand1;
+        dec.operands[1] = math.operand2;
+        break;
+      }
+      case Op::Not:
+      case Op::FNegate:
+      case Op::SNegate: dec.operands[0] = OpNot(it).operand; break;
+      case Op::Load: dec.operands[0] = OpLoad(it).pointer; break;
+      case Op::Store:
+      {
+        OpStore store(it);
+        dec.operands[0] = store.pointer;
+        dec.operands[1] = store.object;
+        break;
+      }
+      case Op::Select:
+      {
+        OpSelect select(it);
+        dec.operands[0] = select.condition;
+        dec.operands[1] = select.object1;
+        dec.operands[2] = select.object2;
+        break;
+      }
+      case Op::BranchConditional:
+      {
+        OpBranchConditional branch(it);
+        dec.operands[0] = branch.condition;
+        dec.operands[1] = branch.trueLabel;
+        dec.operands[2] = branch.falseLabel;
+        break;
+      }
+      case Op::DPdx:
+      case Op::DPdy:
+      case Op::DPdxCoarse:
+      case Op::DPdyCoarse:
+      case Op::DPdxFine:
+      case Op::DPdyFine:
+      case Op::ImageSampleImplicitLod: dec.crossLane = true; break;
+      case Op::Branch: dec.branchTarget = OpBranch(it).targetLabel; break;
+      default: break;
+    }
+  }
+
+  // resolve from the back, so OpLine/OpNoLine can take the resolved target of their successor
+  for(size_t i = decodedInstructions.size(); i-- > 0;)
+  {
+    DecodedInstruction &dec = decodedInstructions[i];
+
+    dec.execInstruction = (uint32_t)i;
+
+    // functions always end with OpFunctionEnd, so anything we skip has a successor
+    if(i + 1 >= decodedInstructions.size())
+      continue;
+
+    const DecodedInstruction &next = decodedInstructions[i + 1];
+
+    // merges are always directly followed by their branch, with no OpLine in between
+    if(dec.op == Op::Line || dec.op == Op::NoLine)
+      dec.execInstruction = next.execInstruction;
+    else if(dec.op == Op::SelectionMerge || dec.op == Op::LoopMerge)
+      dec.execInstruction = (uint32_t)i + 1;
+
+    // a branch is degenerate if the label it jumps to is the next thing executed anyway. Since
+    // labels are never skipped, the next instruction's resolved target points to it
+    if(dec.op == Op::Branch && decodedInstructions[next.execInstruction].op == Op::Label &&
+       OpLabel(ConstIter(m_SPIRV, instructionOffsets[next.execInstruction])).result ==
+           dec.branchTarget)
+      dec.degenerateBranch = true;
+  }
 }
 
 void Debugger::RegisterOp(Iter it)
@@ -1514,6 +1670,7 @@ void Debugger::RegisterOp(Iter it)
     curFunction = &functions[func.result];
 
     curFunction->begin = it.offs();
+    curFunction->instruction = (uint32_t)instructionOffsets.size();
   }
   else if(opdata.op == Op::FunctionParameter)
   {
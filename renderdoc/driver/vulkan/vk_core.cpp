@@ -25,6 +25,7 @@
 #include "vk_core.h"
 #include <ctype.h>
 #include <algorithm>
+#include "core/settings.h"
 #include "driver/ihv/amd/amd_rgp.h"
 #include "driver/shaders/spirv/spirv_compile.h"
 #include "jpeg-compressor/jpge.h"
@@ -36,6 +37,14 @@
 
 #include "stb/stb_image_write.h"
 
+RDOC_CONFIG(bool, Vulkan_ChunkCache, false,
+            "While loading a capture, record where command buffer recording chunks lie so that "
+            "replaying to an event can skip commands that aren't being re-recorded without "
+            "deserialising them.");
+RDOC_CONFIG(uint32_t, Vulkan_ChunkCacheMB, 64,
+            "The maximum amount of memory in MB that Vulkan.ChunkCache will use. Chunks past this "
+            "budget are deserialised on every replay as normal.");
+
 uint64_t VkInitParams::GetSerialiseSize()
 {
   // misc bytes and fixed integer members
@@ -187,6 +196,9 @@ WrappedVulkan::~WrappedVulkan()
 
   SAFE_DELETE(m_FrameReader);
 
+  if(m_LazyChunkSource)
+    m_LazyChunkSource->Release();
+
   for(size_t i = 0; i < m_ThreadSerialisers.size(); i++)
     delete m_ThreadSerialisers[i];
 
@@ -1911,24 +1923,31 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
   StreamWriter *captureWriter = NULL;
 
-  if(rdc)
-  {
-    SectionProperties props;
+  SectionProperties props;
 
-    // Compress with LZ4 so that it's fast
-    props.flags = SectionFlags::LZ4Compressed;
-    props.version = m_SectionVersion;
-    props.type = SectionType::FrameCapture;
+  // Compress with LZ4 so that it's fast
+  props.flags = SectionFlags::LZ4Compressed;
+  props.version = m_SectionVersion;
+  props.type = SectionType::FrameCapture;
 
+  // when writing in the background we only gather the frame contents into memory here, the
+  // compression and disk I/O happen on the writer thread once we've returned to the application.
+  // The chunks themselves are still copied here, since they're owned by resource and command buffer
+  // records that the application can modify or free as soon as it resumes, and initial contents
+  // are serialised from readback memory that's freed below.
+  const bool backgroundWrite = rdc && RenderDoc::Inst().IsBackgroundCaptureWritingEnabled();
+
+  if(backgroundWrite)
+    captureWriter = new StreamWriter(StreamWriter::DefaultScratchSize);
+  else if(rdc)
     captureWriter = rdc->WriteSection(props);
-  }
   else
-  {
     captureWriter = new StreamWriter(StreamWriter::InvalidStream);
-  }
+
+  uint64_t captureSize = 0;
 
   {
-    WriteSerialiser ser(captureWriter, Ownership::Stream);
+    WriteSerialiser ser(captureWriter, backgroundWrite ? Ownership::Nothing : Ownership::Stream);
 
     ser.SetChunkMetadataRecording(GetThreadSerialiser().GetChunkMetadataRecording());
 
@@ -2004,13 +2023,18 @@ bool WrappedVulkan::EndFrameCapture(void *dev, void *wnd)
 
       RDCDEBUG("Done");
     }
+
+    captureSize = captureWriter->GetOffset();
   }
 
   RDCLOG("Captured Vulkan frame with %f MB capture section in %f seconds",
-         double(captureWriter->GetOffset()) / (1024.0 * 1024.0),
-         m_CaptureTimer.GetMilliseconds() / 1000.0);
+         double(captureSize) / (1024.0 * 1024.0), m_CaptureTimer.GetMilliseconds() / 1000.0);
 
-  RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
+  if(backgroundWrite)
+    RenderDoc::Inst().QueueCaptureWriting(rdc, m_CapturedFrames.back().frameNumber, props,
+                                          captureWriter);
+  else
+    RenderDoc::Inst().FinishCaptureWriting(rdc, m_CapturedFrames.back().frameNumber);
 
   SAFE_DELETE(m_HeaderChunk);
 
@@ -2148,6 +2172,128 @@ void WrappedVulkan::AddResourceCurChunk(ResourceId id)
   AddResourceCurChunk(GetReplay()->GetResourceDesc(id));
 }
 
+// decodes driver chunks for lazily populated structured data by reading them again from the
+// capture file, so loading only needs to record where each chunk starts. The file and the exporting
+// driver are only created the first time a chunk is populated.
+class VulkanLazyChunkSource : public LazyChunkSource
+{
+public:
+  VulkanLazyChunkSource(const rdcstr &filename, uint64_t sectionVersion, bool storeBuffers)
+      : m_Filename(filename), m_SectionVersion(sectionVersion), m_StoreBuffers(storeBuffers)
+  {
+  }
+
+  bool CanDecode(uint32_t chunkID) override
+  {
+    return chunkID >= (uint32_t)SystemChunk::FirstDriverChunk;
+  }
+
+  bool DecodeChunk(uint64_t offset, StructuredObjectList &children) override
+  {
+    // without a block index compressed sections can only be read forwards, so seeking backwards
+    // means starting again from the beginning of the section
+    if(!m_Reader || m_Reader->IsErrored() || (!m_Seekable && offset < m_Reader->GetOffset()))
+    {
+      if(!OpenSection())
+        return false;
+    }
+
+    if(m_Seekable)
+      m_Reader->SetOffset(offset);
+    else
+      m_Reader->SkipBytes(offset - m_Reader->GetOffset());
+
+    if(m_Reader->IsErrored() || m_Reader->GetOffset() != offset)
+      return false;
+
+    if(!m_Exporter)
+    {
+      m_Exporter = new WrappedVulkan();
+      m_Exporter->SetStructuredExport(m_SectionVersion);
+    }
+
+    return m_Exporter->ExportLazyChunk(m_Reader, m_StoreBuffers, children);
+  }
+
+protected:
+  ~VulkanLazyChunkSource()
+  {
+    SAFE_DELETE(m_Reader);
+    SAFE_DELETE(m_File);
+    SAFE_DELETE(m_Exporter);
+  }
+
+private:
+  bool OpenSection()
+  {
+    SAFE_DELETE(m_Reader);
+
+    if(!m_File)
+    {
+      m_File = new RDCFile;
+      m_File->Open(m_Filename.c_str());
+    }
+
+    if(m_File->ErrorCode() != ContainerError::NoError)
+    {
+      RDCERR("Couldn't reopen %s to populate structured data", m_Filename.c_str());
+      return false;
+    }
+
+    int sectionIdx = m_File->SectionIndex(SectionType::FrameCapture);
+
+    if(sectionIdx < 0)
+      return false;
+
+    SectionFlags flags = m_File->GetSectionProperties(sectionIdx).flags;
+    m_Seekable = (flags & SectionFlags::BlockIndexed) ||
+                 !(flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed));
+
+    m_Reader = m_File->ReadSection(sectionIdx);
+
+    return !m_Reader->IsErrored();
+  }
+
+  rdcstr m_Filename;
+  uint64_t m_SectionVersion;
+  bool m_StoreBuffers;
+
+  RDCFile *m_File = NULL;
+  StreamReader *m_Reader = NULL;
+  bool m_Seekable = false;
+  WrappedVulkan *m_Exporter = NULL;
+};
+
+bool WrappedVulkan::ExportLazyChunk(StreamReader *reader, bool storeStructuredBuffers,
+                                    StructuredObjectList &children)
+{
+  ReadSerialiser ser(reader, Ownership::Nothing);
+
+  ser.SetStringDatabase(&m_StringDB);
+  ser.SetUserData(GetResourceManager());
+  ser.SetVersion(m_SectionVersion);
+
+  ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
+
+  VulkanChunk context = ser.ReadChunk<VulkanChunk>();
+
+  if(reader->IsErrored())
+    return false;
+
+  bool success = ProcessChunk(ser, context);
+
+  ser.EndChunk();
+
+  SDFile &file = ser.GetStructuredFile();
+
+  if(!success || reader->IsErrored() || file.chunks.empty())
+    return false;
+
+  children.swap(file.chunks[0]->data.children);
+
+  return true;
+}
+
 ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers)
 {
   int sectionIdx = rdc->SectionIndex(SectionType::FrameCapture);
@@ -2172,6 +2318,15 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
 
   ser.ConfigureStructuredExport(&GetChunkName, storeStructuredBuffers);
 
+  // with lazy structured data, driver chunks are only recorded here and decoded from the file again
+  // when accessed. Captures that aren't on disk are compacted after loading like other drivers.
+  if(IsStructuredDataLazy() && !IsStructuredExporting(m_State) && !rdc->GetFilename().empty())
+  {
+    m_LazyChunkSource =
+        new VulkanLazyChunkSource(rdc->GetFilename(), m_SectionVersion, storeStructuredBuffers);
+    ser.SetLazyChunkSource(m_LazyChunkSource, 0);
+  }
+
   m_StructuredFile = &ser.GetStructuredFile();
 
   m_StoredStructuredData.version = m_StructuredFile->version = m_SectionVersion;
@@ -2198,6 +2353,10 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
   if(m_ReplayOptions.apiValidation)
     sink = new ScopedDebugMessageSink(this);
 
+  // parse and reflect shader modules on the job system while the rest of the initialisation chunks
+  // are read. They are finished before the frame is replayed, since that needs their reflection.
+  m_CreationInfo.m_DeferShaderLoading = !IsStructuredExporting(m_State);
+
   for(;;)
   {
     PerformanceTimer timer;
@@ -2266,8 +2425,11 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
         }
       }
 
+      m_FrameDataOffset = reader->GetOffset();
       m_FrameReader = new StreamReader(reader, frameDataSize);
 
+      m_CreationInfo.FinishShaderLoading();
+
       ReplayStatus status = ContextReplayLog(m_State, 0, 0, false);
 
       if(status != ReplayStatus::Succeeded)
@@ -2287,6 +2449,8 @@ ReplayStatus WrappedVulkan::ReadLogInitialisation(RDCFile *rdc, bool storeStruct
 
   SAFE_DELETE(sink);
 
+  m_CreationInfo.FinishShaderLoading();
+
 #if ENABLED(RDOC_DEVEL)
   for(auto it = chunkInfos.begin(); it != chunkInfos.end(); ++it)
   {
@@ -2357,6 +2521,7 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
   if(IsLoading(m_State) || IsStructuredExporting(m_State))
   {
     ser.ConfigureStructuredExport(&GetChunkName, IsStructuredExporting(m_State));
+    ser.SetLazyChunkSource(m_LazyChunkSource, m_FrameDataOffset);
 
     ser.GetStructuredFile().Swap(*m_StructuredFile);
 
@@ -2440,6 +2605,31 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
 
     m_CurChunkOffset = ser.GetReader()->GetOffset();
 
+    // commands recorded into a command buffer that isn't being re-recorded do nothing on replay, so
+    // if we know where the chunk ends we can skip it without deserialising anything. This is only
+    // valid when replaying through linearly, a sub-section replay seeks event by event below.
+    if(IsActiveReplaying(m_State) && startEventID <= 1 && startEventID != endEventID &&
+       !m_CmdChunkCache.empty())
+    {
+      const CachedCmdChunk *cached = FindCachedCmdChunk(m_CurChunkOffset);
+
+      // InRerecordRange() is false both for command buffers that aren't being re-recorded at all
+      // and for the partial command buffer once its event counter is past the target event, so
+      // this also skips the tail of the partial command buffer.
+      if(cached && !InRerecordRange(cached->cmdBuffer))
+      {
+        ser.GetReader()->SetOffset(m_CurChunkOffset + cached->length);
+
+        if(ser.GetReader()->IsErrored())
+          return ReplayStatus::APIDataCorrupted;
+
+        m_LastChunk = cached->chunk;
+        m_LastCmdBufferID = cached->cmdBuffer;
+        m_BakedCmdBufferInfo[m_LastCmdBufferID].curEventID++;
+        continue;
+      }
+    }
+
     VulkanChunk chunktype = ser.ReadChunk<VulkanChunk>();
 
     if(ser.GetReader()->IsErrored())
@@ -2461,6 +2651,10 @@ ReplayStatus WrappedVulkan::ContextReplayLog(CaptureState readType, uint32_t sta
     if(!success)
       return m_FailedReplayStatus;
 
+    if(IsLoading(m_State) && Vulkan_ChunkCache && m_LastCmdBufferID != ResourceId() &&
+       IsCacheableCmdChunk(chunktype))
+      CacheCmdChunk(chunktype, m_CurChunkOffset, ser.GetReader()->GetOffset());
+
     RenderDoc::Inst().SetProgress(
         LoadProgress::FrameEventsRead,
         float(m_CurChunkOffset - startOffset) / float(ser.GetReader()->GetSize()));
@@ -3574,6 +3768,86 @@ VkBool32 VKAPI_PTR WrappedVulkan::DebugUtilsCallbackStatic(
       ->DebugCallback(severity, category, messageCode, pMessageId, pCallbackData->pMessage);
 }
 
+bool WrappedVulkan::IsCacheableCmdChunk(VulkanChunk chunk)
+{
+  // only commands that do nothing on replay when their command buffer isn't in the re-record range,
+  // and which always correspond to exactly one event, can be skipped. Anything that tracks state
+  // outside of re-recording (render passes, barriers, events, queries) or that can expand to a
+  // varying number of events (indirect draws, secondary command buffers) must always be processed.
+  switch(chunk)
+  {
+    case VulkanChunk::vkCmdBindPipeline:
+    case VulkanChunk::vkCmdBindDescriptorSets:
+    case VulkanChunk::vkCmdBindVertexBuffers:
+    case VulkanChunk::vkCmdBindIndexBuffer:
+    case VulkanChunk::vkCmdPushConstants:
+    case VulkanChunk::vkCmdUpdateBuffer:
+    case VulkanChunk::vkCmdSetViewport:
+    case VulkanChunk::vkCmdSetScissor:
+    case VulkanChunk::vkCmdSetLineWidth:
+    case VulkanChunk::vkCmdSetDepthBias:
+    case VulkanChunk::vkCmdSetBlendConstants:
+    case VulkanChunk::vkCmdSetDepthBounds:
+    case VulkanChunk::vkCmdSetStencilCompareMask:
+    case VulkanChunk::vkCmdSetStencilWriteMask:
+    case VulkanChunk::vkCmdSetStencilReference:
+    case VulkanChunk::vkCmdDraw:
+    case VulkanChunk::vkCmdDrawIndexed:
+    case VulkanChunk::vkCmdDispatch:
+    case VulkanChunk::vkCmdDispatchIndirect:
+    case VulkanChunk::vkCmdDispatchBase:
+    case VulkanChunk::vkCmdBlitImage:
+    case VulkanChunk::vkCmdResolveImage:
+    case VulkanChunk::vkCmdCopyImage:
+    case VulkanChunk::vkCmdCopyBufferToImage:
+    case VulkanChunk::vkCmdCopyImageToBuffer:
+    case VulkanChunk::vkCmdCopyBuffer:
+    case VulkanChunk::vkCmdFillBuffer:
+    case VulkanChunk::vkCmdClearColorImage:
+    case VulkanChunk::vkCmdClearDepthStencilImage:
+    case VulkanChunk::vkCmdClearAttachments: return true;
+    default: break;
+  }
+
+  return false;
+}
+
+void WrappedVulkan::CacheCmdChunk(VulkanChunk chunk, uint64_t startOffset, uint64_t endOffset)
+{
+  const uint64_t budget = uint64_t(Vulkan_ChunkCacheMB) * 1024 * 1024;
+
+  // chunks are read in file order, so the cache stays sorted as we append to it
+  if(!m_CmdChunkCache.empty() && m_CmdChunkCache.back().fileOffset >= startOffset)
+    return;
+
+  if((m_CmdChunkCache.size() + 1) * sizeof(CachedCmdChunk) > budget)
+    return;
+
+  // chunk lengths are 32-bit, but be safe
+  if(endOffset - startOffset > UINT32_MAX)
+    return;
+
+  CachedCmdChunk cached;
+  cached.fileOffset = startOffset;
+  cached.cmdBuffer = m_LastCmdBufferID;
+  cached.length = uint32_t(endOffset - startOffset);
+  cached.chunk = chunk;
+  m_CmdChunkCache.push_back(cached);
+}
+
+const WrappedVulkan::CachedCmdChunk *WrappedVulkan::FindCachedCmdChunk(uint64_t fileOffset)
+{
+  CachedCmdChunk search = {};
+  search.fileOffset = fileOffset;
+
+  auto it = std::lower_bound(m_CmdChunkCache.begin(), m_CmdChunkCache.end(), search);
+
+  if(it != m_CmdChunkCache.end() && it->fileOffset == fileOffset)
+    return it;
+
+  return NULL;
+}
+
 bool WrappedVulkan::HasNonMarkerEvents(ResourceId cmdBuffer)
 {
   for(const APIEvent &ev : m_BakedCmdBufferInfo[m_LastCmdBufferID].curEvents)
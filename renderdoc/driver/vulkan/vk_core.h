@@ -308,6 +308,10 @@ private:
   uint64_t m_SectionVersion;
 
   StreamReader *m_FrameReader = NULL;
+  // offset of m_FrameReader's data in the frame capture section
+  uint64_t m_FrameDataOffset = 0;
+  // decodes chunks for lazily populated structured data, NULL otherwise
+  LazyChunkSource *m_LazyChunkSource = NULL;
 
   std::set<rdcstr> m_StringDB;
 
@@ -592,6 +596,24 @@ private:
   };
   rdcarray<DrawcallUse> m_DrawcallUses;
 
+  // optionally built while loading: the extent and command buffer of each command recording chunk
+  // that has no side-effects on replay unless its command buffer is being re-recorded. When
+  // replaying, chunks for command buffers outside the re-record range are skipped over entirely
+  // instead of being deserialised only to be discarded.
+  struct CachedCmdChunk
+  {
+    uint64_t fileOffset;
+    ResourceId cmdBuffer;
+    uint32_t length;
+    VulkanChunk chunk;
+    bool operator<(const CachedCmdChunk &o) const { return fileOffset < o.fileOffset; }
+  };
+  rdcarray<CachedCmdChunk> m_CmdChunkCache;
+
+  bool IsCacheableCmdChunk(VulkanChunk chunk);
+  void CacheCmdChunk(VulkanChunk chunk, uint64_t startOffset, uint64_t endOffset);
+  const CachedCmdChunk *FindCachedCmdChunk(uint64_t fileOffset);
+
   enum PartialReplayIndex
   {
     Primary,
@@ -965,6 +987,9 @@ public:
   void Shutdown();
   void ReplayLog(uint32_t startEventID, uint32_t endEventID, ReplayLogType replayType);
   ReplayStatus ReadLogInitialisation(RDCFile *rdc, bool storeStructuredBuffers);
+  // exports the structured data for the single chunk at the reader's current position
+  bool ExportLazyChunk(StreamReader *reader, bool storeStructuredBuffers,
+                       StructuredObjectList &children);
 
   SDFile &GetStructuredFile() { return *m_StructuredFile; }
   const APIEvent &GetEvent(uint32_t eventId);
@@ -23,6 +23,9 @@
  ******************************************************************************/
 
 #include "vk_info.h"
+#include "common/timing.h"
+#include "vk_shader_cache.h"
+#include "zstd/xxhash.h"
 
 VkDynamicState ConvertDynamicState(VulkanDynamicStateIndex idx)
 {
@@ -256,8 +259,8 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan,
 
     ShaderModuleReflection &reflData = info.m_ShaderModule[shadid].m_Reflections[key];
 
-    reflData.Init(resourceMan, shadid, info.m_ShaderModule[shadid].spirv, shad.entryPoint,
-                  pCreateInfo->pStages[i].stage, shad.specialization);
+    reflData.Init(resourceMan, info.m_ShaderCache, shadid, info.m_ShaderModule[shadid],
+                  shad.entryPoint, pCreateInfo->pStages[i].stage, shad.specialization);
 
     shad.refl = &reflData.refl;
     shad.mapping = &reflData.mapping;
@@ -585,8 +588,8 @@ void VulkanCreationInfo::Pipeline::Init(VulkanResourceManager *resourceMan, Vulk
 
     ShaderModuleReflection &reflData = info.m_ShaderModule[shadid].m_Reflections[key];
 
-    reflData.Init(resourceMan, shadid, info.m_ShaderModule[shadid].spirv, shad.entryPoint,
-                  pCreateInfo->stage.stage, shad.specialization);
+    reflData.Init(resourceMan, info.m_ShaderCache, shadid, info.m_ShaderModule[shadid],
+                  shad.entryPoint, pCreateInfo->stage.stage, shad.specialization);
 
     shad.refl = &reflData.refl;
     shad.mapping = &reflData.mapping;
@@ -1076,13 +1079,87 @@ void VulkanCreationInfo::ShaderModule::Init(VulkanResourceManager *resourceMan,
   else
   {
     RDCASSERT(pCreateInfo->codeSize % sizeof(uint32_t) == 0);
-    spirv.Parse(rdcarray<uint32_t>((uint32_t *)(pCreateInfo->pCode),
-                                   pCreateInfo->codeSize / sizeof(uint32_t)));
+
+    // the hash is needed straight away to key reflections, and is cheap compared to parsing
+    spirvHash = XXH64(pCreateInfo->pCode, pCreateInfo->codeSize, 0);
+
+    rdcarray<uint32_t> words((uint32_t *)(pCreateInfo->pCode),
+                             pCreateInfo->codeSize / sizeof(uint32_t));
+
+    if(info.m_DeferShaderLoading)
+    {
+      // nothing else touches the reflector until FinishLoading() has synced this job
+      loadJob = JobSystem::AddJob([this, words]() {
+        PerformanceTimer timer;
+        spirv.Parse(words);
+        parseTime = timer.GetMilliseconds();
+      });
+    }
+    else
+    {
+      spirv.Parse(words);
+    }
+  }
+}
+
+void VulkanCreationInfo::ShaderModule::FinishLoading()
+{
+  if(loadJob)
+  {
+    JobSystem::SyncJob(loadJob);
+    loadJob = NULL;
+  }
+
+  if(pendingReflections.empty())
+    return;
+
+  PerformanceTimer timer;
+
+  for(PendingReflection &pending : pendingReflections)
+  {
+    pending.reflData->Reflect(pending.shaderCache, *this, pending.specInfo);
+    pending.reflData->refl.resourceId = pending.origId;
+  }
+
+  pendingReflections.clear();
+
+  reflectTime += timer.GetMilliseconds();
+}
+
+void VulkanCreationInfo::FinishShaderLoading()
+{
+  m_DeferShaderLoading = false;
+
+  rdcarray<ShaderModule *> modules;
+  for(auto it = m_ShaderModule.begin(); it != m_ShaderModule.end(); ++it)
+    if(it->second.IsLoading())
+      modules.push_back(&it->second);
+
+  if(modules.empty())
+    return;
+
+  PerformanceTimer timer;
+
+  // each module is only touched by one index, and the shader cache is internally locked
+  JobSystem::ParallelFor((uint32_t)modules.size(),
+                         [&modules](uint32_t i) { modules[i]->FinishLoading(); });
+
+  double parseTime = 0.0, reflectTime = 0.0;
+  for(ShaderModule *mod : modules)
+  {
+    parseTime += mod->parseTime;
+    reflectTime += mod->reflectTime;
   }
+
+  RDCLOG("Loaded %zu shader modules on %u workers: %.3lf ms parsing, %.3lf ms reflecting, "
+         "%.3lf ms waiting",
+         modules.size(), JobSystem::GetNumWorkers(), parseTime, reflectTime,
+         timer.GetMilliseconds());
 }
 
 void VulkanCreationInfo::ShaderModuleReflection::Init(VulkanResourceManager *resourceMan,
-                                                      ResourceId id, const rdcspv::Reflector &spv,
+                                                      VulkanShaderCache *shaderCache,
+                                                      ResourceId id, ShaderModule &module,
                                                       const rdcstr &entry,
                                                       VkShaderStageFlagBits stage,
                                                       const rdcarray<SpecConstant> &specInfo)
@@ -1092,10 +1169,55 @@ void VulkanCreationInfo::ShaderModuleReflection::Init(VulkanResourceManager *res
     entryPoint = entry;
     stageIndex = StageIndex(stage);
 
-    spv.MakeReflection(GraphicsAPI::Vulkan, ShaderStage(stageIndex), entryPoint, specInfo, refl,
-                       mapping, patchData);
+    // the resource manager isn't thread-safe, so look up the original ID here even if the
+    // reflection itself is deferred
+    ResourceId origId = resourceMan->GetOriginalID(id);
+
+    if(module.IsLoading())
+    {
+      module.pendingReflections.push_back({this, shaderCache, origId, stage, specInfo});
+      return;
+    }
+
+    Reflect(shaderCache, module, specInfo);
+
+    refl.resourceId = origId;
+  }
+}
+
+void VulkanCreationInfo::ShaderModuleReflection::Reflect(VulkanShaderCache *shaderCache,
+                                                         const ShaderModule &module,
+                                                         const rdcarray<SpecConstant> &specInfo)
+{
+  uint64_t key = 0;
+  bool cached = false;
+
+  // modules without SPIR-V can't be reflected, so there's nothing to cache
+  if(shaderCache && module.spirvHash != 0)
+  {
+    key = VulkanShaderCache::GetReflectionKey(module.spirvHash, ShaderStage(stageIndex),
+                                              entryPoint, specInfo);
+    cached = shaderCache->GetReflection(key, refl, mapping, patchData);
+  }
+
+  if(cached)
+  {
+    // the SPIR-V itself isn't stored in the cache, since we already have it
+    rdcarray<uint32_t> words = module.spirv.GetSPIRV();
+    refl.rawBytes.assign((const byte *)words.data(), words.size() * sizeof(uint32_t));
+  }
+  else
+  {
+    module.spirv.MakeReflection(GraphicsAPI::Vulkan, ShaderStage(stageIndex), entryPoint, specInfo,
+                                refl, mapping, patchData);
 
-    refl.resourceId = resourceMan->GetOriginalID(id);
+    if(shaderCache && module.spirvHash != 0)
+    {
+      bytebuf rawBytes;
+      rawBytes.swap(refl.rawBytes);
+      shaderCache->SetReflection(key, refl, mapping, patchData);
+      refl.rawBytes.swap(rawBytes);
+    }
   }
 }
 
@@ -1281,3 +1403,116 @@ void DescUpdateTemplate::Apply(const void *pData, DescUpdateTemplateApplication
       application.writes.push_back(write);
   }
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#undef None
+
+#include "catch/catch.hpp"
+#include "core/core.h"
+#include "driver/shaders/spirv/spirv_compile.h"
+
+TEST_CASE("Check deferred shader module loading", "[vulkan][reflection]")
+{
+  rdcspv::Init();
+  RenderDoc::Inst().RegisterShutdownFunction(&rdcspv::Shutdown);
+
+  rdcarray<uint32_t> spirv;
+  rdcspv::CompilationSettings settings(rdcspv::InputLanguage::VulkanGLSL,
+                                       rdcspv::ShaderStage::Compute);
+  rdcstr errors = rdcspv::Compile(settings, {R"(
+#version 450 core
+
+layout(local_size_x = 4, local_size_y = 1, local_size_z = 1) in;
+
+layout(binding = 0, std430) buffer outbuf
+{
+  uint data[];
+};
+
+void main()
+{
+  data[gl_GlobalInvocationID.x] = gl_GlobalInvocationID.x * 2;
+}
+)"},
+                                         spirv);
+
+  INFO("SPIR-V compile output: " << errors);
+
+  REQUIRE(!spirv.empty());
+
+  VkShaderModuleCreateInfo createInfo = {
+      VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, NULL, 0, spirv.byteSize(), spirv.data(),
+  };
+
+  VulkanCreationInfo info;
+
+  VulkanCreationInfo::ShaderModule &immediate = info.m_ShaderModule[ResourceId()];
+  immediate.Init(NULL, info, &createInfo);
+
+  CHECK(!immediate.IsLoading());
+
+  VulkanCreationInfo::ShaderModuleReflection &expected =
+      immediate.m_Reflections[{"main", ResourceId()}];
+  expected.entryPoint = "main";
+  expected.stageIndex = 5;
+  expected.Reflect(NULL, immediate, {});
+
+  const uint32_t numModules = 64;
+
+  info.m_DeferShaderLoading = true;
+
+  rdcarray<VulkanCreationInfo::ShaderModule *> modules;
+  for(uint32_t i = 0; i < numModules; i++)
+  {
+    ResourceId id = ResourceIDGen::GetNewUniqueID();
+    VulkanCreationInfo::ShaderModule &mod = info.m_ShaderModule[id];
+    mod.Init(NULL, info, &createInfo);
+
+    CHECK(mod.IsLoading());
+
+    // queue up a reflection the way a pipeline would while loading
+    VulkanCreationInfo::ShaderModuleReflection &reflData =
+        mod.m_Reflections[{"main", ResourceId()}];
+    reflData.entryPoint = "main";
+    reflData.stageIndex = 5;
+    mod.pendingReflections.push_back({&reflData, NULL, id, VK_SHADER_STAGE_COMPUTE_BIT, {}});
+
+    modules.push_back(&mod);
+  }
+
+  SECTION("Bulk join")
+  {
+    info.FinishShaderLoading();
+
+    CHECK(!info.m_DeferShaderLoading);
+  };
+
+  SECTION("Lazy join")
+  {
+    // reflections are available on demand even before the bulk join
+    VulkanCreationInfo::ShaderModuleReflection &reflData =
+        modules[7]->GetReflection("main", ResourceId());
+
+    CHECK(!modules[7]->IsLoading());
+    CHECK(reflData.refl.resourceId != ResourceId());
+
+    info.FinishShaderLoading();
+  };
+
+  for(VulkanCreationInfo::ShaderModule *mod : modules)
+  {
+    CHECK(!mod->IsLoading());
+    CHECK(mod->spirvHash == immediate.spirvHash);
+    CHECK(mod->spirv.EntryPoints() == immediate.spirv.EntryPoints());
+
+    const ShaderReflection &refl = mod->GetReflection("main", ResourceId()).refl;
+    CHECK(refl.resourceId != ResourceId());
+    CHECK(refl.rawBytes == expected.refl.rawBytes);
+    CHECK(refl.dispatchThreadsDimension[0] == expected.refl.dispatchThreadsDimension[0]);
+    REQUIRE(refl.readWriteResources.size() == expected.refl.readWriteResources.size());
+    CHECK(refl.readWriteResources[0].name == expected.refl.readWriteResources[0].name);
+  }
+}
+
+#endif
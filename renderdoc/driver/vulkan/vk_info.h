@@ -24,11 +24,13 @@
 
 #pragma once
 
+#include "core/jobsystem.h"
 #include "driver/shaders/spirv/spirv_reflect.h"
 #include "vk_common.h"
 #include "vk_manager.h"
 
 struct VulkanCreationInfo;
+class VulkanShaderCache;
 
 // linearised version of VkDynamicState
 enum VulkanDynamicStateIndex
@@ -168,6 +170,8 @@ struct VulkanCreationInfo
     ResourceId specialisingPipe;
   };
 
+  struct ShaderModule;
+
   struct ShaderModuleReflection
   {
     uint32_t stageIndex;
@@ -178,9 +182,11 @@ struct VulkanCreationInfo
     SPIRVPatchData patchData;
     std::map<size_t, uint32_t> instructionLines;
 
-    void Init(VulkanResourceManager *resourceMan, ResourceId id, const rdcspv::Reflector &spv,
-              const rdcstr &entry, VkShaderStageFlagBits stage,
+    void Init(VulkanResourceManager *resourceMan, VulkanShaderCache *shaderCache, ResourceId id,
+              ShaderModule &module, const rdcstr &entry, VkShaderStageFlagBits stage,
               const rdcarray<SpecConstant> &specInfo);
+    void Reflect(VulkanShaderCache *shaderCache, const ShaderModule &module,
+                 const rdcarray<SpecConstant> &specInfo);
 
     void PopulateDisassembly(const rdcspv::Reflector &spirv);
   };
@@ -521,11 +527,26 @@ struct VulkanCreationInfo
 
   struct ShaderModule
   {
+    ShaderModule() = default;
+    ShaderModule(const ShaderModule &) = delete;
+    ShaderModule &operator=(const ShaderModule &) = delete;
+    ~ShaderModule()
+    {
+      if(loadJob)
+        JobSystem::SyncJob(loadJob);
+    }
+
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
               const VkShaderModuleCreateInfo *pCreateInfo);
 
+    // waits for the background parse of this module, and runs any reflections that were deferred
+    // while the capture was loading. Must only be called from one thread at a time.
+    void FinishLoading();
+    bool IsLoading() const { return loadJob != NULL || !pendingReflections.empty(); }
     ShaderModuleReflection &GetReflection(const rdcstr &entry, ResourceId pipe)
     {
+      FinishLoading();
+
       // look for one from this pipeline specifically, if it was specialised
       auto it = m_Reflections.find({entry, pipe});
       if(it != m_Reflections.end())
@@ -536,13 +557,38 @@ struct VulkanCreationInfo
     }
 
     rdcspv::Reflector spirv;
+    // hash of the module's SPIR-V, used to look up its reflections in the shader cache
+    uint64_t spirvHash = 0;
 
     rdcstr unstrippedPath;
 
     std::map<ShaderModuleReflectionKey, ShaderModuleReflection> m_Reflections;
+
+    // while loading, the SPIR-V is parsed on a worker thread and reflections are queued up to be
+    // run in bulk - see FinishShaderLoading()
+    JobSystem::Job *loadJob = NULL;
+    double parseTime = 0.0;
+
+    struct PendingReflection
+    {
+      ShaderModuleReflection *reflData;
+      VulkanShaderCache *shaderCache;
+      ResourceId origId;
+      VkShaderStageFlagBits stage;
+      rdcarray<SpecConstant> specInfo;
+    };
+    rdcarray<PendingReflection> pendingReflections;
+    double reflectTime = 0.0;
   };
   std::map<ResourceId, ShaderModule> m_ShaderModule;
 
+  // set while the capture's initialisation chunks are being read, so that shader modules can be
+  // parsed and reflected on the job system instead of serially on the loading thread.
+  bool m_DeferShaderLoading = false;
+
+  // finishes all shader module work deferred while loading, and stops deferring new modules.
+  void FinishShaderLoading();
+
   struct DescSetPool
   {
     void Init(VulkanResourceManager *resourceMan, VulkanCreationInfo &info,
@@ -565,6 +611,10 @@ struct VulkanCreationInfo
   // just contains the queueFamilyIndex (after remapping)
   std::map<ResourceId, uint32_t> m_Queue;
 
+  // the driver's shader cache, which holds reflections from previous sessions. May be NULL before
+  // the device is created.
+  VulkanShaderCache *m_ShaderCache = NULL;
+
   void erase(ResourceId id)
   {
     m_Pipeline.erase(id);
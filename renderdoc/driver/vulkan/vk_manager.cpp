@@ -822,6 +822,11 @@ void VulkanResourceManager::RecordBarriers(std::map<ResourceId, ImageState> &sta
 
 ResourceId VulkanResourceManager::GetFirstIDForHandle(uint64_t handle)
 {
+  // the map is unordered, so to stay deterministic when several resources share a handle, return
+  // the lowest matching ID as the ordered map used to.
+  ResourceId first;
+  WrappedVkRes *firstRes = NULL;
+
   for(auto it = m_CurrentResourceMap.begin(); it != m_CurrentResourceMap.end(); ++it)
   {
     WrappedVkRes *res = it->second;
@@ -829,21 +834,26 @@ ResourceId VulkanResourceManager::GetFirstIDForHandle(uint64_t handle)
     if(!res)
       continue;
 
-    if(IsDispatchableRes(res))
-    {
-      WrappedVkDispRes *disp = (WrappedVkDispRes *)res;
-      if(disp->real.handle == handle)
-        return IsReplayMode(m_State) ? GetOriginalID(disp->id) : disp->id;
-    }
-    else
+    if(firstRes && !(it->first < first))
+      continue;
+
+    uint64_t realHandle = IsDispatchableRes(res) ? ((WrappedVkDispRes *)res)->real.handle
+                                                 : ((WrappedVkNonDispRes *)res)->real.handle;
+
+    if(realHandle == handle)
     {
-      WrappedVkNonDispRes *nondisp = (WrappedVkNonDispRes *)res;
-      if(nondisp->real.handle == handle)
-        return IsReplayMode(m_State) ? GetOriginalID(nondisp->id) : nondisp->id;
+      first = it->first;
+      firstRes = res;
     }
   }
 
-  return ResourceId();
+  if(!firstRes)
+    return ResourceId();
+
+  ResourceId id = IsDispatchableRes(firstRes) ? ((WrappedVkDispRes *)firstRes)->id
+                                              : ((WrappedVkNonDispRes *)firstRes)->id;
+
+  return IsReplayMode(m_State) ? GetOriginalID(id) : id;
 }
 
 void VulkanResourceManager::MarkMemoryFrameReferenced(ResourceId mem, VkDeviceSize offset,
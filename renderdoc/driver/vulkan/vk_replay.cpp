@@ -417,6 +417,8 @@ rdcarray<ShaderEntryPoint> VulkanReplay::GetShaderEntryPoints(ResourceId shader)
   if(shad == m_pDriver->m_CreationInfo.m_ShaderModule.end())
     return {};
 
+  shad->second.FinishLoading();
+
   rdcarray<rdcstr> entries = shad->second.spirv.EntryPoints();
 
   rdcarray<ShaderEntryPoint> ret;
@@ -441,7 +443,7 @@ ShaderReflection *VulkanReplay::GetShader(ResourceId pipeline, ResourceId shader
   // if this shader was never used in a pipeline the reflection won't be prepared. Do that now -
   // this will be ignored if it was already prepared.
   shad->second.GetReflection(entry.name, pipeline)
-      .Init(GetResourceManager(), shader, shad->second.spirv, entry.name,
+      .Init(GetResourceManager(), m_pDriver->GetShaderCache(), shader, shad->second, entry.name,
             VkShaderStageFlagBits(1 << uint32_t(entry.stage)), {});
 
   return &shad->second.GetReflection(entry.name, pipeline).refl;
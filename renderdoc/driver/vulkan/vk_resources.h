@@ -1081,7 +1081,8 @@ struct MemMapState
         mapFlushed(false),
         mapCoherent(false),
         mappedPtr(NULL),
-        refData(NULL)
+        refData(NULL),
+        writeTracking(NULL)
   {
   }
   VkDeviceSize mapOffset, mapSize;
@@ -1090,6 +1091,8 @@ struct MemMapState
   bool mapCoherent;
   byte *mappedPtr;
   byte *refData;
+  // if page tracking is enabled for coherent maps, tracks writes to the mapped range
+  PageTracking::Region *writeTracking;
   Threading::CriticalSection mrLock;
 };
 
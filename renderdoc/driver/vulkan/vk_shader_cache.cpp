@@ -23,9 +23,16 @@
  ******************************************************************************/
 
 #include "vk_shader_cache.h"
+#include "api/replay/version.h"
 #include "common/shader_cache.h"
+#include "core/settings.h"
 #include "data/glsl_shaders.h"
 #include "strings/string_utils.h"
+#include "zstd/xxhash.h"
+
+RDOC_CONFIG(uint32_t, Vulkan_ReflectionCacheSize, 16384,
+            "The most shader reflections to keep in the on-disk cache between sessions. If 0 "
+            "reflections are not cached.");
 
 enum class FeatureCheck
 {
@@ -120,6 +127,103 @@ struct VulkanBlobShaderCallbacks
   const byte *GetData(SPIRVBlob blob) const { return (const byte *)blob->data(); }
 } VulkanShaderCacheCallbacks;
 
+struct VulkanReflectionCacheCallbacks
+{
+  bool Create(uint32_t size, byte *data, bytebuf **ret) const
+  {
+    RDCASSERT(ret);
+
+    *ret = new bytebuf(data, size);
+
+    return true;
+  }
+
+  void Destroy(bytebuf *blob) const { delete blob; }
+  uint32_t GetSize(bytebuf *blob) const { return (uint32_t)blob->size(); }
+  const byte *GetData(bytebuf *blob) const { return blob->data(); }
+} VulkanReflectionCacheCallbacks;
+
+DECLARE_REFLECTION_STRUCT(SPIRVInterfaceAccess);
+DECLARE_REFLECTION_STRUCT(SPIRVPatchData);
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, SPIRVInterfaceAccess &el)
+{
+  uint32_t ID = el.ID.value();
+  uint32_t structID = el.structID.value();
+  SERIALISE_ELEMENT(ID);
+  SERIALISE_ELEMENT(structID);
+  el.ID = rdcspv::Id::fromWord(ID);
+  el.structID = rdcspv::Id::fromWord(structID);
+
+  SERIALISE_MEMBER(structMemberIndex);
+  SERIALISE_MEMBER(accessChain);
+  SERIALISE_MEMBER(isArraySubsequentElement);
+}
+
+template <typename SerialiserType>
+void DoSerialise(SerialiserType &ser, SPIRVPatchData &el)
+{
+  SERIALISE_MEMBER(inputs);
+  SERIALISE_MEMBER(outputs);
+  SERIALISE_MEMBER(outTopo);
+}
+
+static bytebuf *EncodeReflection(uint64_t key, const ShaderReflection &refl,
+                                 const ShaderBindpointMapping &mapping,
+                                 const SPIRVPatchData &patchData)
+{
+  WriteSerialiser ser(new StreamWriter(4 * 1024), Ownership::Stream);
+
+  {
+    SCOPED_SERIALISE_CHUNK(1);
+
+    uint64_t storedKey = key;
+    SERIALISE_ELEMENT(storedKey);
+
+    // the serialiser takes mutable references even when writing
+    ser.Serialise("refl"_lit, (ShaderReflection &)refl);
+    ser.Serialise("mapping"_lit, (ShaderBindpointMapping &)mapping);
+    ser.Serialise("patchData"_lit, (SPIRVPatchData &)patchData);
+  }
+
+  StreamWriter *writer = ser.GetWriter();
+  return new bytebuf(writer->GetData(), (size_t)writer->GetOffset());
+}
+
+static bool DecodeReflection(const bytebuf &blob, uint64_t key, ShaderReflection &refl,
+                             ShaderBindpointMapping &mapping, SPIRVPatchData &patchData)
+{
+  ReadSerialiser ser(new StreamReader(blob), Ownership::Stream);
+
+  ser.ReadChunk<uint32_t>();
+
+  // entries are stored under the bottom 32 bits of the key, so check the whole key in case this
+  // entry is for a different reflection that happens to share them
+  uint64_t storedKey = 0;
+  SERIALISE_ELEMENT(storedKey);
+
+  if(ser.IsErrored() || storedKey != key)
+    return false;
+
+  SERIALISE_ELEMENT(refl);
+  SERIALISE_ELEMENT(mapping);
+  SERIALISE_ELEMENT(patchData);
+
+  ser.EndChunk();
+
+  if(ser.IsErrored())
+  {
+    RDCWARN("Corrupt cached reflection for key %016llx", key);
+    refl = ShaderReflection();
+    mapping = ShaderBindpointMapping();
+    patchData = SPIRVPatchData();
+    return false;
+  }
+
+  return true;
+}
+
 VulkanShaderCache::VulkanShaderCache(WrappedVulkan *driver)
 {
   // Load shader cache, if present
@@ -240,6 +344,39 @@ VulkanShaderCache::~VulkanShaderCache()
       VulkanShaderCacheCallbacks.Destroy(it->second);
   }
 
+  if(m_ReflectionCacheDirty)
+  {
+    // drop reflections that weren't used this session first, then any others, to fit in the limit
+    for(auto it = m_ReflectionCache.begin();
+        it != m_ReflectionCache.end() && m_ReflectionCache.size() > Vulkan_ReflectionCacheSize;)
+    {
+      if(m_ReflectionsUsed.find(it->first) == m_ReflectionsUsed.end())
+      {
+        VulkanReflectionCacheCallbacks.Destroy(it->second);
+        it = m_ReflectionCache.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    while(m_ReflectionCache.size() > Vulkan_ReflectionCacheSize)
+    {
+      VulkanReflectionCacheCallbacks.Destroy(m_ReflectionCache.begin()->second);
+      m_ReflectionCache.erase(m_ReflectionCache.begin());
+    }
+
+    if(!m_ReflectionCache.empty())
+      SaveShaderCache("vkreflection.cache", m_ReflectionCacheMagic, m_ReflectionCacheVersion,
+                      m_ReflectionCache, VulkanReflectionCacheCallbacks);
+  }
+  else
+  {
+    for(auto it = m_ReflectionCache.begin(); it != m_ReflectionCache.end(); ++it)
+      VulkanReflectionCacheCallbacks.Destroy(it->second);
+  }
+
   for(size_t i = 0; i < ARRAY_COUNT(m_BuiltinShaderModules); i++)
     m_pDriver->vkDestroyShaderModule(m_Device, m_BuiltinShaderModules[i], NULL);
 }
@@ -289,6 +426,97 @@ rdcstr VulkanShaderCache::GetSPIRVBlob(const rdcspv::CompilationSettings &settin
   return errors;
 }
 
+uint64_t VulkanShaderCache::GetReflectionKey(uint64_t spirvHash, ShaderStage stage,
+                                             const rdcstr &entryPoint,
+                                             const rdcarray<SpecConstant> &specInfo)
+{
+  // reflection output changes between builds, so include the build's hash. Stale entries from
+  // other builds are then never used, and are evicted first once the cache fills up.
+  uint64_t hash = XXH64(GitVersionHash, sizeof(GitVersionHash), spirvHash);
+  hash = XXH64(&stage, sizeof(stage), hash);
+  hash = XXH64(entryPoint.c_str(), entryPoint.size() + 1, hash);
+
+  for(const SpecConstant &spec : specInfo)
+  {
+    hash = XXH64(&spec.specID, sizeof(spec.specID), hash);
+    hash = XXH64(&spec.value, sizeof(spec.value), hash);
+    hash = XXH64(&spec.dataSize, sizeof(spec.dataSize), hash);
+  }
+
+  return hash;
+}
+
+void VulkanShaderCache::LoadReflectionCache()
+{
+  // the cache is created while capturing too, where reflections are never looked up, so it's only
+  // read from disk once it's first needed
+  if(m_ReflectionCacheLoaded)
+    return;
+
+  m_ReflectionCacheLoaded = true;
+
+  bool success = LoadShaderCache("vkreflection.cache", m_ReflectionCacheMagic,
+                                 m_ReflectionCacheVersion, m_ReflectionCache,
+                                 VulkanReflectionCacheCallbacks);
+
+  m_ReflectionCacheDirty = !success;
+}
+
+bool VulkanShaderCache::GetReflection(uint64_t key, ShaderReflection &refl,
+                                      ShaderBindpointMapping &mapping, SPIRVPatchData &patchData)
+{
+  if(Vulkan_ReflectionCacheSize == 0)
+    return false;
+
+  uint32_t hash = uint32_t(key & 0xffffffff);
+
+  bytebuf blob;
+
+  {
+    SCOPED_LOCK(m_ReflectionLock);
+    LoadReflectionCache();
+
+    auto it = m_ReflectionCache.find(hash);
+    if(it == m_ReflectionCache.end())
+      return false;
+
+    blob = *it->second;
+  }
+
+  if(!DecodeReflection(blob, key, refl, mapping, patchData))
+    return false;
+
+  {
+    SCOPED_LOCK(m_ReflectionLock);
+    m_ReflectionsUsed.insert(hash);
+  }
+
+  return true;
+}
+
+void VulkanShaderCache::SetReflection(uint64_t key, const ShaderReflection &refl,
+                                      const ShaderBindpointMapping &mapping,
+                                      const SPIRVPatchData &patchData)
+{
+  if(Vulkan_ReflectionCacheSize == 0)
+    return;
+
+  bytebuf *blob = EncodeReflection(key, refl, mapping, patchData);
+
+  uint32_t hash = uint32_t(key & 0xffffffff);
+
+  SCOPED_LOCK(m_ReflectionLock);
+  LoadReflectionCache();
+
+  auto it = m_ReflectionCache.find(hash);
+  if(it != m_ReflectionCache.end())
+    VulkanReflectionCacheCallbacks.Destroy(it->second);
+
+  m_ReflectionCache[hash] = blob;
+  m_ReflectionsUsed.insert(hash);
+  m_ReflectionCacheDirty = true;
+}
+
 void VulkanShaderCache::MakeGraphicsPipelineInfo(VkGraphicsPipelineCreateInfo &pipeCreateInfo,
                                                  ResourceId pipeline)
 {
@@ -716,3 +944,124 @@ void VulkanShaderCache::MakeComputePipelineInfo(VkComputePipelineCreateInfo &pip
 
   pipeCreateInfo = ret;
 }
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+
+TEST_CASE("Check Vulkan reflection cache entries", "[vulkan][reflection]")
+{
+  ShaderReflection refl;
+  refl.entryPoint = "main";
+  refl.stage = ShaderStage::Vertex;
+  refl.debugInfo.files = {{"shader.vert", "void main() {}"}};
+
+  SigParameter sig;
+  sig.varName = "pos";
+  sig.regIndex = 0;
+  sig.compCount = 4;
+  sig.compType = CompType::Float;
+  refl.inputSignature = {sig};
+
+  ConstantBlock cblock = {};
+  cblock.name = "ubo";
+  cblock.bindPoint = 0;
+  cblock.byteSize = 80;
+  cblock.bufferBacked = true;
+  cblock.variables.resize(2);
+  cblock.variables[0].name = "scale";
+  cblock.variables[1].name = "transform";
+  cblock.variables[1].byteOffset = 16;
+  refl.constantBlocks = {cblock};
+
+  ShaderResource tex = {};
+  tex.name = "tex";
+  tex.resType = TextureType::Texture2D;
+  tex.bindPoint = 0;
+  tex.isTexture = true;
+  tex.isReadOnly = true;
+  refl.readOnlyResources = {tex};
+
+  ShaderBindpointMapping mapping;
+  mapping.inputAttributes = {0};
+  mapping.constantBlocks = {Bindpoint(0, 0)};
+  mapping.readOnlyResources = {Bindpoint(1, 2)};
+
+  SPIRVPatchData patchData;
+  SPIRVInterfaceAccess access;
+  access.ID = rdcspv::Id::fromWord(12);
+  access.structID = rdcspv::Id::fromWord(7);
+  access.structMemberIndex = 1;
+  access.accessChain = {1, 3};
+  patchData.inputs = {access};
+  patchData.outTopo = Topology::TriangleList;
+
+  uint64_t spirvHash = 0x0123456789abcdefULL;
+  uint64_t key = VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Vertex, "main", {});
+
+  SECTION("Keys cover everything that affects reflection")
+  {
+    CHECK(key == VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Vertex, "main", {}));
+    CHECK(key !=
+          VulkanShaderCache::GetReflectionKey(spirvHash + 1, ShaderStage::Vertex, "main", {}));
+    CHECK(key !=
+          VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Fragment, "main", {}));
+    CHECK(key != VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Vertex, "main2", {}));
+
+    uint64_t specKey = VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Vertex, "main",
+                                                           {SpecConstant(3, 8, 4)});
+    CHECK(key != specKey);
+    CHECK(specKey != VulkanShaderCache::GetReflectionKey(spirvHash, ShaderStage::Vertex, "main",
+                                                         {SpecConstant(3, 9, 4)}));
+  };
+
+  SECTION("Entries decode to the same reflection")
+  {
+    bytebuf *blob = EncodeReflection(key, refl, mapping, patchData);
+
+    ShaderReflection cachedRefl;
+    ShaderBindpointMapping cachedMapping;
+    SPIRVPatchData cachedPatchData;
+    REQUIRE(DecodeReflection(*blob, key, cachedRefl, cachedMapping, cachedPatchData));
+
+    CHECK(cachedRefl.entryPoint == "main");
+    CHECK((cachedRefl.inputSignature == refl.inputSignature));
+    REQUIRE(cachedRefl.constantBlocks.size() == 1);
+    CHECK(cachedRefl.constantBlocks[0].variables[1].name == "transform");
+    CHECK(cachedRefl.readOnlyResources[0].name == "tex");
+    CHECK(cachedRefl.debugInfo.files[0].contents == "void main() {}");
+    CHECK((cachedMapping.readOnlyResources == mapping.readOnlyResources));
+    REQUIRE(cachedPatchData.inputs.size() == 1);
+    CHECK(cachedPatchData.inputs[0].ID == access.ID);
+    CHECK(cachedPatchData.inputs[0].structID == access.structID);
+    CHECK(cachedPatchData.inputs[0].accessChain == access.accessChain);
+    CHECK(cachedPatchData.outTopo == Topology::TriangleList);
+
+    // everything else is checked by encoding the decoded reflection again
+    bytebuf *reencoded = EncodeReflection(key, cachedRefl, cachedMapping, cachedPatchData);
+    CHECK(*reencoded == *blob);
+
+    delete reencoded;
+    delete blob;
+  };
+
+  SECTION("Mismatched or damaged entries are rejected")
+  {
+    bytebuf *blob = EncodeReflection(key, refl, mapping, patchData);
+
+    ShaderReflection cachedRefl;
+    ShaderBindpointMapping cachedMapping;
+    SPIRVPatchData cachedPatchData;
+    CHECK_FALSE(DecodeReflection(*blob, key ^ 0x100000000ULL, cachedRefl, cachedMapping,
+                                 cachedPatchData));
+
+    bytebuf truncated;
+    truncated.assign(blob->data(), blob->size() / 2);
+    CHECK_FALSE(DecodeReflection(truncated, key, cachedRefl, cachedMapping, cachedPatchData));
+    CHECK(cachedRefl.inputSignature.empty());
+
+    delete blob;
+  };
+}
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
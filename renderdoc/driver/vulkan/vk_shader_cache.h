@@ -80,10 +80,26 @@ public:
 
   rdcstr GetGlobalDefines() { return m_GlobalDefines; }
   void SetCaching(bool enabled) { m_CacheShaders = enabled; }
+
+  // reflecting a shader module is expensive and the same modules tend to be used across many
+  // captures, so reflections are kept on disk between sessions. The key combines the module's
+  // hash with everything else that affects the reflection.
+  static uint64_t GetReflectionKey(uint64_t spirvHash, ShaderStage stage, const rdcstr &entryPoint,
+                                   const rdcarray<SpecConstant> &specInfo);
+  bool GetReflection(uint64_t key, ShaderReflection &refl, ShaderBindpointMapping &mapping,
+                     SPIRVPatchData &patchData);
+  void SetReflection(uint64_t key, const ShaderReflection &refl,
+                     const ShaderBindpointMapping &mapping, const SPIRVPatchData &patchData);
+
 private:
   static const uint32_t m_ShaderCacheMagic = 0xf00d00d5;
   static const uint32_t m_ShaderCacheVersion = 1;
 
+  static const uint32_t m_ReflectionCacheMagic = 0xf00d00d6;
+  static const uint32_t m_ReflectionCacheVersion = 1;
+
+  void LoadReflectionCache();
+
   WrappedVulkan *m_pDriver = NULL;
   VkDevice m_Device = VK_NULL_HANDLE;
 
@@ -92,6 +108,14 @@ private:
   bool m_ShaderCacheDirty = false, m_CacheShaders = false;
   std::map<uint32_t, SPIRVBlob> m_ShaderCache;
 
+  // reflections can be looked up from several threads at once
+  Threading::CriticalSection m_ReflectionLock;
+  bool m_ReflectionCacheLoaded = false;
+  bool m_ReflectionCacheDirty = false;
+  std::map<uint32_t, bytebuf *> m_ReflectionCache;
+  // the reflections used this session, which are kept first if the cache is over its size limit
+  std::set<uint32_t> m_ReflectionsUsed;
+
   SPIRVBlob m_BuiltinShaderBlobs[arraydim<BuiltinShader>()] = {NULL};
   VkShaderModule m_BuiltinShaderModules[arraydim<BuiltinShader>()] = {VK_NULL_HANDLE};
 };
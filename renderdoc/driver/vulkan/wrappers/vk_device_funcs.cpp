@@ -846,6 +846,7 @@ void WrappedVulkan::Shutdown()
 
   // destroy debug manager and any objects it created
   SAFE_DELETE(m_DebugManager);
+  m_CreationInfo.m_ShaderCache = NULL;
   SAFE_DELETE(m_ShaderCache);
 
   if(m_Instance && ObjDisp(m_Instance)->DestroyDebugReportCallbackEXT &&
@@ -3036,6 +3037,7 @@ bool WrappedVulkan::Serialise_vkCreateDevice(SerialiserType &ser, VkPhysicalDevi
     SetDebugMessageSink(NULL);
 
     m_ShaderCache = new VulkanShaderCache(this);
+    m_CreationInfo.m_ShaderCache = m_ShaderCache;
 
     m_DebugManager = new VulkanDebugManager(this);
 
@@ -3491,6 +3493,7 @@ VkResult WrappedVulkan::vkCreateDevice(VkPhysicalDevice physicalDevice,
     memcpy(m_PhysicalDeviceData.queueProps, props, qCount * sizeof(VkQueueFamilyProperties));
 
     m_ShaderCache = new VulkanShaderCache(this);
+    m_CreationInfo.m_ShaderCache = m_ShaderCache;
 
     m_TextRenderer = new VulkanTextRenderer(this);
 
@@ -3520,6 +3523,7 @@ void WrappedVulkan::vkDestroyDevice(VkDevice device, const VkAllocationCallbacks
 
   // delete all debug manager objects
   SAFE_DELETE(m_DebugManager);
+  m_CreationInfo.m_ShaderCache = NULL;
   SAFE_DELETE(m_ShaderCache);
   SAFE_DELETE(m_TextRenderer);
 
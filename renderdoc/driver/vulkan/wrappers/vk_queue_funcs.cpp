@@ -509,6 +509,9 @@ bool WrappedVulkan::PatchIndirectDraw(size_t drawIndex, uint32_t paramStride,
     if(chunk->metadata.chunkID != (uint32_t)VulkanChunk::vkCmdIndirectSubCommand)
       chunk = m_StructuredFile->chunks[draw.events.back().chunkIndex - 1];
 
+    // mutable access keeps a lazily populated chunk populated, so that the patches below persist
+    chunk->GetChildren();
+
     SDObject *drawIdx = chunk->FindChild("drawIndex");
 
     if(drawIdx)
@@ -1040,8 +1043,8 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
             continue;
           }
 
-          size_t diffStart = 0, diffEnd = 0;
-          bool found = true;
+          // ranges relative to the start of the map that need to be flushed
+          rdcarray<rdcpair<size_t, size_t>> diffRanges;
 
 // enabled as this is necessary for programs with very large coherent mappings
 // (> 1GB) as otherwise more than a couple of vkQueueSubmit calls leads to vast
@@ -1066,28 +1069,56 @@ VkResult WrappedVulkan::vkQueueSubmit(VkQueue queue, uint32_t submitCount,
           // shouldn't miss anything
           state.needRefData = true;
 
+          byte *mapData = state.mappedPtr + (size_t)state.mapOffset;
+
+          // if writes are being tracked, only the pages written since the last submit can differ.
+          // Collecting them also protects them again, before we read anything below.
+          rdcarray<rdcpair<size_t, size_t>> writtenRanges;
+          if(state.writeTracking)
+            PageTracking::GetDirtyRanges(state.writeTracking, writtenRanges);
+          else
+            writtenRanges.push_back({0, (size_t)state.mapSize});
+
           // if we have a previous set of data, compare.
           // otherwise just serialise it all
           if(state.refData)
-            found = FindDiffRange((byte *)state.mappedPtr, state.refData, (size_t)state.mapSize,
-                                  diffStart, diffEnd);
+          {
+            // separate changes closer than this are flushed together, since each range has its
+            // own overhead in the serialised flush.
+            const size_t mergeGap = 4096;
+
+            rdcarray<rdcpair<size_t, size_t>> changed;
+            for(const rdcpair<size_t, size_t> &written : writtenRanges)
+            {
+              FindDiffRanges(mapData + written.first, state.refData + written.first,
+                             written.second - written.first, mergeGap, changed);
+
+              for(const rdcpair<size_t, size_t> &diff : changed)
+                diffRanges.push_back({written.first + diff.first, written.first + diff.second});
+            }
+          }
           else
 #endif
-            diffEnd = (size_t)state.mapSize;
+            diffRanges.push_back({0, (size_t)state.mapSize});
 
-          if(found)
+          if(!diffRanges.empty())
           {
             // MULTIDEVICE should find the device for this queue.
             // MULTIDEVICE only want to flush maps associated with this queue
             VkDevice dev = GetDev();
 
             {
-              RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
-                     ToStr(record->GetResourceID()).c_str(), (uint64_t)diffStart, (uint64_t)diffEnd);
-              VkMappedMemoryRange range = {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
-                                           (VkDeviceMemory)(uint64_t)record->Resource,
-                                           state.mapOffset + diffStart, diffEnd - diffStart};
-              vkFlushMappedMemoryRanges(dev, 1, &range);
+              rdcarray<VkMappedMemoryRange> ranges;
+              for(const rdcpair<size_t, size_t> &diff : diffRanges)
+              {
+                RDCLOG("Persistent map flush forced for %s (%llu -> %llu)",
+                       ToStr(record->GetResourceID()).c_str(), (uint64_t)diff.first,
+                       (uint64_t)diff.second);
+                ranges.push_back({VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, NULL,
+                                  (VkDeviceMemory)(uint64_t)record->Resource,
+                                  state.mapOffset + diff.first, diff.second - diff.first});
+              }
+              vkFlushMappedMemoryRanges(dev, (uint32_t)ranges.size(), ranges.data());
               state.mapFlushed = false;
             }
 
@@ -537,6 +537,12 @@ void WrappedVulkan::vkFreeMemory(VkDevice device, VkDeviceMemory memory,
       wrapped->record->memMapState->refData = NULL;
     }
 
+    if(wrapped->record->memMapState && wrapped->record->memMapState->writeTracking)
+    {
+      PageTracking::Untrack(wrapped->record->memMapState->writeTracking);
+      wrapped->record->memMapState->writeTracking = NULL;
+    }
+
     {
       SCOPED_LOCK(m_CoherentMapsLock);
       m_CoherentMaps.removeOne(wrapped->record);
@@ -587,6 +593,9 @@ VkResult WrappedVulkan::vkMapMemory(VkDevice device, VkDeviceMemory mem, VkDevic
 
       if(state.mapCoherent)
       {
+        if(RenderDoc::Inst().IsMapPageTrackingEnabled())
+          state.writeTracking = PageTracking::Track(realData, (size_t)state.mapSize);
+
         SCOPED_LOCK(m_CoherentMapsLock);
         m_CoherentMaps.push_back(memrecord);
       }
@@ -726,6 +735,9 @@ void WrappedVulkan::vkUnmapMemory(VkDevice device, VkDeviceMemory mem)
 
     FreeAlignedBuffer(state.refData);
     state.refData = NULL;
+
+    PageTracking::Untrack(state.writeTracking);
+    state.writeTracking = NULL;
   }
 
   ObjDisp(device)->UnmapMemory(Unwrap(device), Unwrap(mem));
@@ -801,7 +813,9 @@ bool WrappedVulkan::Serialise_vkFlushMappedMemoryRanges(SerialiserType &ser, VkD
 
     const byte *serialisedData = ser.GetWriter()->GetData() + offs;
 
-    memcpy(state->refData, serialisedData, (size_t)memRangeSize);
+    // the reference data is relative to the start of the map
+    memcpy(state->refData + size_t(MemRange.offset - state->mapOffset), serialisedData,
+           (size_t)memRangeSize);
   }
 
   return true;
@@ -30,6 +30,11 @@
 #include "common/common.h"
 #include "os/os_specific.h"
 
+#if ENABLED(RDOC_SSE2)
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
 //	for(int i=0; i < 256; i++)
 //	{
 //		uint8_t comp = i&0xff;
@@ -338,7 +343,6 @@ FloatVector ConvertComponents(const ResourceFormat &fmt, const byte *data)
     ret.x = v.x;
     ret.y = v.y;
     ret.z = v.z;
-    RDCLOG("%x -> %f,%f,%f", *(const uint32_t *)data, v.x, v.y, v.z);
   }
   else
   {
@@ -483,6 +487,637 @@ FloatVector ConvertComponents(const ResourceFormat &fmt, const byte *data)
   return ret;
 }
 
+// the array conversions below are vectorised with SSE2 on x86, with AVX2 kernels for the regular
+// formats when the CPU supports it. Everywhere else (and for the left-over elements at the end of
+// an array) they use the scalar conversions above.
+namespace
+{
+// how many elements are decoded at once, sized so the intermediate data stays on the stack
+const size_t DecodeChunk = 256;
+
+#if ENABLED(RDOC_SSE2)
+
+inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i Max32(__m128i a, __m128i b)
+{
+  return Select(_mm_cmpgt_epi32(a, b), a, b);
+}
+
+inline __m128 Scale(__m128i v, float divisor)
+{
+  return _mm_div_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(divisor));
+}
+
+// converts 4 half floats, each in the low 16 bits of a lane, exactly like ConvertFromHalf
+inline __m128 HalfToFloat(__m128i h)
+{
+  const __m128i sign = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16);
+  const __m128i exponent = _mm_and_si128(h, _mm_set1_epi32(0x7c00));
+  const __m128i mantissa = _mm_and_si128(h, _mm_set1_epi32(0x03ff));
+  const __m128i zero = _mm_setzero_si128();
+
+  // normal values only need the exponent re-biased, then everything shifted into place
+  __m128i normal = _mm_add_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)),
+                                 _mm_set1_epi32((127 - 15) << 10));
+  normal = _mm_or_si128(sign, _mm_slli_epi32(normal, 13));
+
+  // subnormals are mantissa * 2^-24 which a float holds exactly. Both zeroes become +0
+  __m128i subnormal =
+      _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(mantissa), _mm_set1_ps(1.0f / 16777216.0f)));
+  subnormal = _mm_or_si128(subnormal, _mm_andnot_si128(_mm_cmpeq_epi32(mantissa, zero), sign));
+
+  // infinities keep their sign, every NaN becomes the same value
+  const __m128i special = Select(_mm_cmpeq_epi32(mantissa, zero),
+                                 _mm_or_si128(sign, _mm_set1_epi32(0x7f800000)),
+                                 _mm_set1_epi32(0x7f800001));
+
+  __m128i ret = Select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7c00)), special, normal);
+  ret = Select(_mm_cmpeq_epi32(exponent, zero), subnormal, ret);
+
+  return _mm_castsi128_ps(ret);
+}
+
+// decodes one channel of 4 R11G11B10 values, where bits holds the channel's exponent and mantissa
+inline __m128 SmallFloatToFloat(__m128i bits, int mantissaBits)
+{
+  const __m128i mantissa = _mm_and_si128(bits, _mm_set1_epi32((1 << mantissaBits) - 1));
+  const __m128i exponent = _mm_srli_epi32(bits, mantissaBits);
+  const __m128i shiftedMantissa = _mm_slli_epi32(mantissa, 23 - mantissaBits);
+
+  const __m128i normal = _mm_or_si128(
+      _mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 15)), 23), shiftedMantissa);
+
+  // subnormals (and zero) are mantissa * 2^-(14 + mantissaBits), which a float holds exactly
+  const __m128i subnormal = _mm_castps_si128(_mm_mul_ps(
+      _mm_cvtepi32_ps(mantissa), _mm_set1_ps(1.0f / float(1 << (14 + mantissaBits)))));
+
+  const __m128i special = _mm_or_si128(_mm_set1_epi32(0x7f800000), shiftedMantissa);
+
+  __m128i ret = Select(_mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x1f)), special, normal);
+  ret = Select(_mm_cmpeq_epi32(exponent, _mm_setzero_si128()), subnormal, ret);
+
+  return _mm_castsi128_ps(ret);
+}
+
+// transposes 4 channels of 4 elements into 4 RGBA elements
+inline void StoreRGBA(FloatVector *out, __m128 r, __m128 g, __m128 b, __m128 a)
+{
+  _MM_TRANSPOSE4_PS(r, g, b, a);
+  _mm_storeu_ps(&out[0].x, r);
+  _mm_storeu_ps(&out[1].x, g);
+  _mm_storeu_ps(&out[2].x, b);
+  _mm_storeu_ps(&out[3].x, a);
+}
+
+inline __m128i Load16x4(const uint16_t *src)
+{
+  return _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)src), _mm_setzero_si128());
+}
+
+// the AVX2 kernels are only called if this is set. The tests clear it to check the SSE2 kernels
+bool useAVX2 = CPUHasAVX2();
+
+AVX2_FUNCTION inline __m256i Select256(__m256i mask, __m256i a, __m256i b)
+{
+  return _mm256_blendv_epi8(b, a, mask);
+}
+
+// 8-wide version of HalfToFloat
+AVX2_FUNCTION inline __m256 HalfToFloat256(__m256i h)
+{
+  const __m256i sign = _mm256_slli_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x8000)), 16);
+  const __m256i exponent = _mm256_and_si256(h, _mm256_set1_epi32(0x7c00));
+  const __m256i mantissa = _mm256_and_si256(h, _mm256_set1_epi32(0x03ff));
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i zeroMantissa = _mm256_cmpeq_epi32(mantissa, zero);
+
+  __m256i normal = _mm256_add_epi32(_mm256_and_si256(h, _mm256_set1_epi32(0x7fff)),
+                                    _mm256_set1_epi32((127 - 15) << 10));
+  normal = _mm256_or_si256(sign, _mm256_slli_epi32(normal, 13));
+
+  __m256i subnormal = _mm256_castps_si256(
+      _mm256_mul_ps(_mm256_cvtepi32_ps(mantissa), _mm256_set1_ps(1.0f / 16777216.0f)));
+  subnormal = _mm256_or_si256(subnormal, _mm256_andnot_si256(zeroMantissa, sign));
+
+  const __m256i special = Select256(
+      zeroMantissa, _mm256_or_si256(sign, _mm256_set1_epi32(0x7f800000)),
+      _mm256_set1_epi32(0x7f800001));
+
+  __m256i ret = Select256(_mm256_cmpeq_epi32(exponent, _mm256_set1_epi32(0x7c00)), special, normal);
+  ret = Select256(_mm256_cmpeq_epi32(exponent, zero), subnormal, ret);
+
+  return _mm256_castsi256_ps(ret);
+}
+
+AVX2_FUNCTION size_t ConvertFromHalf_AVX2(const uint16_t *src, float *dst, size_t count)
+{
+  size_t i = 0;
+  for(; i + 16 <= count; i += 16)
+  {
+    __m256i lo = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+    __m256i hi = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(src + i + 8)));
+    _mm256_storeu_ps(dst + i, HalfToFloat256(lo));
+    _mm256_storeu_ps(dst + i + 8, HalfToFloat256(hi));
+  }
+  return i;
+}
+
+// the same conversions as the SSE2 part of DecodeComponents, widening straight to 8 dwords. 32-bit
+// components are left to SSE2, since they don't need widening and gain nothing from AVX2.
+AVX2_FUNCTION size_t DecodeComponents_AVX2(CompType compType, uint32_t byteWidth, const byte *src,
+                                           float *dst, size_t count)
+{
+  const bool isSigned =
+      (compType == CompType::SInt || compType == CompType::SScaled || compType == CompType::SNorm);
+
+  size_t i = 0;
+
+  if(byteWidth == 1)
+  {
+    for(; i + 8 <= count; i += 8)
+    {
+      __m128i bytes = _mm_loadl_epi64((const __m128i *)(src + i));
+      __m256i v;
+
+      if(isSigned)
+      {
+        v = _mm256_cvtepi8_epi32(bytes);
+        if(compType == CompType::SNorm)
+          v = _mm256_max_epi32(v, _mm256_set1_epi32(-127));
+      }
+      else
+      {
+        v = _mm256_cvtepu8_epi32(bytes);
+      }
+
+      __m256 f = _mm256_cvtepi32_ps(v);
+
+      if(compType == CompType::UNorm)
+        f = _mm256_div_ps(f, _mm256_set1_ps(255.0f));
+      else if(compType == CompType::SNorm)
+        f = _mm256_div_ps(f, _mm256_set1_ps(127.0f));
+
+      _mm256_storeu_ps(dst + i, f);
+    }
+  }
+  else if(byteWidth == 2)
+  {
+    for(; i + 8 <= count; i += 8)
+    {
+      __m128i words = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      __m256i v;
+
+      if(isSigned)
+      {
+        v = _mm256_cvtepi16_epi32(words);
+        if(compType == CompType::SNorm)
+          v = _mm256_max_epi32(v, _mm256_set1_epi32(-32767));
+      }
+      else
+      {
+        v = _mm256_cvtepu16_epi32(words);
+      }
+
+      __m256 f = _mm256_cvtepi32_ps(v);
+
+      if(compType == CompType::UNorm || compType == CompType::Depth)
+        f = _mm256_div_ps(f, _mm256_set1_ps(65535.0f));
+      else if(compType == CompType::SNorm)
+        f = _mm256_div_ps(f, _mm256_set1_ps(32767.0f));
+
+      _mm256_storeu_ps(dst + i, f);
+    }
+  }
+
+  return i;
+}
+
+#endif
+
+// each of these decodes packed values 4 at a time, returning how many were decoded. The caller
+// converts whatever is left over with the scalar function.
+size_t DecodeR10G10B10A2(const uint32_t *src, FloatVector *out, size_t count, CompType compType)
+{
+  size_t i = 0;
+#if ENABLED(RDOC_SSE2)
+  const __m128i mask = _mm_set1_epi32(0x3ff);
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128 r, g, b, a;
+
+    if(compType == CompType::SNorm)
+    {
+      // sign extend each field, and clamp the most negative value as the scalar version does
+      const __m128i minVal = _mm_set1_epi32(-511);
+      r = Scale(Max32(_mm_srai_epi32(_mm_slli_epi32(p, 22), 22), minVal), 511.0f);
+      g = Scale(Max32(_mm_srai_epi32(_mm_slli_epi32(p, 12), 22), minVal), 511.0f);
+      b = Scale(Max32(_mm_srai_epi32(_mm_slli_epi32(p, 2), 22), minVal), 511.0f);
+      a = _mm_cvtepi32_ps(Max32(_mm_srai_epi32(p, 30), _mm_set1_epi32(-1)));
+    }
+    else
+    {
+      r = Scale(_mm_and_si128(p, mask), 1023.0f);
+      g = Scale(_mm_and_si128(_mm_srli_epi32(p, 10), mask), 1023.0f);
+      b = Scale(_mm_and_si128(_mm_srli_epi32(p, 20), mask), 1023.0f);
+      a = Scale(_mm_srli_epi32(p, 30), 3.0f);
+
+      // UInt is scaled back up after normalising, which isn't always exactly the original value
+      if(compType == CompType::UInt)
+      {
+        const __m128 scale = _mm_set1_ps(1023.0f);
+        r = _mm_mul_ps(r, scale);
+        g = _mm_mul_ps(g, scale);
+        b = _mm_mul_ps(b, scale);
+        a = _mm_mul_ps(a, _mm_set1_ps(3.0f));
+      }
+    }
+
+    StoreRGBA(out + i, r, g, b, a);
+  }
+#endif
+  return i;
+}
+
+size_t DecodeR11G11B10(const uint32_t *src, FloatVector *out, size_t count)
+{
+  size_t i = 0;
+#if ENABLED(RDOC_SSE2)
+  const __m128i mask11 = _mm_set1_epi32(0x7ff);
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+    StoreRGBA(out + i, SmallFloatToFloat(_mm_and_si128(p, mask11), 6),
+              SmallFloatToFloat(_mm_and_si128(_mm_srli_epi32(p, 11), mask11), 6),
+              SmallFloatToFloat(_mm_srli_epi32(p, 22), 5), _mm_set1_ps(1.0f));
+  }
+#endif
+  return i;
+}
+
+size_t DecodeR9G9B9E5(const uint32_t *src, FloatVector *out, size_t count)
+{
+  size_t i = 0;
+#if ENABLED(RDOC_SSE2)
+  const __m128i mask = _mm_set1_epi32(0x1ff);
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i p = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i exponent = _mm_srli_epi32(p, 27);
+    __m128i isSpecial = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x1f));
+
+    // each value is mantissa * 2^(exponent - 15 - 9), which is always exact
+    __m128 scale =
+        _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(127 - 24)), 23));
+
+    __m128 rgb[3];
+    for(int c = 0; c < 3; c++)
+    {
+      __m128i mantissa = _mm_and_si128(_mm_srli_epi32(p, c * 9), mask);
+      __m128i value = _mm_castps_si128(_mm_mul_ps(_mm_cvtepi32_ps(mantissa), scale));
+      __m128i special = _mm_or_si128(_mm_set1_epi32(0x7f800000), _mm_slli_epi32(mantissa, 14));
+      rgb[c] = _mm_castsi128_ps(Select(isSpecial, special, value));
+    }
+
+    StoreRGBA(out + i, rgb[0], rgb[1], rgb[2], _mm_set1_ps(1.0f));
+  }
+#endif
+  return i;
+}
+
+size_t Decode16BitPacked(ResourceFormatType type, const uint16_t *src, FloatVector *out,
+                         size_t count)
+{
+  size_t i = 0;
+#if ENABLED(RDOC_SSE2)
+  for(; i + 4 <= count; i += 4)
+  {
+    __m128i p = Load16x4(src + i);
+
+    auto field = [p](int shift, int mask) {
+      return _mm_and_si128(_mm_srli_epi32(p, shift), _mm_set1_epi32(mask));
+    };
+
+    if(type == ResourceFormatType::R5G5B5A1)
+    {
+      StoreRGBA(out + i, Scale(field(10, 0x1f), 31.0f), Scale(field(5, 0x1f), 31.0f),
+                Scale(field(0, 0x1f), 31.0f), _mm_cvtepi32_ps(field(15, 0x1)));
+    }
+    else if(type == ResourceFormatType::R5G6B5)
+    {
+      StoreRGBA(out + i, Scale(field(11, 0x1f), 31.0f), Scale(field(5, 0x3f), 63.0f),
+                Scale(field(0, 0x1f), 31.0f), _mm_set1_ps(1.0f));
+    }
+    else
+    {
+      StoreRGBA(out + i, Scale(field(8, 0xf), 15.0f), Scale(field(4, 0xf), 15.0f),
+                Scale(field(0, 0xf), 15.0f), Scale(field(12, 0xf), 15.0f));
+    }
+  }
+#endif
+  return i;
+}
+
+// decodes count tightly packed components of a regular format, returning how many were decoded.
+size_t DecodeComponents(CompType compType, uint32_t byteWidth, const byte *src, float *dst,
+                        size_t count)
+{
+  size_t i = 0;
+
+  if(byteWidth == 1 && compType == CompType::UNormSRGB)
+  {
+    ConvertFromSRGB8(src, dst, count);
+    return count;
+  }
+  else if(byteWidth == 2 && compType == CompType::Float)
+  {
+    ConvertFromHalf((const uint16_t *)src, dst, count);
+    return count;
+  }
+  else if(byteWidth == 4 && (compType == CompType::Float || compType == CompType::Depth))
+  {
+    memcpy(dst, src, count * sizeof(float));
+    return count;
+  }
+
+#if ENABLED(RDOC_SSE2)
+  // the SSE2 loops below pick up from wherever the AVX2 kernel stopped
+  if(useAVX2)
+    i = DecodeComponents_AVX2(compType, byteWidth, src, dst, count);
+
+  if(byteWidth == 1)
+  {
+    for(; i + 16 <= count; i += 16)
+    {
+      __m128i bytes = _mm_loadu_si128((const __m128i *)(src + i));
+      __m128i words[2];
+      __m128i dwords[4];
+
+      if(compType == CompType::SInt || compType == CompType::SScaled ||
+         compType == CompType::SNorm)
+      {
+        // sign extend by putting each byte in the top of a word then shifting back down
+        words[0] = _mm_srai_epi16(_mm_unpacklo_epi8(bytes, bytes), 8);
+        words[1] = _mm_srai_epi16(_mm_unpackhi_epi8(bytes, bytes), 8);
+
+        if(compType == CompType::SNorm)
+        {
+          words[0] = _mm_max_epi16(words[0], _mm_set1_epi16(-127));
+          words[1] = _mm_max_epi16(words[1], _mm_set1_epi16(-127));
+        }
+
+        for(int w = 0; w < 2; w++)
+        {
+          dwords[w * 2 + 0] = _mm_srai_epi32(_mm_unpacklo_epi16(words[w], words[w]), 16);
+          dwords[w * 2 + 1] = _mm_srai_epi32(_mm_unpackhi_epi16(words[w], words[w]), 16);
+        }
+      }
+      else
+      {
+        const __m128i zero = _mm_setzero_si128();
+        words[0] = _mm_unpacklo_epi8(bytes, zero);
+        words[1] = _mm_unpackhi_epi8(bytes, zero);
+
+        for(int w = 0; w < 2; w++)
+        {
+          dwords[w * 2 + 0] = _mm_unpacklo_epi16(words[w], zero);
+          dwords[w * 2 + 1] = _mm_unpackhi_epi16(words[w], zero);
+        }
+      }
+
+      for(int d = 0; d < 4; d++)
+      {
+        __m128 f = _mm_cvtepi32_ps(dwords[d]);
+
+        if(compType == CompType::UNorm)
+          f = _mm_div_ps(f, _mm_set1_ps(255.0f));
+        else if(compType == CompType::SNorm)
+          f = _mm_div_ps(f, _mm_set1_ps(127.0f));
+
+        _mm_storeu_ps(dst + i + d * 4, f);
+      }
+    }
+  }
+  else if(byteWidth == 2)
+  {
+    for(; i + 8 <= count; i += 8)
+    {
+      __m128i words = _mm_loadu_si128((const __m128i *)(src + i * 2));
+      __m128i dwords[2];
+
+      if(compType == CompType::SInt || compType == CompType::SScaled ||
+         compType == CompType::SNorm)
+      {
+        if(compType == CompType::SNorm)
+          words = _mm_max_epi16(words, _mm_set1_epi16(-32767));
+
+        dwords[0] = _mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16);
+        dwords[1] = _mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16);
+      }
+      else
+      {
+        dwords[0] = _mm_unpacklo_epi16(words, _mm_setzero_si128());
+        dwords[1] = _mm_unpackhi_epi16(words, _mm_setzero_si128());
+      }
+
+      for(int d = 0; d < 2; d++)
+      {
+        __m128 f = _mm_cvtepi32_ps(dwords[d]);
+
+        if(compType == CompType::UNorm || compType == CompType::Depth)
+          f = _mm_div_ps(f, _mm_set1_ps(65535.0f));
+        else if(compType == CompType::SNorm)
+          f = _mm_div_ps(f, _mm_set1_ps(32767.0f));
+
+        _mm_storeu_ps(dst + i + d * 4, f);
+      }
+    }
+  }
+  else if(byteWidth == 4)
+  {
+    for(; i + 4 <= count; i += 4)
+    {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 4));
+      __m128 f;
+
+      if(compType == CompType::SInt || compType == CompType::SScaled)
+      {
+        f = _mm_cvtepi32_ps(v);
+      }
+      else
+      {
+        // there's no unsigned conversion, so convert each half exactly and let the add round once
+        __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(v, 16)), _mm_set1_ps(65536.0f));
+        __m128 lo = _mm_cvtepi32_ps(_mm_and_si128(v, _mm_set1_epi32(0xffff)));
+        f = _mm_add_ps(hi, lo);
+      }
+
+      _mm_storeu_ps(dst + i, f);
+    }
+  }
+#endif
+
+  return i;
+}
+
+// whether DecodeComponents handles this format. Anything else goes through ConvertComponents
+bool CanDecodeComponents(const ResourceFormat &fmt)
+{
+  if(fmt.type != ResourceFormatType::Regular || fmt.compCount == 0 || fmt.compCount > 4)
+    return false;
+
+  const CompType t = fmt.compType;
+  const bool integer = (t == CompType::UInt || t == CompType::UScaled || t == CompType::SInt ||
+                        t == CompType::SScaled);
+
+  switch(fmt.compByteWidth)
+  {
+    case 1:
+      return integer || t == CompType::UNorm || t == CompType::SNorm || t == CompType::UNormSRGB;
+    case 2:
+      return integer || t == CompType::Float || t == CompType::UNorm || t == CompType::SNorm ||
+             t == CompType::Depth;
+    case 4: return integer || t == CompType::Float || t == CompType::Depth;
+    default: return false;
+  }
+}
+
+// returns the size of the element that the array decode reads, or 0 if it isn't supported
+uint32_t DecodedElementSize(const ResourceFormat &fmt)
+{
+  switch(fmt.type)
+  {
+    case ResourceFormatType::R10G10B10A2:
+    case ResourceFormatType::R11G11B10:
+    case ResourceFormatType::R9G9B9E5: return 4;
+    case ResourceFormatType::R5G5B5A1:
+    case ResourceFormatType::R5G6B5:
+    case ResourceFormatType::R4G4B4A4: return 2;
+    case ResourceFormatType::Regular:
+      return CanDecodeComponents(fmt) ? fmt.compCount * fmt.compByteWidth : 0;
+    default: return 0;
+  }
+}
+};
+
+void ConvertFromHalf(const uint16_t *src, float *dst, size_t count)
+{
+  size_t i = 0;
+#if ENABLED(RDOC_SSE2)
+  if(useAVX2)
+    i = ConvertFromHalf_AVX2(src, dst, count);
+
+  for(; i + 8 <= count; i += 8)
+  {
+    __m128i h = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm_storeu_ps(dst + i, HalfToFloat(_mm_unpacklo_epi16(h, _mm_setzero_si128())));
+    _mm_storeu_ps(dst + i + 4, HalfToFloat(_mm_unpackhi_epi16(h, _mm_setzero_si128())));
+  }
+#endif
+  for(; i < count; i++)
+    dst[i] = ConvertFromHalf(src[i]);
+}
+
+void ConvertFromSRGB8(const uint8_t *src, float *dst, size_t count)
+{
+  // there's no gather in SSE2, and the AVX2 gather is slower than this plain lookup
+  for(size_t i = 0; i < count; i++)
+    dst[i] = SRGB8_lookuptable[src[i]];
+}
+
+void ConvertComponents(const ResourceFormat &fmt, const byte *data, size_t stride, size_t count,
+                       FloatVector *out)
+{
+  const uint32_t elemSize = DecodedElementSize(fmt);
+
+  if(elemSize == 0)
+  {
+    for(size_t i = 0; i < count; i++)
+      out[i] = ConvertComponents(fmt, data + i * stride);
+    return;
+  }
+
+  // strided elements are packed together first, so the decoding only handles contiguous data
+  byte packed[DecodeChunk * 16];
+  float components[DecodeChunk * 4];
+
+  for(size_t base = 0; base < count; base += DecodeChunk)
+  {
+    const size_t num = RDCMIN(DecodeChunk, count - base);
+    const byte *src = data + base * stride;
+    FloatVector *dst = out + base;
+
+    if(stride != elemSize)
+    {
+      for(size_t i = 0; i < num; i++)
+        memcpy(packed + i * elemSize, src + i * stride, elemSize);
+      src = packed;
+    }
+
+    size_t done = 0;
+
+    switch(fmt.type)
+    {
+      case ResourceFormatType::R10G10B10A2:
+        done = DecodeR10G10B10A2((const uint32_t *)src, dst, num, fmt.compType);
+        break;
+      case ResourceFormatType::R11G11B10:
+        done = DecodeR11G11B10((const uint32_t *)src, dst, num);
+        break;
+      case ResourceFormatType::R9G9B9E5:
+        done = DecodeR9G9B9E5((const uint32_t *)src, dst, num);
+        break;
+      case ResourceFormatType::R5G5B5A1:
+      case ResourceFormatType::R5G6B5:
+      case ResourceFormatType::R4G4B4A4:
+        done = Decode16BitPacked(fmt.type, (const uint16_t *)src, dst, num);
+        break;
+      default:
+      {
+        const uint32_t compCount = fmt.compCount;
+        const size_t numComps = num * compCount;
+
+        // four components decode straight into the output, anything else needs expanding
+        float *c = compCount == 4 ? &dst[0].x : components;
+
+        size_t decoded = DecodeComponents(fmt.compType, fmt.compByteWidth, src, c, numComps);
+
+        // decode whole elements only, the scalar conversion does any remainder below
+        done = decoded / compCount;
+
+        // alpha is never interpreted as sRGB
+        if(fmt.compType == CompType::UNormSRGB && compCount == 4)
+        {
+          for(size_t i = 0; i < done; i++)
+            c[i * 4 + 3] = float(src[i * 4 + 3]) / 255.0f;
+        }
+
+        if(compCount == 3)
+          for(size_t i = 0; i < done; i++, c += 3)
+            dst[i] = FloatVector(c[0], c[1], c[2], 1.0f);
+        else if(compCount == 2)
+          for(size_t i = 0; i < done; i++, c += 2)
+            dst[i] = FloatVector(c[0], c[1], 0.0f, 1.0f);
+        else if(compCount == 1)
+          for(size_t i = 0; i < done; i++, c++)
+            dst[i] = FloatVector(c[0], 0.0f, 0.0f, 1.0f);
+
+        if(fmt.BGRAOrder())
+          for(size_t i = 0; i < done; i++)
+            std::swap(dst[i].x, dst[i].z);
+        break;
+      }
+    }
+
+    for(size_t i = done; i < num; i++)
+      dst[i] = ConvertComponents(fmt, src + i * elemSize);
+  }
+}
+
 #if ENABLED(ENABLE_UNIT_TESTS)
 
 #undef None
@@ -1192,4 +1827,334 @@ TEST_CASE("Check format conversion", "[format]")
   };
 }
 
+static ResourceFormat MakeFormat(ResourceFormatType type, CompType compType, uint8_t compCount,
+                                 uint8_t compByteWidth, bool bgra = false)
+{
+  ResourceFormat fmt;
+  fmt.type = type;
+  fmt.compType = compType;
+  fmt.compCount = compCount;
+  fmt.compByteWidth = compByteWidth;
+  fmt.SetBGRAOrder(bgra);
+  return fmt;
+}
+
+// the vector kernels that can run on this CPU, as values for useAVX2
+static rdcarray<bool> GetTestAVX2Modes()
+{
+  rdcarray<bool> ret = {false};
+#if ENABLED(RDOC_SSE2)
+  if(CPUHasAVX2())
+    ret.push_back(true);
+#endif
+  return ret;
+}
+
+static void SetTestAVX2Mode(bool avx2)
+{
+#if ENABLED(RDOC_SSE2)
+  useAVX2 = avx2;
+#else
+  (void)avx2;
+#endif
+}
+
+// decodes every element in data with the array conversion, both tightly packed and with an odd
+// stride, and counts how many don't exactly match the scalar conversion. This is done with each
+// set of vector kernels the CPU supports.
+static size_t CountArrayMismatches(const ResourceFormat &fmt, uint32_t elemSize,
+                                   const bytebuf &data)
+{
+  const size_t count = data.size() / elemSize;
+
+  rdcarray<FloatVector> expected;
+  expected.resize(count);
+  for(size_t i = 0; i < count; i++)
+    expected[i] = ConvertComponents(fmt, data.data() + i * elemSize);
+
+  const size_t stride = elemSize + 3;
+  bytebuf strided;
+  strided.resize(count * stride);
+  for(size_t i = 0; i < count; i++)
+    memcpy(strided.data() + i * stride, data.data() + i * elemSize, elemSize);
+
+  size_t mismatches = 0;
+
+  for(bool avx2 : GetTestAVX2Modes())
+  {
+    SetTestAVX2Mode(avx2);
+
+    rdcarray<FloatVector> packed, spaced;
+    packed.resize(count);
+    spaced.resize(count);
+    ConvertComponents(fmt, data.data(), elemSize, count, packed.data());
+    ConvertComponents(fmt, strided.data(), stride, count, spaced.data());
+
+    for(size_t i = 0; i < count; i++)
+    {
+      if(memcmp(&expected[i], &packed[i], sizeof(FloatVector)) != 0)
+        mismatches++;
+      if(memcmp(&expected[i], &spaced[i], sizeof(FloatVector)) != 0)
+        mismatches++;
+    }
+  }
+
+  SetTestAVX2Mode(CPUHasAVX2());
+
+  return mismatches;
+}
+
+template <typename T>
+static bytebuf ToBytes(const rdcarray<T> &values)
+{
+  bytebuf ret;
+  ret.resize(values.byteSize());
+  memcpy(ret.data(), values.data(), ret.size());
+  return ret;
+}
+
+TEST_CASE("Check array format conversion", "[format]")
+{
+  SECTION("Halfs")
+  {
+    rdcarray<uint16_t> halfs;
+    for(uint32_t i = 0; i <= 0xffff; i++)
+      halfs.push_back(uint16_t(i));
+
+    size_t mismatches = 0;
+
+    for(bool avx2 : GetTestAVX2Modes())
+    {
+      SetTestAVX2Mode(avx2);
+
+      rdcarray<float> floats;
+      floats.resize(halfs.size());
+      ConvertFromHalf(halfs.data(), floats.data(), halfs.size());
+
+      for(size_t i = 0; i < halfs.size(); i++)
+      {
+        float expected = ConvertFromHalf(halfs[i]);
+        if(memcmp(&expected, &floats[i], sizeof(float)) != 0)
+          mismatches++;
+      }
+    }
+
+    SetTestAVX2Mode(CPUHasAVX2());
+
+    CHECK(mismatches == 0);
+  };
+
+  SECTION("8-bit components")
+  {
+    // every value in every component, with some left over so the element count isn't a multiple
+    // of the vector width
+    bytebuf data;
+    for(uint32_t i = 0; i < 256 * 4 + 7; i++)
+      data.push_back(byte(i * 7 + i / 256));
+
+    for(CompType compType : {CompType::UNorm, CompType::SNorm, CompType::UInt, CompType::SInt,
+                             CompType::UScaled, CompType::SScaled, CompType::UNormSRGB})
+    {
+      for(uint8_t compCount = 1; compCount <= 4; compCount++)
+      {
+        for(bool bgra : {false, true})
+        {
+          if(bgra && compCount < 3)
+            continue;
+
+          INFO(ToStr(compType) << " x" << (uint32_t)compCount << (bgra ? " BGRA" : ""));
+          ResourceFormat fmt =
+              MakeFormat(ResourceFormatType::Regular, compType, compCount, 1, bgra);
+          CHECK(CountArrayMismatches(fmt, compCount, data) == 0);
+        }
+      }
+    }
+  };
+
+  SECTION("16-bit components")
+  {
+    rdcarray<uint16_t> values;
+    for(uint32_t i = 0; i <= 0xffff + 13; i++)
+      values.push_back(uint16_t(i));
+    bytebuf data = ToBytes(values);
+
+    for(CompType compType : {CompType::Float, CompType::UNorm, CompType::SNorm, CompType::UInt,
+                             CompType::SInt, CompType::Depth})
+    {
+      for(uint8_t compCount = 1; compCount <= 4; compCount++)
+      {
+        INFO(ToStr(compType) << " x" << (uint32_t)compCount);
+        ResourceFormat fmt = MakeFormat(ResourceFormatType::Regular, compType, compCount, 2);
+        CHECK(CountArrayMismatches(fmt, compCount * 2, data) == 0);
+      }
+    }
+  };
+
+  SECTION("32-bit components")
+  {
+    rdcarray<uint32_t> values = {
+        0,          1,          0x7f,       0x80,       0xffff,     0x10000,    0x00ffffff,
+        0x01000000, 0x01000001, 0x7fffffff, 0x80000000, 0x80000001, 0xfffffffe, 0xffffffff,
+        0x3f800000, 0xbf800000, 0x7f800000, 0xff800000, 0x7fc00000, 0x00000010, 0x80000010,
+    };
+
+    uint32_t seed = 1234;
+    for(uint32_t i = 0; i < 100000; i++)
+    {
+      seed = seed * 1664525 + 1013904223;
+      values.push_back(seed);
+    }
+
+    bytebuf data = ToBytes(values);
+
+    for(CompType compType :
+        {CompType::Float, CompType::Depth, CompType::UInt, CompType::SInt, CompType::UScaled})
+    {
+      for(uint8_t compCount = 1; compCount <= 4; compCount++)
+      {
+        INFO(ToStr(compType) << " x" << (uint32_t)compCount);
+        ResourceFormat fmt = MakeFormat(ResourceFormatType::Regular, compType, compCount, 4);
+        CHECK(CountArrayMismatches(fmt, compCount * 4, data) == 0);
+      }
+    }
+  };
+
+  SECTION("Packed 16-bit formats")
+  {
+    rdcarray<uint16_t> values;
+    for(uint32_t i = 0; i <= 0xffff + 3; i++)
+      values.push_back(uint16_t(i));
+    bytebuf data = ToBytes(values);
+
+    for(ResourceFormatType type :
+        {ResourceFormatType::R5G5B5A1, ResourceFormatType::R5G6B5, ResourceFormatType::R4G4B4A4})
+    {
+      INFO(ToStr(type));
+      ResourceFormat fmt = MakeFormat(type, CompType::UNorm, 4, 1);
+      CHECK(CountArrayMismatches(fmt, 2, data) == 0);
+    }
+  };
+
+  SECTION("R10G10B10A2")
+  {
+    // every value in every channel, in a different order in each so they aren't all the same
+    rdcarray<uint32_t> values;
+    for(uint32_t i = 0; i < 1024; i++)
+      for(uint32_t a = 0; a < 4; a++)
+        values.push_back(i | ((1023 - i) << 10) | (((i * 37) & 0x3ff) << 20) | (a << 30));
+    values.push_back(0x12345678);
+    bytebuf data = ToBytes(values);
+
+    for(CompType compType : {CompType::UNorm, CompType::SNorm, CompType::UInt})
+    {
+      INFO(ToStr(compType));
+      ResourceFormat fmt = MakeFormat(ResourceFormatType::R10G10B10A2, compType, 4, 1);
+      CHECK(CountArrayMismatches(fmt, 4, data) == 0);
+    }
+  };
+
+  SECTION("R11G11B10")
+  {
+    rdcarray<uint32_t> values;
+    for(uint32_t i = 0; i < 2048; i++)
+      values.push_back(i | (((i * 37) & 0x7ff) << 11) | ((i & 0x3ff) << 22));
+    for(uint32_t i = 0; i < 1024; i++)
+      values.push_back(((1023 - i) << 22) | i);
+    values.push_back(0xdeadbee);
+    bytebuf data = ToBytes(values);
+
+    ResourceFormat fmt = MakeFormat(ResourceFormatType::R11G11B10, CompType::Float, 3, 1);
+    CHECK(CountArrayMismatches(fmt, 4, data) == 0);
+  };
+
+  SECTION("R9G9B9E5")
+  {
+    // every mantissa with every exponent, in each channel
+    rdcarray<uint32_t> values;
+    for(uint32_t e = 0; e < 32; e++)
+      for(uint32_t m = 0; m < 512; m++)
+        values.push_back(m | ((511 - m) << 9) | (((m * 37) & 0x1ff) << 18) | (e << 27));
+    values.push_back(0xabcdef1);
+    bytebuf data = ToBytes(values);
+
+    ResourceFormat fmt = MakeFormat(ResourceFormatType::R9G9B9E5, CompType::Float, 3, 1);
+    CHECK(CountArrayMismatches(fmt, 4, data) == 0);
+  };
+
+  SECTION("Formats without an array decode")
+  {
+    rdcarray<double> values = {1.0, -2.5, 1.0e10, 0.125, 3.0, 7.0, -0.0, 100.0, 5.0};
+    bytebuf data = ToBytes(values);
+
+    ResourceFormat fmt = MakeFormat(ResourceFormatType::Regular, CompType::Double, 3, 8);
+    CHECK(CountArrayMismatches(fmt, 24, data) == 0);
+
+    fmt = MakeFormat(ResourceFormatType::Regular, CompType::UNormSRGB, 2, 2);
+    CHECK(CountArrayMismatches(fmt, 4, data) == 0);
+  };
+}
+
+TEST_CASE("Benchmark format conversion", "[.][benchmark]")
+{
+  const size_t count = 4 * 1024 * 1024;
+
+  bytebuf data;
+  data.resize(count * 16);
+  uint32_t seed = 99;
+  for(size_t i = 0; i < data.size(); i += 4)
+  {
+    seed = seed * 1664525 + 1013904223;
+    memcpy(&data[i], &seed, sizeof(seed));
+  }
+
+  rdcarray<FloatVector> out;
+  out.resize(count);
+
+  struct
+  {
+    const char *name;
+    ResourceFormat fmt;
+  } formats[] = {
+      {"RGBA8 UNorm", MakeFormat(ResourceFormatType::Regular, CompType::UNorm, 4, 1)},
+      {"BGRA8 sRGB", MakeFormat(ResourceFormatType::Regular, CompType::UNormSRGB, 4, 1, true)},
+      {"RG8 SNorm", MakeFormat(ResourceFormatType::Regular, CompType::SNorm, 2, 1)},
+      {"RGBA16 Float", MakeFormat(ResourceFormatType::Regular, CompType::Float, 4, 2)},
+      {"RGBA16 UNorm", MakeFormat(ResourceFormatType::Regular, CompType::UNorm, 4, 2)},
+      {"R32 UInt", MakeFormat(ResourceFormatType::Regular, CompType::UInt, 1, 4)},
+      {"RGBA32 Float", MakeFormat(ResourceFormatType::Regular, CompType::Float, 4, 4)},
+      {"R10G10B10A2", MakeFormat(ResourceFormatType::R10G10B10A2, CompType::UNorm, 4, 1)},
+      {"R11G11B10", MakeFormat(ResourceFormatType::R11G11B10, CompType::Float, 3, 1)},
+      {"R9G9B9E5", MakeFormat(ResourceFormatType::R9G9B9E5, CompType::Float, 3, 1)},
+      {"R5G6B5", MakeFormat(ResourceFormatType::R5G6B5, CompType::UNorm, 3, 1)},
+  };
+
+  WARN("Decoding " << count << " elements of each format");
+
+  for(const auto &f : formats)
+  {
+    const uint32_t elemSize = f.fmt.ElementSize();
+    const rdcstr name = f.name;
+
+    BENCHMARK((name + " (per-element)").c_str())
+    {
+      for(size_t i = 0; i < count; i++)
+        out[i] = ConvertComponents(f.fmt, data.data() + i * elemSize);
+    }
+    BENCHMARK(name.c_str())
+    {
+      ConvertComponents(f.fmt, data.data(), elemSize, count, out.data());
+    }
+
+    if(CPUHasAVX2())
+    {
+      SetTestAVX2Mode(false);
+      BENCHMARK((name + " (SSE2 only)").c_str())
+      {
+        ConvertComponents(f.fmt, data.data(), elemSize, count, out.data());
+      }
+      SetTestAVX2Mode(true);
+    }
+  }
+}
+
 #endif
@@ -25,6 +25,7 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include "half_convert.h"
 #include "vec.h"
@@ -106,3 +107,13 @@ typedef uint8_t byte;
 
 struct ResourceFormat;
 FloatVector ConvertComponents(const ResourceFormat &fmt, const byte *data);
+
+// array versions of the conversions, for decoding many values at once. These give bit-identical
+// results to calling the single value functions above in a loop, but are vectorised where possible.
+void ConvertFromHalf(const uint16_t *src, float *dst, size_t count);
+void ConvertFromSRGB8(const uint8_t *src, float *dst, size_t count);
+
+// decodes count elements of fmt, each stride bytes after the previous, as if by ConvertComponents.
+// Block compressed and other formats with no per-element decoding are not supported here either.
+void ConvertComponents(const ResourceFormat &fmt, const byte *data, size_t stride, size_t count,
+                       FloatVector *out);
@@ -88,6 +88,29 @@ uint32_t GetCurrentPID();
 void Shutdown();
 };
 
+// Tracks CPU writes to a range of memory at page granularity, by write-protecting pages and catching
+// the fault on the first write to each. Only the first write to a page after its dirty state is
+// collected costs anything. This only works for memory the CPU writes directly - writes by the
+// kernel (e.g. read() into a tracked buffer) will fail rather than be caught, so it must be opt-in.
+// If the application replaces the fault handler, every range is reported as written until all
+// regions are untracked, though a fault that reaches the application's handler first is lost.
+namespace PageTracking
+{
+struct Region;
+
+bool IsSupported();
+
+// begin tracking [base, base+size). Every page starts out dirty and writable. Returns NULL if the
+// region can't be tracked.
+Region *Track(void *base, size_t size);
+void Untrack(Region *region);
+
+// returns the byte ranges (relative to base) written since the last call, with adjacent pages
+// coalesced into one range and clamped to the tracked size. The returned pages are protected again,
+// so that writes from now on are caught for the next call.
+void GetDirtyRanges(Region *region, rdcarray<rdcpair<size_t, size_t>> &ranges);
+};
+
 namespace Timing
 {
 double GetTickFrequency();
@@ -137,6 +160,25 @@ public:
   data m_Data;
 };
 
+// a counting semaphore, for sleeping worker threads until there is work for them. This is an
+// opaque type allocated by Create() and released with Destroy().
+struct Semaphore
+{
+  static Semaphore *Create();
+  void Destroy();
+
+  // increments the count, waking up to numToWake threads that are waiting
+  void Wake(uint32_t numToWake);
+  // blocks until the count is non-zero, then decrements it
+  void WaitForWake();
+
+  // no construction or copying, only via Create()/Destroy()
+  Semaphore() = delete;
+  ~Semaphore() = delete;
+  Semaphore &operator=(const Semaphore &other) = delete;
+  Semaphore(const Semaphore &other) = delete;
+};
+
 void Init();
 void Shutdown();
 uint64_t AllocateTLSSlot();
@@ -164,6 +206,13 @@ void ReleaseModuleExitThread();
 
 namespace Network
 {
+// one buffer in a gathered send
+struct SendBuffer
+{
+  const void *data;
+  uint32_t length;
+};
+
 class Socket
 {
 public:
@@ -181,13 +230,26 @@ public:
 
   bool IsRecvDataWaiting();
 
+  // waits up to timeoutMilliseconds for data to arrive, or for a client to connect on a server
+  // socket. Returns true if there's something to read/accept, false on timeout or error.
+  bool WaitForRecv(uint32_t timeoutMilliseconds);
+
   bool SendDataBlocking(const void *buf, uint32_t length);
+  // sends the buffers in order with as few calls as possible, without copying them together first
+  bool SendDataBlocking(const SendBuffer *bufs, uint32_t count);
   bool RecvDataBlocking(void *data, uint32_t length);
   bool RecvDataNonBlocking(void *data, uint32_t &length);
 
+  // sockets are created with nodelay enabled so small packets go out immediately
+  void SetNoDelay(bool nodelay);
+  // while corked, partial segments are held back until uncorking so that a burst of small sends
+  // goes out as full segments.
+  void SetCork(bool cork);
+
 private:
   ptrdiff_t socket;
   uint32_t timeoutMS;
+  bool corked = false;
 };
 
 Socket *CreateServerSocket(const char *addr, uint16_t port, int queuesize);
@@ -318,6 +380,13 @@ bool feof(FILE *f);
 
 int fclose(FILE *f);
 
+// maps a read-only view of part of a file into memory. The view stays valid after the file is
+// closed. Returns NULL if the file can't be mapped, in which case it should be read normally.
+struct FileMapping;
+FileMapping *MapFile(FILE *f, uint64_t offset, uint64_t length);
+const byte *GetMappedData(FileMapping *mapping);
+void UnmapFile(FileMapping *mapping);
+
 // functions for atomically appending to a log that may be in use in multiple
 // processes
 struct LogFileHandle;
@@ -503,6 +572,10 @@ inline uint32_t CountLeadingZeroes(uint32_t value);
 #if ENABLED(RDOC_X64)
 inline uint64_t CountLeadingZeroes(uint64_t value);
 #endif
+inline uint32_t CountTrailingZeroes(uint32_t value);
+#if ENABLED(RDOC_X64)
+inline uint64_t CountTrailingZeroes(uint64_t value);
+#endif
 };
 
 // must #define:
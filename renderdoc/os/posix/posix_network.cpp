@@ -27,16 +27,19 @@
 #include <netdb.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
 #include "api/replay/data_types.h"
 #include "common/common.h"
 #include "common/formatting.h"
+#include "core/settings.h"
 #include "os/os_specific.h"
 #include "strings/string_utils.h"
 
@@ -70,6 +73,47 @@ static rdcstr errno_string(int err)
   return StringFormat::Fmt("Unknown error %d", err);
 }
 
+RDOC_CONFIG(uint64_t, Network_SocketBufferKB, 0,
+            "The size in kilobytes to request for socket send and receive buffers. 0 leaves the "
+            "system default, which lets the kernel auto-tune the buffers.");
+
+// waits for the socket to be ready for the given poll() events. Returns 1 when ready, 0 on timeout
+// and -1 on error.
+static int WaitForSocket(int s, short events, uint32_t timeoutMS)
+{
+  pollfd fd = {};
+  fd.fd = s;
+  fd.events = events;
+
+  int ret = 0;
+
+  do
+  {
+    // as with EINTR elsewhere, this restarts the timeout but we expect it to be rare.
+    ret = poll(&fd, 1, (int)timeoutMS);
+  } while(ret < 0 && errno == EINTR);
+
+  return ret;
+}
+
+// set up a newly connected socket. All sockets are non-blocking, and blocking operations wait with
+// poll() so that we don't need to toggle the socket's mode and timeouts on every call.
+static void ConfigureConnectedSocket(int s)
+{
+  int flags = fcntl(s, F_GETFL, 0);
+  fcntl(s, F_SETFL, flags | O_NONBLOCK);
+
+  int nodelay = 1;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+
+  if(Network_SocketBufferKB > 0)
+  {
+    int size = (int)RDCMIN(Network_SocketBufferKB * 1024, (uint64_t)INT32_MAX);
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&size, sizeof(size));
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&size, sizeof(size));
+  }
+}
+
 namespace Network
 {
 void SocketPostSend();
@@ -104,17 +148,14 @@ bool Socket::Connected() const
 
 Socket *Socket::AcceptClient(uint32_t timeoutMilliseconds)
 {
-  do
+  // try once immediately, then if nothing is waiting wait for a connection and try again.
+  for(int attempt = 0; attempt < 2; attempt++)
   {
     int s = accept(socket, NULL, NULL);
 
     if(s != -1)
     {
-      int flags = fcntl(s, F_GETFL, 0);
-      fcntl(s, F_SETFL, flags | O_NONBLOCK);
-
-      int nodelay = 1;
-      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+      ConfigureConnectedSocket(s);
 
       return new Socket((ptrdiff_t)s);
     }
@@ -125,59 +166,96 @@ Socket *Socket::AcceptClient(uint32_t timeoutMilliseconds)
     {
       RDCWARN("accept: %s", errno_string(err).c_str());
       Shutdown();
+      return NULL;
     }
 
-    const uint32_t sleeptime = 4;
+    if(attempt > 0 || timeoutMilliseconds == 0 || !WaitForRecv(timeoutMilliseconds))
+      break;
+  }
 
-    Threading::Sleep(sleeptime);
+  return NULL;
+}
 
-    if(sleeptime < timeoutMilliseconds)
-      timeoutMilliseconds -= sleeptime;
-    else
-      timeoutMilliseconds = 0U;
-  } while(timeoutMilliseconds);
+bool Socket::WaitForRecv(uint32_t timeoutMilliseconds)
+{
+  if(!Connected())
+    return false;
 
-  return NULL;
+  int ret = WaitForSocket((int)socket, POLLIN, timeoutMilliseconds);
+
+  if(ret < 0)
+  {
+    RDCWARN("poll: %s", errno_string(errno).c_str());
+    return false;
+  }
+
+  return ret > 0;
 }
 
 bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 {
-  if(length == 0)
-    return true;
+  SendBuffer send = {buf, length};
+  return SendDataBlocking(&send, 1);
+}
+
+bool Socket::SendDataBlocking(const SendBuffer *bufs, uint32_t count)
+{
+  // the buffer we're up to, and how much of it has been sent
+  uint32_t cur = 0;
+  uint32_t curSent = 0;
+
+  iovec iov[64];
+
+  while(true)
+  {
+    while(cur < count && curSent == bufs[cur].length)
+    {
+      cur++;
+      curSent = 0;
+    }
 
-  uint32_t sent = 0;
+    if(cur == count)
+      break;
 
-  char *src = (char *)buf;
+    msghdr msg = {};
+    msg.msg_iov = iov;
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
+    for(uint32_t i = cur; i < count && (size_t)msg.msg_iovlen < ARRAY_COUNT(iov); i++)
+    {
+      uint32_t offs = (i == cur) ? curSent : 0;
 
-  timeval oldtimeout = {0};
-  socklen_t len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&oldtimeout, &len);
+      if(bufs[i].length == offs)
+        continue;
 
-  timeval timeout = {0};
-  timeout.tv_sec = (timeoutMS / 1000);
-  timeout.tv_usec = (timeoutMS % 1000) * 1000;
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+      iov[msg.msg_iovlen].iov_base = (byte *)bufs[i].data + offs;
+      iov[msg.msg_iovlen].iov_len = bufs[i].length - offs;
+      msg.msg_iovlen++;
+    }
 
-  while(sent < length)
-  {
-    int ret = send(socket, src, length - sent, 0);
+    ssize_t ret = sendmsg((int)socket, &msg, 0);
 
-    if(ret <= 0)
+    if(ret < 0)
     {
       int err = errno;
 
       if(err == EINTR)
       {
-        // if we hit EINTR, just try again completely. Technically this restarts the timeout but we
-        // expect EINTR to be rare so it's not a big deal.
         continue;
       }
       else if(err == EWOULDBLOCK || err == EAGAIN)
       {
-        RDCWARN("Timeout in send");
+        // the socket buffer is full, wait for it to drain. The timeout applies to each wait, so it
+        // only triggers if the other end stops reading entirely.
+        int ready = WaitForSocket((int)socket, POLLOUT, timeoutMS);
+
+        if(ready > 0)
+          continue;
+
+        if(ready == 0)
+          RDCWARN("Timeout in send");
+        else
+          RDCWARN("poll: %s", errno_string(errno).c_str());
+
         Shutdown();
         return false;
       }
@@ -189,16 +267,25 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
       }
     }
 
-    sent += ret;
-    src += ret;
-  }
-
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
-
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
+    // step past what was sent
+    size_t sent = (size_t)ret;
+    while(sent > 0)
+    {
+      uint32_t remaining = bufs[cur].length - curSent;
 
-  RDCASSERT(sent == length);
+      if(sent >= remaining)
+      {
+        sent -= remaining;
+        cur++;
+        curSent = 0;
+      }
+      else
+      {
+        curSent += (uint32_t)sent;
+        sent = 0;
+      }
+    }
+  }
 
   // incredibly ugly hack necessary for android
   SocketPostSend();
@@ -276,40 +363,36 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
 
   char *dst = (char *)buf;
 
-  int flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags & ~O_NONBLOCK);
-
-  timeval oldtimeout = {0};
-  socklen_t len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&oldtimeout, &len);
-
-  timeval timeout = {0};
-  timeout.tv_sec = (timeoutMS / 1000);
-  timeout.tv_usec = (timeoutMS % 1000) * 1000;
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
-
   while(received < length)
   {
-    int ret = recv(socket, dst, length - received, 0);
+    // read whatever is already here first, and only wait if there's nothing
+    ssize_t ret = recv(socket, dst, length - received, 0);
 
     if(ret == 0)
     {
       Shutdown();
       return false;
     }
-    else if(ret <= 0)
+    else if(ret < 0)
     {
       int err = errno;
 
       if(err == EINTR)
       {
-        // if we hit EINTR, just try again completely. Technically this restarts the timeout but we
-        // expect EINTR to be rare so it's not a big deal.
         continue;
       }
       else if(err == EWOULDBLOCK || err == EAGAIN)
       {
-        RDCWARN("Timeout in recv");
+        int ready = WaitForSocket((int)socket, POLLIN, timeoutMS);
+
+        if(ready > 0)
+          continue;
+
+        if(ready == 0)
+          RDCWARN("Timeout in recv");
+        else
+          RDCWARN("poll: %s", errno_string(errno).c_str());
+
         Shutdown();
         return false;
       }
@@ -321,20 +404,41 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
       }
     }
 
-    received += ret;
+    received += (uint32_t)ret;
     dst += ret;
   }
 
-  flags = fcntl(socket, F_GETFL, 0);
-  fcntl(socket, F_SETFL, flags | O_NONBLOCK);
-
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
-
   RDCASSERT(received == length);
 
   return true;
 }
 
+void Socket::SetNoDelay(bool nodelay)
+{
+  int enable = nodelay ? 1 : 0;
+  setsockopt((int)socket, IPPROTO_TCP, TCP_NODELAY, (char *)&enable, sizeof(enable));
+}
+
+void Socket::SetCork(bool cork)
+{
+  if(corked == cork)
+    return;
+
+  corked = cork;
+
+  int enable = cork ? 1 : 0;
+#if ENABLED(RDOC_APPLE)
+  setsockopt((int)socket, IPPROTO_TCP, TCP_NOPUSH, (char *)&enable, sizeof(enable));
+
+  // clearing TCP_NOPUSH doesn't send what's been held back, so push it out with an empty send
+  if(!cork)
+    send((int)socket, NULL, 0, 0);
+#else
+  // uncorking sends anything that's been held back
+  setsockopt((int)socket, IPPROTO_TCP, TCP_CORK, (char *)&enable, sizeof(enable));
+#endif
+}
+
 uint32_t GetIPFromTCPSocket(int socket)
 {
   sockaddr_in addr = {};
@@ -492,8 +596,7 @@ Socket *CreateClientSocket(const char *host, uint16_t port, int timeoutMS)
       }
     }
 
-    int nodelay = 1;
-    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&nodelay, sizeof(nodelay));
+    ConfigureConnectedSocket(s);
 
     freeaddrinfo(addrResult);
 
@@ -29,9 +29,11 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <algorithm>
 #include <map>
 //#include "api/app/renderdoc_app.h"
 #include "api/replay/capture_options.h"
@@ -902,6 +904,312 @@ void Process::Shutdown()
   }
 }
 
+struct PageTracking::Region
+{
+  byte *pageBase;
+  size_t numPages;
+  // offset and size of the tracked range relative to pageBase
+  size_t offset, size;
+  volatile int32_t *dirty;
+};
+
+namespace PageTrackingInternal
+{
+// the fault handler can't take locks, so regions live in a fixed table that it scans. Registering
+// and unregistering is serialised with a normal lock.
+static const int MaxRegions = 256;
+static PageTracking::Region *volatile regions[MaxRegions] = {};
+static volatile int32_t activeHandlers = 0;
+static Threading::CriticalSection regionLock;
+
+static size_t pageSize = 0;
+static struct sigaction oldSegvAction;
+
+// set if our fault handler was replaced, e.g. by the application installing its own SIGSEGV
+// handler. Faults on protected pages would no longer reach us, so tracking is abandoned until every
+// region has been untracked.
+static bool handlerLost = false;
+
+static void WriteFaultHandler(int signum, siginfo_t *info, void *context)
+{
+  int saved_errno = errno;
+
+  Atomic::Inc32(&activeHandlers);
+
+  byte *addr = (byte *)info->si_addr;
+  bool handled = false;
+
+  // a page could be shared by two regions if they aren't page aligned, so check them all
+  for(int i = 0; i < MaxRegions; i++)
+  {
+    PageTracking::Region *region = regions[i];
+
+    if(region && addr >= region->pageBase && addr < region->pageBase + region->numPages * pageSize)
+    {
+      size_t page = (addr - region->pageBase) / pageSize;
+      region->dirty[page] = 1;
+      mprotect(region->pageBase + page * pageSize, pageSize, PROT_READ | PROT_WRITE);
+      handled = true;
+    }
+  }
+
+  Atomic::Dec32(&activeHandlers);
+
+  errno = saved_errno;
+
+  if(handled)
+    return;
+
+  // not one of ours, pass it along
+  if(oldSegvAction.sa_flags & SA_SIGINFO)
+  {
+    oldSegvAction.sa_sigaction(signum, info, context);
+  }
+  else if(oldSegvAction.sa_handler != SIG_DFL && oldSegvAction.sa_handler != SIG_IGN)
+  {
+    oldSegvAction.sa_handler(signum);
+  }
+  else
+  {
+    // restore the default action and return, the faulting instruction will re-execute and crash
+    signal(signum, SIG_DFL);
+  }
+}
+
+static bool IsHandlerInstalled()
+{
+  struct sigaction cur = {};
+  sigaction(SIGSEGV, NULL, &cur);
+
+  return (cur.sa_flags & SA_SIGINFO) && cur.sa_sigaction == &WriteFaultHandler;
+}
+
+// must be called with regionLock held. Installs our handler in front of whatever is installed now,
+// unless it's already there and hasn't been lost since.
+static void InstallHandler()
+{
+  bool empty = true;
+  for(int i = 0; i < MaxRegions; i++)
+    empty &= (regions[i] == NULL);
+
+  // while regions are live a lost handler stays lost, since their writes may already have been
+  // missed. Once they're all gone we can start over.
+  if(!empty || (!handlerLost && IsHandlerInstalled()))
+    return;
+
+  handlerLost = false;
+
+  pageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+  struct sigaction new_action = {};
+  sigemptyset(&new_action.sa_mask);
+  new_action.sa_flags = SA_SIGINFO | SA_RESTART;
+  new_action.sa_sigaction = &WriteFaultHandler;
+
+  sigaction(SIGSEGV, &new_action, &oldSegvAction);
+}
+
+// must be called with regionLock held. Returns true if our handler is still the one installed,
+// otherwise makes every tracked page writable and dirty so callers fall back to full comparisons.
+static bool CheckHandler()
+{
+  if(handlerLost)
+    return false;
+
+  if(IsHandlerInstalled())
+    return true;
+
+  RDCWARN("SIGSEGV handler has been replaced, disabling page write tracking");
+
+  handlerLost = true;
+
+  for(int i = 0; i < MaxRegions; i++)
+  {
+    PageTracking::Region *region = regions[i];
+
+    if(region)
+    {
+      mprotect(region->pageBase, region->numPages * pageSize, PROT_READ | PROT_WRITE);
+      for(size_t p = 0; p < region->numPages; p++)
+        region->dirty[p] = 1;
+    }
+  }
+
+  return false;
+}
+
+// must be called with regionLock held and region already removed from the table. Makes the
+// region's pages writable, except for pages still covered by another tracked region.
+static void UnprotectRegion(PageTracking::Region *region)
+{
+  byte *start = region->pageBase;
+  byte *end = region->pageBase + region->numPages * pageSize;
+
+  // gather the parts of our pages that other regions cover. Regions only share whole pages.
+  rdcarray<rdcpair<byte *, byte *>> covered;
+  for(int i = 0; i < MaxRegions; i++)
+  {
+    PageTracking::Region *other = regions[i];
+
+    if(other == NULL)
+      continue;
+
+    byte *otherStart = RDCMAX(other->pageBase, start);
+    byte *otherEnd = RDCMIN(other->pageBase + other->numPages * pageSize, end);
+
+    if(otherStart < otherEnd)
+      covered.push_back({otherStart, otherEnd});
+  }
+
+  std::sort(covered.begin(), covered.end());
+
+  byte *cur = start;
+  for(const rdcpair<byte *, byte *> &c : covered)
+  {
+    if(c.first > cur)
+      mprotect(cur, c.first - cur, PROT_READ | PROT_WRITE);
+    cur = RDCMAX(cur, c.second);
+  }
+
+  if(cur < end)
+    mprotect(cur, end - cur, PROT_READ | PROT_WRITE);
+}
+};
+
+bool PageTracking::IsSupported()
+{
+  return true;
+}
+
+PageTracking::Region *PageTracking::Track(void *base, size_t size)
+{
+  using namespace PageTrackingInternal;
+
+  if(base == NULL || size == 0)
+    return NULL;
+
+  SCOPED_LOCK(regionLock);
+
+  InstallHandler();
+
+  if(!CheckHandler())
+    return NULL;
+
+  int slot = -1;
+  for(int i = 0; i < MaxRegions; i++)
+  {
+    if(regions[i] == NULL)
+    {
+      slot = i;
+      break;
+    }
+  }
+
+  if(slot < 0)
+  {
+    RDCWARN("Too many tracked regions, can't track writes to %p", base);
+    return NULL;
+  }
+
+  Region *region = new Region;
+  region->pageBase = (byte *)(uintptr_t(base) & ~uintptr_t(pageSize - 1));
+  region->offset = (byte *)base - region->pageBase;
+  region->size = size;
+  region->numPages = (region->offset + size + pageSize - 1) / pageSize;
+  region->dirty = new int32_t[region->numPages];
+  for(size_t i = 0; i < region->numPages; i++)
+    region->dirty[i] = 1;
+
+  regions[slot] = region;
+
+  return region;
+}
+
+void PageTracking::Untrack(Region *region)
+{
+  using namespace PageTrackingInternal;
+
+  if(region == NULL)
+    return;
+
+  {
+    SCOPED_LOCK(regionLock);
+
+    for(int i = 0; i < MaxRegions; i++)
+    {
+      if(regions[i] == region)
+        regions[i] = NULL;
+    }
+
+    // make our pages writable so no new faults come in for this region. A page shared with a
+    // neighbouring region stays as it is, so writes to it are still caught for that region.
+    if(!handlerLost)
+      UnprotectRegion(region);
+  }
+
+  // wait for any handler that might have already found this region to finish with it
+  while(Atomic::CmpExch32(&activeHandlers, 0, 0) != 0)
+    Threading::Sleep(0);
+
+  delete[] region->dirty;
+  delete region;
+}
+
+void PageTracking::GetDirtyRanges(Region *region, rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+  using namespace PageTrackingInternal;
+
+  ranges.clear();
+
+  if(region == NULL)
+    return;
+
+  SCOPED_LOCK(regionLock);
+
+  // without our handler nothing is tracked any more, so everything has to be treated as written
+  if(!CheckHandler())
+  {
+    ranges.push_back({0, region->size});
+    return;
+  }
+
+  auto flushRun = [region, &ranges](size_t first, size_t end) {
+    // protect the pages again *after* clearing their dirty flags, so that any write racing with
+    // this is either visible to the caller reading the pages now, or is caught next time.
+    mprotect(region->pageBase + first * pageSize, (end - first) * pageSize, PROT_READ);
+
+    size_t start = first * pageSize;
+    size_t finish = end * pageSize;
+
+    start = start < region->offset ? 0 : start - region->offset;
+    finish = RDCMIN(finish - region->offset, region->size);
+
+    ranges.push_back({start, finish});
+  };
+
+  size_t runStart = 0;
+  bool inRun = false;
+
+  for(size_t page = 0; page < region->numPages; page++)
+  {
+    bool dirty = Atomic::CmpExch32(&region->dirty[page], 1, 0) == 1;
+
+    if(dirty && !inRun)
+    {
+      runStart = page;
+      inRun = true;
+    }
+    else if(!dirty && inRun)
+    {
+      flushRun(runStart, page);
+      inRun = false;
+    }
+  }
+
+  if(inRun)
+    flushRun(runStart, region->numPages);
+}
+
 #if ENABLED(ENABLE_UNIT_TESTS)
 
 #include "catch/catch.hpp"
@@ -1010,4 +1318,162 @@ TEST_CASE("Test PID Node list handling", "[osspecific]")
   delete f;
 };
 
+TEST_CASE("Test page write tracking", "[osspecific]")
+{
+  const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t numPages = 16;
+
+  byte *mem = (byte *)mmap(NULL, pageSize * numPages, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(mem != MAP_FAILED);
+
+  // track from an unaligned offset to an unaligned end
+  const size_t offset = 100;
+  const size_t size = pageSize * 10;
+
+  PageTracking::Region *region = PageTracking::Track(mem + offset, size);
+  REQUIRE(region);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+
+  // everything starts dirty
+  PageTracking::GetDirtyRanges(region, ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == 0);
+  CHECK(ranges[0].second == size);
+
+  PageTracking::GetDirtyRanges(region, ranges);
+  CHECK(ranges.empty());
+
+  // reads don't dirty anything
+  volatile byte read = mem[offset + pageSize * 2];
+  (void)read;
+
+  mem[offset + pageSize * 2] = 1;
+  mem[offset + pageSize * 2 + 10] = 2;
+  mem[offset + pageSize * 3 + 5] = 3;
+  mem[offset + pageSize * 7] = 4;
+  mem[offset + size - 1] = 5;
+
+  PageTracking::GetDirtyRanges(region, ranges);
+  REQUIRE(ranges.size() == 3);
+  CHECK(ranges[0].first == pageSize * 2 - offset);
+  CHECK(ranges[0].second == pageSize * 4 - offset);
+  CHECK(ranges[1].first == pageSize * 7 - offset);
+  CHECK(ranges[1].second == pageSize * 8 - offset);
+  CHECK(ranges[2].first == pageSize * 10 - offset);
+  CHECK(ranges[2].second == size);
+
+  CHECK(mem[offset + pageSize * 2] == 1);
+  CHECK(mem[offset + size - 1] == 5);
+
+  // writes after collecting are caught again
+  mem[offset + pageSize * 2] = 6;
+
+  PageTracking::GetDirtyRanges(region, ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == pageSize * 2 - offset);
+
+  PageTracking::Untrack(region);
+
+  // untracked memory is writable again
+  mem[offset + pageSize * 5] = 7;
+  CHECK(mem[offset + pageSize * 5] == 7);
+
+  munmap(mem, pageSize * numPages);
+};
+
+TEST_CASE("Test page write tracking with a shared page", "[osspecific]")
+{
+  const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t numPages = 4;
+
+  byte *mem = (byte *)mmap(NULL, pageSize * numPages, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(mem != MAP_FAILED);
+
+  // two regions that meet in the middle of page 1
+  const size_t split = pageSize + 64;
+
+  PageTracking::Region *a = PageTracking::Track(mem, split);
+  PageTracking::Region *b = PageTracking::Track(mem + split, pageSize * numPages - split);
+  REQUIRE(a);
+  REQUIRE(b);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+
+  PageTracking::GetDirtyRanges(a, ranges);
+  PageTracking::GetDirtyRanges(b, ranges);
+
+  PageTracking::Untrack(a);
+
+  // a's own page is writable, the shared page must still be tracked for b
+  mem[0] = 1;
+  mem[split + 8] = 2;
+
+  PageTracking::GetDirtyRanges(b, ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == 0);
+  CHECK(ranges[0].second == pageSize * 2 - split);
+
+  PageTracking::Untrack(b);
+
+  mem[split + 8] = 3;
+  CHECK(mem[split + 8] == 3);
+
+  munmap(mem, pageSize * numPages);
+};
+
+TEST_CASE("Test page write tracking after the fault handler is replaced", "[osspecific]")
+{
+  const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t numPages = 4;
+
+  byte *mem = (byte *)mmap(NULL, pageSize * numPages, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  REQUIRE(mem != MAP_FAILED);
+
+  PageTracking::Region *region = PageTracking::Track(mem, pageSize * numPages);
+  REQUIRE(region);
+
+  rdcarray<rdcpair<size_t, size_t>> ranges;
+  PageTracking::GetDirtyRanges(region, ranges);
+  PageTracking::GetDirtyRanges(region, ranges);
+  CHECK(ranges.empty());
+
+  struct sigaction ours = {}, other = {};
+  sigemptyset(&other.sa_mask);
+  other.sa_handler = SIG_DFL;
+  sigaction(SIGSEGV, &other, &ours);
+
+  // nothing can be tracked any more, so everything is reported and the memory is writable
+  PageTracking::GetDirtyRanges(region, ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == 0);
+  CHECK(ranges[0].second == pageSize * numPages);
+
+  mem[pageSize] = 1;
+  CHECK(mem[pageSize] == 1);
+
+  CHECK(PageTracking::Track(mem, pageSize) == NULL);
+
+  PageTracking::Untrack(region);
+
+  // with nothing tracked the handler is installed again
+  region = PageTracking::Track(mem, pageSize * numPages);
+  REQUIRE(region);
+
+  PageTracking::GetDirtyRanges(region, ranges);
+  mem[pageSize * 2] = 2;
+  PageTracking::GetDirtyRanges(region, ranges);
+  REQUIRE(ranges.size() == 1);
+  CHECK(ranges[0].first == pageSize * 2);
+
+  PageTracking::Untrack(region);
+
+  sigaction(SIGSEGV, &ours, NULL);
+
+  munmap(mem, pageSize * numPages);
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
@@ -32,6 +32,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <time.h>
@@ -450,6 +451,62 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+struct FileMapping
+{
+  void *base;
+  size_t length;
+  const byte *data;
+};
+
+FileMapping *MapFile(FILE *f, uint64_t offset, uint64_t length)
+{
+  if(length == 0)
+    return NULL;
+
+  // make sure anything we've written is visible through the mapping
+  ::fflush(f);
+
+  // pages past the end of the file fault when they're read, so don't map a range the file
+  // doesn't cover and let the caller read it normally
+  struct stat st = {};
+  if(fstat(::fileno(f), &st) != 0 || offset + length > (uint64_t)st.st_size)
+  {
+    RDCWARN("Can't map %llu bytes at %llu, past the end of the file", length, offset);
+    return NULL;
+  }
+
+  // mappings must start on a page boundary
+  uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+  uint64_t alignedOffset = offset - (offset % pageSize);
+  size_t mapLength = size_t(length + offset - alignedOffset);
+
+  void *base = mmap(NULL, mapLength, PROT_READ, MAP_PRIVATE, ::fileno(f), (off_t)alignedOffset);
+
+  if(base == MAP_FAILED)
+  {
+    RDCWARN("Couldn't map %llu bytes of file: errno %d", length, errno);
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->base = base;
+  ret->length = mapLength;
+  ret->data = (const byte *)base + (offset - alignedOffset);
+  return ret;
+}
+
+const byte *GetMappedData(FileMapping *mapping)
+{
+  return mapping->data;
+}
+
+void UnmapFile(FileMapping *mapping)
+{
+  if(mapping)
+    munmap(mapping->base, mapping->length);
+  delete mapping;
+}
+
 bool exists(const char *filename)
 {
   struct ::stat st;
@@ -157,6 +157,52 @@ void RWLock::ReadUnlock()
   pthread_rwlock_unlock(&m_Data.rwlock);
 }
 
+struct PosixSemaphore
+{
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t count;
+};
+
+Semaphore *Semaphore::Create()
+{
+  PosixSemaphore *sem = new PosixSemaphore;
+  pthread_mutex_init(&sem->lock, NULL);
+  pthread_cond_init(&sem->cond, NULL);
+  sem->count = 0;
+  return (Semaphore *)sem;
+}
+
+void Semaphore::Destroy()
+{
+  PosixSemaphore *sem = (PosixSemaphore *)this;
+  pthread_cond_destroy(&sem->cond);
+  pthread_mutex_destroy(&sem->lock);
+  delete sem;
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  PosixSemaphore *sem = (PosixSemaphore *)this;
+  pthread_mutex_lock(&sem->lock);
+  sem->count += numToWake;
+  if(numToWake == 1)
+    pthread_cond_signal(&sem->cond);
+  else
+    pthread_cond_broadcast(&sem->cond);
+  pthread_mutex_unlock(&sem->lock);
+}
+
+void Semaphore::WaitForWake()
+{
+  PosixSemaphore *sem = (PosixSemaphore *)this;
+  pthread_mutex_lock(&sem->lock);
+  while(sem->count == 0)
+    pthread_cond_wait(&sem->cond, &sem->lock);
+  sem->count--;
+  pthread_mutex_unlock(&sem->lock);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
@@ -28,6 +28,7 @@
 #include "api/replay/stringise.h"
 #include "common/common.h"
 #include "common/formatting.h"
+#include "core/settings.h"
 #include "os/os_specific.h"
 
 #ifndef WSA_FLAG_NO_HANDLE_INHERIT
@@ -99,6 +100,53 @@ static rdcstr wsaerr_string(int err)
   return StringFormat::Fmt("Unknown error %d", err);
 }
 
+RDOC_CONFIG(uint64_t, Network_SocketBufferKB, 0,
+            "The size in kilobytes to request for socket send and receive buffers. 0 leaves the "
+            "system default, which lets the OS auto-tune the buffers.");
+
+// waits for the socket to be readable (or writable). Returns 1 when ready, 0 on timeout and
+// SOCKET_ERROR on error.
+static int WaitForSocket(SOCKET s, bool write, uint32_t timeoutMS)
+{
+  fd_set set = {}, setE = {};
+  FD_ZERO(&set);
+  FD_ZERO(&setE);
+
+// macro FD_SET contains the do { } while(0) idiom, which warns
+#pragma warning(push)
+#pragma warning(disable : 4127)    // conditional expression is constant
+  FD_SET(s, &set);
+  FD_SET(s, &setE);
+#pragma warning(pop)
+
+  timeval timeout;
+  timeout.tv_sec = (timeoutMS / 1000);
+  timeout.tv_usec = (timeoutMS % 1000) * 1000;
+
+  int ret = select(0, write ? NULL : &set, write ? &set : NULL, &setE, &timeout);
+
+  // an exceptional socket counts as ready, so that the next call on it reports the error.
+  return ret > 0 ? 1 : ret;
+}
+
+// set up a newly connected socket. All sockets are non-blocking, and blocking operations wait with
+// select() so that we don't need to toggle the socket's mode and timeouts on every call.
+static void ConfigureConnectedSocket(SOCKET s)
+{
+  u_long enable = 1;
+  ioctlsocket(s, FIONBIO, &enable);
+
+  BOOL nodelay = TRUE;
+  setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+
+  if(Network_SocketBufferKB > 0)
+  {
+    int size = (int)RDCMIN(Network_SocketBufferKB * 1024, (uint64_t)INT32_MAX);
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, (const char *)&size, sizeof(size));
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, (const char *)&size, sizeof(size));
+  }
+}
+
 namespace Network
 {
 void Init()
@@ -144,17 +192,14 @@ uint32_t Socket::GetRemoteIP() const
 
 Socket *Socket::AcceptClient(uint32_t timeoutMilliseconds)
 {
-  do
+  // try once immediately, then if nothing is waiting wait for a connection and try again.
+  for(int attempt = 0; attempt < 2; attempt++)
   {
     SOCKET s = accept(socket, NULL, NULL);
 
     if(s != INVALID_SOCKET)
     {
-      u_long enable = 1;
-      ioctlsocket(s, FIONBIO, &enable);
-
-      BOOL nodelay = TRUE;
-      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+      ConfigureConnectedSocket(s);
 
       return new Socket((ptrdiff_t)s);
     }
@@ -165,51 +210,92 @@ Socket *Socket::AcceptClient(uint32_t timeoutMilliseconds)
     {
       RDCWARN("accept: %s", wsaerr_string(err).c_str());
       Shutdown();
+      return NULL;
     }
 
-    const uint32_t sleeptime = 4;
+    if(attempt > 0 || timeoutMilliseconds == 0 || !WaitForRecv(timeoutMilliseconds))
+      break;
+  }
 
-    Threading::Sleep(sleeptime);
+  return NULL;
+}
 
-    if(sleeptime < timeoutMilliseconds)
-      timeoutMilliseconds -= sleeptime;
-    else
-      timeoutMilliseconds = 0U;
-  } while(timeoutMilliseconds);
+bool Socket::WaitForRecv(uint32_t timeoutMilliseconds)
+{
+  if(!Connected())
+    return false;
 
-  return NULL;
+  int ret = WaitForSocket((SOCKET)socket, false, timeoutMilliseconds);
+
+  if(ret == SOCKET_ERROR)
+  {
+    RDCWARN("select: %s", wsaerr_string(WSAGetLastError()).c_str());
+    return false;
+  }
+
+  return ret > 0;
 }
 
 bool Socket::SendDataBlocking(const void *buf, uint32_t length)
 {
-  if(length == 0)
-    return true;
+  SendBuffer send = {buf, length};
+  return SendDataBlocking(&send, 1);
+}
+
+bool Socket::SendDataBlocking(const SendBuffer *bufs, uint32_t count)
+{
+  // the buffer we're up to, and how much of it has been sent
+  uint32_t cur = 0;
+  uint32_t curSent = 0;
 
-  uint32_t sent = 0;
+  WSABUF wsabufs[64];
 
-  char *src = (char *)buf;
+  while(true)
+  {
+    while(cur < count && curSent == bufs[cur].length)
+    {
+      cur++;
+      curSent = 0;
+    }
 
-  u_long enable = 0;
-  ioctlsocket(socket, FIONBIO, &enable);
+    if(cur == count)
+      break;
 
-  DWORD oldtimeout = 0;
-  int len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (char *)&oldtimeout, &len);
+    DWORD numBufs = 0;
 
-  DWORD timeout = timeoutMS;
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+    for(uint32_t i = cur; i < count && numBufs < ARRAY_COUNT(wsabufs); i++)
+    {
+      uint32_t offs = (i == cur) ? curSent : 0;
 
-  while(sent < length)
-  {
-    int ret = send(socket, src, length - sent, 0);
+      if(bufs[i].length == offs)
+        continue;
+
+      wsabufs[numBufs].buf = (CHAR *)bufs[i].data + offs;
+      wsabufs[numBufs].len = bufs[i].length - offs;
+      numBufs++;
+    }
 
-    if(ret <= 0)
+    DWORD sent = 0;
+    int ret = WSASend((SOCKET)socket, wsabufs, numBufs, &sent, 0, NULL, NULL);
+
+    if(ret == SOCKET_ERROR)
     {
       int err = WSAGetLastError();
 
-      if(err == WSAEWOULDBLOCK || err == WSAETIMEDOUT)
+      if(err == WSAEWOULDBLOCK)
       {
-        RDCWARN("Timeout in send");
+        // the socket buffer is full, wait for it to drain. The timeout applies to each wait, so it
+        // only triggers if the other end stops reading entirely.
+        int ready = WaitForSocket((SOCKET)socket, true, timeoutMS);
+
+        if(ready > 0)
+          continue;
+
+        if(ready == 0)
+          RDCWARN("Timeout in send");
+        else
+          RDCWARN("select: %s", wsaerr_string(WSAGetLastError()).c_str());
+
         Shutdown();
         return false;
       }
@@ -221,16 +307,24 @@ bool Socket::SendDataBlocking(const void *buf, uint32_t length)
       }
     }
 
-    sent += ret;
-    src += ret;
-  }
-
-  enable = 1;
-  ioctlsocket(socket, FIONBIO, &enable);
-
-  setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
+    // step past what was sent
+    while(sent > 0)
+    {
+      uint32_t remaining = bufs[cur].length - curSent;
 
-  RDCASSERT(sent == length);
+      if(sent >= remaining)
+      {
+        sent -= remaining;
+        cur++;
+        curSent = 0;
+      }
+      else
+      {
+        curSent += sent;
+        sent = 0;
+      }
+    }
+  }
 
   return true;
 }
@@ -305,18 +399,9 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
 
   char *dst = (char *)buf;
 
-  u_long enable = 0;
-  ioctlsocket(socket, FIONBIO, &enable);
-
-  DWORD oldtimeout = 0;
-  int len = sizeof(oldtimeout);
-  getsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (char *)&oldtimeout, &len);
-
-  DWORD timeout = timeoutMS;
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
-
   while(received < length)
   {
+    // read whatever is already here first, and only wait if there's nothing
     int ret = recv(socket, dst, length - received, 0);
 
     if(ret == 0)
@@ -324,13 +409,22 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
       Shutdown();
       return false;
     }
-    else if(ret <= 0)
+    else if(ret < 0)
     {
       int err = WSAGetLastError();
 
-      if(err == WSAEWOULDBLOCK || err == WSAETIMEDOUT)
+      if(err == WSAEWOULDBLOCK)
       {
-        RDCWARN("Timeout in recv");
+        int ready = WaitForSocket((SOCKET)socket, false, timeoutMS);
+
+        if(ready > 0)
+          continue;
+
+        if(ready == 0)
+          RDCWARN("Timeout in recv");
+        else
+          RDCWARN("select: %s", wsaerr_string(WSAGetLastError()).c_str());
+
         Shutdown();
         return false;
       }
@@ -346,16 +440,24 @@ bool Socket::RecvDataBlocking(void *buf, uint32_t length)
     dst += ret;
   }
 
-  enable = 1;
-  ioctlsocket(socket, FIONBIO, &enable);
-
-  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, (const char *)&oldtimeout, sizeof(oldtimeout));
-
   RDCASSERT(received == length);
 
   return true;
 }
 
+void Socket::SetNoDelay(bool nodelay)
+{
+  BOOL enable = nodelay ? TRUE : FALSE;
+  setsockopt((SOCKET)socket, IPPROTO_TCP, TCP_NODELAY, (const char *)&enable, sizeof(enable));
+}
+
+void Socket::SetCork(bool cork)
+{
+  // winsock has no equivalent to corking, and turning nagle back on and off doesn't reliably push
+  // out what it held back. Gathered sends already batch the data so we don't do anything here.
+  corked = cork;
+}
+
 Socket *CreateServerSocket(const char *bindaddr, uint16_t port, int queuesize)
 {
   SOCKET s = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0,
@@ -477,8 +579,7 @@ Socket *CreateClientSocket(const char *host, uint16_t port, int timeoutMS)
       }
     }
 
-    BOOL nodelay = TRUE;
-    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+    ConfigureConnectedSocket(s);
 
     FreeAddrInfoW(addrResult);
 
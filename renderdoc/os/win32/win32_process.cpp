@@ -1641,3 +1641,21 @@ void Process::Shutdown()
 {
   // nothing to do
 }
+
+bool PageTracking::IsSupported()
+{
+  return false;
+}
+
+PageTracking::Region *PageTracking::Track(void *base, size_t size)
+{
+  return NULL;
+}
+
+void PageTracking::Untrack(Region *region)
+{
+}
+
+void PageTracking::GetDirtyRanges(Region *region, rdcarray<rdcpair<size_t, size_t>> &ranges)
+{
+}
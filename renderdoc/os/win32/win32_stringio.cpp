@@ -653,6 +653,73 @@ int fclose(FILE *f)
   return ::fclose(f);
 }
 
+struct FileMapping
+{
+  HANDLE mapping;
+  void *base;
+  const byte *data;
+};
+
+FileMapping *MapFile(FILE *f, uint64_t offset, uint64_t length)
+{
+  if(length == 0)
+    return NULL;
+
+  // make sure anything we've written is visible through the mapping
+  ::fflush(f);
+
+  HANDLE file = (HANDLE)_get_osfhandle(_fileno(f));
+
+  if(file == INVALID_HANDLE_VALUE)
+    return NULL;
+
+  HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+  if(mapping == NULL)
+  {
+    RDCWARN("Couldn't create file mapping: %u", GetLastError());
+    return NULL;
+  }
+
+  // views must start on an allocation granularity boundary
+  SYSTEM_INFO info = {};
+  GetSystemInfo(&info);
+
+  uint64_t alignedOffset = offset - (offset % info.dwAllocationGranularity);
+
+  void *base = MapViewOfFile(mapping, FILE_MAP_READ, DWORD(alignedOffset >> 32),
+                             DWORD(alignedOffset & 0xffffffff),
+                             SIZE_T(length + offset - alignedOffset));
+
+  if(base == NULL)
+  {
+    RDCWARN("Couldn't map %llu bytes of file: %u", length, GetLastError());
+    CloseHandle(mapping);
+    return NULL;
+  }
+
+  FileMapping *ret = new FileMapping;
+  ret->mapping = mapping;
+  ret->base = base;
+  ret->data = (const byte *)base + (offset - alignedOffset);
+  return ret;
+}
+
+const byte *GetMappedData(FileMapping *mapping)
+{
+  return mapping->data;
+}
+
+void UnmapFile(FileMapping *mapping)
+{
+  if(mapping)
+  {
+    UnmapViewOfFile(mapping->base);
+    CloseHandle(mapping->mapping);
+  }
+  delete mapping;
+}
+
 LogFileHandle *logfile_open(const char *filename)
 {
   rdcwstr wfn = StringFormat::UTF82Wide(filename);
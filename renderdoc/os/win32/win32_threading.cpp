@@ -151,6 +151,27 @@ void RWLock::ReadUnlock()
   ReleaseSRWLockShared(&m_Data);
 }
 
+Semaphore *Semaphore::Create()
+{
+  HANDLE ret = CreateSemaphore(NULL, 0, LONG_MAX, NULL);
+  return (Semaphore *)ret;
+}
+
+void Semaphore::Destroy()
+{
+  CloseHandle((HANDLE)this);
+}
+
+void Semaphore::Wake(uint32_t numToWake)
+{
+  ReleaseSemaphore((HANDLE)this, (LONG)numToWake, NULL);
+}
+
+void Semaphore::WaitForWake()
+{
+  WaitForSingleObject((HANDLE)this, INFINITE);
+}
+
 struct ThreadInitData
 {
   std::function<void()> entryFunc;
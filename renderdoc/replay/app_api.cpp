@@ -95,6 +95,10 @@ static uint32_t GetCapture(uint32_t idx, char *filename, uint32_t *pathlength, u
 
   CaptureData &c = caps[idx];
 
+  // the caller is likely to open the file, so make sure it has been completely written
+  if(filename)
+    RenderDoc::Inst().FlushCaptureWriting();
+
   if(filename)
     memcpy(filename, c.path.c_str(), sizeof(char) * (c.path.size() + 1));
   if(pathlength)
@@ -107,6 +111,9 @@ static uint32_t GetCapture(uint32_t idx, char *filename, uint32_t *pathlength, u
 
 static void SetCaptureFileComments(const char *filePath, const char *comments)
 {
+  // the file may still be being written in the background
+  RenderDoc::Inst().FlushCaptureWriting();
+
   rdcstr path;
   if(filePath == NULL || filePath[0] == 0)
   {
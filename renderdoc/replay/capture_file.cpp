@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "common/dds_readwrite.h"
 #include "core/core.h"
 #include "jpeg-compressor/jpgd.h"
 #include "jpeg-compressor/jpge.h"
@@ -38,6 +39,49 @@ static void writeToByteVector(void *context, void *data, int size)
   buf->append((byte *)data, size);
 }
 
+// DDS images have no embedded thumbnail, so decode the first subresource on the CPU. This means
+// thumbnails work without a replay device, including for block compressed formats.
+static bool LoadDDSThumbnail(const rdcstr &filename, bytebuf &rgb, uint32_t &width,
+                             uint32_t &height)
+{
+  FILE *f = FileIO::fopen(filename.c_str(), "rb");
+
+  if(!f)
+    return false;
+
+  byte headerBuffer[4];
+  const size_t headerSize = FileIO::fread(headerBuffer, 1, 4, f);
+
+  if(!is_dds_file(headerBuffer, headerSize))
+  {
+    FileIO::fclose(f);
+    return false;
+  }
+
+  FileIO::fseek64(f, 0, SEEK_SET);
+
+  // only read the subresource we need, not the whole file
+  DDSReader *dds = DDSReader::Open(f, filename);
+
+  if(dds == NULL)
+    return false;
+
+  // subresource 0 is the top mip of the first slice, for 3D textures we take the first depth slice
+  bytebuf data;
+  bool ret = dds->ReadSubresource(0, data);
+
+  if(ret)
+  {
+    width = dds->GetData().width;
+    height = dds->GetData().height;
+    ret = decode_dds_to_rgb8(dds->GetData().format, data.data(), data.size(), width, height, rgb);
+  }
+
+  delete dds;
+
+  return ret;
+}
+
 static RDCDriver driverFromName(const char *driverName)
 {
   for(int d = (int)RDCDriver::Unknown; d < (int)RDCDriver::MaxBuiltin; d++)
@@ -554,6 +598,16 @@ Thumbnail CaptureFile::GetThumbnail(FileType type, uint32_t maxsize)
   const byte *thumbbuf = thumb.pixels;
   size_t thumblen = thumb.len;
   uint32_t thumbwidth = thumb.width, thumbheight = thumb.height;
+  FileType thumbformat = thumb.format;
+
+  bytebuf ddsPixels;
+  if(thumbbuf == NULL && m_RDC->GetDriver() == RDCDriver::Image &&
+     LoadDDSThumbnail(m_RDC->GetFilename(), ddsPixels, thumbwidth, thumbheight))
+  {
+    thumbbuf = ddsPixels.data();
+    thumblen = ddsPixels.size();
+    thumbformat = FileType::Raw;
+  }
 
   if(thumbbuf == NULL)
     return ret;
@@ -562,7 +616,7 @@ Thumbnail CaptureFile::GetThumbnail(FileType type, uint32_t maxsize)
 
   // if the desired output is the format of stored thumbnail and either there's no max size or it's
   // already satisfied, return the data directly
-  if(type == thumb.format && (maxsize == 0 || (maxsize > thumbwidth && maxsize > thumbheight)))
+  if(type == thumbformat && (maxsize == 0 || (maxsize > thumbwidth && maxsize > thumbheight)))
   {
     buf.assign(thumbbuf, thumblen);
   }
@@ -575,7 +629,7 @@ Thumbnail CaptureFile::GetThumbnail(FileType type, uint32_t maxsize)
     int comp = 3;
     const byte *thumbpixels = NULL;
     byte *allocatedBuffer = NULL;
-    switch(thumb.format)
+    switch(thumbformat)
     {
       case FileType::JPG:
         allocatedBuffer =
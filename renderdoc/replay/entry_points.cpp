@@ -33,6 +33,7 @@
 #include "maths/formatpacking.h"
 #include "miniz/miniz.h"
 #include "replay/replay_driver.h"
+#include "serialise/serialiser.h"
 #include "strings/string_utils.h"
 
 // these entry points are for the replay/analysis side - not for the application.
@@ -423,6 +424,28 @@ extern "C" RENDERDOC_API void *RENDERDOC_CC RENDERDOC_AllocArrayMem(uint64_t sz)
   return ret;
 }
 
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_FreeStructuredMem(void *mem)
+{
+  SDObjectArena::Free(mem);
+}
+
+extern "C" RENDERDOC_API void *RENDERDOC_CC RENDERDOC_AllocStructuredMem(uint64_t sz,
+                                                                        SDObjectArena *arena)
+{
+  return SDObjectArena::Allocate(sz, arena);
+}
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_PopulateLazyStructuredObject(SDObject *obj,
+                                                                                bool keep)
+{
+  SDObjectLazyData::Populate(obj, keep);
+}
+
+extern "C" RENDERDOC_API void RENDERDOC_CC RENDERDOC_ReleaseLazyStructuredObject(SDObject *obj)
+{
+  SDObjectLazyData::Release(obj);
+}
+
 extern "C" RENDERDOC_API uint32_t RENDERDOC_CC RENDERDOC_EnumerateRemoteTargets(const char *URL,
                                                                                 uint32_t nextIdent)
 {
@@ -27,6 +27,9 @@
 #include <string.h>
 #include <time.h>
 #include "common/dds_readwrite.h"
+#include "core/jobsystem.h"
+#include "core/settings.h"
+#include "core/shader_debug_trace.h"
 #include "driver/ihv/amd/amd_isa.h"
 #include "driver/ihv/amd/amd_rgp.h"
 #include "jpeg-compressor/jpgd.h"
@@ -38,8 +41,14 @@
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
 #include "strings/string_utils.h"
+#include "texture_convert.h"
 #include "tinyexr/tinyexr.h"
 
+RDOC_CONFIG(uint64_t, Replay_TextureSaveMemoryMB, 1024,
+            "When saving several textures at once, the most texture data in MB that can be read "
+            "back and waiting to be written out before the readback pauses. If 0 there is no "
+            "limit.");
+
 static void fileWriteFunc(void *context, void *data, int size)
 {
   FileIO::fwrite(data, 1, size, (FILE *)context);
@@ -83,6 +92,11 @@ ReplayController::~ReplayController()
 
   m_TargetResources.clear();
 
+  for(auto it = m_DebugStates.begin(); it != m_DebugStates.end(); ++it)
+    delete it->second;
+
+  m_DebugStates.clear();
+
   if(m_pDevice)
     m_pDevice->Shutdown();
   m_pDevice = NULL;
@@ -101,9 +115,12 @@ void ReplayController::SetFrameEvent(uint32_t eventId, bool force)
     for(size_t i = 0; i < m_Outputs.size(); i++)
       m_Outputs[i]->SetFrameEvent(eventId);
 
-    m_pDevice->ReplayLog(eventId, eReplay_OnlyDraw);
-
-    FetchPipelineState(eventId);
+    // when replaying remotely, the draw and the pipeline state fetch are sent together so they only
+    // cost one round-trip
+    m_pDevice->ExecuteBatch({
+        [this, eventId]() { m_pDevice->ReplayLog(eventId, eReplay_OnlyDraw); },
+        [this, eventId]() { FetchPipelineState(eventId); },
+    });
   }
 }
 
@@ -548,11 +565,142 @@ bytebuf ReplayController::GetTextureData(ResourceId tex, const Subresource &sub)
   return ret;
 }
 
+// a texture save once its subresources have been read back. Everything past the readback only
+// works on this data, so the conversion and encoding can be done off the replay thread.
+struct TextureSaveData
+{
+  TextureSaveData() = default;
+  TextureSaveData(const TextureSaveData &) = delete;
+  TextureSaveData &operator=(const TextureSaveData &) = delete;
+  ~TextureSaveData()
+  {
+    for(size_t i = 0; i < subdata.size(); i++)
+      delete[] subdata[i];
+  }
+
+  // the save settings and texture description, clamped and adjusted for the destination format
+  TextureSave sd;
+  TextureDescription td;
+
+  rdcarray<byte *> subdata;
+  uint64_t byteSize = 0;
+
+  uint32_t rowPitch = 0;
+  uint32_t numMips = 1;
+  uint32_t numSlices = 1;
+  bool singleSlice = false;
+};
+
+static bool EncodeTextureSave(TextureSaveData &data, const char *path);
+
 bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path)
 {
   CHECK_REPLAY_THREAD();
 
-  TextureSave sd = saveData;    // mutable copy
+  TextureSaveData data;
+
+  if(!FetchTextureSave(saveData, data))
+    return false;
+
+  return EncodeTextureSave(data, path);
+}
+
+rdcarray<bool> ReplayController::SaveTextures(const rdcarray<TextureSave> &saveData,
+                                              const rdcarray<rdcstr> &paths,
+                                              RENDERDOC_ProgressCallback progress)
+{
+  CHECK_REPLAY_THREAD();
+
+  rdcarray<bool> ret;
+  ret.resize(saveData.size());
+
+  if(saveData.size() != paths.size())
+  {
+    RDCERR("Got %zu textures to save but %zu paths", saveData.size(), paths.size());
+    return ret;
+  }
+
+  struct PendingSave
+  {
+    TextureSaveData *data;
+    JobSystem::Job *job;
+  };
+
+  // saves that have been read back and are being encoded, oldest first
+  rdcarray<PendingSave> pending;
+  uint64_t pendingBytes = 0;
+
+  const uint64_t maxPendingBytes = Replay_TextureSaveMemoryMB * 1024 * 1024;
+
+  // each save counts as two steps, one for the readback and one for the encode
+  const float numSteps = float(saveData.size() * 2);
+  size_t stepsDone = 0;
+
+  auto retireOldest = [&]() {
+    PendingSave p = pending[0];
+    pending.erase(0);
+
+    JobSystem::SyncJob(p.job);
+
+    pendingBytes -= p.data->byteSize;
+    delete p.data;
+
+    stepsDone++;
+    if(progress)
+      progress(float(stepsDone) / numSteps);
+  };
+
+  for(size_t i = 0; i < saveData.size(); i++)
+  {
+    TextureSaveData *data = new TextureSaveData;
+
+    stepsDone++;
+
+    if(!FetchTextureSave(saveData[i], *data))
+    {
+      delete data;
+
+      ret[i] = false;
+      stepsDone++;
+      if(progress)
+        progress(float(stepsDone) / numSteps);
+      continue;
+    }
+
+    if(progress)
+      progress(float(stepsDone) / numSteps);
+
+    // ret is never resized past this point so the element can be written from the job
+    bool *result = &ret[i];
+    rdcstr path = paths[i];
+
+    pending.push_back(
+        {data, JobSystem::AddJob([data, result, path]() {
+           *result = EncodeTextureSave(*data, path.c_str());
+         })});
+    pendingBytes += data->byteSize;
+
+    // free up anything that's already been written, then if we're still holding too much data
+    // wait for the oldest saves before reading back any more.
+    while(!pending.empty() && JobSystem::IsJobComplete(pending[0].job))
+      retireOldest();
+
+    while(!pending.empty() && maxPendingBytes > 0 && pendingBytes > maxPendingBytes)
+      retireOldest();
+  }
+
+  while(!pending.empty())
+    retireOldest();
+
+  return ret;
+}
+
+bool ReplayController::FetchTextureSave(const TextureSave &saveData, TextureSaveData &data)
+{
+  CHECK_REPLAY_THREAD();
+
+  TextureSave &sd = data.sd;
+  sd = saveData;
   ResourceId liveid = m_pDevice->GetLiveID(sd.resourceId);
 
   if(liveid == ResourceId())
@@ -561,9 +709,8 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
     return false;
   }
 
-  TextureDescription td = m_pDevice->GetTexture(liveid);
-
-  bool success = false;
+  TextureDescription &td = data.td;
+  td = m_pDevice->GetTexture(liveid);
 
   // clamp sample/mip/slice indices
   if(td.msSamp == 1)
@@ -714,7 +861,7 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
     // otherwise take all mips, as by default
   }
 
-  rdcarray<byte *> subdata;
+  rdcarray<byte *> &subdata = data.subdata;
 
   bool downcast = false;
 
@@ -855,24 +1002,21 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
 
       Subresource sub = {mip, slice / sampleCount, slice % sampleCount};
 
-      bytebuf data;
-      m_pDevice->GetTextureData(liveid, sub, params, data);
+      bytebuf texData;
+      m_pDevice->GetTextureData(liveid, sub, params, texData);
 
-      if(data.empty())
+      if(texData.empty())
       {
         RDCERR("Couldn't get bytes for mip %u, slice %u", mip, slice);
-
-        for(size_t i = 0; i < subdata.size(); i++)
-          delete[] subdata[i];
-
         return false;
       }
 
       if(td.depth == 1)
       {
-        byte *bytes = new byte[data.size()];
-        memcpy(bytes, data.data(), data.size());
+        byte *bytes = new byte[texData.size()];
+        memcpy(bytes, texData.data(), texData.size());
         subdata.push_back(bytes);
+        data.byteSize += texData.size();
         continue;
       }
 
@@ -898,16 +1042,17 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
       if(numSlices == 1)
       {
         byte *depthslice = new byte[mipSlicePitch];
-        byte *b = data.data() + mipSlicePitch * sliceOffset;
+        byte *b = texData.data() + mipSlicePitch * sliceOffset;
         memcpy(depthslice, b, slicePitch);
         subdata.push_back(depthslice);
+        data.byteSize += mipSlicePitch;
 
         continue;
       }
 
       s += (d - 1);
 
-      byte *b = data.data();
+      byte *b = texData.data();
 
       // add each depth slice as a separate subdata
       for(uint32_t di = 0; di < d; di++)
@@ -917,12 +1062,34 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
         memcpy(depthslice, b, mipSlicePitch);
 
         subdata.push_back(depthslice);
+        data.byteSize += mipSlicePitch;
 
         b += mipSlicePitch;
       }
     }
   }
 
+  data.rowPitch = rowPitch;
+  data.numMips = numMips;
+  data.numSlices = numSlices;
+  data.singleSlice = singleSlice;
+
+  return true;
+}
+
+static bool EncodeTextureSave(TextureSaveData &data, const char *path)
+{
+  const TextureSave &sd = data.sd;
+  TextureDescription &td = data.td;
+  rdcarray<byte *> &subdata = data.subdata;
+
+  uint32_t rowPitch = data.rowPitch;
+  const uint32_t numMips = data.numMips;
+  const uint32_t numSlices = data.numSlices;
+  const bool singleSlice = data.singleSlice;
+
+  bool success = false;
+
   // should have been handled above, but verify incoming data is RGBA8 or RGBA32
   if(sd.slice.slicesAsGrid && (td.format.compByteWidth == 1 || td.format.compByteWidth == 4) &&
      td.format.compCount == 4 && !td.format.Special())
@@ -948,20 +1115,8 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
       uint32_t gridx = (uint32_t)i % sd.slice.sliceGridWidth;
       uint32_t gridy = (uint32_t)i / sd.slice.sliceGridWidth;
 
-      uint32_t yoffs = gridy * sliceHeight;
-      uint32_t xoffs = gridx * sliceWidth;
-
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
+      TextureConvert::CopyTile(subdata[i], sliceWidth, sliceHeight, combinedData, td.width,
+                               gridx * sliceWidth, gridy * sliceHeight, pixelStride);
 
       delete[] subdata[i];
     }
@@ -1007,20 +1162,8 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
 
     for(size_t i = 0; i < subdata.size(); i++)
     {
-      uint32_t yoffs = gridy[i] * sliceHeight;
-      uint32_t xoffs = gridx[i] * sliceWidth;
-
-      for(uint32_t y = 0; y < sliceHeight; y++)
-      {
-        for(uint32_t x = 0; x < sliceWidth; x++)
-        {
-          uint32_t *srcpix = (uint32_t *)&subdata[i][(y * sliceWidth + x) * pixelStride + 0];
-          uint32_t *dstpix =
-              (uint32_t *)&combinedData[((y + yoffs) * td.width + x + xoffs) * pixelStride + 0];
-
-          memcpy(dstpix, srcpix, pixelStride);
-        }
-      }
+      TextureConvert::CopyTile(subdata[i], sliceWidth, sliceHeight, combinedData, td.width,
+                               gridx[i] * sliceWidth, gridy[i] * sliceHeight, pixelStride);
 
       delete[] subdata[i];
     }
@@ -1038,41 +1181,8 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
      (td.format.compByteWidth == 1 || td.format.compByteWidth == 4) &&
      (uint32_t)sd.channelExtract < td.format.compCount)
   {
-    uint32_t pixelStride = td.format.compCount * td.format.compByteWidth;
-    uint32_t compWidth = td.format.compByteWidth;
-    uint32_t compCount = td.format.compCount;
-
-    uint32_t val = 0;
-    uint32_t max = ~0U;
-
-    for(uint32_t y = 0; y < td.height; y++)
-    {
-      for(uint32_t x = 0; x < td.width; x++)
-      {
-        memcpy(&val, &subdata[0][(y * td.width + x) * pixelStride + sd.channelExtract * compWidth],
-               td.format.compByteWidth);
-
-        switch(compCount)
-        {
-          case 4:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 3 * compWidth], &max,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 3:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 2 * compWidth], &val,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 2:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 1 * compWidth], &val,
-                   td.format.compByteWidth);
-            DELIBERATE_FALLTHROUGH();
-          case 1:
-            memcpy(&subdata[0][(y * td.width + x) * pixelStride + 0 * compWidth], &val,
-                   td.format.compByteWidth);
-            break;
-        }
-      }
-    }
+    TextureConvert::ExtractChannel(subdata[0], td.width, td.height, td.format.compCount,
+                                   td.format.compByteWidth, sd.channelExtract);
   }
 
   // handle formats that don't support alpha
@@ -1080,46 +1190,9 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
   {
     byte *nonalpha = new byte[td.width * td.height * 3];
 
-    for(uint32_t y = 0; y < td.height; y++)
-    {
-      for(uint32_t x = 0; x < td.width; x++)
-      {
-        byte r = subdata[0][(y * td.width + x) * 4 + 0];
-        byte g = subdata[0][(y * td.width + x) * 4 + 1];
-        byte b = subdata[0][(y * td.width + x) * 4 + 2];
-        byte a = subdata[0][(y * td.width + x) * 4 + 3];
-
-        if(sd.alpha != AlphaMapping::Discard)
-        {
-          Vec4f col = Vec4f(sd.alphaCol.x, sd.alphaCol.y, sd.alphaCol.z);
-          if(sd.alpha == AlphaMapping::BlendToCheckerboard)
-          {
-            bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
-            col = lightSquare ? RenderDoc::Inst().LightCheckerboardColor()
-                              : RenderDoc::Inst().DarkCheckerboardColor();
-          }
-
-          col.x = ConvertLinearToSRGB(col.x);
-          col.y = ConvertLinearToSRGB(col.y);
-          col.z = ConvertLinearToSRGB(col.z);
-
-          FloatVector pixel = FloatVector(float(r) / 255.0f, float(g) / 255.0f, float(b) / 255.0f,
-                                          float(a) / 255.0f);
-
-          pixel.x = pixel.x * pixel.w + col.x * (1.0f - pixel.w);
-          pixel.y = pixel.y * pixel.w + col.y * (1.0f - pixel.w);
-          pixel.z = pixel.z * pixel.w + col.z * (1.0f - pixel.w);
-
-          r = byte(pixel.x * 255.0f);
-          g = byte(pixel.y * 255.0f);
-          b = byte(pixel.z * 255.0f);
-        }
-
-        nonalpha[(y * td.width + x) * 3 + 0] = r;
-        nonalpha[(y * td.width + x) * 3 + 1] = g;
-        nonalpha[(y * td.width + x) * 3 + 2] = b;
-      }
-    }
+    TextureConvert::RemoveAlpha(subdata[0], nonalpha, td.width, td.height, sd.alpha, sd.alphaCol,
+                                RenderDoc::Inst().LightCheckerboardColor(),
+                                RenderDoc::Inst().DarkCheckerboardColor());
 
     delete[] subdata[0];
 
@@ -1135,22 +1208,8 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
   {
     byte *rg0 = new byte[td.width * td.height * 3];
 
-    for(uint32_t y = 0; y < td.height; y++)
-    {
-      for(uint32_t x = 0; x < td.width; x++)
-      {
-        byte r = subdata[0][(y * td.width + x) * 2 + 0];
-        byte g = subdata[0][(y * td.width + x) * 2 + 1];
-
-        rg0[(y * td.width + x) * 3 + 0] = r;
-        rg0[(y * td.width + x) * 3 + 1] = g;
-        rg0[(y * td.width + x) * 3 + 2] = 0;
-
-        // if we're greyscaling the image, then keep the greyscale here.
-        if(sd.channelExtract >= 0)
-          rg0[(y * td.width + x) * 3 + 2] = r;
-      }
-    }
+    // if we're greyscaling the image, then keep the greyscale in blue too.
+    TextureConvert::ExpandRG(subdata[0], rg0, td.width, td.height, sd.channelExtract >= 0);
 
     delete[] subdata[0];
 
@@ -1273,59 +1332,9 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
       if(saveFmt.compType == CompType::Depth && pixStride == 3)
         pixStride = 4;
 
-      for(uint32_t y = 0; y < td.height; y++)
-      {
-        for(uint32_t x = 0; x < td.width; x++)
-        {
-          FloatVector pixel = ConvertComponents(saveFmt, srcData);
-          srcData += pixStride;
-
-          // HDR can't represent negative values
-          if(sd.destType == FileType::HDR)
-          {
-            pixel.x = RDCMAX(pixel.x, 0.0f);
-            pixel.y = RDCMAX(pixel.y, 0.0f);
-            pixel.z = RDCMAX(pixel.z, 0.0f);
-            pixel.w = RDCMAX(pixel.w, 0.0f);
-          }
-
-          if(sd.channelExtract == 0)
-          {
-            pixel.y = pixel.z = pixel.x;
-            pixel.w = 1.0f;
-          }
-          else if(sd.channelExtract == 1)
-          {
-            pixel.x = pixel.z = pixel.y;
-            pixel.w = 1.0f;
-          }
-          else if(sd.channelExtract == 2)
-          {
-            pixel.x = pixel.y = pixel.z;
-            pixel.w = 1.0f;
-          }
-          else if(sd.channelExtract == 3)
-          {
-            pixel.x = pixel.y = pixel.z = pixel.w;
-            pixel.w = 1.0f;
-          }
-
-          if(fldata)
-          {
-            fldata[(y * td.width + x) * 4 + 0] = pixel.x;
-            fldata[(y * td.width + x) * 4 + 1] = pixel.y;
-            fldata[(y * td.width + x) * 4 + 2] = pixel.z;
-            fldata[(y * td.width + x) * 4 + 3] = pixel.w;
-          }
-          else
-          {
-            abgr[0][(y * td.width + x)] = pixel.w;
-            abgr[1][(y * td.width + x)] = pixel.z;
-            abgr[2][(y * td.width + x)] = pixel.y;
-            abgr[3][(y * td.width + x)] = pixel.x;
-          }
-        }
-      }
+      // HDR can't represent negative values
+      TextureConvert::DecodeToFloat(saveFmt, pixStride, srcData, td.width, td.height,
+                                    sd.destType == FileType::HDR, sd.channelExtract, fldata, abgr);
 
       if(sd.destType == FileType::HDR)
       {
@@ -1401,9 +1410,6 @@ bool ReplayController::SaveTexture(const TextureSave &saveData, const char *path
     FileIO::fclose(f);
   }
 
-  for(size_t i = 0; i < subdata.size(); i++)
-    delete[] subdata[i];
-
   return success;
 }
 
@@ -1619,12 +1625,63 @@ rdcarray<ShaderDebugState> ReplayController::ContinueDebug(ShaderDebugger *debug
   return ret;
 }
 
+uint32_t ReplayController::AdvanceDebug(ShaderDebugger *debugger)
+{
+  CHECK_REPLAY_THREAD();
+
+  if(!debugger)
+    return 0;
+
+  rdcarray<ShaderDebugState> states = m_pDevice->ContinueDebug(debugger);
+
+  if(states.empty())
+    return 0;
+
+  PackedShaderDebugTrace *&packed = m_DebugStates[debugger];
+  if(!packed)
+    packed = new PackedShaderDebugTrace;
+
+  packed->Append(states);
+
+  return (uint32_t)states.size();
+}
+
+uint32_t ReplayController::GetNumDebugStates(ShaderDebugger *debugger)
+{
+  CHECK_REPLAY_THREAD();
+
+  auto it = m_DebugStates.find(debugger);
+  if(it == m_DebugStates.end())
+    return 0;
+
+  return (uint32_t)it->second->GetNumStates();
+}
+
+rdcarray<ShaderDebugState> ReplayController::GetDebugStates(ShaderDebugger *debugger,
+                                                            uint32_t first, uint32_t count)
+{
+  CHECK_REPLAY_THREAD();
+
+  auto it = m_DebugStates.find(debugger);
+  if(it == m_DebugStates.end())
+    return {};
+
+  return it->second->GetStates(first, count);
+}
+
 void ReplayController::FreeTrace(ShaderDebugTrace *trace)
 {
   CHECK_REPLAY_THREAD();
 
   if(trace)
   {
+    auto it = m_DebugStates.find(trace->debugger);
+    if(it != m_DebugStates.end())
+    {
+      delete it->second;
+      m_DebugStates.erase(it);
+    }
+
     SAFE_DELETE(trace->debugger);
     delete trace;
   }
@@ -2002,16 +2059,20 @@ ReplayStatus ReplayController::PostCreateInit(IReplayDriver *device, RDCFile *rd
   if(status != ReplayStatus::Succeeded)
     return status;
 
+  if(IsStructuredDataLazy())
+    MakeStructuredFileLazy((SDFile &)m_pDevice->GetStructuredFile());
+
   m_APIProps = m_pDevice->GetAPIProperties();
 
   // fetch GCN ISA targets
   GCNISA::GetTargets(m_APIProps.pipelineType, m_GCNTargets);
 
-  m_Buffers = m_pDevice->GetBuffers();
-  m_Textures = m_pDevice->GetTextures();
-  m_Resources = m_pDevice->GetResources();
-
-  m_FrameRecord = m_pDevice->GetFrameRecord();
+  m_pDevice->ExecuteBatch({
+      [this]() { m_Buffers = m_pDevice->GetBuffers(); },
+      [this]() { m_Textures = m_pDevice->GetTextures(); },
+      [this]() { m_Resources = m_pDevice->GetResources(); },
+      [this]() { m_FrameRecord = m_pDevice->GetFrameRecord(); },
+  });
 
   if(m_FrameRecord.drawcallList.empty())
     return ReplayStatus::APIReplayFailed;
@@ -34,6 +34,7 @@
 #define CHECK_REPLAY_THREAD() RDCASSERT(Threading::GetCurrentID() == m_ThreadID);
 
 struct ReplayController;
+struct TextureSaveData;
 
 struct ReplayOutput : public IReplayOutput
 {
@@ -122,6 +123,8 @@ private:
   friend struct ReplayController;
 };
 
+class PackedShaderDebugTrace;
+
 struct ReplayController : public IReplayController
 {
 public:
@@ -189,6 +192,10 @@ public:
   ShaderDebugTrace *DebugPixel(uint32_t x, uint32_t y, uint32_t sample, uint32_t primitive);
   ShaderDebugTrace *DebugThread(const uint32_t groupid[3], const uint32_t threadid[3]);
   rdcarray<ShaderDebugState> ContinueDebug(ShaderDebugger *debugger);
+  uint32_t AdvanceDebug(ShaderDebugger *debugger);
+  uint32_t GetNumDebugStates(ShaderDebugger *debugger);
+  rdcarray<ShaderDebugState> GetDebugStates(ShaderDebugger *debugger, uint32_t first,
+                                            uint32_t count);
   void FreeTrace(ShaderDebugTrace *trace);
 
   MeshFormat GetPostVSData(uint32_t instID, uint32_t viewID, MeshDataStage stage);
@@ -199,6 +206,8 @@ public:
   bytebuf GetTextureData(ResourceId buff, const Subresource &sub);
 
   bool SaveTexture(const TextureSave &saveData, const char *path);
+  rdcarray<bool> SaveTextures(const rdcarray<TextureSave> &saveData, const rdcarray<rdcstr> &paths,
+                              RENDERDOC_ProgressCallback progress);
 
   rdcarray<ShaderVariable> GetCBufferVariableContents(ResourceId pipeline, ResourceId shader,
                                                       const char *entryPoint, uint32_t cbufslot,
@@ -222,6 +231,8 @@ private:
 
   void FetchPipelineState(uint32_t eventId);
 
+  bool FetchTextureSave(const TextureSave &saveData, TextureSaveData &data);
+
   DrawcallDescription *GetDrawcallByEID(uint32_t eventId);
   bool ContainsMarker(const rdcarray<DrawcallDescription> &draws);
   bool PassEquivalent(const DrawcallDescription &a, const DrawcallDescription &b);
@@ -257,5 +268,8 @@ private:
   std::set<ResourceId> m_TargetResources;
   std::set<ResourceId> m_CustomShaders;
 
+  // states stored by AdvanceDebug for each debugger, freed with the trace
+  std::map<ShaderDebugger *, PackedShaderDebugTrace *> m_DebugStates;
+
   friend struct ReplayOutput;
 };
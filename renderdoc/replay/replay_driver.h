@@ -207,6 +207,15 @@ class IReplayDriver : public IRemoteDriver
 public:
   virtual bool IsRemoteProxy() = 0;
 
+  // runs a set of calls against this driver, each of which makes one query. By default they run in
+  // order, but a driver proxying to a remote host can pipeline them so the set costs one network
+  // round-trip rather than one per call.
+  virtual void ExecuteBatch(const rdcarray<std::function<void()>> &calls)
+  {
+    for(const std::function<void()> &call : calls)
+      call();
+  }
+
   virtual rdcarray<WindowingSystem> GetSupportedWindowSystems() = 0;
 
   virtual AMDRGPControl *GetRGPControl() = 0;
@@ -0,0 +1,828 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "texture_convert.h"
+#include "core/core.h"
+#include "core/jobsystem.h"
+#include "maths/formatpacking.h"
+
+#if ENABLED(RDOC_SSE2)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// bands are around this many pixels, enough to amortise the cost of a job
+const uint32_t BandPixels = 64 * 1024;
+
+void ForEachRowBand(uint32_t width, uint32_t height,
+                    const std::function<void(uint32_t, uint32_t)> &callback)
+{
+  const uint32_t rowsPerBand = RDCMAX(1U, BandPixels / RDCMAX(1U, width));
+  const uint32_t numBands = (height + rowsPerBand - 1) / rowsPerBand;
+
+  if(numBands <= 1)
+  {
+    callback(0, height);
+    return;
+  }
+
+  JobSystem::ParallelFor(numBands, [&callback, rowsPerBand, height](uint32_t band) {
+    uint32_t y = band * rowsPerBand;
+    callback(y, RDCMIN(height, y + rowsPerBand));
+  });
+}
+
+template <typename T>
+void ExtractChannelRows(byte *data, uint32_t width, uint32_t compCount, uint32_t channel,
+                        uint32_t y0, uint32_t y1)
+{
+  T *pixels = (T *)data + (size_t)y0 * width * compCount;
+  const size_t count = size_t(y1 - y0) * width;
+
+  if(compCount == 4)
+  {
+    // the common case, written so that the loop vectorises
+    for(size_t i = 0; i < count; i++, pixels += 4)
+    {
+      T val = pixels[channel];
+      pixels[0] = pixels[1] = pixels[2] = val;
+      pixels[3] = T(~0U);
+    }
+    return;
+  }
+
+  for(size_t i = 0; i < count; i++, pixels += compCount)
+  {
+    T val = pixels[channel];
+    for(uint32_t c = 0; c < compCount; c++)
+      pixels[c] = val;
+  }
+}
+
+void BlendAlphaRows(const byte *src, byte *dst, uint32_t width, bool checkerboard,
+                    const FloatVector &col, const FloatVector &lightCol, const FloatVector &darkCol,
+                    uint32_t y0, uint32_t y1)
+{
+  for(uint32_t y = y0; y < y1; y++)
+  {
+    const byte *s = src + (size_t)y * width * 4;
+    byte *d = dst + (size_t)y * width * 3;
+
+    uint32_t x = 0;
+
+#if ENABLED(RDOC_SSE2)
+    const __m128 div = _mm_set1_ps(255.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lowByte = _mm_set1_epi32(0xff);
+
+    // four pixels at a time, each pixel's channels in one register. The arithmetic matches the
+    // scalar path below exactly. Groups of four never straddle a checkerboard square.
+    for(; x + 4 <= width; x += 4, s += 16, d += 12)
+    {
+      const bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
+      const FloatVector &c = checkerboard ? (lightSquare ? lightCol : darkCol) : col;
+      const __m128 blendCol = _mm_set_ps(0.0f, c.z, c.y, c.x);
+
+      __m128i px = _mm_loadu_si128((const __m128i *)s);
+      __m128i lo = _mm_unpacklo_epi8(px, zero);
+      __m128i hi = _mm_unpackhi_epi8(px, zero);
+
+      __m128i in[4] = {
+          _mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+          _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero),
+      };
+
+      for(int i = 0; i < 4; i++)
+      {
+        __m128 pixel = _mm_div_ps(_mm_cvtepi32_ps(in[i]), div);
+        __m128 a = _mm_shuffle_ps(pixel, pixel, _MM_SHUFFLE(3, 3, 3, 3));
+        pixel = _mm_add_ps(_mm_mul_ps(pixel, a), _mm_mul_ps(blendCol, _mm_sub_ps(one, a)));
+
+        // truncate then wrap to a byte, as the scalar conversion does
+        in[i] = _mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(pixel, div)), lowByte);
+      }
+
+      alignas(16) byte out[16];
+      __m128i lo16 = _mm_packs_epi32(in[0], in[1]);
+      __m128i hi16 = _mm_packs_epi32(in[2], in[3]);
+      _mm_store_si128((__m128i *)out, _mm_packus_epi16(lo16, hi16));
+
+      for(int i = 0; i < 4; i++)
+      {
+        d[i * 3 + 0] = out[i * 4 + 0];
+        d[i * 3 + 1] = out[i * 4 + 1];
+        d[i * 3 + 2] = out[i * 4 + 2];
+      }
+    }
+#endif
+
+    for(; x < width; x++, s += 4, d += 3)
+    {
+      const bool lightSquare = ((x / 64) % 2) == ((y / 64) % 2);
+      const FloatVector &c = checkerboard ? (lightSquare ? lightCol : darkCol) : col;
+
+      float r = float(s[0]) / 255.0f;
+      float g = float(s[1]) / 255.0f;
+      float b = float(s[2]) / 255.0f;
+      float a = float(s[3]) / 255.0f;
+
+      r = r * a + c.x * (1.0f - a);
+      g = g * a + c.y * (1.0f - a);
+      b = b * a + c.z * (1.0f - a);
+
+      d[0] = byte(int(r * 255.0f));
+      d[1] = byte(int(g * 255.0f));
+      d[2] = byte(int(b * 255.0f));
+    }
+  }
+}
+
+FloatVector ToSRGB(const FloatVector &col)
+{
+  return FloatVector(ConvertLinearToSRGB(col.x), ConvertLinearToSRGB(col.y),
+                     ConvertLinearToSRGB(col.z), col.w);
+}
+
+void PostProcessFloatRow(float *row, uint32_t width, bool clampNegative, int channelExtract,
+                         float *rgba, float *const abgr[4])
+{
+  uint32_t x = 0;
+
+#if ENABLED(RDOC_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  // selects xyz from the splatted channel and w from 1.0
+  const __m128 wOne = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+  const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+  for(; x + 4 <= width; x += 4)
+  {
+    __m128 p[4];
+
+    for(int i = 0; i < 4; i++)
+    {
+      p[i] = _mm_loadu_ps(row + (x + i) * 4);
+
+      if(clampNegative)
+        p[i] = _mm_max_ps(p[i], zero);
+
+      __m128 splat;
+      switch(channelExtract)
+      {
+        case 0: splat = _mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(0, 0, 0, 0)); break;
+        case 1: splat = _mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(1, 1, 1, 1)); break;
+        case 2: splat = _mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(2, 2, 2, 2)); break;
+        case 3: splat = _mm_shuffle_ps(p[i], p[i], _MM_SHUFFLE(3, 3, 3, 3)); break;
+        default: splat = p[i]; break;
+      }
+
+      if(channelExtract >= 0 && channelExtract <= 3)
+        p[i] = _mm_or_ps(_mm_and_ps(splat, xyzMask), wOne);
+    }
+
+    if(rgba)
+    {
+      for(int i = 0; i < 4; i++)
+        _mm_storeu_ps(rgba + (x + i) * 4, p[i]);
+    }
+    else
+    {
+      // transpose so each register holds one channel for the four pixels
+      _MM_TRANSPOSE4_PS(p[0], p[1], p[2], p[3]);
+      _mm_storeu_ps(abgr[0] + x, p[3]);
+      _mm_storeu_ps(abgr[1] + x, p[2]);
+      _mm_storeu_ps(abgr[2] + x, p[1]);
+      _mm_storeu_ps(abgr[3] + x, p[0]);
+    }
+  }
+#endif
+
+  for(; x < width; x++)
+  {
+    float *pixel = row + x * 4;
+
+    if(clampNegative)
+    {
+      for(int c = 0; c < 4; c++)
+        pixel[c] = RDCMAX(pixel[c], 0.0f);
+    }
+
+    if(channelExtract >= 0 && channelExtract <= 3)
+    {
+      pixel[0] = pixel[1] = pixel[2] = pixel[channelExtract];
+      pixel[3] = 1.0f;
+    }
+
+    if(rgba)
+    {
+      memcpy(rgba + x * 4, pixel, sizeof(float) * 4);
+    }
+    else
+    {
+      abgr[0][x] = pixel[3];
+      abgr[1][x] = pixel[2];
+      abgr[2][x] = pixel[1];
+      abgr[3][x] = pixel[0];
+    }
+  }
+}
+};
+
+namespace TextureConvert
+{
+void ExtractChannel(byte *data, uint32_t width, uint32_t height, uint32_t compCount,
+                    uint32_t compByteWidth, uint32_t channel)
+{
+  if(channel >= compCount || (compByteWidth != 1 && compByteWidth != 4))
+    return;
+
+  ForEachRowBand(width, height, [=](uint32_t y0, uint32_t y1) {
+    if(compByteWidth == 1)
+      ExtractChannelRows<byte>(data, width, compCount, channel, y0, y1);
+    else
+      ExtractChannelRows<uint32_t>(data, width, compCount, channel, y0, y1);
+  });
+}
+
+void RemoveAlpha(const byte *src, byte *dst, uint32_t width, uint32_t height, AlphaMapping alpha,
+                 const FloatVector &alphaCol, const FloatVector &lightCol,
+                 const FloatVector &darkCol)
+{
+  if(alpha == AlphaMapping::Discard)
+  {
+    ForEachRowBand(width, height, [=](uint32_t y0, uint32_t y1) {
+      const byte *s = src + (size_t)y0 * width * 4;
+      byte *d = dst + (size_t)y0 * width * 3;
+      const size_t count = size_t(y1 - y0) * width;
+
+      for(size_t i = 0; i < count; i++, s += 4, d += 3)
+      {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+      }
+    });
+    return;
+  }
+
+  // the blend colours are the same for every pixel, so convert them once up front
+  const bool checkerboard = (alpha == AlphaMapping::BlendToCheckerboard);
+  const FloatVector col = ToSRGB(alphaCol);
+  const FloatVector light = ToSRGB(lightCol);
+  const FloatVector dark = ToSRGB(darkCol);
+
+  ForEachRowBand(width, height, [&](uint32_t y0, uint32_t y1) {
+    BlendAlphaRows(src, dst, width, checkerboard, col, light, dark, y0, y1);
+  });
+}
+
+void ExpandRG(const byte *src, byte *dst, uint32_t width, uint32_t height, bool greyscale)
+{
+  ForEachRowBand(width, height, [=](uint32_t y0, uint32_t y1) {
+    const byte *s = src + (size_t)y0 * width * 2;
+    byte *d = dst + (size_t)y0 * width * 3;
+    const size_t count = size_t(y1 - y0) * width;
+
+    for(size_t i = 0; i < count; i++, s += 2, d += 3)
+    {
+      d[0] = s[0];
+      d[1] = s[1];
+      d[2] = greyscale ? s[0] : 0;
+    }
+  });
+}
+
+void CopyTile(const byte *src, uint32_t width, uint32_t height, byte *dst, uint32_t dstWidth,
+              uint32_t x, uint32_t y, uint32_t pixelStride)
+{
+  const size_t rowSize = size_t(width) * pixelStride;
+
+  ForEachRowBand(width, height, [=](uint32_t y0, uint32_t y1) {
+    for(uint32_t row = y0; row < y1; row++)
+      memcpy(dst + (size_t(y + row) * dstWidth + x) * pixelStride, src + row * rowSize, rowSize);
+  });
+}
+
+void DecodeToFloat(const ResourceFormat &fmt, uint32_t pixelStride, const byte *src, uint32_t width,
+                   uint32_t height, bool clampNegative, int channelExtract, float *rgba,
+                   float *const abgr[4])
+{
+  // already 32-bit float RGBA, so decoding is just a copy
+  const bool rawFloats = fmt.type == ResourceFormatType::Regular &&
+                         fmt.compType == CompType::Float && fmt.compByteWidth == 4 &&
+                         fmt.compCount == 4 && pixelStride == 16;
+
+  ForEachRowBand(width, height, [&](uint32_t y0, uint32_t y1) {
+    rdcarray<float> row;
+    row.resize(width * 4);
+
+    for(uint32_t y = y0; y < y1; y++)
+    {
+      const byte *s = src + (size_t)y * width * pixelStride;
+
+      if(rawFloats)
+      {
+        memcpy(row.data(), s, width * sizeof(float) * 4);
+      }
+      else
+      {
+        ConvertComponents(fmt, s, pixelStride, width, (FloatVector *)row.data());
+      }
+
+      float *planes[4] = {};
+      if(!rgba)
+      {
+        for(int c = 0; c < 4; c++)
+          planes[c] = abgr[c] + (size_t)y * width;
+      }
+
+      PostProcessFloatRow(row.data(), width, clampNegative, channelExtract,
+                          rgba ? rgba + (size_t)y * width * 4 : NULL, planes);
+    }
+  });
+}
+};
+
+#if ENABLED(ENABLE_UNIT_TESTS)
+
+#include "catch/catch.hpp"
+#include "jpeg-compressor/jpge.h"
+#include "stb/stb_image_write.h"
+#include "tinyexr/tinyexr.h"
+
+// straightforward per-pixel versions of the conversions, as SaveTexture used to do them
+static void RefRemoveAlpha(const byte *src, byte *dst, uint32_t width, uint32_t height,
+                           AlphaMapping alpha, FloatVector alphaCol, FloatVector light,
+                           FloatVector dark)
+{
+  for(uint32_t y = 0; y < height; y++)
+  {
+    for(uint32_t x = 0; x < width; x++)
+    {
+      byte r = src[(y * width + x) * 4 + 0];
+      byte g = src[(y * width + x) * 4 + 1];
+      byte b = src[(y * width + x) * 4 + 2];
+      byte a = src[(y * width + x) * 4 + 3];
+
+      if(alpha != AlphaMapping::Discard)
+      {
+        FloatVector col = alphaCol;
+        if(alpha == AlphaMapping::BlendToCheckerboard)
+          col = (((x / 64) % 2) == ((y / 64) % 2)) ? light : dark;
+
+        col.x = ConvertLinearToSRGB(col.x);
+        col.y = ConvertLinearToSRGB(col.y);
+        col.z = ConvertLinearToSRGB(col.z);
+
+        FloatVector pixel = FloatVector(float(r) / 255.0f, float(g) / 255.0f, float(b) / 255.0f,
+                                        float(a) / 255.0f);
+
+        pixel.x = pixel.x * pixel.w + col.x * (1.0f - pixel.w);
+        pixel.y = pixel.y * pixel.w + col.y * (1.0f - pixel.w);
+        pixel.z = pixel.z * pixel.w + col.z * (1.0f - pixel.w);
+
+        r = byte(pixel.x * 255.0f);
+        g = byte(pixel.y * 255.0f);
+        b = byte(pixel.z * 255.0f);
+      }
+
+      dst[(y * width + x) * 3 + 0] = r;
+      dst[(y * width + x) * 3 + 1] = g;
+      dst[(y * width + x) * 3 + 2] = b;
+    }
+  }
+}
+
+static void RefDecodeToFloat(const ResourceFormat &fmt, uint32_t pixelStride, const byte *src,
+                             uint32_t width, uint32_t height, bool clampNegative,
+                             int channelExtract, float *rgba, float *const abgr[4])
+{
+  for(uint32_t i = 0; i < width * height; i++)
+  {
+    FloatVector pixel = ConvertComponents(fmt, src);
+    src += pixelStride;
+
+    if(clampNegative)
+    {
+      pixel.x = RDCMAX(pixel.x, 0.0f);
+      pixel.y = RDCMAX(pixel.y, 0.0f);
+      pixel.z = RDCMAX(pixel.z, 0.0f);
+      pixel.w = RDCMAX(pixel.w, 0.0f);
+    }
+
+    if(channelExtract == 0)
+      pixel.y = pixel.z = pixel.x;
+    else if(channelExtract == 1)
+      pixel.x = pixel.z = pixel.y;
+    else if(channelExtract == 2)
+      pixel.x = pixel.y = pixel.z;
+    else if(channelExtract == 3)
+      pixel.x = pixel.y = pixel.z = pixel.w;
+
+    if(channelExtract >= 0)
+      pixel.w = 1.0f;
+
+    if(rgba)
+    {
+      memcpy(rgba + i * 4, &pixel, sizeof(pixel));
+    }
+    else
+    {
+      abgr[0][i] = pixel.w;
+      abgr[1][i] = pixel.z;
+      abgr[2][i] = pixel.y;
+      abgr[3][i] = pixel.x;
+    }
+  }
+}
+
+static bytebuf RandomPixels(size_t size, uint32_t seed)
+{
+  bytebuf ret;
+  ret.resize(size);
+  for(size_t i = 0; i < size; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    ret[i] = byte(seed >> 16);
+  }
+  return ret;
+}
+
+static ResourceFormat HalfRGBA()
+{
+  ResourceFormat fmt;
+  fmt.type = ResourceFormatType::Regular;
+  fmt.compType = CompType::Float;
+  fmt.compByteWidth = 2;
+  fmt.compCount = 4;
+  return fmt;
+}
+
+static ResourceFormat FloatRGBA()
+{
+  ResourceFormat fmt = HalfRGBA();
+  fmt.compByteWidth = 4;
+  return fmt;
+}
+
+static ResourceFormat R11G11B10()
+{
+  ResourceFormat fmt;
+  fmt.type = ResourceFormatType::R11G11B10;
+  fmt.compType = CompType::Float;
+  fmt.compByteWidth = 1;
+  fmt.compCount = 3;
+  return fmt;
+}
+
+// fills a buffer with finite floats of either sign, so that comparisons aren't confused by NaNs
+static bytebuf RandomFloats(size_t count, uint32_t seed)
+{
+  bytebuf ret;
+  ret.resize(count * sizeof(float));
+  float *f = (float *)ret.data();
+  for(size_t i = 0; i < count; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    f[i] = (float(seed >> 8) / float(1 << 24)) * 8.0f - 4.0f;
+  }
+  return ret;
+}
+
+static bytebuf RandomHalfs(size_t count, uint32_t seed)
+{
+  bytebuf floats = RandomFloats(count, seed);
+  bytebuf ret;
+  ret.resize(count * sizeof(uint16_t));
+  for(size_t i = 0; i < count; i++)
+    ((uint16_t *)ret.data())[i] = ConvertToHalf(((float *)floats.data())[i]);
+  return ret;
+}
+
+static bytebuf RandomR11G11B10(size_t count, uint32_t seed)
+{
+  bytebuf floats = RandomFloats(count * 3, seed);
+  bytebuf ret;
+  ret.resize(count * sizeof(uint32_t));
+  const float *f = (const float *)floats.data();
+  for(size_t i = 0; i < count; i++)
+    ((uint32_t *)ret.data())[i] =
+        ConvertToR11G11B10(Vec3f(fabsf(f[i * 3 + 0]), fabsf(f[i * 3 + 1]), fabsf(f[i * 3 + 2])));
+  return ret;
+}
+
+TEST_CASE("Test texture save conversions", "[texconvert]")
+{
+  // wide enough to leave a tail after the vector loops, and tall enough to be split into bands
+  const uint32_t width = 301, height = 700;
+  const size_t count = width * height;
+
+  const FloatVector alphaCol(0.2f, 0.5f, 0.9f, 1.0f);
+  const FloatVector light(0.8f, 0.8f, 0.8f, 1.0f);
+  const FloatVector dark(0.1f, 0.1f, 0.1f, 1.0f);
+
+  SECTION("Removing alpha")
+  {
+    bytebuf src = RandomPixels(count * 4, 5);
+
+    bytebuf expected, actual;
+    expected.resize(count * 3);
+    actual.resize(count * 3);
+
+    for(AlphaMapping alpha : {AlphaMapping::Discard, AlphaMapping::BlendToColor,
+                              AlphaMapping::BlendToCheckerboard, AlphaMapping::Preserve})
+    {
+      RefRemoveAlpha(src.data(), expected.data(), width, height, alpha, alphaCol, light, dark);
+      TextureConvert::RemoveAlpha(src.data(), actual.data(), width, height, alpha, alphaCol, light,
+                                  dark);
+
+      CHECK(actual == expected);
+    }
+  };
+
+  SECTION("Extracting channels")
+  {
+    for(uint32_t compCount = 1; compCount <= 4; compCount++)
+    {
+      for(uint32_t channel = 0; channel < compCount; channel++)
+      {
+        bytebuf data = RandomPixels(count * compCount, channel + 7);
+        TextureConvert::ExtractChannel(data.data(), width, height, compCount, 1, channel);
+
+        bytebuf orig = RandomPixels(count * compCount, channel + 7);
+
+        bool match = true;
+        for(size_t i = 0; i < count && match; i++)
+        {
+          for(uint32_t c = 0; c < compCount; c++)
+          {
+            byte expected = (compCount == 4 && c == 3) ? 0xff : orig[i * compCount + channel];
+            match &= (data[i * compCount + c] == expected);
+          }
+        }
+
+        CHECK(match);
+      }
+    }
+
+    bytebuf data = RandomPixels(count * 16, 3);
+    bytebuf orig = data;
+    TextureConvert::ExtractChannel(data.data(), width, height, 4, 4, 1);
+
+    const uint32_t *src = (const uint32_t *)orig.data();
+    const uint32_t *dst = (const uint32_t *)data.data();
+
+    bool match = true;
+    for(size_t i = 0; i < count && match; i++)
+      match = dst[i * 4 + 0] == src[i * 4 + 1] && dst[i * 4 + 1] == src[i * 4 + 1] &&
+              dst[i * 4 + 2] == src[i * 4 + 1] && dst[i * 4 + 3] == ~0U;
+
+    CHECK(match);
+  };
+
+  SECTION("Expanding RG")
+  {
+    bytebuf src = RandomPixels(count * 2, 11);
+    bytebuf dst;
+    dst.resize(count * 3);
+
+    TextureConvert::ExpandRG(src.data(), dst.data(), width, height, false);
+
+    bool match = true;
+    for(size_t i = 0; i < count && match; i++)
+      match = dst[i * 3 + 0] == src[i * 2 + 0] && dst[i * 3 + 1] == src[i * 2 + 1] &&
+              dst[i * 3 + 2] == 0;
+    CHECK(match);
+
+    TextureConvert::ExpandRG(src.data(), dst.data(), width, height, true);
+
+    match = true;
+    for(size_t i = 0; i < count && match; i++)
+      match = dst[i * 3 + 2] == src[i * 2 + 0];
+    CHECK(match);
+  };
+
+  SECTION("Copying tiles")
+  {
+    bytebuf tile = RandomPixels(count * 4, 13);
+    bytebuf dst;
+    dst.resize(count * 4 * 4);
+
+    TextureConvert::CopyTile(tile.data(), width, height, dst.data(), width * 2, width, height, 4);
+
+    bool match = true;
+    for(uint32_t y = 0; y < height && match; y++)
+      match = memcmp(dst.data() + ((y + height) * width * 2 + width) * 4,
+                     tile.data() + y * width * 4, width * 4) == 0;
+    CHECK(match);
+  };
+
+  SECTION("Decoding to float")
+  {
+    struct Source
+    {
+      ResourceFormat fmt;
+      uint32_t stride;
+      bytebuf data;
+    };
+
+    Source sources[] = {
+        {FloatRGBA(), 16, RandomFloats(count * 4, 17)},
+        {HalfRGBA(), 8, RandomHalfs(count * 4, 19)},
+        {R11G11B10(), 4, RandomR11G11B10(count, 23)},
+    };
+
+    rdcarray<float> expected, actual;
+    expected.resize(count * 4);
+    actual.resize(count * 4);
+
+    for(const Source &src : sources)
+    {
+      for(int channelExtract = -1; channelExtract < 4; channelExtract++)
+      {
+        for(bool clamp : {false, true})
+        {
+          // interleaved
+          RefDecodeToFloat(src.fmt, src.stride, src.data.data(), width, height, clamp,
+                           channelExtract, expected.data(), NULL);
+          TextureConvert::DecodeToFloat(src.fmt, src.stride, src.data.data(), width, height,
+                                        clamp, channelExtract, actual.data(), NULL);
+
+          CHECK(memcmp(actual.data(), expected.data(), count * 4 * sizeof(float)) == 0);
+
+          // planar
+          float *expectedPlanes[4] = {expected.data(), expected.data() + count,
+                                      expected.data() + count * 2, expected.data() + count * 3};
+          float *actualPlanes[4] = {actual.data(), actual.data() + count,
+                                    actual.data() + count * 2, actual.data() + count * 3};
+
+          RefDecodeToFloat(src.fmt, src.stride, src.data.data(), width, height, clamp,
+                           channelExtract, NULL, expectedPlanes);
+          TextureConvert::DecodeToFloat(src.fmt, src.stride, src.data.data(), width, height,
+                                        clamp, channelExtract, NULL, actualPlanes);
+
+          CHECK(memcmp(actual.data(), expected.data(), count * 4 * sizeof(float)) == 0);
+        }
+      }
+    }
+  };
+};
+
+static void NullWriteFunc(void *context, void *data, int size)
+{
+  *(size_t *)context += size;
+}
+
+TEST_CASE("Benchmark texture saving", "[.][benchmark]")
+{
+  const uint32_t width = 3840, height = 2160;
+  const size_t count = width * height;
+
+  const FloatVector light(0.8f, 0.8f, 0.8f, 1.0f);
+  const FloatVector dark(0.1f, 0.1f, 0.1f, 1.0f);
+
+  bytebuf halfData = RandomHalfs(count * 4, 1);
+  bytebuf r11g11b10Data = RandomR11G11B10(count, 2);
+  // LDR formats are remapped to RGBA8 on the GPU before any of the CPU conversion happens
+  bytebuf rgba8 = RandomPixels(count * 4, 3);
+
+  rdcarray<float> rgba;
+  rgba.resize(count * 4);
+  float *abgr[4] = {rgba.data(), rgba.data() + count, rgba.data() + count * 2,
+                    rgba.data() + count * 3};
+
+  bytebuf rgb8;
+  rgb8.resize(count * 3);
+
+  size_t written = 0;
+
+  auto writeHDR = [&]() {
+    stbi_write_hdr_to_func(NullWriteFunc, &written, width, height, 4, rgba.data());
+  };
+
+  auto writeEXR = [&]() {
+    EXRHeader exrHeader;
+    InitEXRHeader(&exrHeader);
+    EXRImage exrImage;
+    InitEXRImage(&exrImage);
+
+    int pixTypes[4] = {TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT, TINYEXR_PIXELTYPE_FLOAT,
+                       TINYEXR_PIXELTYPE_FLOAT};
+    int reqTypes[4] = {TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF,
+                       TINYEXR_PIXELTYPE_HALF};
+    EXRChannelInfo bgraChannels[4] = {
+        {"A"}, {"B"}, {"G"}, {"R"},
+    };
+
+    exrHeader.num_channels = 4;
+    exrHeader.channels = bgraChannels;
+    exrImage.images = (unsigned char **)abgr;
+    exrImage.width = width;
+    exrImage.height = height;
+    exrHeader.pixel_types = pixTypes;
+    exrHeader.requested_pixel_types = reqTypes;
+
+    unsigned char *mem = NULL;
+    const char *err = NULL;
+    written += SaveEXRImageToMemory(&exrImage, &exrHeader, &mem, &err);
+    free(mem);
+  };
+
+  WARN("Converting " << width << "x" << height << " images with " << JobSystem::GetNumWorkers()
+                     << " workers. Set Threading.JobWorkerCount to measure scaling.");
+
+  BENCHMARK("RGBA16F decode for HDR (per-pixel)")
+  {
+    RefDecodeToFloat(HalfRGBA(), 8, halfData.data(), width, height, true, -1, rgba.data(), NULL);
+  }
+  BENCHMARK("RGBA16F decode for HDR")
+  {
+    TextureConvert::DecodeToFloat(HalfRGBA(), 8, halfData.data(), width, height, true, -1,
+                                  rgba.data(), NULL);
+  }
+  BENCHMARK("RGBA16F decode for EXR (per-pixel)")
+  {
+    RefDecodeToFloat(HalfRGBA(), 8, halfData.data(), width, height, false, -1, NULL, abgr);
+  }
+  BENCHMARK("RGBA16F decode for EXR")
+  {
+    TextureConvert::DecodeToFloat(HalfRGBA(), 8, halfData.data(), width, height, false, -1, NULL,
+                                  abgr);
+  }
+  BENCHMARK("R11G11B10 decode for HDR (per-pixel)")
+  {
+    RefDecodeToFloat(R11G11B10(), 4, r11g11b10Data.data(), width, height, true, -1, rgba.data(),
+                     NULL);
+  }
+  BENCHMARK("R11G11B10 decode for HDR")
+  {
+    TextureConvert::DecodeToFloat(R11G11B10(), 4, r11g11b10Data.data(), width, height, true, -1,
+                                  rgba.data(), NULL);
+  }
+  BENCHMARK("R11G11B10 decode for EXR")
+  {
+    TextureConvert::DecodeToFloat(R11G11B10(), 4, r11g11b10Data.data(), width, height, false, -1,
+                                  NULL, abgr);
+  }
+  BENCHMARK("Checkerboard alpha blend for BMP/JPG (per-pixel)")
+  {
+    RefRemoveAlpha(rgba8.data(), rgb8.data(), width, height, AlphaMapping::BlendToCheckerboard,
+                   light, light, dark);
+  }
+  BENCHMARK("Checkerboard alpha blend for BMP/JPG")
+  {
+    TextureConvert::RemoveAlpha(rgba8.data(), rgb8.data(), width, height,
+                                AlphaMapping::BlendToCheckerboard, light, light, dark);
+  }
+
+  // the encoders themselves, for comparison with the conversion cost
+  BENCHMARK("HDR encode") { writeHDR(); }
+  BENCHMARK("EXR encode") { writeEXR(); }
+  BENCHMARK("PNG encode")
+  {
+    stbi_write_png_to_func(NullWriteFunc, &written, width, height, 4, rgba8.data(), width * 4);
+  }
+  BENCHMARK("TGA encode")
+  {
+    stbi_write_tga_to_func(NullWriteFunc, &written, width, height, 4, rgba8.data());
+  }
+  BENCHMARK("BMP encode")
+  {
+    stbi_write_bmp_to_func(NullWriteFunc, &written, width, height, 3, rgb8.data());
+  }
+  BENCHMARK("JPG encode")
+  {
+    int len = width * height * 3;
+    char *jpgdst = new char[len];
+    jpge::compress_image_to_jpeg_file_in_memory(jpgdst, len, width, height, 3, rgb8.data(),
+                                                jpge::params());
+    written += len;
+    delete[] jpgdst;
+  }
+
+  CHECK(written > 0);
+};
+
+#endif    // ENABLED(ENABLE_UNIT_TESTS)
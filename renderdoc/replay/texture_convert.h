@@ -0,0 +1,58 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#pragma once
+
+#include "api/replay/renderdoc_replay.h"
+
+// The CPU-side pixel conversions used by ReplayController::SaveTexture. Each works on whole rows so
+// that the inner loops vectorise, and large images are split into bands of rows which are processed
+// in parallel on the job system.
+namespace TextureConvert
+{
+// splats one channel across all the others and sets alpha to full, in place. Only 1 and 4 byte
+// components are supported.
+void ExtractChannel(byte *data, uint32_t width, uint32_t height, uint32_t compCount,
+                    uint32_t compByteWidth, uint32_t channel);
+
+// converts RGBA8 to RGB8, either discarding alpha or blending against a solid colour or the
+// checkerboard. The colours are linear and are converted to sRGB before blending.
+void RemoveAlpha(const byte *src, byte *dst, uint32_t width, uint32_t height, AlphaMapping alpha,
+                 const FloatVector &alphaCol, const FloatVector &lightCol,
+                 const FloatVector &darkCol);
+
+// converts RG8 to RGB8. Blue is zero, or a copy of red if the image is greyscale.
+void ExpandRG(const byte *src, byte *dst, uint32_t width, uint32_t height, bool greyscale);
+
+// copies a width x height tile of pixels into a larger image at (x, y)
+void CopyTile(const byte *src, uint32_t width, uint32_t height, byte *dst, uint32_t dstWidth,
+              uint32_t x, uint32_t y, uint32_t pixelStride);
+
+// decodes pixels of the given format to floats, clamping negative values if requested and splatting
+// one channel if channelExtract is 0-3. The result is written either interleaved as RGBA into
+// rgba, or split into the planes abgr[0] = A to abgr[3] = R.
+void DecodeToFloat(const ResourceFormat &fmt, uint32_t pixelStride, const byte *src, uint32_t width,
+                   uint32_t height, bool clampNegative, int channelExtract, float *rgba,
+                   float *const abgr[4]);
+};
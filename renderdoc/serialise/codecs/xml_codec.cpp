@@ -427,6 +427,8 @@ static ReplayStatus Structured2XML(const char *filename, const RDCFile &file, ui
       }
     }
 
+    chunk->PopulateChildren();
+
     if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
     {
       xChunk.append_attribute("opaque") = true;
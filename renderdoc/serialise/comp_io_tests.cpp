@@ -22,6 +22,7 @@
  * THE SOFTWARE.
  ******************************************************************************/
 
+#include "core/jobsystem.h"
 #include "lz4io.h"
 #include "serialiser.h"
 #include "zstdio.h"
@@ -190,4 +191,384 @@ TEST_CASE("Test ZSTD compression/decompression", "[streamio][zstd]")
   delete[] randomData;
 };
 
+// fills a buffer with data that compresses somewhat, like a real capture would: runs of repeated
+// and regular data interspersed with noise.
+static void FillCompressibleData(byte *data, size_t size)
+{
+  for(size_t i = 0; i < size; i++)
+  {
+    size_t block = (i / 4096) % 4;
+    if(block == 0)
+      data[i] = 0x7c;
+    else if(block == 1)
+      data[i] = byte(i & 0xff);
+    else if(block == 2)
+      data[i] = rand() & 0xff;
+    else
+      data[i] = byte((i / 64) & 0x3);
+  }
+}
+
+template <typename CompressorType, typename DecompressorType>
+static void CheckParallelRoundTrip()
+{
+  // not a multiple of any block size, and written in odd-sized pieces
+  const size_t size = 7 * 1024 * 1024 + 123;
+
+  byte *data = new byte[size];
+  FillCompressibleData(data, size);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    StreamWriter writer(new CompressorType(&buf, Ownership::Nothing), Ownership::Stream);
+
+    size_t offs = 0;
+    size_t chunk = 1;
+    while(offs < size)
+    {
+      size_t len = RDCMIN(chunk, size - offs);
+      writer.Write(data + offs, len);
+      offs += len;
+      chunk = (chunk * 7 + 13) % (300 * 1024);
+    }
+
+    CHECK(writer.GetOffset() == size);
+
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  CHECK(buf.GetOffset() < size);
+
+  // the serial decompressor must be able to read it back unchanged
+  {
+    StreamReader reader(
+        new DecompressorType(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream),
+        size, Ownership::Stream);
+
+    byte *readData = new byte[size];
+
+    reader.Read(readData, size);
+    CHECK_FALSE(memcmp(readData, data, size));
+
+    CHECK_FALSE(reader.IsErrored());
+    CHECK(reader.AtEnd());
+
+    delete[] readData;
+  }
+
+  delete[] data;
+}
+
+TEST_CASE("Test parallel block compression", "[streamio][lz4][zstd]")
+{
+  SECTION("LZ4")
+  {
+    CheckParallelRoundTrip<LZ4ParallelCompressor, LZ4Decompressor>();
+  };
+
+  SECTION("ZSTD")
+  {
+    CheckParallelRoundTrip<ZSTDParallelCompressor, ZSTDDecompressor>();
+  };
+
+  SECTION("Empty stream")
+  {
+    StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+    {
+      StreamWriter writer(new LZ4ParallelCompressor(&buf, Ownership::Nothing), Ownership::Stream);
+      writer.Finish();
+      CHECK_FALSE(writer.IsErrored());
+    }
+
+    CHECK(buf.GetOffset() == 0);
+  };
+};
+
+// reads back the index that a BlockCompressor appends to the end of its stream
+static BlockIndex ReadTestBlockIndex(const byte *data, uint64_t size)
+{
+  BlockIndex index;
+  BlockIndex::Footer footer;
+
+  REQUIRE(size >= sizeof(footer));
+  memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+
+  CHECK(footer.magic == BlockIndex::Magic);
+  CHECK(footer.version == BlockIndex::Version);
+
+  index.uncompressedSize = footer.uncompressedSize;
+  index.blockSize = footer.blockSize;
+  index.blockOffsets.resize((size_t)footer.numBlocks);
+
+  memcpy(index.blockOffsets.data(), data + size - index.GetSerialisedSize(),
+         index.blockOffsets.byteSize());
+
+  return index;
+}
+
+template <typename CompressorType, typename DecompressorType>
+static void CheckIndexedRoundTrip()
+{
+  const size_t size = 5 * 1024 * 1024 + 77;
+
+  byte *data = new byte[size];
+  FillCompressibleData(data, size);
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    StreamWriter writer(new CompressorType(&buf, Ownership::Nothing, true), Ownership::Stream);
+    writer.Write(data, size);
+    writer.Finish();
+
+    CHECK_FALSE(writer.IsErrored());
+  }
+
+  BlockIndex index = ReadTestBlockIndex(buf.GetData(), buf.GetOffset());
+
+  CHECK(index.uncompressedSize == size);
+  CHECK(index.blockOffsets.size() == (size + index.blockSize - 1) / index.blockSize);
+  CHECK(index.blockOffsets[0] == 0);
+
+  const uint64_t blockDataSize = buf.GetOffset() - index.GetSerialisedSize();
+
+  auto makeReader = [&]() {
+    return new StreamReader(new DecompressorType(new StreamReader(buf.GetData(), blockDataSize),
+                                                 Ownership::Stream, index),
+                            size, Ownership::Stream);
+  };
+
+  byte *readData = new byte[size];
+
+  SECTION("Large read")
+  {
+    StreamReader *reader = makeReader();
+
+    reader->Read(readData, size);
+    CHECK_FALSE(memcmp(readData, data, size));
+
+    CHECK_FALSE(reader->IsErrored());
+    CHECK(reader->AtEnd());
+
+    delete reader;
+  };
+
+  SECTION("Small reads")
+  {
+    StreamReader *reader = makeReader();
+
+    size_t offs = 0;
+    size_t chunk = 1;
+    while(offs < size)
+    {
+      size_t len = RDCMIN(chunk, size - offs);
+      reader->Read(readData + offs, len);
+      offs += len;
+      chunk = (chunk * 7 + 13) % (200 * 1024);
+    }
+
+    CHECK_FALSE(memcmp(readData, data, size));
+    CHECK_FALSE(reader->IsErrored());
+
+    delete reader;
+  };
+
+  SECTION("Seeking")
+  {
+    StreamReader *reader = makeReader();
+
+    // forwards, backwards, within the read-ahead window, across blocks and to the very end
+    const uint64_t offsets[] = {
+        3 * index.blockSize + 17, 10, 3 * index.blockSize + 20000, size - 5000, 1000, size - 1,
+        index.blockSize,
+    };
+
+    for(uint64_t offs : offsets)
+    {
+      reader->SetOffset(offs);
+      CHECK(reader->GetOffset() == offs);
+
+      uint64_t len = RDCMIN<uint64_t>(100000, size - offs);
+      reader->Read(readData, len);
+      CHECK_FALSE(memcmp(readData, data + offs, (size_t)len));
+    }
+
+    reader->SetOffset(size);
+    CHECK(reader->AtEnd());
+
+    CHECK_FALSE(reader->IsErrored());
+
+    delete reader;
+  };
+
+  delete[] readData;
+  delete[] data;
+}
+
+TEST_CASE("Test block indexed decompression", "[streamio][lz4][zstd]")
+{
+  SECTION("LZ4")
+  {
+    CheckIndexedRoundTrip<LZ4ParallelCompressor, LZ4BlockDecompressor>();
+  };
+
+  SECTION("ZSTD")
+  {
+    CheckIndexedRoundTrip<ZSTDParallelCompressor, ZSTDBlockDecompressor>();
+  };
+
+  SECTION("Recompress")
+  {
+    const size_t size = 1024 * 1024 + 5;
+
+    byte *data = new byte[size];
+    FillCompressibleData(data, size);
+
+    StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+    {
+      StreamWriter writer(new LZ4ParallelCompressor(&buf, Ownership::Nothing, true),
+                          Ownership::Stream);
+      writer.Write(data, size);
+      writer.Finish();
+    }
+
+    BlockIndex index = ReadTestBlockIndex(buf.GetData(), buf.GetOffset());
+
+    StreamWriter zstdbuf(StreamWriter::DefaultScratchSize);
+
+    {
+      LZ4BlockDecompressor decomp(
+          new StreamReader(buf.GetData(), buf.GetOffset() - index.GetSerialisedSize()),
+          Ownership::Stream, index);
+
+      ZSTDCompressor comp(&zstdbuf, Ownership::Nothing);
+
+      CHECK(decomp.Recompress(&comp));
+    }
+
+    StreamReader reader(
+        new ZSTDDecompressor(new StreamReader(zstdbuf.GetData(), zstdbuf.GetOffset()),
+                             Ownership::Stream),
+        size, Ownership::Stream);
+
+    byte *readData = new byte[size];
+    reader.Read(readData, size);
+    CHECK_FALSE(memcmp(readData, data, size));
+    CHECK_FALSE(reader.IsErrored());
+
+    delete[] readData;
+    delete[] data;
+  };
+
+  SECTION("Empty stream")
+  {
+    StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+    {
+      StreamWriter writer(new ZSTDParallelCompressor(&buf, Ownership::Nothing, true),
+                          Ownership::Stream);
+      writer.Finish();
+      CHECK_FALSE(writer.IsErrored());
+    }
+
+    BlockIndex index = ReadTestBlockIndex(buf.GetData(), buf.GetOffset());
+
+    CHECK(buf.GetOffset() == sizeof(BlockIndex::Footer));
+    CHECK(index.uncompressedSize == 0);
+    CHECK(index.blockOffsets.empty());
+  };
+};
+
+TEST_CASE("Benchmark parallel block compression", "[.][benchmark]")
+{
+  const size_t size = 256 * 1024 * 1024;
+
+  byte *data = new byte[size];
+  FillCompressibleData(data, size);
+
+  StreamWriter buf(size + 1024 * 1024);
+
+  auto compress = [&buf, data, size](Compressor *comp) {
+    buf.Rewind();
+    StreamWriter writer(comp, Ownership::Stream);
+    writer.Write(data, size);
+    writer.Finish();
+  };
+
+  WARN("Compressing " << size / (1024 * 1024) << "MB with " << JobSystem::GetNumWorkers()
+                      << " workers. Set Threading.JobWorkerCount to measure scaling.");
+
+  BENCHMARK("LZ4 serial") { compress(new LZ4Compressor(&buf, Ownership::Nothing)); }
+  BENCHMARK("LZ4 parallel") { compress(new LZ4ParallelCompressor(&buf, Ownership::Nothing)); }
+  BENCHMARK("ZSTD serial") { compress(new ZSTDCompressor(&buf, Ownership::Nothing)); }
+  BENCHMARK("ZSTD parallel") { compress(new ZSTDParallelCompressor(&buf, Ownership::Nothing)); }
+
+  delete[] data;
+};
+
+TEST_CASE("Benchmark parallel block decompression", "[.][benchmark]")
+{
+  const size_t size = 256 * 1024 * 1024;
+
+  byte *data = new byte[size];
+  FillCompressibleData(data, size);
+
+  StreamWriter lz4buf(size + 1024 * 1024);
+  StreamWriter zstdbuf(size + 1024 * 1024);
+
+  {
+    StreamWriter writer(new LZ4ParallelCompressor(&lz4buf, Ownership::Nothing, true),
+                        Ownership::Stream);
+    writer.Write(data, size);
+    writer.Finish();
+  }
+
+  {
+    StreamWriter writer(new ZSTDParallelCompressor(&zstdbuf, Ownership::Nothing, true),
+                        Ownership::Stream);
+    writer.Write(data, size);
+    writer.Finish();
+  }
+
+  BlockIndex lz4index = ReadTestBlockIndex(lz4buf.GetData(), lz4buf.GetOffset());
+  BlockIndex zstdindex = ReadTestBlockIndex(zstdbuf.GetData(), zstdbuf.GetOffset());
+
+  // the serial decompressors stop reading before the index, so they can share the same data
+  auto decompress = [data, size](Decompressor *decomp) {
+    StreamReader reader(decomp, size, Ownership::Stream);
+    reader.Read(data, size);
+  };
+
+  auto blocks = [](StreamWriter &buf, const BlockIndex &index) {
+    return new StreamReader(buf.GetData(), buf.GetOffset() - index.GetSerialisedSize());
+  };
+
+  WARN("Decompressing " << size / (1024 * 1024) << "MB with " << JobSystem::GetNumWorkers()
+                        << " workers. Set Threading.JobWorkerCount to measure scaling.");
+
+  BENCHMARK("LZ4 serial")
+  {
+    decompress(new LZ4Decompressor(blocks(lz4buf, lz4index), Ownership::Stream));
+  }
+  BENCHMARK("LZ4 parallel")
+  {
+    decompress(new LZ4BlockDecompressor(blocks(lz4buf, lz4index), Ownership::Stream, lz4index));
+  }
+  BENCHMARK("ZSTD serial")
+  {
+    decompress(new ZSTDDecompressor(blocks(zstdbuf, zstdindex), Ownership::Stream));
+  }
+  BENCHMARK("ZSTD parallel")
+  {
+    decompress(new ZSTDBlockDecompressor(blocks(zstdbuf, zstdindex), Ownership::Stream, zstdindex));
+  }
+
+  delete[] data;
+};
+
 #endif    // ENABLED(ENABLE_UNIT_TESTS)
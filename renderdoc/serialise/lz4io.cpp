@@ -153,6 +153,31 @@ bool LZ4Compressor::FlushPage0()
   return success;
 }
 
+LZ4ParallelCompressor::LZ4ParallelCompressor(StreamWriter *write, Ownership own, bool writeIndex)
+    : BlockCompressor(write, own, lz4BlockSize, LZ4_COMPRESSBOUND(lz4BlockSize), writeIndex)
+{
+}
+
+LZ4ParallelCompressor::~LZ4ParallelCompressor()
+{
+  WaitForBlocks();
+}
+
+uint64_t LZ4ParallelCompressor::CompressBlock(const byte *src, uint64_t srcSize, byte *dst)
+{
+  // blocks don't reference any history, which LZ4Decompressor handles transparently.
+  int32_t compSize = LZ4_compress_fast((const char *)src, (char *)dst, (int)srcSize,
+                                       (int)LZ4_COMPRESSBOUND(lz4BlockSize), 20);
+
+  if(compSize <= 0)
+  {
+    RDCERR("Error compressing: %i", compSize);
+    return 0;
+  }
+
+  return (uint64_t)compSize;
+}
+
 LZ4Decompressor::LZ4Decompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
 {
   m_Page[0] = AllocAlignedBuffer(lz4BlockSize);
@@ -300,3 +325,34 @@ bool LZ4Decompressor::FillPage0()
 
   return success;
 }
+
+LZ4BlockDecompressor::LZ4BlockDecompressor(StreamReader *read, Ownership own,
+                                           const BlockIndex &index)
+    : BlockDecompressor(read, own, index, LZ4_COMPRESSBOUND(lz4BlockSize))
+{
+  if(index.blockSize != lz4BlockSize)
+  {
+    RDCERR("Unexpected LZ4 block size %llu", index.blockSize);
+    m_Error = true;
+  }
+}
+
+LZ4BlockDecompressor::~LZ4BlockDecompressor()
+{
+  WaitForBlocks();
+}
+
+bool LZ4BlockDecompressor::DecompressBlock(const byte *src, uint64_t srcSize, byte *dst,
+                                           uint64_t dstSize)
+{
+  int32_t decompSize =
+      LZ4_decompress_safe((const char *)src, (char *)dst, (int)srcSize, (int)dstSize);
+
+  if(decompSize < 0 || (uint64_t)decompSize != dstSize)
+  {
+    RDCERR("Error decompressing: %i", decompSize);
+    return false;
+  }
+
+  return true;
+}
@@ -46,6 +46,18 @@ private:
   LZ4_stream_t *m_LZ4Comp;
 };
 
+// writes the same block framing as LZ4Compressor, but each block is compressed independently
+// without history, so that several can be compressed in parallel.
+class LZ4ParallelCompressor : public BlockCompressor
+{
+public:
+  LZ4ParallelCompressor(StreamWriter *write, Ownership own, bool writeIndex = false);
+  ~LZ4ParallelCompressor();
+
+protected:
+  uint64_t CompressBlock(const byte *src, uint64_t srcSize, byte *dst);
+};
+
 class LZ4Decompressor : public Decompressor
 {
 public:
@@ -65,3 +77,14 @@ private:
 
   LZ4_streamDecode_t *m_LZ4Decomp;
 };
+
+// reads a stream from LZ4ParallelCompressor with its index, decompressing blocks in parallel.
+class LZ4BlockDecompressor : public BlockDecompressor
+{
+public:
+  LZ4BlockDecompressor(StreamReader *read, Ownership own, const BlockIndex &index);
+  ~LZ4BlockDecompressor();
+
+protected:
+  bool DecompressBlock(const byte *src, uint64_t srcSize, byte *dst, uint64_t dstSize);
+};
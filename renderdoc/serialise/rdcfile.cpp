@@ -27,11 +27,17 @@
 #include "api/replay/version.h"
 #include "common/dds_readwrite.h"
 #include "common/formatting.h"
+#include "core/settings.h"
 #include "jpeg-compressor/jpge.h"
 #include "stb/stb_image.h"
 #include "lz4io.h"
 #include "zstdio.h"
 
+RDOC_CONFIG(bool, Replay_MemoryMapSections, false,
+            "Read uncompressed capture sections by mapping the file into memory rather than "
+            "copying the data. The capture file must not be truncated or rewritten while it's "
+            "open, as reading a mapped page past the end of the file crashes the process.");
+
 // not provided by tinyexr, just do by hand
 bool is_exr_file(FILE *f)
 {
@@ -803,13 +809,51 @@ StreamReader *RDCFile::ReadSection(int index) const
 
   const SectionProperties &props = m_Sections[index];
   SectionLocation offsetSize = m_SectionLocations[index];
+
+  BlockIndex blockIndex;
+  bool indexed = false;
+
+  if((props.flags & SectionFlags::BlockIndexed) &&
+     (props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)))
+  {
+    indexed = ReadBlockIndex(offsetSize, blockIndex);
+
+    if(!indexed)
+      return new StreamReader(StreamReader::InvalidStream);
+
+    // the blocks are read on their own, without the index after them
+    offsetSize.diskLength -= blockIndex.GetSerialisedSize();
+  }
+
+  // uncompressed sections can be read straight from the file's pages
+  if(!(props.flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed)) &&
+     Replay_MemoryMapSections)
+  {
+    FileIO::FileMapping *mapping =
+        FileIO::MapFile(m_File, offsetSize.dataOffset, offsetSize.diskLength);
+
+    if(mapping)
+      return new StreamReader(mapping, offsetSize.diskLength);
+  }
+
   FileIO::fseek64(m_File, offsetSize.dataOffset, SEEK_SET);
 
   StreamReader *fileReader = new StreamReader(m_File, offsetSize.diskLength, Ownership::Nothing);
 
   StreamReader *compReader = NULL;
 
-  if(props.flags & SectionFlags::LZ4Compressed)
+  if(indexed && (props.flags & SectionFlags::LZ4Compressed))
+  {
+    compReader = new StreamReader(new LZ4BlockDecompressor(fileReader, Ownership::Stream, blockIndex),
+                                  props.uncompressedSize, Ownership::Stream);
+  }
+  else if(indexed && (props.flags & SectionFlags::ZstdCompressed))
+  {
+    compReader =
+        new StreamReader(new ZSTDBlockDecompressor(fileReader, Ownership::Stream, blockIndex),
+                         props.uncompressedSize, Ownership::Stream);
+  }
+  else if(props.flags & SectionFlags::LZ4Compressed)
   {
     // the user will delete the compressed reader, and then it will delete the compressor and the
     // file reader
@@ -826,6 +870,61 @@ StreamReader *RDCFile::ReadSection(int index) const
   return compReader ? compReader : fileReader;
 }
 
+bool RDCFile::ReadBlockIndex(const SectionLocation &loc, BlockIndex &index) const
+{
+  BlockIndex::Footer footer = {};
+
+  if(loc.diskLength < sizeof(footer))
+  {
+    RDCERR("Section is too small to contain a block index");
+    return false;
+  }
+
+  FileIO::fseek64(m_File, loc.dataOffset + loc.diskLength - sizeof(footer), SEEK_SET);
+
+  if(FileIO::fread(&footer, 1, sizeof(footer), m_File) != sizeof(footer))
+  {
+    RDCERR("Error reading block index footer, errno %d", errno);
+    return false;
+  }
+
+  if(footer.magic != BlockIndex::Magic || footer.version != BlockIndex::Version ||
+     footer.numBlocks * sizeof(uint64_t) + sizeof(footer) > loc.diskLength)
+  {
+    RDCERR("Invalid block index footer");
+    return false;
+  }
+
+  index.uncompressedSize = footer.uncompressedSize;
+  index.blockSize = footer.blockSize;
+  index.blockOffsets.resize((size_t)footer.numBlocks);
+
+  uint64_t dataLength = loc.diskLength - index.GetSerialisedSize();
+
+  FileIO::fseek64(m_File, loc.dataOffset + dataLength, SEEK_SET);
+
+  if(FileIO::fread(index.blockOffsets.data(), 1, index.blockOffsets.byteSize(), m_File) !=
+     index.blockOffsets.byteSize())
+  {
+    RDCERR("Error reading block index, errno %d", errno);
+    return false;
+  }
+
+  // blocks must be in order and within the section, with room for at least each size prefix
+  for(size_t i = 0; i < index.blockOffsets.size(); i++)
+  {
+    uint64_t next = i + 1 < index.blockOffsets.size() ? index.blockOffsets[i + 1] : dataLength;
+
+    if(index.blockOffsets[i] + sizeof(uint32_t) > next)
+    {
+      RDCERR("Invalid offset for block %zu in block index", i);
+      return false;
+    }
+  }
+
+  return true;
+}
+
 StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 {
   if(m_Error != ContainerError::NoError)
@@ -1097,6 +1196,12 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
 
   uint64_t headerOffset = FileIO::ftell64(m_File);
 
+  // compressed sections are always written with a block index, regardless of where the properties
+  // came from.
+  SectionFlags flags = props.flags & ~SectionFlags::BlockIndexed;
+  if(flags & (SectionFlags::LZ4Compressed | SectionFlags::ZstdCompressed))
+    flags |= SectionFlags::BlockIndexed;
+
   size_t numWritten;
 
   // write section header
@@ -1113,7 +1218,7 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
                                 // sectionVersion
                                 props.version,
                                 // sectionFlags
-                                props.flags,
+                                flags,
                                 // sectionNameLength
                                 uint32_t(name.length() + 1)};
 
@@ -1136,19 +1241,20 @@ StreamWriter *RDCFile::WriteSection(const SectionProperties &props)
   {
     // the user will delete the compressed writer, and then it will delete the compressor and the
     // file writer
-    compWriter =
-        new StreamWriter(new LZ4Compressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    compWriter = new StreamWriter(new LZ4ParallelCompressor(fileWriter, Ownership::Stream, true),
+                                  Ownership::Stream);
   }
   else if(props.flags & SectionFlags::ZstdCompressed)
   {
-    compWriter =
-        new StreamWriter(new ZSTDCompressor(fileWriter, Ownership::Stream), Ownership::Stream);
+    compWriter = new StreamWriter(new ZSTDParallelCompressor(fileWriter, Ownership::Stream, true),
+                                  Ownership::Stream);
   }
 
   uint64_t dataOffset = FileIO::ftell64(m_File);
 
   m_CurrentWritingProps = props;
   m_CurrentWritingProps.name = name;
+  m_CurrentWritingProps.flags = flags;
 
   // register a destroy callback to tidy up the section at the end
   fileWriter->AddCloseCallback([this, type, name, headerOffset, dataOffset, fileWriter, compWriter]() {
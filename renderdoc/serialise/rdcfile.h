@@ -83,6 +83,7 @@ public:
   // creates a new file with current properties, file will be overwritten if it already exists
   void Create(const char *filename);
 
+  const rdcstr &GetFilename() const { return m_Filename; }
   ContainerError ErrorCode() const { return m_Error; }
   rdcstr ErrorString() const { return m_ErrorString; }
   RDCDriver GetDriver() const { return m_Driver; }
@@ -126,6 +127,8 @@ private:
     uint64_t diskLength;
   };
 
+  bool ReadBlockIndex(const SectionLocation &loc, BlockIndex &index) const;
+
   rdcarray<SectionProperties> m_Sections;
   rdcarray<SectionLocation> m_SectionLocations;
   rdcarray<bytebuf> m_MemorySections;
@@ -36,6 +36,97 @@ int64_t Chunk::m_TotalMem = 0;
 
 #endif
 
+namespace
+{
+// prefixed to every structured allocation, sized to keep the object itself 16-byte aligned
+struct StructuredAllocHeader
+{
+  SDObjectArena *arena;
+  uint64_t padding;
+};
+}
+
+// RDCMAX takes its parameters by reference, so this needs a definition
+const size_t SDObjectArena::BlockSize;
+
+SDObjectArena *SDObjectArena::Create()
+{
+  return new SDObjectArena();
+}
+
+SDObjectArena::~SDObjectArena()
+{
+  for(byte *block : m_Blocks)
+    FreeAlignedBuffer(block);
+}
+
+void SDObjectArena::Release()
+{
+  // swap the creator's bias for a reference per allocation, keeping one for the creator so frees
+  // racing with this can't delete the arena, then drop that last one
+  Atomic::ExchAdd64(&m_RefCount, m_Allocations - CreatorRefs + 1);
+  RemoveRef();
+}
+
+void SDObjectArena::RemoveRef()
+{
+  if(Atomic::Dec64(&m_RefCount) == 0)
+    delete this;
+}
+
+void *SDObjectArena::Alloc(size_t size)
+{
+  size = AlignUp16(size);
+
+  if(m_Cur + size > m_End)
+  {
+    size_t blockSize = RDCMAX(size, BlockSize);
+    byte *block = AllocAlignedBuffer(blockSize);
+    m_Blocks.push_back(block);
+    m_Cur = block;
+    m_End = block + blockSize;
+  }
+
+  void *ret = m_Cur;
+  m_Cur += size;
+  return ret;
+}
+
+void *SDObjectArena::Allocate(uint64_t size, SDObjectArena *arena)
+{
+  size += sizeof(StructuredAllocHeader);
+
+  StructuredAllocHeader *header = NULL;
+
+  if(arena)
+  {
+    arena->m_Allocations++;
+    header = (StructuredAllocHeader *)arena->Alloc((size_t)size);
+  }
+  else
+  {
+    header = (StructuredAllocHeader *)malloc((size_t)size);
+    if(header == NULL)
+      RENDERDOC_OutOfMemory(size);
+  }
+
+  header->arena = arena;
+  return header + 1;
+}
+
+void SDObjectArena::Free(void *mem)
+{
+  if(mem == NULL)
+    return;
+
+  StructuredAllocHeader *header = ((StructuredAllocHeader *)mem) - 1;
+
+  if(header->arena)
+    header->arena->RemoveRef();
+  else
+    free(header);
+}
+
 void DumpObject(FileIO::LogFileHandle *log, const rdcstr &indent, SDObject *obj)
 {
   if(obj->NumChildren() > 0)
@@ -104,6 +195,9 @@ Serialiser<SerialiserMode::Reading>::~Serialiser()
 {
   if(m_Ownership == Ownership::Stream && m_Read)
     delete m_Read;
+
+  if(m_StructArena)
+    m_StructArena->Release();
 }
 
 template <>
@@ -113,6 +207,8 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint64_t)
 
   m_ChunkMetadata = SDChunkMetaData();
 
+  const uint64_t chunkOffset = m_Read->GetOffset();
+
   {
     uint32_t c = 0;
     bool success = m_Read->Read(c);
@@ -178,13 +274,20 @@ uint32_t Serialiser<SerialiserMode::Reading>::BeginChunk(uint32_t, uint64_t)
     if(name.empty())
       name = "<Unknown Chunk>";
 
-    SDChunk *chunk = new SDChunk(name.c_str());
+    SDChunk *chunk = new(m_StructArena) SDChunk(name);
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
     m_StructureStack.push_back(chunk);
 
     m_InternalElement = false;
+
+    // only record where the chunk is, and skip exporting its children until EndChunk
+    if(m_LazySource && m_LazySource->CanDecode(chunkID))
+    {
+      SDObjectLazyData::MakeLazy(chunk, m_LazySource, m_LazyBaseOffset + chunkOffset);
+      m_LazyChunk = true;
+    }
   }
 
   return chunkID;
@@ -201,7 +304,7 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
     SDObject &current = *m_StructureStack.back();
 
     current.data.basic.numChildren++;
-    current.data.children.push_back(new SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
+    current.data.children.push_back(new(m_StructArena) SDObject("Opaque chunk"_lit, "Byte Buffer"_lit));
 
     SDObject &obj = *current.data.children.back();
     obj.type.basetype = SDBasic::Buffer;
@@ -254,6 +357,8 @@ void Serialiser<SerialiserMode::Reading>::SkipCurrentChunk()
 template <>
 void Serialiser<SerialiserMode::Reading>::EndChunk()
 {
+  m_LazyChunk = false;
+
   if(ExportStructure())
   {
     RDCASSERTMSG("Object Stack is imbalanced!", m_StructureStack.size() <= 1,
@@ -319,6 +424,9 @@ Serialiser<SerialiserMode::Writing>::~Serialiser()
     m_Write->Finish();
     delete m_Write;
   }
+
+  if(m_StructArena)
+    m_StructArena->Release();
 }
 
 template <>
@@ -438,7 +546,7 @@ uint32_t Serialiser<SerialiserMode::Writing>::BeginChunk(uint32_t chunkID, uint6
     if(name.empty())
       name = "<Unknown Chunk>";
 
-    SDChunk *chunk = new SDChunk(name.c_str());
+    SDChunk *chunk = new(m_StructArena) SDChunk(name);
     chunk->metadata = m_ChunkMetadata;
 
     m_StructuredFile->chunks.push_back(chunk);
@@ -579,6 +687,8 @@ void Serialiser<SerialiserMode::Writing>::WriteStructuredFile(const SDFile &file
 
     ser->BeginChunk(m_ChunkMetadata.chunkID, m_ChunkMetadata.length);
 
+    chunk.PopulateChildren();
+
     if(chunk.metadata.flags & SDChunkFlags::OpaqueChunk)
     {
       RDCASSERT(chunk.data.children.size() == 1);
@@ -707,6 +817,9 @@ void DoSerialise(SerialiserType &ser, SDObjectData &el)
 template <class SerialiserType>
 void DoSerialise(SerialiserType &ser, SDObject &el)
 {
+  if(ser.IsWriting())
+    el.PopulateChildren();
+
   SERIALISE_MEMBER(name);
   SERIALISE_MEMBER(type);
   SERIALISE_MEMBER(data);
@@ -715,12 +828,16 @@ void DoSerialise(SerialiserType &ser, SDObject &el)
 template <class SerialiserType>
 void DoSerialise(SerialiserType &ser, SDChunk &el)
 {
+  if(ser.IsWriting())
+    el.PopulateChildren();
+
   SERIALISE_MEMBER(name);
   SERIALISE_MEMBER(type);
   SERIALISE_MEMBER(data);
   SERIALISE_MEMBER(metadata);
 }
 
+INSTANTIATE_SERIALISE_TYPE(StructuredObjectList);
 INSTANTIATE_SERIALISE_TYPE(SDChunk);
 
 // serialise the pointer version - special case for writing a structured file, so can assume writing
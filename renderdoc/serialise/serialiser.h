@@ -51,6 +51,120 @@ void Deserialise(const T &el)
 
 typedef rdcstr (*ChunkLookup)(uint32_t chunkType);
 
+// A bump allocator for the SDObject and SDChunk nodes of a structured file, so that building one
+// with millions of objects doesn't need a heap allocation per node. Only the nodes themselves come
+// from here - child lists and string values are still ordinary heap allocations. Every allocation
+// is prefixed with a small header identifying the arena it came from (or none, for a plain heap
+// allocation) so that any object can still be deleted individually through the normal operator
+// delete, from any module.
+//
+// The arena holds a reference for each live object allocated from it plus one for its creator, and
+// the memory is only released in bulk once all of them are gone. That way objects can freely be
+// moved between files or outlive the serialiser that created them.
+//
+// Only the creator allocates, so it counts allocations without atomics and adds them to the
+// reference count when it releases the arena. Until then its own reference is a large bias, so
+// objects freed in the meantime can't take the count to zero.
+struct SDObjectArena
+{
+  static SDObjectArena *Create();
+  void Release();
+
+  static void *Allocate(uint64_t size, SDObjectArena *arena);
+  static void Free(void *mem);
+
+private:
+  SDObjectArena() = default;
+  ~SDObjectArena();
+
+  void *Alloc(size_t size);
+  void RemoveRef();
+
+  // big enough to hold tens of thousands of objects before needing another block
+  static const size_t BlockSize = 4 * 1024 * 1024;
+
+  rdcarray<byte *> m_Blocks;
+  byte *m_Cur = NULL;
+  byte *m_End = NULL;
+  static const int64_t CreatorRefs = 1LL << 62;
+
+  int64_t m_RefCount = CreatorRefs;
+  int64_t m_Allocations = 0;
+};
+
+// Decodes the structured data of a single chunk on demand, so that loading only needs to record
+// where each chunk is rather than building its children. Drivers that can deserialise a chunk in
+// isolation provide one while loading, see Serialiser::SetLazyChunkSource. It is shared by every
+// chunk decoded through it and destroyed once the last reference is released. Decoding is
+// serialised by the caller.
+struct LazyChunkSource
+{
+  // returns true if chunks of this type can be decoded on their own. Others are exported in full
+  // while loading as normal.
+  virtual bool CanDecode(uint32_t chunkID) = 0;
+  // deserialises the chunk starting at the given offset and moves its children into the list
+  virtual bool DecodeChunk(uint64_t offset, StructuredObjectList &children) = 0;
+
+  void AddRef() { Atomic::Inc32(&m_RefCount); }
+  void Release()
+  {
+    if(Atomic::Dec32(&m_RefCount) == 0)
+      delete this;
+  }
+
+protected:
+  virtual ~LazyChunkSource() = default;
+
+private:
+  int32_t m_RefCount = 1;
+};
+
+// Chunks in lazily populated structured data only deserialise their children when accessed. The
+// children come either from a LazyChunkSource, with only the chunk's offset recorded at load, or
+// from a compact serialised copy made after loading for drivers without one.
+//
+// Populated chunks are kept in an LRU shared by all files, and the least recently used is
+// unpopulated again once more than Replay.LazyStructuredDataCacheSize are populated. Requesting
+// mutable access to a chunk's children, or handing it to python, keeps it populated for good since
+// the children may be modified or held indefinitely. All access goes through a single lock since
+// population is rare compared to the cost of deserialising.
+struct SDObjectLazyData
+{
+  static void MakeLazy(SDObject *obj);
+  static void MakeLazy(SDObject *obj, LazyChunkSource *source, uint64_t offset);
+  static void Populate(SDObject *obj, bool keep);
+  static void Release(SDObject *obj);
+
+  static uint32_t GetNumPopulated();
+
+private:
+  void Link();
+  void Unlink();
+  void Unpopulate();
+
+  SDObject *obj = NULL;
+
+  bytebuf children;
+  LazyChunkSource *source = NULL;
+  uint64_t offset = 0;
+
+  bool populated = false;
+  SDObjectLazyData *prev = NULL;
+  SDObjectLazyData *next = NULL;
+
+  static Threading::CriticalSection lock;
+  static SDObjectLazyData *head;
+  static SDObjectLazyData *tail;
+  static uint32_t numPopulated;
+};
+
+// returns true if loaded structured data will be made lazy. Structured export then allocates from
+// the heap rather than an SDObjectArena, so that the memory for compacted children is returned.
+bool IsStructuredDataLazy();
+
+// convert every chunk in the file to be lazily populated
+void MakeStructuredFileLazy(SDFile &file);
+
 enum class SerialiserFlags
 {
   NoFlags = 0x0,
@@ -94,7 +208,7 @@ public:
 #if ENABLED(RDOC_RELEASE)
         sertype == SerialiserMode::Reading &&
 #endif
-        m_ExportStructured && !m_InternalElement;
+        m_ExportStructured && !m_InternalElement && !m_LazyChunk;
   }
 
   enum ChunkFlags
@@ -162,6 +276,18 @@ public:
     m_ChunkLookup = lookup;
     m_ExportBuffers = includeBuffers;
     m_ExportStructured = (lookup != NULL);
+
+    if(m_ExportStructured && !m_StructArena && !IsStructuredDataLazy())
+      m_StructArena = SDObjectArena::Create();
+  }
+
+  // when exporting lazily populated structured data, chunks the source can decode are only
+  // recorded with their offset and their children aren't exported. baseOffset is where this
+  // serialiser's stream starts in the stream the source reads from.
+  void SetLazyChunkSource(LazyChunkSource *source, uint64_t baseOffset)
+  {
+    m_LazySource = source;
+    m_LazyBaseOffset = baseOffset;
   }
 
   uint32_t BeginChunk(uint32_t chunkID, uint64_t byteLength);
@@ -218,7 +344,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, TypeName<T>()));
+      current.data.children.push_back(new(m_StructArena) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -265,7 +391,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"_lit));
+      current.data.children.push_back(new(m_StructArena) SDObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -376,7 +502,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name, "Byte Buffer"_lit));
+      current.data.children.push_back(new(m_StructArena) SDObject(name, "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -489,7 +615,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(new(m_StructArena) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -502,7 +628,7 @@ public:
 
       for(size_t i = 0; i < N; i++)
       {
-        arr.data.children[i] = new SDObject("$el"_lit, TypeName<T>());
+        arr.data.children[i] = new(m_StructArena) SDObject("$el"_lit, TypeName<T>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -611,7 +737,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+      parent.data.children.push_back(new(m_StructArena) SDObject(name, TypeName<T>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -636,7 +762,7 @@ public:
 
       for(uint64_t i = 0; el && i < arrayCount; i++)
       {
-        arr.data.children[(size_t)i] = new SDObject("$el"_lit, TypeName<T>());
+        arr.data.children[(size_t)i] = new(m_StructArena) SDObject("$el"_lit, TypeName<T>());
         m_StructureStack.push_back(arr.data.children[(size_t)i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -704,7 +830,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, TypeName<U>()));
+      parent.data.children.push_back(new(m_StructArena) SDObject(name, TypeName<U>()));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -719,7 +845,7 @@ public:
 
       for(size_t i = 0; i < (size_t)size; i++)
       {
-        arr.data.children[i] = new SDObject("$el"_lit, TypeName<U>());
+        arr.data.children[i] = new(m_StructArena) SDObject("$el"_lit, TypeName<U>());
         m_StructureStack.push_back(arr.data.children[i]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -761,7 +887,7 @@ public:
 
       SDObject &parent = *m_StructureStack.back();
       parent.data.basic.numChildren++;
-      parent.data.children.push_back(new SDObject(name, "pair"_lit));
+      parent.data.children.push_back(new(m_StructArena) SDObject(name, "pair"_lit));
       m_StructureStack.push_back(parent.data.children.back());
 
       SDObject &arr = *m_StructureStack.back();
@@ -772,7 +898,7 @@ public:
       arr.data.children.resize(2);
 
       {
-        arr.data.children[0] = new SDObject("first"_lit, TypeName<U>());
+        arr.data.children[0] = new(m_StructArena) SDObject("first"_lit, TypeName<U>());
         m_StructureStack.push_back(arr.data.children[0]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -787,7 +913,7 @@ public:
       }
 
       {
-        arr.data.children[1] = new SDObject("second"_lit, TypeName<V>());
+        arr.data.children[1] = new(m_StructArena) SDObject("second"_lit, TypeName<V>());
         m_StructureStack.push_back(arr.data.children[1]);
 
         SDObject &obj = *m_StructureStack.back();
@@ -879,7 +1005,7 @@ public:
       {
         SDObject &parent = *m_StructureStack.back();
         parent.data.basic.numChildren++;
-        parent.data.children.push_back(new SDObject(name, TypeName<T>()));
+        parent.data.children.push_back(new(m_StructArena) SDObject(name, TypeName<T>()));
 
         SDObject &nullable = *parent.data.children.back();
         nullable.type.basetype = SDBasic::Null;
@@ -967,7 +1093,7 @@ public:
       SDObject &current = *m_StructureStack.back();
 
       current.data.basic.numChildren++;
-      current.data.children.push_back(new SDObject(name.c_str(), "Byte Buffer"_lit));
+      current.data.children.push_back(new(m_StructArena) SDObject(name.c_str(), "Byte Buffer"_lit));
       m_StructureStack.push_back(current.data.children.back());
 
       SDObject &obj = *m_StructureStack.back();
@@ -1310,8 +1436,12 @@ private:
   bool m_ExportStructured = false;
   bool m_ExportBuffers = false;
   bool m_InternalElement = false;
+  bool m_LazyChunk = false;
+  LazyChunkSource *m_LazySource = NULL;
+  uint64_t m_LazyBaseOffset = 0;
   SDFile m_StructData;
   SDFile *m_StructuredFile = &m_StructData;
+  SDObjectArena *m_StructArena = NULL;
   rdcarray<SDObject *> m_StructureStack;
 
   uint32_t m_ChunkFlags = 0;
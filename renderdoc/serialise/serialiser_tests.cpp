@@ -23,6 +23,7 @@
  ******************************************************************************/
 
 #include "serialiser.h"
+#include "core/core.h"
 
 #if ENABLED(ENABLE_UNIT_TESTS)
 
@@ -830,6 +831,352 @@ TEST_CASE("Verify multiple chunks can be merged", "[serialiser][chunks]")
   delete buf;
 };
 
+TEST_CASE("Structured data outlives the serialiser that created it", "[serialiser][structured]")
+{
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(int i = 0; i < 1000; i++)
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      rdcstr s = "a string that's long enough to need its own allocation";
+      rdcarray<uint32_t> values = {1, 2, 3, (uint32_t)i};
+
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(values);
+    }
+  }
+
+  SDFile file;
+  SDObject *extra = NULL;
+
+  {
+    ReadSerialiser ser(new StreamReader(buf->GetData(), buf->GetOffset()), Ownership::Stream);
+
+    ChunkLookup testChunkLoop = [](uint32_t) -> rdcstr { return "TestChunk"_lit; };
+
+    ser.ConfigureStructuredExport(testChunkLoop, true);
+
+    while(!ser.GetReader()->AtEnd())
+    {
+      ser.ReadChunk<uint32_t>();
+
+      rdcstr s;
+      rdcarray<uint32_t> values;
+
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(values);
+
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+
+    ser.GetStructuredFile().Swap(file);
+
+    // keep a single object alive on its own after everything else is gone
+    extra = file.chunks[10]->GetChild(1)->GetChild(3);
+    file.chunks[10]->GetChild(1)->GetChildren().pop_back();
+  }
+
+  REQUIRE(file.chunks.size() == 1000);
+
+  // mix heap-allocated objects in with the arena-allocated ones
+  file.chunks[0]->GetChildren().push_back(makeSDString("heap", "heap string"_lit));
+  file.chunks[1]->GetChildren().push_back(file.chunks[2]->GetChild(0)->Duplicate());
+
+  for(size_t i = 0; i < file.chunks.size(); i++)
+  {
+    SDChunk *chunk = file.chunks[i];
+
+    CHECK(chunk->name == "TestChunk");
+    CHECK(chunk->GetChild(0)->AsString() == "a string that's long enough to need its own allocation");
+
+    if(i == 10)
+    {
+      CHECK(chunk->GetChild(1)->NumChildren() == 3);
+    }
+    else
+    {
+      REQUIRE(chunk->GetChild(1)->NumChildren() == 4);
+      CHECK(chunk->GetChild(1)->GetChild(3)->AsUInt32() == i);
+    }
+  }
+
+  CHECK(file.chunks[0]->GetChild(2)->AsString() == "heap string");
+  CHECK(file.chunks[1]->GetChild(2)->AsString() == file.chunks[2]->GetChild(0)->AsString());
+
+  // delete some chunks early, then the rest with the file
+  for(int i = 0; i < 100; i++)
+  {
+    delete file.chunks.back();
+    file.chunks.pop_back();
+  }
+
+  {
+    SDFile tmp;
+    tmp.Swap(file);
+  }
+
+  CHECK(extra->AsUInt32() == 10);
+  delete extra;
+
+  delete buf;
+};
+
+TEST_CASE("Lazily populated structured data", "[serialiser][structured]")
+{
+  const uint32_t numChunks = 3000;
+  const uint32_t cacheSize = 16;
+
+  StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(buf, Ownership::Nothing);
+
+    for(uint32_t i = 0; i < numChunks; i++)
+    {
+      // alternate chunk IDs so that the source below can only decode half of them
+      SCOPED_SERIALISE_CHUNK(5 + (i % 2));
+
+      rdcstr s = StringFormat::Fmt("string %u", i);
+      rdcarray<uint32_t> values = {1, 2, 3, i};
+
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(values);
+    }
+  }
+
+  bytebuf data(buf->GetData(), (size_t)buf->GetOffset());
+
+  delete buf;
+
+  ChunkLookup testChunkLoop = [](uint32_t) -> rdcstr { return "TestChunk"_lit; };
+
+  struct TestChunkSource : public LazyChunkSource
+  {
+    TestChunkSource(const bytebuf &data, ChunkLookup lookup) : data(data), lookup(lookup) {}
+    bool CanDecode(uint32_t chunkID) override { return chunkID == 5; }
+    bool DecodeChunk(uint64_t offset, StructuredObjectList &children) override
+    {
+      decodes++;
+
+      ReadSerialiser ser(new StreamReader(data), Ownership::Stream);
+      ser.GetReader()->SetOffset(offset);
+      ser.ConfigureStructuredExport(lookup, true);
+
+      ser.ReadChunk<uint32_t>();
+
+      rdcstr s;
+      rdcarray<uint32_t> values;
+
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(values);
+
+      ser.EndChunk();
+
+      children.swap(ser.GetStructuredFile().chunks[0]->data.children);
+
+      return !ser.IsErrored();
+    }
+
+    bytebuf data;
+    ChunkLookup lookup;
+    uint32_t decodes = 0;
+  };
+
+  auto load = [&](SDFile &file, LazyChunkSource *source) {
+    ReadSerialiser ser(new StreamReader(data), Ownership::Stream);
+
+    ser.ConfigureStructuredExport(testChunkLoop, true);
+    ser.SetLazyChunkSource(source, 0);
+
+    while(!ser.GetReader()->AtEnd())
+    {
+      ser.ReadChunk<uint32_t>();
+
+      rdcstr s;
+      rdcarray<uint32_t> values;
+
+      SERIALISE_ELEMENT(s);
+      SERIALISE_ELEMENT(values);
+
+      ser.EndChunk();
+    }
+
+    REQUIRE_FALSE(ser.IsErrored());
+
+    ser.GetStructuredFile().Swap(file);
+  };
+
+  auto checkChunks = [&](SDFile &file, uint32_t first) {
+    for(int pass = 0; pass < 2; pass++)
+    {
+      for(uint32_t i = first; i < numChunks; i++)
+      {
+        const SDChunk *chunk = file.chunks[i];
+
+        REQUIRE(chunk->NumChildren() == 2);
+        CHECK(chunk->GetChild(0)->AsString() == StringFormat::Fmt("string %u", i));
+        REQUIRE(chunk->GetChild(1)->NumChildren() == 4);
+        CHECK(chunk->GetChild(1)->GetChild(3)->AsUInt32() == i);
+      }
+    }
+  };
+
+  SDObject *cacheConfig = RenderDoc::Inst().SetConfigSetting("Replay_LazyStructuredDataCacheSize");
+  const uint64_t prevCacheSize = cacheConfig->data.basic.u;
+  cacheConfig->data.basic.u = cacheSize;
+
+  SECTION("Compacted after loading")
+  {
+    SDFile file;
+    load(file, NULL);
+
+    REQUIRE(file.chunks.size() == numChunks);
+
+    SDChunk *reference = file.chunks[7]->Duplicate();
+
+    MakeStructuredFileLazy(file);
+
+    // the chunks themselves are untouched, only their children are deferred
+    CHECK(file.chunks[7]->name == "TestChunk");
+    CHECK(file.chunks[7]->HasEqualValue(reference));
+
+    checkChunks(file, 0);
+
+    // only the most recently accessed chunks stay populated
+    CHECK(SDObjectLazyData::GetNumPopulated() <= cacheSize);
+
+    // duplicating gives a normal non-lazy object
+    SDChunk *dup = file.chunks[100]->Duplicate();
+    CHECK(dup->FindChild("s")->AsString() == "string 100");
+    delete dup;
+
+    // modifications to a chunk are kept, since mutable access keeps it populated
+    file.chunks[0]->GetChildren().push_back(makeSDString("extra", "extra string"_lit));
+
+    checkChunks(file, 1);
+
+    REQUIRE(file.chunks[0]->NumChildren() == 3);
+    CHECK(file.chunks[0]->GetChild(2)->AsString() == "extra string");
+
+    // delete some chunks while populated, some while not, and the rest with the file
+    for(uint32_t i = 0; i < 100; i++)
+    {
+      delete file.chunks.back();
+      file.chunks.pop_back();
+    }
+
+    delete reference;
+  }
+
+  SECTION("Decoded from a chunk source")
+  {
+    TestChunkSource *source = new TestChunkSource(data, testChunkLoop);
+
+    SDFile file;
+    load(file, source);
+
+    REQUIRE(file.chunks.size() == numChunks);
+
+    // nothing is decoded while loading, and chunks the source can't decode are exported in full
+    CHECK(source->decodes == 0);
+    CHECK(file.chunks[1]->data.children.size() == 2);
+    CHECK(file.chunks[2]->data.children.empty());
+
+    checkChunks(file, 0);
+
+    CHECK(SDObjectLazyData::GetNumPopulated() <= cacheSize);
+
+    // half the chunks are decodable, and each was evicted again before the second pass
+    CHECK(source->decodes == (numChunks / 2) * 2);
+
+    // accessing a populated chunk again doesn't decode it
+    const uint32_t decodes = source->decodes;
+    CHECK(file.chunks[numChunks - 2]->NumChildren() == 2);
+    CHECK(source->decodes == decodes);
+
+    // the source is kept alive by the chunks that reference it
+    source->Release();
+
+    file.chunks[0]->GetChildren().push_back(makeSDString("extra", "extra string"_lit));
+
+    checkChunks(file, 1);
+
+    REQUIRE(file.chunks[0]->NumChildren() == 3);
+    CHECK(file.chunks[0]->GetChild(2)->AsString() == "extra string");
+  }
+
+  cacheConfig->data.basic.u = prevCacheSize;
+};
+
+TEST_CASE("Benchmark structured data allocation", "[.][benchmark]")
+{
+  const int numChunks = 200000;
+  const int numChildren = 16;
+
+  auto build = [](SDObjectArena *arena) {
+    SDFile *file = new SDFile;
+    file->chunks.reserve(numChunks);
+    for(int c = 0; c < numChunks; c++)
+    {
+      SDChunk *chunk = new(arena) SDChunk("Chunk"_lit);
+      chunk->GetChildren().resize(numChildren);
+      for(int i = 0; i < numChildren; i++)
+        chunk->GetChildren()[i] = new(arena) SDObject("member"_lit, "uint32_t"_lit);
+      file->chunks.push_back(chunk);
+    }
+    delete file;
+  };
+
+  WARN("Building and destroying " << numChunks << " chunks of " << numChildren << " objects");
+
+  BENCHMARK("Heap allocated") { build(NULL); }
+  BENCHMARK("Arena allocated")
+  {
+    SDObjectArena *arena = SDObjectArena::Create();
+    build(arena);
+    arena->Release();
+  }
+
+  StreamWriter buf(StreamWriter::DefaultScratchSize);
+
+  {
+    WriteSerialiser ser(&buf, Ownership::Nothing);
+
+    for(int c = 0; c < numChunks; c++)
+    {
+      SCOPED_SERIALISE_CHUNK(5);
+
+      uint32_t values[numChildren] = {};
+      SERIALISE_ELEMENT(values);
+    }
+  }
+
+  BENCHMARK("Structured read")
+  {
+    ReadSerialiser ser(new StreamReader(buf.GetData(), buf.GetOffset()), Ownership::Stream);
+
+    ChunkLookup testChunkLoop = [](uint32_t) -> rdcstr { return "TestChunk"_lit; };
+
+    ser.ConfigureStructuredExport(testChunkLoop, true);
+
+    while(!ser.GetReader()->AtEnd())
+    {
+      ser.ReadChunk<uint32_t>();
+
+      uint32_t values[numChildren];
+      SERIALISE_ELEMENT(values);
+
+      ser.EndChunk();
+    }
+  }
+};
+
 TEST_CASE("Read/write container types", "[serialiser][structured]")
 {
   StreamWriter *buf = new StreamWriter(StreamWriter::DefaultScratchSize);
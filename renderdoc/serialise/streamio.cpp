@@ -25,7 +25,15 @@
 #include "streamio.h"
 #include <errno.h>
 #include "api/replay/stringise.h"
+#include "common/formatting.h"
 #include "common/timing.h"
+#include "core/jobsystem.h"
+#include "core/settings.h"
+
+RDOC_CONFIG(uint32_t, Replay_FrameCacheFileMB, 0,
+            "When loading a capture, frame data of at least this many MB is decompressed into a "
+            "temporary file and memory-mapped, instead of being held in memory. 0 disables the "
+            "cache file.");
 
 Compressor::~Compressor()
 {
@@ -33,14 +41,474 @@ Compressor::~Compressor()
     delete m_Write;
 }
 
+BlockCompressor::BlockCompressor(StreamWriter *write, Ownership own, uint64_t blockSize,
+                                 uint64_t compressBound, bool writeIndex)
+    : Compressor(write, own),
+      m_BlockSize(blockSize),
+      m_CompressBound(compressBound),
+      m_WriteIndex(writeIndex)
+{
+  // allow a couple of blocks per worker to be in flight, so workers always have something queued
+  // while we wait for the oldest block to be written.
+  m_MaxInFlight = JobSystem::GetNumWorkers() * 2 + 1;
+
+  m_BaseOffset = m_Write->GetOffset();
+  m_Index.blockSize = blockSize;
+}
+
+BlockCompressor::~BlockCompressor()
+{
+  WaitForBlocks();
+
+  m_FreeBlocks.append(m_InFlight);
+  m_InFlight.clear();
+
+  if(m_Current)
+    m_FreeBlocks.push_back(m_Current);
+  m_Current = NULL;
+
+  for(Block *b : m_FreeBlocks)
+  {
+    FreeAlignedBuffer(b->src);
+    FreeAlignedBuffer(b->dst);
+    delete b;
+  }
+}
+
+void BlockCompressor::WaitForBlocks()
+{
+  for(Block *b : m_InFlight)
+  {
+    JobSystem::SyncJob(b->job);
+    b->job = NULL;
+  }
+}
+
+bool BlockCompressor::Write(const void *data, uint64_t numBytes)
+{
+  if(m_Error)
+    return false;
+
+  const byte *src = (const byte *)data;
+
+  while(numBytes > 0)
+  {
+    if(m_Current == NULL)
+    {
+      if(m_FreeBlocks.empty())
+      {
+        m_Current = new Block;
+        m_Current->src = AllocAlignedBuffer(m_BlockSize);
+        m_Current->dst = AllocAlignedBuffer(m_CompressBound);
+      }
+      else
+      {
+        m_Current = m_FreeBlocks.back();
+        m_FreeBlocks.pop_back();
+      }
+
+      m_Current->srcSize = m_Current->dstSize = 0;
+    }
+
+    // copy as much as will fit in the current block
+    uint64_t copySize = RDCMIN(m_BlockSize - m_Current->srcSize, numBytes);
+    memcpy(m_Current->src + m_Current->srcSize, src, (size_t)copySize);
+
+    m_Current->srcSize += copySize;
+    m_Index.uncompressedSize += copySize;
+    numBytes -= copySize;
+    src += copySize;
+
+    // once full, send it off to be compressed
+    if(m_Current->srcSize == m_BlockSize && !SubmitBlock())
+      return false;
+  }
+
+  return true;
+}
+
+bool BlockCompressor::Finish()
+{
+  if(m_Error)
+    return false;
+
+  if(m_Finished)
+    return true;
+
+  m_Finished = true;
+
+  bool success = true;
+
+  // only the last block can be partial
+  if(m_Current && m_Current->srcSize > 0)
+    success &= SubmitBlock();
+
+  while(success && !m_InFlight.empty())
+    success &= RetireBlock();
+
+  if(success && m_WriteIndex)
+  {
+    BlockIndex::Footer footer;
+    footer.uncompressedSize = m_Index.uncompressedSize;
+    footer.blockSize = m_Index.blockSize;
+    footer.numBlocks = m_Index.blockOffsets.size();
+    footer.version = BlockIndex::Version;
+    footer.magic = BlockIndex::Magic;
+
+    success &= m_Write->Write(m_Index.blockOffsets.data(), m_Index.blockOffsets.byteSize());
+    success &= m_Write->Write(footer);
+
+    if(!success)
+      m_Error = true;
+  }
+
+  return success;
+}
+
+bool BlockCompressor::SubmitBlock()
+{
+  // if too many blocks are outstanding, write the oldest first so memory use stays bounded
+  if(m_InFlight.size() >= m_MaxInFlight && !RetireBlock())
+    return false;
+
+  Block *b = m_Current;
+  m_Current = NULL;
+
+  b->job = JobSystem::AddJob([this, b]() { b->dstSize = CompressBlock(b->src, b->srcSize, b->dst); });
+
+  m_InFlight.push_back(b);
+
+  return true;
+}
+
+bool BlockCompressor::RetireBlock()
+{
+  Block *b = m_InFlight[0];
+  m_InFlight.erase(0);
+
+  JobSystem::SyncJob(b->job);
+  b->job = NULL;
+
+  m_FreeBlocks.push_back(b);
+
+  if(b->dstSize == 0 || b->dstSize > m_CompressBound)
+  {
+    RDCERR("Error compressing block of %llu bytes", b->srcSize);
+    m_Error = true;
+    return false;
+  }
+
+  m_Index.blockOffsets.push_back(m_Write->GetOffset() - m_BaseOffset);
+
+  bool success = true;
+
+  success &= m_Write->Write((uint32_t)b->dstSize);
+  success &= m_Write->Write(b->dst, b->dstSize);
+
+  if(!success)
+    m_Error = true;
+
+  return success;
+}
+
 Decompressor::~Decompressor()
 {
   if(m_Ownership == Ownership::Stream && m_Read)
     delete m_Read;
 }
 
+BlockDecompressor::BlockDecompressor(StreamReader *read, Ownership own, const BlockIndex &index,
+                                     uint64_t compressBound)
+    : Decompressor(read, own), m_Index(index), m_CompressBound(compressBound)
+{
+  // keep enough blocks in flight that every worker has one to decompress while we consume the
+  // oldest, the same as BlockCompressor.
+  m_MaxInFlight = JobSystem::GetNumWorkers() * 2 + 1;
+
+  if(m_Index.blockSize == 0 ||
+     m_Index.blockOffsets.size() !=
+         (m_Index.uncompressedSize + m_Index.blockSize - 1) / m_Index.blockSize)
+  {
+    RDCERR("Invalid block index: %zu blocks of %llu bytes for %llu bytes",
+           m_Index.blockOffsets.size(), m_Index.blockSize, m_Index.uncompressedSize);
+    m_Error = true;
+  }
+}
+
+BlockDecompressor::~BlockDecompressor()
+{
+  ReleaseBlocks();
+
+  for(Block *b : m_FreeBlocks)
+  {
+    FreeAlignedBuffer(b->src);
+    FreeAlignedBuffer(b->dst);
+    delete b;
+  }
+}
+
+void BlockDecompressor::WaitForBlocks()
+{
+  for(Block *b : m_Window)
+  {
+    if(b->job)
+      JobSystem::SyncJob(b->job);
+    b->job = NULL;
+  }
+}
+
+void BlockDecompressor::ReleaseBlocks()
+{
+  WaitForBlocks();
+
+  m_FreeBlocks.append(m_Window);
+  m_Window.clear();
+}
+
+BlockDecompressor::Block *BlockDecompressor::AllocBlock()
+{
+  Block *b = NULL;
+
+  if(m_FreeBlocks.empty())
+  {
+    b = new Block;
+    b->src = AllocAlignedBuffer(m_CompressBound);
+    b->dst = AllocAlignedBuffer(m_Index.blockSize);
+  }
+  else
+  {
+    b = m_FreeBlocks.back();
+    m_FreeBlocks.pop_back();
+  }
+
+  b->srcSize = b->dstSize = 0;
+  b->success = false;
+
+  return b;
+}
+
+bool BlockDecompressor::ReadCompressedBlock(Block *b)
+{
+  // blocks are read in order, so the reader only needs to move after a seek
+  uint64_t offs = m_Index.blockOffsets[b->index];
+  if(m_Read->GetOffset() != offs)
+    m_Read->SetOffset(offs);
+
+  uint32_t compSize = 0;
+  bool success = m_Read->Read(compSize);
+
+  if(success && compSize > m_CompressBound)
+  {
+    RDCERR("Block %u has invalid compressed size %u", b->index, compSize);
+    success = false;
+  }
+
+  success = success && m_Read->Read(b->src, compSize);
+
+  b->srcSize = compSize;
+  b->dstSize = GetBlockSize(b->index);
+
+  if(!success || m_Read->IsErrored())
+  {
+    m_Error = true;
+    return false;
+  }
+
+  return true;
+}
+
+bool BlockDecompressor::QueueBlocks()
+{
+  while(m_Window.size() < m_MaxInFlight && m_NextBlock < m_Index.blockOffsets.size())
+  {
+    Block *b = AllocBlock();
+    b->index = m_NextBlock++;
+
+    if(!ReadCompressedBlock(b))
+    {
+      m_FreeBlocks.push_back(b);
+      return false;
+    }
+
+    b->job = JobSystem::AddJob(
+        [this, b]() { b->success = DecompressBlock(b->src, b->srcSize, b->dst, b->dstSize); });
+
+    m_Window.push_back(b);
+  }
+
+  return true;
+}
+
+bool BlockDecompressor::DecompressDirect(byte *&dst, uint64_t &numBytes)
+{
+  rdcarray<Block *> batch;
+  uint64_t batchSize = 0;
+
+  // read in as many whole blocks as fit in the destination, up to the usual in-flight limit
+  while(batch.size() < m_MaxInFlight && m_NextBlock < m_Index.blockOffsets.size() &&
+        batchSize + GetBlockSize(m_NextBlock) <= numBytes)
+  {
+    Block *b = AllocBlock();
+    b->index = m_NextBlock++;
+
+    batch.push_back(b);
+
+    if(!ReadCompressedBlock(b))
+    {
+      m_FreeBlocks.append(batch);
+      return false;
+    }
+
+    batchSize += b->dstSize;
+  }
+
+  // only the last block can be partial, so each block lands at a multiple of the block size
+  JobSystem::ParallelFor((uint32_t)batch.size(), [this, &batch, dst](uint32_t i) {
+    Block *b = batch[i];
+    b->success = DecompressBlock(b->src, b->srcSize, dst + i * m_Index.blockSize, b->dstSize);
+  });
+
+  bool success = true;
+  for(Block *b : batch)
+    success &= b->success;
+
+  m_FreeBlocks.append(batch);
+
+  if(!success)
+  {
+    RDCERR("Error decompressing blocks");
+    m_Error = true;
+    return false;
+  }
+
+  dst += batchSize;
+  numBytes -= batchSize;
+  m_Position += batchSize;
+
+  return true;
+}
+
+bool BlockDecompressor::Recompress(Compressor *comp)
+{
+  bool success = true;
+
+  byte *buf = AllocAlignedBuffer(m_Index.blockSize);
+
+  while(success && m_Position < m_Index.uncompressedSize)
+  {
+    uint64_t len = RDCMIN(m_Index.blockSize, m_Index.uncompressedSize - m_Position);
+
+    success &= Read(buf, len);
+    if(success)
+      success &= comp->Write(buf, len);
+  }
+
+  FreeAlignedBuffer(buf);
+
+  success &= comp->Finish();
+
+  return success;
+}
+
+bool BlockDecompressor::Read(void *data, uint64_t numBytes)
+{
+  if(m_Error)
+    return false;
+
+  byte *dst = (byte *)data;
+
+  while(numBytes > 0)
+  {
+    // move past the current block once it's consumed
+    if(!m_Window.empty() && m_BlockOffset == m_Window[0]->dstSize)
+    {
+      m_FreeBlocks.push_back(m_Window[0]);
+      m_Window.erase(0);
+      m_BlockOffset = 0;
+    }
+
+    // once there's no read-ahead pending, whole blocks can go straight into the destination.
+    if(m_Window.empty() && m_BlockOffset == 0 && m_NextBlock < m_Index.blockOffsets.size() &&
+       numBytes >= GetBlockSize(m_NextBlock))
+    {
+      if(!DecompressDirect(dst, numBytes))
+        return false;
+
+      continue;
+    }
+
+    if(!QueueBlocks())
+      return false;
+
+    if(m_Window.empty())
+    {
+      RDCERR("Reading %llu bytes past the end of the stream", numBytes);
+      m_Error = true;
+      return false;
+    }
+
+    Block *b = m_Window[0];
+
+    if(b->job)
+    {
+      JobSystem::SyncJob(b->job);
+      b->job = NULL;
+    }
+
+    if(!b->success)
+    {
+      RDCERR("Error decompressing block %u", b->index);
+      m_Error = true;
+      return false;
+    }
+
+    uint64_t copySize = RDCMIN(numBytes, b->dstSize - m_BlockOffset);
+    memcpy(dst, b->dst + m_BlockOffset, (size_t)copySize);
+
+    dst += copySize;
+    m_BlockOffset += copySize;
+    m_Position += copySize;
+    numBytes -= copySize;
+  }
+
+  return true;
+}
+
+bool BlockDecompressor::Seek(uint64_t offs)
+{
+  if(m_Error || offs > m_Index.uncompressedSize)
+    return false;
+
+  uint32_t index = uint32_t(offs / m_Index.blockSize);
+
+  // drop any blocks before the target, keeping the read-ahead if we're seeking forward into it
+  while(!m_Window.empty() && m_Window[0]->index < index)
+  {
+    Block *b = m_Window[0];
+    if(b->job)
+      JobSystem::SyncJob(b->job);
+    b->job = NULL;
+
+    m_FreeBlocks.push_back(b);
+    m_Window.erase(0);
+  }
+
+  if(m_Window.empty() || m_Window[0]->index != index)
+  {
+    ReleaseBlocks();
+    m_NextBlock = index;
+  }
+
+  m_Position = offs;
+  m_BlockOffset = offs - uint64_t(index) * m_Index.blockSize;
+
+  return true;
+}
+
 static const uint64_t initialBufferSize = 64 * 1024;
 const byte StreamWriter::empty[128] = {};
+const uint32_t BlockIndex::Magic;
+const uint32_t BlockIndex::Version;
 
 StreamReader::StreamReader(const byte *buffer, uint64_t bufferSize)
 {
@@ -114,6 +582,7 @@ StreamReader::StreamReader(FILE *file, uint64_t fileSize, Ownership own)
   }
 
   m_File = file;
+  m_FileBase = FileIO::ftell64(file);
   m_InputSize = fileSize;
 
   m_BufferSize = initialBufferSize;
@@ -153,12 +622,107 @@ StreamReader::StreamReader(FILE *file)
 
 StreamReader::StreamReader(StreamReader *reader, uint64_t bufferSize)
 {
+  m_Ownership = Ownership::Nothing;
+
+  // if the source is mapped, point into its mapping instead of copying
+  if(reader->m_Mapping && !reader->m_HasError &&
+     reader->GetOffset() + bufferSize <= reader->GetSize())
+  {
+    m_Mapping = reader->m_Mapping;
+    Atomic::Inc32(&m_Mapping->refCount);
+
+    m_InputSize = m_BufferSize = bufferSize;
+    m_BufferHead = m_BufferBase = reader->m_BufferHead;
+
+    reader->m_BufferHead += bufferSize;
+    return;
+  }
+
+  // large amounts of data can be cached on disk and mapped, so that the OS can page it out.
+  uint64_t cacheThreshold = uint64_t(Replay_FrameCacheFileMB) * 1024 * 1024;
+  if(cacheThreshold > 0 && bufferSize >= cacheThreshold && !reader->m_Dummy &&
+     ReadToCacheFile(reader, bufferSize))
+    return;
+
   m_InputSize = m_BufferSize = bufferSize;
   m_BufferHead = m_BufferBase = AllocAlignedBuffer(m_BufferSize);
 
   reader->Read(m_BufferBase, bufferSize);
+}
+
+bool StreamReader::ReadToCacheFile(StreamReader *reader, uint64_t length)
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() +
+                    StringFormat::Fmt("renderdoc_cache_%u_%llu.bin", Process::GetCurrentPID(),
+                                      Timing::GetTick());
 
+  FILE *f = FileIO::fopen(filename.c_str(), "w+b");
+
+  if(f == NULL)
+  {
+    RDCWARN("Couldn't open cache file '%s', reading %llu bytes into memory", filename.c_str(),
+            length);
+    return false;
+  }
+
+  // copy across in pieces so we never hold all of the data in memory
+  const uint64_t chunkSize = 4 * 1024 * 1024;
+  byte *buf = AllocAlignedBuffer(chunkSize);
+
+  bool success = true;
+
+  for(uint64_t offs = 0; success && offs < length; offs += chunkSize)
+  {
+    uint64_t len = RDCMIN(chunkSize, length - offs);
+
+    success &= reader->Read(buf, len);
+    success &= (FileIO::fwrite(buf, 1, (size_t)len, f) == len);
+  }
+
+  FreeAlignedBuffer(buf);
+
+  FileIO::FileMapping *mapping = success ? FileIO::MapFile(f, 0, length) : NULL;
+
+  FileIO::fclose(f);
+
+  if(mapping == NULL)
+  {
+    // the source has been consumed so we can't fall back to reading into memory
+    RDCERR("Couldn't cache %llu bytes to '%s'", length, filename.c_str());
+    FileIO::Delete(filename.c_str());
+
+    m_InputSize = m_BufferSize = 0;
+    m_BufferHead = m_BufferBase = NULL;
+    m_HasError = true;
+    return true;
+  }
+
+  RDCLOG("Cached %llu bytes to '%s'", length, filename.c_str());
+
+  InitMapping(mapping, length, filename);
+  return true;
+}
+
+StreamReader::StreamReader(FileIO::FileMapping *mapping, uint64_t size)
+{
   m_Ownership = Ownership::Nothing;
+
+  InitMapping(mapping, size, rdcstr());
+}
+
+void StreamReader::InitMapping(FileIO::FileMapping *mapping, uint64_t size,
+                               const rdcstr &deleteFilename)
+{
+  m_Mapping = new SharedMapping;
+  m_Mapping->mapping = mapping;
+  m_Mapping->refCount = 1;
+  m_Mapping->deleteFilename = deleteFilename;
+
+  m_InputSize = m_BufferSize = size;
+
+  // the mapping is read-only, which is fine as we never write through m_BufferBase when reading
+  // from memory.
+  m_BufferHead = m_BufferBase = (byte *)FileIO::GetMappedData(mapping);
 }
 
 StreamReader::StreamReader(Decompressor *decompressor, uint64_t uncompressedSize, Ownership own)
@@ -179,7 +743,22 @@ StreamReader::~StreamReader()
   for(StreamCloseCallback cb : m_Callbacks)
     cb();
 
-  FreeAlignedBuffer(m_BufferBase);
+  if(m_Mapping)
+  {
+    if(Atomic::Dec32(&m_Mapping->refCount) == 0)
+    {
+      FileIO::UnmapFile(m_Mapping->mapping);
+
+      if(!m_Mapping->deleteFilename.empty())
+        FileIO::Delete(m_Mapping->deleteFilename.c_str());
+
+      delete m_Mapping;
+    }
+  }
+  else
+  {
+    FreeAlignedBuffer(m_BufferBase);
+  }
 
   if(m_Ownership == Ownership::Stream)
   {
@@ -195,7 +774,39 @@ void StreamReader::SetOffset(uint64_t offs)
 {
   if(m_File || m_Decompressor)
   {
-    RDCERR("File and decompress stream readers do not support seeking");
+    if(m_HasError)
+      return;
+
+    if(offs > m_InputSize)
+    {
+      RDCERR("Seeking to %llu past the end of the stream at %llu", offs, m_InputSize);
+      return;
+    }
+
+    // if the offset is ahead of us in our window, just move to it. Data behind the head isn't
+    // guaranteed to be valid after a large read.
+    uint64_t windowSize = RDCMIN(m_BufferSize, m_InputSize - m_ReadOffset);
+    if(offs >= GetOffset() && offs <= m_ReadOffset + windowSize)
+    {
+      m_BufferHead = m_BufferBase + (offs - m_ReadOffset);
+      return;
+    }
+
+    if(m_File)
+    {
+      FileIO::fseek64(m_File, m_FileBase + offs, SEEK_SET);
+    }
+    else if(!m_Decompressor->Seek(offs))
+    {
+      RDCERR("Decompressor does not support seeking");
+      return;
+    }
+
+    // refill the window from the new offset
+    m_ReadOffset = offs;
+    m_BufferHead = m_BufferBase;
+
+    ReadFromExternal(m_BufferBase, RDCMIN(m_BufferSize, m_InputSize - offs));
     return;
   }
 
@@ -317,6 +928,10 @@ bool StreamReader::ReadLargeBuffer(void *buffer, uint64_t length)
         m_BufferBase = AllocAlignedBuffer(m_BufferSize);
       }
 
+      // sockets must not read ahead into the buffer we're discarding into
+      if(m_Sock)
+        m_InputSize = m_BufferSize;
+
       while(directReadLength > 0)
       {
         uint64_t chunkRead = RDCMIN(m_BufferSize, directReadLength);
@@ -346,6 +961,10 @@ bool StreamReader::ReadLargeBuffer(void *buffer, uint64_t length)
   // set the head to *after* where we're reading, this is where it'll end up after the read.
   m_BufferHead = m_BufferBase + m_BufferSize;
 
+  // for sockets the buffer will then be full of valid data, ending at the head
+  if(m_Sock)
+    m_InputSize = m_BufferSize - 128;
+
   // read the 128 bytes
   m_ReadOffset += 128;
   bool ret = ReadFromExternal(m_BufferHead - 128, 128);
@@ -386,7 +1005,9 @@ bool StreamReader::ReadFromExternal(void *buffer, uint64_t length)
 
       success = m_Sock->RecvDataBlocking(readDest, (uint32_t)length);
 
-      if(success)
+      // only reads that append to the data in our buffer can read ahead. Large reads go directly
+      // into the destination, and reading ahead there would overrun it.
+      if(success && readDest == m_BufferBase + m_InputSize)
       {
         m_InputSize += length;
         readDest += length;
@@ -515,34 +1136,45 @@ StreamWriter::~StreamWriter()
 bool StreamWriter::SendSocketData(const void *data, uint64_t numBytes)
 {
   // try to coalesce small writes without doing blocking sends, at least until we're flushed.
-  // if the buffer is already full, flush it.
-  if(m_BufferHead + numBytes >= m_BufferEnd)
+  if(m_BufferHead + numBytes < m_BufferEnd)
   {
-    bool success = FlushSocketData();
-    if(!success)
-    {
-      HandleError();
-      return false;
-    }
+    memcpy(m_BufferHead, data, (size_t)numBytes);
+    m_BufferHead += numBytes;
+    return true;
   }
 
-  // if it's larger than our buffer (even after flushing) just write directly
-  if(m_BufferHead + numBytes >= m_BufferEnd)
+  // if it's larger than our buffer, write it directly. Anything already buffered goes out in the
+  // same gathered send instead of needing its own flush first.
+  if(m_BufferBase + numBytes >= m_BufferEnd)
   {
-    bool success = m_Sock->SendDataBlocking(data, (uint32_t)numBytes);
+    Network::SendBuffer bufs[] = {
+        {m_BufferBase, uint32_t(m_BufferHead - m_BufferBase)},
+        {data, (uint32_t)numBytes},
+    };
+
+    bool success = m_Sock->SendDataBlocking(bufs, ARRAY_COUNT(bufs));
     if(!success)
     {
       HandleError();
       return false;
     }
+
+    m_BufferHead = m_BufferBase;
+
+    return true;
   }
-  else
+
+  // otherwise the buffer is full, so flush it and write into it
+  bool success = FlushSocketData();
+  if(!success)
   {
-    // otherwise, write it into the in-memory buffer
-    memcpy(m_BufferHead, data, (size_t)numBytes);
-    m_BufferHead += numBytes;
+    HandleError();
+    return false;
   }
 
+  memcpy(m_BufferHead, data, (size_t)numBytes);
+  m_BufferHead += numBytes;
+
   return true;
 }
 
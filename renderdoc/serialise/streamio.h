@@ -38,6 +38,11 @@ enum class Ownership
 class StreamWriter;
 class StreamReader;
 
+namespace JobSystem
+{
+struct Job;
+};
+
 typedef std::function<void()> StreamCloseCallback;
 
 class Compressor
@@ -53,6 +58,85 @@ protected:
   Ownership m_Ownership;
 };
 
+// describes where each independently compressed block starts, so that a BlockDecompressor can
+// decompress several blocks at once or start reading from any block.
+struct BlockIndex
+{
+  uint64_t uncompressedSize = 0;
+  uint64_t blockSize = 0;
+
+  // offset of each block's size prefix, relative to the start of the compressed stream
+  rdcarray<uint64_t> blockOffsets;
+
+  // when written after the blocks, the offsets are followed by this footer which ends the stream.
+  struct Footer
+  {
+    uint64_t uncompressedSize;
+    uint64_t blockSize;
+    uint64_t numBlocks;
+    uint32_t version;
+    uint32_t magic;
+  };
+
+  static const uint32_t Magic = MAKE_FOURCC('B', 'I', 'D', 'X');
+  static const uint32_t Version = 1;
+
+  // the size on disk of the offsets and footer
+  uint64_t GetSerialisedSize() const { return blockOffsets.byteSize() + sizeof(Footer); }
+};
+
+// base class for compressors that split the stream into fixed-size independent blocks and compress
+// several at once on the job system. Blocks are still written in order, each prefixed with its
+// uint32_t compressed size, so they can be read by the same Decompressor as a serial stream.
+// If writeIndex is true a BlockIndex is appended after the last block on Finish().
+class BlockCompressor : public Compressor
+{
+public:
+  BlockCompressor(StreamWriter *write, Ownership own, uint64_t blockSize, uint64_t compressBound,
+                  bool writeIndex);
+  virtual ~BlockCompressor();
+
+  bool Write(const void *data, uint64_t numBytes);
+  bool Finish();
+
+protected:
+  // compresses srcSize bytes from src into dst, which has room for compressBound bytes. This is
+  // called concurrently from several threads. Returns the compressed size, or 0 on failure.
+  virtual uint64_t CompressBlock(const byte *src, uint64_t srcSize, byte *dst) = 0;
+
+  // waits for any in-flight blocks. Derived classes must call this in their destructor before
+  // destroying anything that CompressBlock uses.
+  void WaitForBlocks();
+
+private:
+  struct Block
+  {
+    byte *src = NULL;
+    uint64_t srcSize = 0;
+    byte *dst = NULL;
+    uint64_t dstSize = 0;
+    JobSystem::Job *job = NULL;
+  };
+
+  bool SubmitBlock();
+  bool RetireBlock();
+
+  uint64_t m_BlockSize;
+  uint64_t m_CompressBound;
+  size_t m_MaxInFlight;
+
+  Block *m_Current = NULL;
+  rdcarray<Block *> m_InFlight;
+  rdcarray<Block *> m_FreeBlocks;
+
+  bool m_WriteIndex;
+  uint64_t m_BaseOffset;
+  BlockIndex m_Index;
+
+  bool m_Finished = false;
+  bool m_Error = false;
+};
+
 class Decompressor
 {
 public:
@@ -61,11 +145,80 @@ public:
   virtual bool Recompress(Compressor *comp) = 0;
   virtual bool Read(void *data, uint64_t numBytes) = 0;
 
+  // moves to the given uncompressed offset, if the decompressor supports random access.
+  virtual bool Seek(uint64_t offs) { return false; }
+
 protected:
   StreamReader *m_Read;
   Ownership m_Ownership;
 };
 
+// reads a stream written by a BlockCompressor with an index. Blocks ahead of the read position are
+// decompressed on the job system, large reads are decompressed straight into the destination in
+// parallel, and Seek() only needs to decompress the block containing the new offset.
+// The reader must be limited to the blocks themselves, not the index after them, and must support
+// SetOffset() for seeking.
+class BlockDecompressor : public Decompressor
+{
+public:
+  BlockDecompressor(StreamReader *read, Ownership own, const BlockIndex &index,
+                    uint64_t compressBound);
+  virtual ~BlockDecompressor();
+
+  bool Recompress(Compressor *comp);
+  bool Read(void *data, uint64_t numBytes);
+  bool Seek(uint64_t offs);
+
+protected:
+  // decompresses srcSize bytes from src into exactly dstSize bytes at dst. This is called
+  // concurrently from several threads. Returns false on failure.
+  virtual bool DecompressBlock(const byte *src, uint64_t srcSize, byte *dst, uint64_t dstSize) = 0;
+
+  // waits for any in-flight blocks. Derived classes must call this in their destructor before
+  // destroying anything that DecompressBlock uses.
+  void WaitForBlocks();
+
+  bool m_Error = false;
+
+private:
+  struct Block
+  {
+    uint32_t index = 0;
+    byte *src = NULL;
+    uint64_t srcSize = 0;
+    byte *dst = NULL;
+    uint64_t dstSize = 0;
+    bool success = false;
+    JobSystem::Job *job = NULL;
+  };
+
+  uint64_t GetBlockSize(uint32_t index) const
+  {
+    return RDCMIN(m_Index.blockSize, m_Index.uncompressedSize - index * m_Index.blockSize);
+  }
+
+  Block *AllocBlock();
+  bool ReadCompressedBlock(Block *b);
+  bool QueueBlocks();
+  bool DecompressDirect(byte *&dst, uint64_t &numBytes);
+  void ReleaseBlocks();
+
+  BlockIndex m_Index;
+  uint64_t m_CompressBound;
+  size_t m_MaxInFlight;
+
+  // the next block to read from m_Read
+  uint32_t m_NextBlock = 0;
+
+  // uncompressed position in the stream, and in the first block in m_Window
+  uint64_t m_Position = 0;
+  uint64_t m_BlockOffset = 0;
+
+  // blocks queued for or finished decompression, in order starting from the current one
+  rdcarray<Block *> m_Window;
+  rdcarray<Block *> m_FreeBlocks;
+};
+
 class StreamReader
 {
 public:
@@ -89,6 +242,10 @@ public:
   StreamReader(StreamReader *reader, uint64_t bufferSize);
   StreamReader(Decompressor *decompressor, uint64_t uncompressedSize, Ownership own);
 
+  // reads directly from a file mapping, which the reader takes ownership of. Readers created from
+  // this one share the mapping rather than copying the data.
+  StreamReader(FileIO::FileMapping *mapping, uint64_t size);
+
   ~StreamReader();
 
   bool IsErrored() { return m_HasError; }
@@ -239,6 +396,18 @@ private:
   bool Reserve(uint64_t numBytes);
   bool ReadLargeBuffer(void *buffer, uint64_t length);
   bool ReadFromExternal(void *buffer, uint64_t length);
+  bool ReadToCacheFile(StreamReader *reader, uint64_t length);
+
+  // a file mapping that m_BufferBase points into, shared between readers
+  struct SharedMapping
+  {
+    FileIO::FileMapping *mapping;
+    int32_t refCount;
+    // a temporary file to delete once the mapping is released
+    rdcstr deleteFilename;
+  };
+
+  void InitMapping(FileIO::FileMapping *mapping, uint64_t size, const rdcstr &deleteFilename);
 
   // base of the buffer allocation
   byte *m_BufferBase;
@@ -257,12 +426,18 @@ private:
   // file pointer, if we're reading from a file
   FILE *m_File = NULL;
 
+  // the position in m_File where the stream starts, for seeking
+  uint64_t m_FileBase = 0;
+
   // socket, if we're reading from a socket
   Network::Socket *m_Sock = NULL;
 
   // the decompressor, if reading from it
   Decompressor *m_Decompressor = NULL;
 
+  // the file mapping, if we're reading from one. This is otherwise treated as reading from memory
+  SharedMapping *m_Mapping = NULL;
+
   // the offset in the file/decompressor that corresponds to the start of m_BufferBase
   uint64_t m_ReadOffset = 0;
 
@@ -462,6 +637,14 @@ public:
     return true;
   }
 
+  // while corked, a socket stream holds back partial packets so that a run of small flushed
+  // writes goes out together. Uncorking sends anything held back.
+  void SetCork(bool cork)
+  {
+    if(m_Sock)
+      m_Sock->SetCork(cork);
+  }
+
   void AddCloseCallback(StreamCloseCallback callback) { m_Callbacks.push_back(callback); }
 private:
   inline void EnsureSized(const uint64_t numBytes)
@@ -471,9 +654,11 @@ private:
 
     if(bufferSize < newSize)
     {
-      // reallocate to a conservative size, don't 'double and allocate'
+      // reallocate to a conservative size, don't 'double and allocate'. Large buffers (e.g. a whole
+      // frame capture gathered in memory for background writing) grow proportionally so that we
+      // don't copy the contents over and over.
       while(bufferSize < newSize)
-        bufferSize += 128 * 1024;
+        bufferSize += RDCMAX((uint64_t)128 * 1024, bufferSize / 4);
 
       byte *newBuf = AllocAlignedBuffer(bufferSize);
 
@@ -94,6 +94,110 @@ TEST_CASE("Test basic stream I/O operations", "[streamio]")
   CHECK(reader.IsErrored());
 };
 
+TEST_CASE("Test file and memory-mapped stream I/O", "[streamio]")
+{
+  rdcstr filename = FileIO::GetTempFolderFilename() + "renderdoc_streamio_test.bin";
+
+  const uint64_t size = 1024 * 1024 + 17;
+
+  rdcarray<uint32_t> data;
+  data.resize(size / sizeof(uint32_t) + 1);
+  for(size_t i = 0; i < data.size(); i++)
+    data[i] = uint32_t(i * 2654435761U);
+
+  REQUIRE(FileIO::WriteAll(filename, data.data(), (size_t)size));
+
+  const byte *bytes = (const byte *)data.data();
+
+  // deliberately not aligned to anything
+  const uint64_t offset = 12345;
+  const uint64_t length = size - offset - 99;
+
+  SECTION("Seeking a file reader")
+  {
+    FILE *f = FileIO::fopen(filename.c_str(), "rb");
+    REQUIRE(f);
+
+    FileIO::fseek64(f, offset, SEEK_SET);
+
+    StreamReader reader(f, length, Ownership::Stream);
+
+    byte buf[256];
+
+    const uint64_t offsets[] = {500000, 100, 120, 0, length - 256, 70000};
+
+    for(uint64_t offs : offsets)
+    {
+      reader.SetOffset(offs);
+      CHECK(reader.GetOffset() == offs);
+
+      reader.Read(buf, sizeof(buf));
+      CHECK_FALSE(memcmp(buf, bytes + offset + offs, sizeof(buf)));
+    }
+
+    CHECK_FALSE(reader.IsErrored());
+  };
+
+  SECTION("Mapped reader")
+  {
+    FILE *f = FileIO::fopen(filename.c_str(), "rb");
+    REQUIRE(f);
+
+    FileIO::FileMapping *mapping = FileIO::MapFile(f, offset, length);
+
+    // the mapping remains valid after the file is closed
+    FileIO::fclose(f);
+
+    REQUIRE(mapping);
+
+    StreamReader *reader = new StreamReader(mapping, length);
+
+    CHECK(reader->GetSize() == length);
+
+    uint32_t val = 0;
+    reader->Read(val);
+    CHECK_FALSE(memcmp(&val, bytes + offset, sizeof(val)));
+
+    reader->SetOffset(1000);
+
+    // a reader created from this one shares the mapping, and outlives it
+    StreamReader *sub = new StreamReader(reader, 200000);
+
+    CHECK(reader->GetOffset() == 201000);
+    CHECK_FALSE(reader->IsErrored());
+
+    delete reader;
+
+    rdcarray<byte> buf;
+    buf.resize(200000);
+    sub->Read(buf.data(), buf.size());
+    CHECK_FALSE(memcmp(buf.data(), bytes + offset + 1000, buf.size()));
+
+    CHECK(sub->AtEnd());
+    CHECK_FALSE(sub->IsErrored());
+
+    // reading off the end errors as with any memory reader
+    sub->Read(val);
+    CHECK(sub->IsErrored());
+
+    delete sub;
+  };
+
+  SECTION("Mapping past the end of the file fails")
+  {
+    FILE *f = FileIO::fopen(filename.c_str(), "rb");
+    REQUIRE(f);
+
+    // the caller falls back to reading the file, instead of faulting on the missing pages
+    CHECK(FileIO::MapFile(f, offset, size) == NULL);
+    CHECK(FileIO::MapFile(f, size + 4096, 100) == NULL);
+
+    FileIO::fclose(f);
+  };
+
+  FileIO::Delete(filename.c_str());
+};
+
 TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
 {
   uint16_t port = 8235;
@@ -302,6 +406,148 @@ TEST_CASE("Test stream I/O operations over the network", "[streamio][network]")
     CHECK(writer.IsErrored());
   };
 
+  SECTION("Gathered sends")
+  {
+    bytebuf data;
+    data.resize(1024 * 1024 + 17);
+    for(size_t i = 0; i < data.size(); i++)
+      data[i] = byte((i * 7) ^ (i >> 9));
+
+    uint32_t header = 0xfeedf00d;
+
+    bytebuf received;
+    received.resize(data.size() * 2 + 1 + sizeof(header));
+
+    Threading::ThreadHandle recvThread = Threading::CreateThread([receiver, &received]() {
+      receiver->RecvDataBlocking(received.data(), (uint32_t)received.size());
+    });
+
+    // directly gather a few buffers, including an empty one
+    Network::SendBuffer bufs[] = {
+        {data.data(), 5}, {data.data(), 0}, {data.data() + 5, (uint32_t)data.size() - 5},
+    };
+
+    CHECK(sender->SendDataBlocking(bufs, ARRAY_COUNT(bufs)));
+
+    // a small buffered write followed by a write too large for the stream's buffer goes out in
+    // one gathered send, and must still arrive in order.
+    {
+      StreamWriter writer(sender, Ownership::Nothing);
+      writer.Write(header);
+      writer.Write(data.data(), data.size());
+      writer.Write<byte>(0x42);
+      writer.Flush();
+
+      CHECK_FALSE(writer.IsErrored());
+    }
+
+    Threading::JoinThread(recvThread);
+    Threading::CloseThread(recvThread);
+
+    REQUIRE(receiver->Connected());
+
+    CHECK(memcmp(received.data(), data.data(), data.size()) == 0);
+
+    uint32_t receivedHeader = 0;
+    memcpy(&receivedHeader, received.data() + data.size(), sizeof(receivedHeader));
+    CHECK(receivedHeader == header);
+
+    CHECK(memcmp(received.data() + data.size() + sizeof(header), data.data(), data.size()) == 0);
+    CHECK(received.back() == 0x42);
+  };
+
+  SECTION("Waiting for data")
+  {
+    CHECK_FALSE(receiver->WaitForRecv(0));
+    CHECK_FALSE(receiver->WaitForRecv(10));
+
+    uint32_t val = 1234;
+    sender->SendDataBlocking(&val, sizeof(val));
+
+    CHECK(receiver->WaitForRecv(1000));
+
+    val = 0;
+    CHECK(receiver->RecvDataBlocking(&val, sizeof(val)));
+    CHECK(val == 1234);
+
+    CHECK_FALSE(receiver->WaitForRecv(0));
+
+    // the other end going away also wakes us up, so we find out on the next read
+    sender->Shutdown();
+
+    CHECK(receiver->WaitForRecv(1000));
+    CHECK_FALSE(receiver->RecvDataBlocking(&val, sizeof(val)));
+  };
+
+  delete sender;
+  delete receiver;
+  delete server;
+};
+
+TEST_CASE("Benchmark socket throughput over loopback", "[.][benchmark]")
+{
+  uint16_t port = 8255;
+  Network::Socket *server = NULL;
+
+  for(uint16_t probe = 0; probe < 20 && server == NULL; probe++)
+    server = Network::CreateServerSocket("localhost", port++, 2);
+
+  REQUIRE(server);
+
+  Network::Socket *sender = Network::CreateClientSocket("localhost", port - 1, 10);
+  REQUIRE(sender);
+
+  Network::Socket *receiver = server->AcceptClient(250);
+  REQUIRE(receiver);
+
+  const size_t size = 256 * 1024 * 1024;
+
+  bytebuf data;
+  data.resize(size);
+  for(size_t i = 0; i < size; i++)
+    data[i] = byte(i * 13);
+
+  bytebuf dest;
+  dest.resize(size);
+
+  StreamWriter writer(sender, Ownership::Nothing);
+  StreamReader reader(receiver, Ownership::Nothing);
+
+  // sends size bytes in writes of the given size, flushing every so often. Each flush is one
+  // socket send
+  auto transfer = [&](size_t writeSize, size_t flushSize) {
+    Threading::ThreadHandle recvThread =
+        Threading::CreateThread([&reader, &dest]() { reader.Read(dest.data(), dest.size()); });
+
+    size_t unflushed = 0;
+    for(size_t offs = 0; offs < size; offs += writeSize)
+    {
+      writer.Write(data.data() + offs, writeSize);
+      unflushed += writeSize;
+
+      if(unflushed >= flushSize)
+      {
+        writer.Flush();
+        unflushed = 0;
+      }
+    }
+    writer.Flush();
+
+    Threading::JoinThread(recvThread);
+    Threading::CloseThread(recvThread);
+  };
+
+  WARN("Sending " << size / (1024 * 1024)
+                  << "MB per run. Set Network.SocketBufferKB to measure buffer sizes.");
+
+  BENCHMARK("1MB writes") { transfer(1024 * 1024, 1024 * 1024); }
+  BENCHMARK("64KB writes") { transfer(64 * 1024, 64 * 1024); }
+  BENCHMARK("256 byte writes, flushed every 4KB") { transfer(256, 4 * 1024); }
+
+  CHECK_FALSE(writer.IsErrored());
+  CHECK_FALSE(reader.IsErrored());
+  CHECK(dest == data);
+
   delete sender;
   delete receiver;
   delete server;
@@ -0,0 +1,215 @@
+/******************************************************************************
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2019-2020 Baldur Karlsson
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ ******************************************************************************/
+
+#include "serialiser.h"
+#include "common/threading.h"
+#include "core/settings.h"
+
+RDOC_CONFIG(bool, Replay_LazyStructuredData, false,
+            "Store the parameters of each chunk in the structured data compactly after loading, "
+            "and only expand them when they are accessed. This reduces memory use for large "
+            "captures at the cost of some latency when first inspecting a chunk.");
+
+RDOC_CONFIG(uint64_t, Replay_LazyStructuredDataCacheSize, 1024,
+            "The number of chunks in lazily populated structured data that are kept populated at "
+            "once. The least recently accessed chunk past this limit is unpopulated again.");
+
+Threading::CriticalSection SDObjectLazyData::lock;
+SDObjectLazyData *SDObjectLazyData::head = NULL;
+SDObjectLazyData *SDObjectLazyData::tail = NULL;
+uint32_t SDObjectLazyData::numPopulated = 0;
+
+void SDObjectLazyData::Link()
+{
+  prev = NULL;
+  next = head;
+  if(head)
+    head->prev = this;
+  head = this;
+  if(!tail)
+    tail = this;
+}
+
+void SDObjectLazyData::Unlink()
+{
+  if(prev)
+    prev->next = next;
+  else
+    head = next;
+
+  if(next)
+    next->prev = prev;
+  else
+    tail = prev;
+
+  prev = next = NULL;
+}
+
+void SDObjectLazyData::Unpopulate()
+{
+  Unlink();
+
+  // the children can be decoded again, so only the objects need to be deleted
+  for(SDObject *child : obj->data.children)
+    delete child;
+  obj->data.children.clear();
+
+  populated = false;
+  numPopulated--;
+}
+
+void SDObjectLazyData::MakeLazy(SDObject *obj)
+{
+  if(obj->m_Lazy || obj->data.children.empty())
+    return;
+
+  SDObjectLazyData *lazy = new SDObjectLazyData;
+  lazy->obj = obj;
+
+  {
+    WriteSerialiser ser(new StreamWriter(4 * 1024), Ownership::Stream);
+    ser.Serialise("children"_lit, obj->data.children);
+    lazy->children.assign(ser.GetWriter()->GetData(), (size_t)ser.GetWriter()->GetOffset());
+  }
+
+  for(SDObject *child : obj->data.children)
+    delete child;
+  obj->data.children.clear();
+
+  obj->m_Lazy = lazy;
+}
+
+void SDObjectLazyData::MakeLazy(SDObject *obj, LazyChunkSource *source, uint64_t offset)
+{
+  if(obj->m_Lazy)
+    return;
+
+  SDObjectLazyData *lazy = new SDObjectLazyData;
+  lazy->obj = obj;
+  lazy->source = source;
+  lazy->offset = offset;
+
+  source->AddRef();
+
+  obj->m_Lazy = lazy;
+}
+
+void SDObjectLazyData::Populate(SDObject *obj, bool keep)
+{
+  SCOPED_LOCK(lock);
+
+  SDObjectLazyData *lazy = obj->m_Lazy;
+
+  if(!lazy)
+    return;
+
+  if(lazy->populated)
+  {
+    // move to the front of the list as the most recently used
+    if(head != lazy)
+    {
+      lazy->Unlink();
+      lazy->Link();
+    }
+  }
+  else
+  {
+    // the children are deserialised without an arena, so they are individual heap allocations
+    if(lazy->source)
+    {
+      if(!lazy->source->DecodeChunk(lazy->offset, obj->data.children))
+        RDCERR("Couldn't decode lazy structured data for %s", obj->name.c_str());
+    }
+    else
+    {
+      ReadSerialiser ser(new StreamReader(lazy->children.data(), lazy->children.size()),
+                         Ownership::Stream);
+      ser.Serialise("children"_lit, obj->data.children);
+    }
+
+    lazy->populated = true;
+    lazy->Link();
+    numPopulated++;
+
+    // the object we just populated is at the head, so it will never be evicted here
+    const uint64_t maxPopulated = RDCMAX((uint64_t)1, Replay_LazyStructuredDataCacheSize);
+    while(numPopulated > maxPopulated && tail != lazy)
+      tail->Unpopulate();
+  }
+
+  if(keep)
+  {
+    lazy->Unlink();
+    numPopulated--;
+    obj->m_Lazy = NULL;
+    if(lazy->source)
+      lazy->source->Release();
+    delete lazy;
+  }
+}
+
+void SDObjectLazyData::Release(SDObject *obj)
+{
+  SCOPED_LOCK(lock);
+
+  SDObjectLazyData *lazy = obj->m_Lazy;
+
+  if(!lazy)
+    return;
+
+  if(lazy->populated)
+  {
+    lazy->Unlink();
+    numPopulated--;
+  }
+
+  if(lazy->source)
+    lazy->source->Release();
+
+  obj->m_Lazy = NULL;
+  delete lazy;
+}
+
+uint32_t SDObjectLazyData::GetNumPopulated()
+{
+  SCOPED_LOCK(lock);
+  return numPopulated;
+}
+
+bool IsStructuredDataLazy()
+{
+  return Replay_LazyStructuredData;
+}
+
+void MakeStructuredFileLazy(SDFile &file)
+{
+  for(SDChunk *chunk : file.chunks)
+  {
+    // opaque chunks only have a buffer reference as their single child, it's not worth it
+    if(chunk->metadata.flags & SDChunkFlags::OpaqueChunk)
+      continue;
+
+    SDObjectLazyData::MakeLazy(chunk);
+  }
+}
@@ -194,6 +194,52 @@ bool ZSTDCompressor::CompressZSTDFrame(ZSTD_inBuffer &in, ZSTD_outBuffer &out)
   return true;
 }
 
+ZSTDParallelCompressor::ZSTDParallelCompressor(StreamWriter *write, Ownership own, bool writeIndex)
+    : BlockCompressor(write, own, zstdBlockSize, compressBlockSize, writeIndex)
+{
+}
+
+ZSTDParallelCompressor::~ZSTDParallelCompressor()
+{
+  WaitForBlocks();
+
+  for(ZSTD_CCtx *ctx : m_Contexts)
+    ZSTD_freeCCtx(ctx);
+}
+
+uint64_t ZSTDParallelCompressor::CompressBlock(const byte *src, uint64_t srcSize, byte *dst)
+{
+  ZSTD_CCtx *ctx = NULL;
+
+  {
+    SCOPED_LOCK(m_ContextLock);
+    if(!m_Contexts.empty())
+    {
+      ctx = m_Contexts.back();
+      m_Contexts.pop_back();
+    }
+  }
+
+  if(ctx == NULL)
+    ctx = ZSTD_createCCtx();
+
+  // use the same compression level as ZSTDCompressor
+  size_t compSize = ZSTD_compressCCtx(ctx, dst, compressBlockSize, src, (size_t)srcSize, 7);
+
+  {
+    SCOPED_LOCK(m_ContextLock);
+    m_Contexts.push_back(ctx);
+  }
+
+  if(ZSTD_isError(compSize))
+  {
+    RDCERR("Error compressing: %s", ZSTD_getErrorName(compSize));
+    return 0;
+  }
+
+  return compSize;
+}
+
 ZSTDDecompressor::ZSTDDecompressor(StreamReader *read, Ownership own) : Decompressor(read, own)
 {
   m_Page = AllocAlignedBuffer(zstdBlockSize);
@@ -343,3 +389,61 @@ bool ZSTDDecompressor::FillPage()
 
   return success;
 }
+
+ZSTDBlockDecompressor::ZSTDBlockDecompressor(StreamReader *read, Ownership own,
+                                             const BlockIndex &index)
+    : BlockDecompressor(read, own, index, compressBlockSize)
+{
+  if(index.blockSize != zstdBlockSize)
+  {
+    RDCERR("Unexpected ZSTD block size %llu", index.blockSize);
+    m_Error = true;
+  }
+}
+
+ZSTDBlockDecompressor::~ZSTDBlockDecompressor()
+{
+  WaitForBlocks();
+
+  for(ZSTD_DCtx *ctx : m_Contexts)
+    ZSTD_freeDCtx(ctx);
+}
+
+bool ZSTDBlockDecompressor::DecompressBlock(const byte *src, uint64_t srcSize, byte *dst,
+                                            uint64_t dstSize)
+{
+  ZSTD_DCtx *ctx = NULL;
+
+  {
+    SCOPED_LOCK(m_ContextLock);
+    if(!m_Contexts.empty())
+    {
+      ctx = m_Contexts.back();
+      m_Contexts.pop_back();
+    }
+  }
+
+  if(ctx == NULL)
+    ctx = ZSTD_createDCtx();
+
+  size_t decompSize = ZSTD_decompressDCtx(ctx, dst, (size_t)dstSize, src, (size_t)srcSize);
+
+  {
+    SCOPED_LOCK(m_ContextLock);
+    m_Contexts.push_back(ctx);
+  }
+
+  if(ZSTD_isError(decompSize))
+  {
+    RDCERR("Error decompressing: %s", ZSTD_getErrorName(decompSize));
+    return false;
+  }
+
+  if(decompSize != dstSize)
+  {
+    RDCERR("Decompressed frame to %zu bytes, expected %llu", decompSize, dstSize);
+    return false;
+  }
+
+  return true;
+}
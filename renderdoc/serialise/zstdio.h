@@ -24,6 +24,7 @@
 
 #pragma once
 
+#include "common/threading.h"
 #include "zstd/zstd.h"
 #include "streamio.h"
 
@@ -48,6 +49,22 @@ private:
   ZSTD_CStream *m_Stream;
 };
 
+// writes the same frames as ZSTDCompressor, with several compressed in parallel.
+class ZSTDParallelCompressor : public BlockCompressor
+{
+public:
+  ZSTDParallelCompressor(StreamWriter *write, Ownership own, bool writeIndex = false);
+  ~ZSTDParallelCompressor();
+
+protected:
+  uint64_t CompressBlock(const byte *src, uint64_t srcSize, byte *dst);
+
+private:
+  // contexts are expensive to create, so they're recycled between blocks
+  Threading::CriticalSection m_ContextLock;
+  rdcarray<ZSTD_CCtx *> m_Contexts;
+};
+
 class ZSTDDecompressor : public Decompressor
 {
 public:
@@ -67,3 +84,18 @@ private:
 
   ZSTD_DStream *m_Stream;
 };
+
+// reads a stream from ZSTDParallelCompressor with its index, decompressing frames in parallel.
+class ZSTDBlockDecompressor : public BlockDecompressor
+{
+public:
+  ZSTDBlockDecompressor(StreamReader *read, Ownership own, const BlockIndex &index);
+  ~ZSTDBlockDecompressor();
+
+protected:
+  bool DecompressBlock(const byte *src, uint64_t srcSize, byte *dst, uint64_t dstSize);
+
+private:
+  Threading::CriticalSection m_ContextLock;
+  rdcarray<ZSTD_DCtx *> m_Contexts;
+};
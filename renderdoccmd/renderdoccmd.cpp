@@ -459,6 +459,7 @@ private:
   std::string host;
   bool daemon = false;
   bool preview = false;
+  uint32_t sessions = 0;
 
 public:
   RemoteServerCommand() : Command() {}
@@ -468,6 +469,11 @@ public:
     parser.add<std::string>(
         "host", 'h', "The interface to listen on. By default listens on all interfaces", false, "");
     parser.add("preview", 'v', "Display a preview window when a replay is active.");
+    parser.add<uint32_t>("sessions", '\0',
+                         "How many clients can have a replay session at once. Others are told "
+                         "the server is busy, unless they have set RemoteServer_QueueWaitMS to "
+                         "wait in a queue for a free session.",
+                         false, 0);
   }
   virtual const char *Description()
   {
@@ -481,6 +487,7 @@ public:
     host = parser.get<std::string>("host");
     daemon = parser.exist("daemon");
     preview = parser.exist("preview");
+    sessions = parser.get<uint32_t>("sessions");
     return true;
   }
   virtual int Execute(const CaptureOptions &)
@@ -496,6 +503,13 @@ public:
 
     usingKillSignal = true;
 
+    if(sessions > 0)
+    {
+      SDObject *setting = RENDERDOC_SetConfigSetting("RemoteServer_MaxSessions");
+      if(setting)
+        setting->data.basic.u = sessions;
+    }
+
     // by default have a do-nothing callback that creates no windows
     RENDERDOC_PreviewWindowCallback previewWindow;
 
@@ -642,6 +656,185 @@ public:
   }
 };
 
+struct TexExportCommand : public Command
+{
+private:
+  std::string infile;
+  std::string outdir;
+  std::string format;
+  uint32_t eventId = 0;
+  bool allSubresources = false;
+
+public:
+  TexExportCommand() : Command() {}
+  virtual void AddOptions(cmdline::parser &parser)
+  {
+    parser.set_footer("<capture.rdc>");
+    parser.add<std::string>("out", 'o', "The directory to save the textures to.", true);
+    parser.add<std::string>("format", 'f', "The format to save the textures in.", false, "png",
+                            cmdline::oneof<std::string>("dds", "png", "jpg", "bmp", "tga", "hdr",
+                                                        "exr"));
+    parser.add<uint32_t>("event", 'e',
+                         "The event to save the textures' contents at. Default is 0, which is the "
+                         "last event in the capture.",
+                         false, 0);
+    parser.add("all-subresources", 'a',
+               "Save every mip and slice to its own file. Otherwise only the first mip and slice "
+               "are saved, except for dds which always contains every subresource.");
+  }
+  virtual const char *Description()
+  {
+    return "Replay a capture and save the contents of every texture to disk.";
+  }
+  virtual bool IsInternalOnly() { return false; }
+  virtual bool IsCaptureCommand() { return false; }
+  virtual bool Parse(cmdline::parser &parser, GlobalEnvironment &)
+  {
+    std::vector<std::string> rest = parser.rest();
+    if(rest.empty())
+    {
+      std::cerr << "Error: texexport command requires a capture filename." << std::endl
+                << std::endl
+                << parser.usage();
+      return false;
+    }
+
+    infile = rest[0];
+
+    rest.erase(rest.begin());
+
+    parser.set_rest(rest);
+
+    outdir = parser.get<std::string>("out");
+    format = parser.get<std::string>("format");
+    eventId = parser.get<uint32_t>("event");
+    allSubresources = parser.exist("all-subresources");
+
+    return true;
+  }
+  virtual int Execute(const CaptureOptions &)
+  {
+    FileType type = FileType::PNG;
+
+    if(format == "dds")
+      type = FileType::DDS;
+    else if(format == "jpg")
+      type = FileType::JPG;
+    else if(format == "bmp")
+      type = FileType::BMP;
+    else if(format == "tga")
+      type = FileType::TGA;
+    else if(format == "hdr")
+      type = FileType::HDR;
+    else if(format == "exr")
+      type = FileType::EXR;
+
+    ICaptureFile *file = RENDERDOC_OpenCaptureFile();
+
+    if(file->OpenFile(infile.c_str(), "rdc", NULL) != ReplayStatus::Succeeded)
+    {
+      std::cerr << "Couldn't load '" << infile << "'." << std::endl;
+      file->Shutdown();
+      return 1;
+    }
+
+    IReplayController *renderer = NULL;
+    ReplayStatus status = ReplayStatus::InternalError;
+    rdctie(status, renderer) = file->OpenCapture(ReplayOptions(), NULL);
+
+    file->Shutdown();
+
+    if(status != ReplayStatus::Succeeded)
+    {
+      std::cerr << "Couldn't load and replay '" << infile << "': " << ToStr(status) << std::endl;
+      return 1;
+    }
+
+    if(eventId == 0)
+    {
+      rdcarray<DrawcallDescription> draws = renderer->GetDrawcalls();
+
+      const DrawcallDescription *last = draws.empty() ? NULL : &draws.back();
+
+      while(last && !last->children.empty())
+        last = &last->children.back();
+
+      if(last)
+        eventId = last->eventId;
+    }
+
+    renderer->SetFrameEvent(eventId, true);
+
+    rdcarray<TextureSave> saves;
+    rdcarray<rdcstr> paths;
+
+    for(const TextureDescription &tex : renderer->GetTextures())
+    {
+      // name the files by the texture's ID, which is stable for a given capture
+      uint64_t id = 0;
+      memcpy(&id, &tex.resourceId, sizeof(id));
+
+      std::string base = outdir + "/" + std::to_string(id);
+
+      TextureSave save;
+      save.resourceId = tex.resourceId;
+      save.destType = type;
+      save.alpha = AlphaMapping::BlendToCheckerboard;
+
+      if(type == FileType::DDS || !allSubresources)
+      {
+        save.mip = type == FileType::DDS ? -1 : 0;
+        save.slice.sliceIndex = type == FileType::DDS ? -1 : 0;
+
+        saves.push_back(save);
+        paths.push_back(conv(base + "." + format));
+        continue;
+      }
+
+      for(uint32_t mip = 0; mip < tex.mips; mip++)
+      {
+        uint32_t numSlices = tex.arraysize * std::max(1U, tex.depth >> mip);
+
+        for(uint32_t slice = 0; slice < numSlices; slice++)
+        {
+          save.mip = (int32_t)mip;
+          save.slice.sliceIndex = (int32_t)slice;
+
+          saves.push_back(save);
+          paths.push_back(conv(base + "_mip" + std::to_string(mip) + "_slice" +
+                               std::to_string(slice) + "." + format));
+        }
+      }
+    }
+
+    std::cout << "Saving " << saves.size() << " textures from event " << eventId << " to '"
+              << outdir << "'." << std::endl;
+
+    rdcarray<bool> saved = renderer->SaveTextures(saves, paths, [](float progress) {
+      std::cout << "\r" << int(progress * 100.0f) << "%" << std::flush;
+    });
+
+    std::cout << std::endl;
+
+    int numFailed = 0;
+
+    for(size_t i = 0; i < saved.size(); i++)
+    {
+      if(!saved[i])
+      {
+        std::cerr << "Couldn't save '" << paths[i] << "'." << std::endl;
+        numFailed++;
+      }
+    }
+
+    renderer->Shutdown();
+
+    std::cout << "Saved " << saves.size() - numFailed << " textures." << std::endl;
+
+    return numFailed > 0 ? 1 : 0;
+  }
+};
+
 struct formats_reader
 {
   formats_reader(bool input)
@@ -1557,6 +1750,7 @@ int renderdoccmd(GlobalEnvironment &env, std::vector<std::string> &argv)
     add_command("capaltbit", new CapAltBitCommand());
     add_command("test", new TestCommand());
     add_command("convert", new ConvertCommand());
+    add_command("texexport", new TexExportCommand());
     add_command("embed", new EmbeddedSectionCommand(false));
     add_command("extract", new EmbeddedSectionCommand(true));
 
@@ -0,0 +1,86 @@
+import rdtest
+import os
+import time
+import renderdoc as rd
+
+
+class Seek_Timing(rdtest.TestCase):
+    slow_test = True
+
+    num_events = 50
+
+    def set_chunk_cache(self, enable: bool):
+        obj: rd.SDObject = rd.SetConfigSetting("Vulkan.ChunkCache")
+        if obj is not None:
+            obj.data.basic.b = enable
+
+    def sample_events(self, controller: rd.ReplayController):
+        draws = []
+
+        def collect(draw: rd.DrawcallDescription):
+            if draw.flags & (rd.DrawFlags.Drawcall | rd.DrawFlags.Dispatch | rd.DrawFlags.Copy | rd.DrawFlags.Clear):
+                draws.append(draw.eventId)
+            for d in draw.children:
+                collect(d)
+
+        for d in controller.GetDrawcalls():
+            collect(d)
+
+        if len(draws) <= self.num_events:
+            return draws
+
+        step = len(draws) / self.num_events
+        return [draws[int(i * step)] for i in range(self.num_events)]
+
+    def time_seeks(self, path, cached: bool):
+        self.set_chunk_cache(cached)
+
+        try:
+            controller = rdtest.open_capture(path)
+        except RuntimeError as err:
+            rdtest.log.print("Skipping. Can't open {}: {}".format(path, err))
+            return None
+
+        events = self.sample_events(controller)
+
+        timings = []
+        pipes = []
+
+        # seek backwards and forwards through the frame, since each seek replays from the start
+        for eid in events + list(reversed(events)):
+            start = time.perf_counter()
+            controller.SetFrameEvent(eid, True)
+            timings.append(time.perf_counter() - start)
+
+            pipe: rd.PipeState = controller.GetPipelineState()
+            pipes.append((eid, pipe.GetGraphicsPipelineObject(), pipe.GetComputePipelineObject()))
+
+        controller.Shutdown()
+
+        if len(timings) == 0:
+            return None
+
+        rdtest.log.print("{} SetFrameEvent over {} events: average {:.2f} ms, max {:.2f} ms".format(
+            "Cached" if cached else "Uncached", len(events), sum(timings) * 1000.0 / len(timings),
+            max(timings) * 1000.0))
+
+        return pipes
+
+    def run(self):
+        dir_path = self.get_ref_path('', extra=True)
+
+        for file in os.scandir(dir_path):
+            rdtest.log.print('Timing event seeks in {}'.format(file.name))
+
+            uncached = self.time_seeks(file.path, False)
+            cached = self.time_seeks(file.path, True)
+
+            self.set_chunk_cache(False)
+
+            if uncached != cached:
+                raise rdtest.TestFailureException("Pipeline state differs with chunk cache enabled in {}"
+                                                  .format(file.name))
+
+            rdtest.log.success("Timed event seeks in {}".format(file.name))
+
+        rdtest.log.success("Timed event seeks in all files")